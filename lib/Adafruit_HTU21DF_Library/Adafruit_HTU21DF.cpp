@@ -52,7 +52,33 @@ boolean Adafruit_HTU21DF::begin(void) {
   //Wire.begin();
 
   reset();
+  return checkAfterReset();
+}
+
+/**
+ * Sends a 'reset' request to the HTU21DF, followed by a 15ms delay.
+ */
+void Adafruit_HTU21DF::reset(void) {
+  startReset();
+  delay(HTU21DF_RESET_MS);
+}
 
+/**
+ * #RVF : Sends a 'reset' request without waiting for it to finish.
+ * Wait HTU21DF_RESET_MS before talking to the sensor again.
+ */
+void Adafruit_HTU21DF::startReset(void) {
+  Wire.beginTransmission(HTU21DF_I2CADDR);
+  Wire.write(HTU21DF_RESET);
+  Wire.endTransmission();
+}
+
+/**
+ * #RVF : Checks if the sensor is in the expected state after a reset.
+ *
+ * @return true if the user register has the default value
+ */
+boolean Adafruit_HTU21DF::checkAfterReset(void) {
   Wire.beginTransmission(HTU21DF_I2CADDR);
   Wire.write(HTU21DF_READREG);
   Wire.endTransmission();
@@ -61,13 +87,86 @@ boolean Adafruit_HTU21DF::begin(void) {
 }
 
 /**
- * Sends a 'reset' request to the HTU21DF, followed by a 15ms delay.
+ * #RVF : Triggers a temperature measurement in no hold master mode.
+ * The sensor doesn't hold the bus while measuring, so the result can be fetched later with fetchMeasurement.
  */
-void Adafruit_HTU21DF::reset(void) {
+void Adafruit_HTU21DF::startTemperature(void) {
   Wire.beginTransmission(HTU21DF_I2CADDR);
-  Wire.write(HTU21DF_RESET);
+  Wire.write(HTU21DF_TRIGGERTEMP_NOHOLD);
+  Wire.endTransmission();
+}
+
+/**
+ * #RVF : Triggers a humidity measurement in no hold master mode.
+ */
+void Adafruit_HTU21DF::startHumidity(void) {
+  Wire.beginTransmission(HTU21DF_I2CADDR);
+  Wire.write(HTU21DF_TRIGGERHUM_NOHOLD);
   Wire.endTransmission();
-  delay(15);
+}
+
+/**
+ * #RVF : Fetches the result of a measurement started with startTemperature or
+ * startHumidity.
+ *
+ * @param raw Measurement with the status bits cleared, if FetchOk is returned
+ * @return FetchNotReady if the sensor is still measuring (it doesn't
+ *         acknowledge the read), FetchCRCError if the checksum doesn't match.
+ */
+Adafruit_HTU21DF::FetchResult Adafruit_HTU21DF::fetchMeasurement(uint16_t &raw) {
+  if (Wire.requestFrom(HTU21DF_I2CADDR, 3) != 3) {
+    return FetchNotReady;
+  }
+
+  uint8_t data[3];
+  for (uint8_t &b : data) {
+    b = Wire.read();
+  }
+
+  if (calcCRC(data, 2) != data[2]) {
+    return FetchCRCError;
+  }
+
+  /* Drop the last two status bits. */
+  raw = (uint16_t(data[0]) << 8) | (data[1] & 0b11111100);
+  return FetchOk;
+}
+
+/**
+ * #RVF : Converts a raw temperature measurement to degrees Celsius.
+ */
+float Adafruit_HTU21DF::rawToTemperature(uint16_t raw) {
+  float temp = raw;
+  temp *= 175.72f;
+  temp /= 65536.0f;
+  temp -= 46.85f;
+  return temp;
+}
+
+/**
+ * #RVF : Converts a raw humidity measurement to relative humidity (0..100.0%).
+ */
+float Adafruit_HTU21DF::rawToHumidity(uint16_t raw) {
+  float hum = raw;
+  hum *= 125.0f;
+  hum /= 65536.0f;
+  hum -= 6.0f;
+  return hum;
+}
+
+/**
+ * #RVF : CRC-8 as used by the HTU21D. Polynomial x^8 + x^5 + x^4 + 1 (0x131),
+ * initial value 0.
+ */
+uint8_t Adafruit_HTU21DF::calcCRC(const uint8_t *data, int len) {
+  uint8_t crc = 0;
+  for (int i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+    }
+  }
+  return crc;
 }
 
 /**
@@ -30,6 +30,22 @@
 /** Reset command. */
 #define HTU21DF_RESET (0xFE)
 
+// #RVF : No hold master commands, for the non-blocking API
+/** Trigger temperature measurement, no hold master. */
+#define HTU21DF_TRIGGERTEMP_NOHOLD (0xF3)
+
+/** Trigger humidity measurement, no hold master. */
+#define HTU21DF_TRIGGERHUM_NOHOLD (0xF5)
+
+/** Maximum time in milliseconds a reset takes. */
+#define HTU21DF_RESET_MS (15)
+
+/** Maximum time in milliseconds a 14 bits temperature measurement takes. */
+#define HTU21DF_TEMP_MEASUREMENT_MS (50)
+
+/** Maximum time in milliseconds a 12 bits humidity measurement takes. */
+#define HTU21DF_HUM_MEASUREMENT_MS (16)
+
 /**
  * Driver for the Adafruit HTU21DF breakout board.
  */
@@ -42,6 +58,19 @@ public:
   float readHumidity(void);
   void reset(void);
 
+  // #RVF : Non-blocking API.
+  // Start a reset/measurement, and then check the result once the respective time (HTU21DF_*_MS) has passed.
+  /** Result of fetchMeasurement */
+  enum FetchResult { FetchOk, FetchNotReady, FetchCRCError };
+  void startReset(void);
+  boolean checkAfterReset(void);
+  void startTemperature(void);
+  void startHumidity(void);
+  FetchResult fetchMeasurement(uint16_t &raw);
+  static float rawToTemperature(uint16_t raw);
+  static float rawToHumidity(uint16_t raw);
+  static uint8_t calcCRC(const uint8_t *data, int len);
+
 private:
   boolean readData(void);
   float _last_humidity, _last_temp;
@@ -128,8 +128,14 @@ uint16_t Adafruit_MCP23017::readGPIOAB() {
 }
 
 void Adafruit_MCP23017::writeGPIOAB(uint16_t ba) {
+  writeRegisterAB(MCP23017_GPIOA, ba);
+}
+
+void Adafruit_MCP23017::writeRegisterAB(uint8_t regA, uint16_t ba) {
+  // With IOCON.BANK=0 (the default), the B register follows the A register,
+  // and the address pointer increments automatically
   WIRE.beginTransmission(MCP23017_ADDRESS | i2caddr);
-  wiresend(MCP23017_GPIOA);
+  wiresend(regA);
   wiresend(ba & 0xFF);
   wiresend(ba >> 8);
   WIRE.endTransmission();
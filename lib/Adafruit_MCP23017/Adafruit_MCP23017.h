@@ -28,6 +28,11 @@ public:
   void writeGPIOAB(uint16_t);
   uint16_t readGPIOAB();
 
+  /*
+   * Writes both the A and B registers of a pair (e.g: MCP23017_IODIRA) in one transaction
+   */
+  void writeRegisterAB(uint8_t regA, uint16_t ba);
+
   /*
    * Returns the address of the device 0..7
    */
@@ -0,0 +1,384 @@
+#pragma once
+
+/*
+ * Minimal Arduino API for host builds. See README.md
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+// Same as ArduinoCore-API, which allows mixing types (e.g: min(uint16_t, int))
+template<class T, class L>
+inline auto min(const T& a, const L& b) -> decltype((b < a) ? b : a)
+{
+	return (b < a) ? b : a;
+}
+
+template<class T, class L>
+inline auto max(const T& a, const L& b) -> decltype((b < a) ? b : a)
+{
+	return (a < b) ? b : a;
+}
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define PI 3.1415926535897932384626433832795
+#define LED_BUILTIN 25
+#define NUM_DIGITAL_PINS 30
+
+enum PinStatus
+{
+	LOW = 0,
+	HIGH = 1,
+	CHANGE = 2,
+	FALLING = 3,
+	RISING = 4
+};
+
+enum PinMode
+{
+	INPUT = 0x0,
+	OUTPUT = 0x1,
+	INPUT_PULLUP = 0x2,
+	INPUT_PULLDOWN = 0x3
+};
+
+//
+// Program memory. The host has none, so it's all just plain memory
+//
+class __FlashStringHelper;
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(PSTR(s)))
+#define pgm_read_byte(addr) (*reinterpret_cast<const uint8_t*>(addr))
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strcasecmp_P strcasecmp
+#define strncpy_P strncpy
+#define memcpy_P memcpy
+#define vsnprintf_P vsnprintf
+
+//
+// Time
+//
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+//
+// Pins
+//
+void pinMode(uint8_t pin, PinMode mode);
+void digitalWrite(uint8_t pin, PinStatus status);
+PinStatus digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogReadResolution(int bits);
+void analogWrite(uint8_t pin, int value);
+void analogWriteFreq(uint32_t freq);
+void analogWriteRange(uint32_t range);
+
+inline int digitalPinToInterrupt(int pin)
+{
+	return pin;
+}
+
+void attachInterrupt(int interrupt, void (*callback)(), PinStatus mode);
+void detachInterrupt(int interrupt);
+
+inline void noInterrupts()
+{
+}
+
+inline void interrupts()
+{
+}
+
+//
+// Math
+//
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+	return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+template<typename T, typename L, typename H>
+inline auto constrain(T x, L low, H high) -> decltype(x < low ? low : (x > high ? high : x))
+{
+	return x < low ? low : (x > high ? high : x);
+}
+
+//
+// Strings
+//
+class String
+{
+  public:
+	String() = default;
+	String(const char* s) : m_str(s ? s : "") {}
+	String(const __FlashStringHelper* s) : String(reinterpret_cast<const char*>(s)) {}
+	explicit String(int v) : m_str(std::to_string(v)) {}
+	explicit String(unsigned int v) : m_str(std::to_string(v)) {}
+	explicit String(long v) : m_str(std::to_string(v)) {}
+	explicit String(unsigned long v) : m_str(std::to_string(v)) {}
+
+	const char* c_str() const
+	{
+		return m_str.c_str();
+	}
+
+	unsigned int length() const
+	{
+		return static_cast<unsigned int>(m_str.size());
+	}
+
+	char* begin()
+	{
+		return &m_str[0];
+	}
+
+	char* end()
+	{
+		return &m_str[0] + m_str.size();
+	}
+
+	char operator[](unsigned int index) const
+	{
+		return index < m_str.size() ? m_str[index] : 0;
+	}
+
+	bool reserve(unsigned int size)
+	{
+		m_str.reserve(size);
+		return true;
+	}
+
+	String& operator+=(const char* s)
+	{
+		m_str += s;
+		return *this;
+	}
+
+	String& operator+=(const String& s)
+	{
+		m_str += s.m_str;
+		return *this;
+	}
+
+	String& operator+=(char c)
+	{
+		m_str += c;
+		return *this;
+	}
+
+	bool operator==(const char* s) const
+	{
+		return m_str == s;
+	}
+
+	bool operator!=(const char* s) const
+	{
+		return m_str != s;
+	}
+
+	bool operator==(const String& s) const
+	{
+		return m_str == s.m_str;
+	}
+
+	bool operator!=(const String& s) const
+	{
+		return m_str != s.m_str;
+	}
+
+	friend String operator+(const String& a, const char* b)
+	{
+		String res(a);
+		res += b;
+		return res;
+	}
+
+	friend String operator+(const String& a, const String& b)
+	{
+		String res(a);
+		res += b;
+		return res;
+	}
+
+  private:
+	std::string m_str;
+};
+
+//
+// Serial ports
+//
+class Print
+{
+  public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t* buffer, size_t size);
+
+	size_t write(const char* str)
+	{
+		return str ? write(reinterpret_cast<const uint8_t*>(str), strlen(str)) : 0;
+	}
+
+	virtual void flush()
+	{
+	}
+
+	size_t print(const __FlashStringHelper* str);
+	size_t print(const char* str);
+	size_t print(const String& str);
+	size_t print(char c);
+	size_t print(int v);
+	size_t print(unsigned int v);
+	size_t print(long v);
+	size_t print(unsigned long v);
+	size_t print(double v);
+	size_t println();
+	template<typename T>
+	size_t println(const T& v)
+	{
+		size_t res = print(v);
+		return res + println();
+	}
+	size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print
+{
+  public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+};
+
+/*
+ * Writes to stdout. Reading never has any data.
+ */
+class HardwareSerial : public Stream
+{
+  public:
+	void begin(unsigned long baud)
+	{
+	}
+
+	void end()
+	{
+	}
+
+	operator bool() const
+	{
+		return true;
+	}
+
+	virtual int available() override
+	{
+		return 0;
+	}
+
+	virtual int read() override
+	{
+		return -1;
+	}
+
+	virtual int peek() override
+	{
+		return -1;
+	}
+
+	virtual size_t write(uint8_t c) override;
+	virtual size_t write(const uint8_t* buffer, size_t size) override;
+	using Print::write;
+	virtual void flush() override;
+};
+
+/*
+ * Arduino-Pico's UART class, so the code configuring the pins compiles
+ */
+class SerialUART : public HardwareSerial
+{
+  public:
+	bool setRX(int pin)
+	{
+		return true;
+	}
+
+	bool setTX(int pin)
+	{
+		return true;
+	}
+
+	bool setFIFOSize(size_t size)
+	{
+		return true;
+	}
+};
+
+extern HardwareSerial Serial;
+extern SerialUART Serial1;
+extern SerialUART Serial2;
+
+//
+// Arduino-Pico's rp2040 object
+//
+class RP2040
+{
+  public:
+	// Exits the process
+	void reboot();
+	void wdt_begin(uint32_t delayMs)
+	{
+	}
+	void wdt_reset()
+	{
+	}
+
+	// Heap usage of the host process, if the C library provides it, or 0 otherwise
+	int getUsedHeap();
+	int getTotalHeap();
+	int getFreeHeap();
+	uint32_t f_cpu()
+	{
+		return 133000000;
+	}
+};
+
+extern RP2040 rp2040;
+
+//
+// Host only API, for tests and simulations
+//
+namespace arduino_native
+{
+	uint64_t getMicros();
+	void setMicros(uint64_t micros);
+	void advanceMicros(uint64_t micros);
+	// If enabled, time also moves with the host's clock, so measuring how long something took works.
+	// delay() still skips ahead without waiting.
+	void setRealTime(bool enabled);
+
+	// Value that digitalRead returns for the specified pin, until the pin is written to
+	void setDigitalInput(uint8_t pin, PinStatus status);
+	// Value that analogRead returns for the specified pin
+	void setAnalogInput(uint8_t pin, int value);
+	int getAnalogOutput(uint8_t pin);
+
+	// Calls the callback registered with attachInterrupt for the specified pin, if any
+	void triggerInterrupt(int interrupt);
+}
@@ -0,0 +1,326 @@
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "Wire.h"
+#include <stdarg.h>
+#include <random>
+#include <chrono>
+#if defined(__GLIBC__)
+	#include <malloc.h>
+#endif
+
+HardwareSerial Serial;
+SerialUART Serial1;
+SerialUART Serial2;
+RP2040 rp2040;
+TwoWire Wire;
+TwoWire Wire1;
+EEPROMClass EEPROM;
+
+namespace
+{
+	uint64_t gNowMicros = 0;
+	bool gRealTime = false;
+	std::chrono::steady_clock::time_point gRealTimeStart;
+	PinStatus gDigitalPins[NUM_DIGITAL_PINS] = {};
+	int gAnalogInputs[NUM_DIGITAL_PINS] = {};
+	int gAnalogOutputs[NUM_DIGITAL_PINS] = {};
+	void (*gInterrupts[NUM_DIGITAL_PINS])() = {};
+	std::minstd_rand gRandom;
+
+	uint64_t getNowMicros()
+	{
+		if (!gRealTime)
+		{
+			return gNowMicros;
+		}
+
+		auto elapsed = std::chrono::steady_clock::now() - gRealTimeStart;
+		return gNowMicros + std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+	}
+}
+
+//
+// Time
+//
+unsigned long millis()
+{
+	return static_cast<unsigned long>(getNowMicros() / 1000);
+}
+
+unsigned long micros()
+{
+	return static_cast<unsigned long>(getNowMicros());
+}
+
+void delay(unsigned long ms)
+{
+	gNowMicros += static_cast<uint64_t>(ms) * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	gNowMicros += us;
+}
+
+void yield()
+{
+}
+
+//
+// Pins
+//
+void pinMode(uint8_t pin, PinMode mode)
+{
+}
+
+void digitalWrite(uint8_t pin, PinStatus status)
+{
+	if (pin < NUM_DIGITAL_PINS)
+	{
+		gDigitalPins[pin] = status;
+	}
+}
+
+PinStatus digitalRead(uint8_t pin)
+{
+	return pin < NUM_DIGITAL_PINS ? gDigitalPins[pin] : LOW;
+}
+
+int analogRead(uint8_t pin)
+{
+	return pin < NUM_DIGITAL_PINS ? gAnalogInputs[pin] : 0;
+}
+
+void analogReadResolution(int bits)
+{
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+	if (pin < NUM_DIGITAL_PINS)
+	{
+		gAnalogOutputs[pin] = value;
+	}
+}
+
+void analogWriteFreq(uint32_t freq)
+{
+}
+
+void analogWriteRange(uint32_t range)
+{
+}
+
+void attachInterrupt(int interrupt, void (*callback)(), PinStatus mode)
+{
+	if (interrupt >= 0 && interrupt < NUM_DIGITAL_PINS)
+	{
+		gInterrupts[interrupt] = callback;
+	}
+}
+
+void detachInterrupt(int interrupt)
+{
+	attachInterrupt(interrupt, nullptr, LOW);
+}
+
+//
+// Math
+//
+long random(long max)
+{
+	return max > 0 ? static_cast<long>(gRandom() % static_cast<unsigned long>(max)) : 0;
+}
+
+long random(long min, long max)
+{
+	return min < max ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed)
+{
+	gRandom.seed(static_cast<std::minstd_rand::result_type>(seed));
+}
+
+//
+// Print
+//
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--)
+	{
+		n += write(*buffer++);
+	}
+	return n;
+}
+
+size_t Print::print(const __FlashStringHelper* str)
+{
+	return write(reinterpret_cast<const char*>(str));
+}
+
+size_t Print::print(const char* str)
+{
+	return write(str);
+}
+
+size_t Print::print(const String& str)
+{
+	return write(str.c_str());
+}
+
+size_t Print::print(char c)
+{
+	return write(static_cast<uint8_t>(c));
+}
+
+size_t Print::print(int v)
+{
+	return printf("%d", v);
+}
+
+size_t Print::print(unsigned int v)
+{
+	return printf("%u", v);
+}
+
+size_t Print::print(long v)
+{
+	return printf("%ld", v);
+}
+
+size_t Print::print(unsigned long v)
+{
+	return printf("%lu", v);
+}
+
+size_t Print::print(double v)
+{
+	return printf("%.2f", v);
+}
+
+size_t Print::println()
+{
+	return write("\r\n");
+}
+
+size_t Print::printf(const char* fmt, ...)
+{
+	char buf[256];
+	va_list args;
+	va_start(args, fmt);
+	int len = vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	if (len < 0)
+	{
+		return 0;
+	}
+	return write(reinterpret_cast<const uint8_t*>(buf), std::min(static_cast<size_t>(len), sizeof(buf) - 1));
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+	return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+	return fwrite(buffer, 1, size, stdout);
+}
+
+void HardwareSerial::flush()
+{
+	fflush(stdout);
+}
+
+//
+// RP2040
+//
+void RP2040::reboot()
+{
+	fflush(stdout);
+	exit(0);
+}
+
+int RP2040::getUsedHeap()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	return static_cast<int>(mallinfo2().uordblks);
+#else
+	return 0;
+#endif
+}
+
+int RP2040::getTotalHeap()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	return static_cast<int>(mallinfo2().arena);
+#else
+	return 0;
+#endif
+}
+
+int RP2040::getFreeHeap()
+{
+	return getTotalHeap() - getUsedHeap();
+}
+
+//
+// Host only API
+//
+namespace arduino_native
+{
+
+uint64_t getMicros()
+{
+	return getNowMicros();
+}
+
+void setMicros(uint64_t micros)
+{
+	gNowMicros = micros;
+	gRealTimeStart = std::chrono::steady_clock::now();
+}
+
+void setRealTime(bool enabled)
+{
+	setMicros(getNowMicros());
+	gRealTime = enabled;
+}
+
+void advanceMicros(uint64_t micros)
+{
+	gNowMicros += micros;
+}
+
+void setDigitalInput(uint8_t pin, PinStatus status)
+{
+	if (pin < NUM_DIGITAL_PINS)
+	{
+		gDigitalPins[pin] = status;
+	}
+}
+
+void setAnalogInput(uint8_t pin, int value)
+{
+	if (pin < NUM_DIGITAL_PINS)
+	{
+		gAnalogInputs[pin] = value;
+	}
+}
+
+int getAnalogOutput(uint8_t pin)
+{
+	return pin < NUM_DIGITAL_PINS ? gAnalogOutputs[pin] : 0;
+}
+
+void triggerInterrupt(int interrupt)
+{
+	if (interrupt >= 0 && interrupt < NUM_DIGITAL_PINS && gInterrupts[interrupt])
+	{
+		gInterrupts[interrupt]();
+	}
+}
+
+} // namespace arduino_native
@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+ * Arduino-Pico's EEPROM emulation, kept in memory. Nothing survives the process exiting.
+ */
+
+#include "Arduino.h"
+
+class EEPROMClass
+{
+  public:
+	EEPROMClass()
+	{
+		// Flash is erased to 0xFF
+		memset(m_data, 0xFF, sizeof(m_data));
+	}
+
+	void begin(size_t size)
+	{
+		m_size = std::min(size, sizeof(m_data));
+	}
+
+	bool end()
+	{
+		return commit();
+	}
+
+	bool commit()
+	{
+		return true;
+	}
+
+	uint8_t read(int address)
+	{
+		return (address >= 0 && static_cast<size_t>(address) < m_size) ? m_data[address] : 0;
+	}
+
+	void write(int address, uint8_t value)
+	{
+		if (address >= 0 && static_cast<size_t>(address) < m_size)
+		{
+			m_data[address] = value;
+		}
+	}
+
+	uint16_t length() const
+	{
+		return static_cast<uint16_t>(m_size);
+	}
+
+  private:
+	uint8_t m_data[4096];
+	size_t m_size = 0;
+};
+
+extern EEPROMClass EEPROM;
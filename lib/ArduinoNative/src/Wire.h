@@ -0,0 +1,129 @@
+#pragma once
+
+/*
+ * I2C bus with nothing connected to it. Every transmission is NACKed, and reads return no data.
+ * Tests can connect their own devices with TwoWire::setDevice.
+ */
+
+#include "Arduino.h"
+
+namespace arduino_native
+{
+	/**
+	 * Something connected to a native I2C bus
+	 */
+	class I2CDevice
+	{
+	  public:
+		virtual ~I2CDevice() = default;
+		// Bytes written in one transmission. Returns false to NACK
+		virtual bool onWrite(const uint8_t* data, size_t len) = 0;
+		// Fills `data` with up to `quantity` bytes, and returns how many. 0 is a NACK
+		virtual size_t onRead(uint8_t* data, size_t quantity) = 0;
+	};
+}
+
+class TwoWire : public Stream
+{
+  public:
+	bool setSDA(int pin)
+	{
+		return true;
+	}
+
+	bool setSCL(int pin)
+	{
+		return true;
+	}
+
+	void setClock(uint32_t freq)
+	{
+	}
+
+	void begin()
+	{
+	}
+
+	void end()
+	{
+	}
+
+	void beginTransmission(uint8_t address)
+	{
+		m_address = address;
+		m_txLen = 0;
+	}
+
+	// 2 is "received NACK on transmit of address"
+	uint8_t endTransmission(bool stopBit = true)
+	{
+		arduino_native::I2CDevice* device = getDevice(m_address);
+		return device && device->onWrite(m_tx, m_txLen) ? 0 : 2;
+	}
+
+	size_t requestFrom(uint8_t address, size_t quantity, bool stopBit = true)
+	{
+		arduino_native::I2CDevice* device = getDevice(address);
+		m_rxPos = 0;
+		m_rxLen = device ? device->onRead(m_rx, quantity < sizeof(m_rx) ? quantity : sizeof(m_rx)) : 0;
+		return m_rxLen;
+	}
+
+	virtual size_t write(uint8_t data) override
+	{
+		if (m_txLen == sizeof(m_tx))
+		{
+			return 0;
+		}
+		m_tx[m_txLen++] = data;
+		return 1;
+	}
+
+	using Print::write;
+
+	virtual int available() override
+	{
+		return static_cast<int>(m_rxLen - m_rxPos);
+	}
+
+	virtual int read() override
+	{
+		return m_rxPos < m_rxLen ? m_rx[m_rxPos++] : -1;
+	}
+
+	virtual int peek() override
+	{
+		return m_rxPos < m_rxLen ? m_rx[m_rxPos] : -1;
+	}
+
+	//
+	// Host only API
+	//
+
+	// Connects a device to the bus (or disconnects it, if nullptr)
+	void setDevice(uint8_t address, arduino_native::I2CDevice* device)
+	{
+		if (address < 128)
+		{
+			m_devices[address] = device;
+		}
+	}
+
+  private:
+	arduino_native::I2CDevice* getDevice(uint8_t address) const
+	{
+		return address < 128 ? m_devices[address] : nullptr;
+	}
+
+	arduino_native::I2CDevice* m_devices[128] = {};
+	uint8_t m_address = 0;
+	// Same buffer size as the Arduino AVR Wire
+	uint8_t m_tx[32];
+	size_t m_txLen = 0;
+	uint8_t m_rx[32];
+	size_t m_rxLen = 0;
+	size_t m_rxPos = 0;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
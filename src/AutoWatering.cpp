@@ -6,15 +6,26 @@
 #include "SoilMoistureSensor.h"
 #include "PumpMonitor.h"
 #include "Timer.h"
+#include "LowPowerIdle.h"
+#if AW_WIFI_ENABLED
+	#include "WifiManager.h"
+#endif
+#if AW_MQTTUI_ENABLED
+	#include "MQTTCache.h"
+#endif
 #include "crazygaze/micromuc/Logging.h"
 #include <algorithm>
 #include <utility>
 #include <memory>
 
-#include "crazygaze/micromuc/SDLogOutput.h"
+#if AW_SD_CARD_LOGGING
+	#include "crazygaze/micromuc/SDLogOutput.h"
+#endif
 #include "crazygaze/micromuc/Profiler.h"
-#include "gfx/TFTeSPIWrapper.h"
-#include "crazygaze/TouchController/XPT2046.h"
+#if AW_TOUCHUI_ENABLED
+	#include "gfx/TFTeSPIWrapper.h"
+	#include "crazygaze/TouchController/XPT2046.h"
+#endif
 #include <memory>
 #include <vector>
 
@@ -26,11 +37,6 @@ using namespace cz;
 #endif
 
 
-namespace cz
-{
-	Setup* gSetup;
-}
-
 namespace cz
 {
 #if AW_TOUCHUI_ENABLED
@@ -171,9 +177,96 @@ void loop()
 		countdown = std::min(Component::tickAll(deltaSeconds), countdown);
 	}
 
+#if AW_MOCK_TIME_SCALE != 1
+	// The countdown is in accelerated time
+	countdown /= AW_MOCK_TIME_SCALE;
+#endif
+
+#if AW_LOWPOWER_IDLE_ENABLED
+	gLowPowerIdle.idle(countdown);
+#else
 	{
-		unsigned long ms = static_cast<unsigned long>(countdown * 1000);
+		// Rounding up, otherwise a countdown that isn't a whole number of milliseconds ends with loop() spinning with
+		// delay(0) until the fraction is gone
+		unsigned long ms = static_cast<unsigned long>(ceilf(countdown * 1000));
 		delay(ms);
 	}
+#endif
 
 }
+
+#if AW_NATIVE && !defined(PIO_UNIT_TESTING)
+//
+// The native_sim environment has no Arduino core to call setup()/loop(), so this runs them for AW_NATIVE_SIM_SECONDS
+// of simulated time, and logs the stats at the end.
+// Time follows the host's clock, so the CPU times are real, but idle time is skipped.
+//
+int main(int argc, char** argv)
+{
+	arduino_native::setRealTime(true);
+	setup();
+
+	// The simulated EEPROM starts empty, so start with the default config (same as resetting it from the boot menu),
+	// with all the groups running
+	gCtx.data.save();
+	for (int idx = 0; idx < AW_MAX_NUM_PAIRS; idx++)
+	{
+		gCtx.data.getGroupData(idx).setRunning(true);
+	}
+
+	while (arduino_native::getMicros() < static_cast<uint64_t>(AW_NATIVE_SIM_SECONDS) * 1000000)
+	{
+		loop();
+	}
+
+	CZ_LOG(logDefault, Log, "Simulated %s days in %u loop() calls", *FloatToString(gTimer.getTotalSeconds() / 86400.0f),
+		static_cast<unsigned int>(gTickCount));
+	Component::logSchedulerStats();
+	Component::logWakeups();
+	Component::logEventStats();
+	Component::logComponentStats();
+	Component::logTickStats();
+	LogOutput::flush();
+	return 0;
+}
+#endif
+
+#if AW_NETWORK_ON_CORE1
+
+#include <pico/time.h>
+
+namespace cz
+{
+	Timer gCore1Timer;
+}
+
+//
+// Core 1 only runs the blocking side of WifiManager and MQTTCache. See AW_NETWORK_ON_CORE1
+//
+void setup1()
+{
+	// Wait until core 0 finished setup() and got the configuration
+	while (!WifiManager::getInstance()->isCore1Started())
+	{
+		delay(10);
+	}
+
+	// No CZ_LOG from here on, since it's not safe to use from core 1 (see Core1Log.h)
+	gCore1Timer.begin();
+}
+
+void loop1()
+{
+	gCore1Timer.update();
+	const float deltaSeconds = gCore1Timer.getDeltaSeconds();
+
+	float countdown = WifiManager::getInstance()->core1Tick(deltaSeconds);
+#if AW_MQTTUI_ENABLED
+	countdown = std::min(MQTTCache::getInstance()->core1Tick(deltaSeconds), countdown);
+#endif
+
+	// Core 0 does a __sev() when it posts work to us, so this wakes up early if there is work to do
+	best_effort_wfe_or_timeout(make_timeout_time_us(static_cast<uint64_t>(countdown * 1000000)));
+}
+
+#endif
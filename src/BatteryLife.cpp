@@ -9,6 +9,7 @@ BatteryLife::BatteryLife()
 {
 	// We only start ticking when we ready a ConfigReady event
 	stopTicking();
+	subscribe(Event::ConfigReady);
 }
 
 float BatteryLife::tick(float deltaSeconds)
@@ -1,56 +1,33 @@
 #include "CommandConsole.h"
+#include "LowPowerIdle.h"
+#include "PumpMonitor.h"
+#include "SharedPump.h"
+#include "SoilMoistureSensor.h"
+#include "utility/PWMMotorPin.h"
 #include <crazygaze/micromuc/Profiler.h>
+#include <iterator>
 
 namespace cz
 {
 
+volatile int gProfilerCount = 0;
+
 //
-// CommandConsole
+// Commands handled by the console itself (commands without a component prefix)
 //
-CommandConsole::CommandConsole()
-{
-}
-
-bool CommandConsole::initImpl()
+static const Component::CommandEntry gConsoleCommands[] =
 {
-	m_serialStringReader.begin(AW_CUSTOM_SERIAL);
-	return true;
-}
-
-float CommandConsole::tick(float deltaSeconds)
-{
-	PROFILE_SCOPE(F("CommandConsole::tick"));
-
-	//CZ_LOG(logDefault, Log, "CommandConsole::tick");
-	while (m_serialStringReader.tryRead())
+	{"batch_begin", [](Component& component, const Command& cmd)
 	{
-		//CZ_LOG(logDefault, Log, "    %u", millis());
-
-		Command cmd(m_serialStringReader.retrieve());
-		if (!cmd.parseCmd())
-		{
-			continue;
-		}
-
-		if (cmd.targetComponent == nullptr)
-		{
-			cmd.targetComponent = this;
-		}
-
-		if (!cmd.targetComponent->processCommand(cmd))
-		{
-			CZ_LOG(logDefault, Error, "Failed to execute %s.%s command", cmd.targetComponent->getName(), cmd.cmd);
-		}
-
-	}
-	return 0.250f;
-}
-
-
-volatile int gProfilerCount = 0;
-bool CommandConsole::processCommand(const Command& cmd)
-{
-	if (cmd.is("setdevicename"))
+		static_cast<CommandConsole&>(component).beginBatch();
+		return true;
+	}},
+	{"batch_end", [](Component& component, const Command& cmd)
+	{
+		static_cast<CommandConsole&>(component).endBatch();
+		return true;
+	}},
+	{"setdevicename", [](Component&, const Command& cmd)
 	{
 		char deviceName[AW_DEVICENAME_MAX_LEN+1];
 		if (cmd.parseParams(deviceName))
@@ -58,26 +35,231 @@ bool CommandConsole::processCommand(const Command& cmd)
 			gCtx.data.setDeviceName(deviceName);
 			return true;
 		}
-	}
-	else if (cmd.is("profiler_log"))
+		return false;
+	}},
+	{"profiler_log", [](Component&, const Command& cmd)
 	{
 		gProfilerCount++; 
 		PROFILER_LOG();
+		Component::logEventStats();
 		gProfilerCount--; 
 		return true;
-	}
-	else if (cmd.is("profiler_reset"))
+	}},
+	{"profiler_reset", [](Component&, const Command& cmd)
 	{
 		PROFILER_RESET();
+		Component::resetEventStats();
 		return true;
-	}
-	else if (cmd.is("heapinfo"))
+	}},
+	{"schedulerstats", [](Component&, const Command& cmd)
+	{
+		Component::logSchedulerStats();
+		return true;
+	}},
+	{"wakeups", [](Component&, const Command& cmd)
+	{
+		Component::logWakeups();
+		return true;
+	}},
+	{"schedulerstats_reset", [](Component&, const Command& cmd)
+	{
+		Component::resetSchedulerStats();
+		return true;
+	}},
+	{"componentstats", [](Component&, const Command& cmd)
+	{
+		Component::logComponentStats();
+		return true;
+	}},
+	{"componentstats_reset", [](Component&, const Command& cmd)
+	{
+		Component::resetComponentStats();
+		return true;
+	}},
+	{"boottimings", [](Component&, const Command& cmd)
+	{
+		Component::logBootTimings();
+		return true;
+	}},
+	{"tickstats", [](Component&, const Command& cmd)
+	{
+		Component::logTickStats();
+		return true;
+	}},
+	{"tickbudget", [](Component&, const Command& cmd)
+	{
+		char name[30];
+		int ms;
+		if (cmd.parseParams(name, ms))
+		{
+			if (Component* component = Component::getByName(name))
+			{
+				component->setTickBudget(ms / 1000.0f);
+				return true;
+			}
+			CZ_LOG(logDefault, Error, "No component with name '%s' found", name);
+		}
+		return false;
+	}},
+#if AW_LOWPOWER_IDLE_ENABLED
+	{"idlestats", [](Component&, const Command& cmd)
+	{
+		gLowPowerIdle.logStats();
+		return true;
+	}},
+	{"idlestats_reset", [](Component&, const Command& cmd)
+	{
+		gLowPowerIdle.resetStats();
+		return true;
+	}},
+#endif
+	{"heapinfo", [](Component&, const Command& cmd)
 	{
 		CZ_LOG(logDefault, Log, "HEAP INFO: size=%d, used=%d, free=%d", rp2040.getTotalHeap(), rp2040.getUsedHeap(),
 		       rp2040.getFreeHeap());
 		return true;
-	}
-	else if (cmd.is("setgroupthreshold"))
+	}},
+	{"adccapture", [](Component&, const Command& cmd)
+	{
+		int numSamples, sampleRate;
+		if (cmd.parseParams(numSamples, sampleRate) && numSamples > 0 && sampleRate > 0)
+		{
+			RealSoilMoistureSensor::setCaptureSettings(numSamples, sampleRate);
+			return true;
+		}
+		return false;
+	}},
+	{"sweepstats", [](Component&, const Command& cmd)
+	{
+		RealSoilMoistureSensor::logSweepStats();
+		return true;
+	}},
+	{"sweepstats_reset", [](Component&, const Command& cmd)
+	{
+		RealSoilMoistureSensor::resetSweepStats();
+		return true;
+	}},
+	{"adaptivesampling", [](Component&, const Command& cmd)
+	{
+		int enabled;
+		if (cmd.parseParams(enabled))
+		{
+			RealSoilMoistureSensor::setAdaptiveSampling(enabled != 0);
+			return true;
+		}
+		return false;
+	}},
+	{"pumpcontroller", [](Component&, const Command& cmd)
+	{
+		int mode;
+		if (cmd.parseParams(mode) && mode >= 0 && mode <= static_cast<int>(PumpMonitor::ControllerMode::PulseAndSoak))
+		{
+			PumpMonitor::setControllerMode(static_cast<PumpMonitor::ControllerMode>(mode));
+			return true;
+		}
+		return false;
+	}},
+	{"pumpsched", [](Component&, const Command& cmd)
+	{
+		PumpMonitor::logScheduler();
+		return true;
+	}},
+#if AW_ADC_CAPTURE_ENABLED && AW_ADC_CAPTURE_SIMULATED
+	{"pumpfault", [](Component&, const Command& cmd)
+	{
+		int idx, fault;
+		float faultTime;
+		if (cmd.parseParams(idx, fault, faultTime) && idx >= 0 && idx < AW_MAX_NUM_PAIRS &&
+			fault >= 0 && fault <= static_cast<int>(PumpCurrentDetector::Fault::OpenCircuit))
+		{
+			gSetup->getPumpMonitor(idx)->setMockFault(static_cast<PumpCurrentDetector::Fault>(fault), faultTime);
+			return true;
+		}
+		return false;
+	}},
+#endif
+#if AW_PUMP_PWM_SIMULATED
+	{"pumppwm", [](Component&, const Command& cmd)
+	{
+		for (PWMMotorPin* pin = PWMMotorPin::getFirst(); pin; pin = pin->getNext())
+		{
+			pin->logTimeline();
+		}
+		return true;
+	}},
+	{"pumppwm_clear", [](Component&, const Command& cmd)
+	{
+		for (PWMMotorPin* pin = PWMMotorPin::getFirst(); pin; pin = pin->getNext())
+		{
+			pin->clearTimeline();
+		}
+		return true;
+	}},
+#endif
+#if AW_PUMP_SHARED
+	{"sharedpump", [](Component&, const Command& cmd)
+	{
+		gSetup->getSharedPump()->logStats();
+		return true;
+	}},
+	{"sharedpump_reset", [](Component&, const Command& cmd)
+	{
+		gSetup->getSharedPump()->resetStats();
+		return true;
+	}},
+#endif
+	{"drift", [](Component&, const Command& cmd)
+	{
+		for (int idx = 0; idx < AW_MAX_NUM_PAIRS; idx++)
+		{
+			gCtx.data.getGroupData(idx).logSensorDrift();
+		}
+		return true;
+	}},
+	{"driftapply", [](Component&, const Command& cmd)
+	{
+		uint8_t idx;
+		if (cmd.parseParams(idx) && idx < AW_MAX_NUM_PAIRS)
+		{
+			gCtx.data.getGroupData(idx).applySensorDriftProposal();
+			return true;
+		}
+		return false;
+	}},
+	{"tempcomp", [](Component&, const Command& cmd)
+	{
+		uint8_t idx;
+		int coldSlope, hotSlope, reference;
+		if (cmd.parseParams(idx, coldSlope, hotSlope, reference) && idx < AW_MAX_NUM_PAIRS)
+		{
+			TemperatureCompensation compensation;
+			compensation.coldSlopeQ8 = coldSlope;
+			compensation.hotSlopeQ8 = hotSlope;
+			compensation.referenceTemperature = reference;
+			gCtx.data.getGroupData(idx).setTemperatureCompensation(compensation);
+			return true;
+		}
+		return false;
+	}},
+	{"tempcomp_learn", [](Component&, const Command& cmd)
+	{
+		uint8_t idx;
+		if (cmd.parseParams(idx) && idx < AW_MAX_NUM_PAIRS)
+		{
+			gCtx.data.getGroupData(idx).applyLearnedTemperatureCompensation();
+			return true;
+		}
+		return false;
+	}},
+	{"tempcomp_log", [](Component&, const Command& cmd)
+	{
+		for (int idx = 0; idx < AW_MAX_NUM_PAIRS; idx++)
+		{
+			gCtx.data.getGroupData(idx).logTemperatureCompensation();
+		}
+		return true;
+	}},
+	{"setgroupthreshold", [](Component&, const Command& cmd)
 	{
 		int idx, value;
 		if (cmd.parseParams(idx, value) && idx < AW_MAX_NUM_PAIRS)
@@ -85,8 +267,34 @@ bool CommandConsole::processCommand(const Command& cmd)
 			gCtx.data.getGroupData(idx).setThresholdValue(value);
 			return true;
 		}
-	}
-	else if (cmd.is("setgroupthresholdaspercentage"))
+		return false;
+	}},
+	{"setgroupshotvolume", [](Component&, const Command& cmd)
+	{
+		int idx, value;
+		if (cmd.parseParams(idx, value) && idx >= 0 && idx < AW_MAX_NUM_PAIRS && value >= 0 && value <= AW_SHOT_MAX_VOLUME)
+		{
+			gCtx.data.getGroupData(idx).setShotVolume(value);
+			return true;
+		}
+		return false;
+	}},
+	{"flow", [](Component&, const Command& cmd)
+	{
+		for (int idx = 0; idx < AW_MAX_NUM_PAIRS; idx++)
+		{
+			GroupData& data = gCtx.data.getGroupData(idx);
+			CZ_LOG(logDefault, Log, F("Group %d: shotVolume=%umL, totalVolume=%umL")
+				, idx
+				, data.getShotVolume()
+				, static_cast<unsigned int>(data.getTotalVolume()));
+		}
+	#if AW_FLOW_METER_SIMULATED
+		CZ_LOG(logDefault, Log, F("Simulated water tank level: %s%%"), *FloatToString(FlowMeter::getSimulatedTankLevel() * 100));
+	#endif
+		return true;
+	}},
+	{"setgroupthresholdaspercentage", [](Component&, const Command& cmd)
 	{
 		int idx, value;
 		if (cmd.parseParams(idx, value) && idx < AW_MAX_NUM_PAIRS)
@@ -94,8 +302,9 @@ bool CommandConsole::processCommand(const Command& cmd)
 			gCtx.data.getGroupData(idx).setThresholdValueAsPercentage(value);
 			return true;
 		}
-	}
-	else if (cmd.is("startgroup"))
+		return false;
+	}},
+	{"startgroup", [](Component&, const Command& cmd)
 	{
 		int idx;
 		if (cmd.parseParams(idx) && idx < AW_MAX_NUM_PAIRS)
@@ -103,8 +312,9 @@ bool CommandConsole::processCommand(const Command& cmd)
 			gCtx.data.getGroupData(idx).setRunning(true);
 			return true;
 		}
-	}
-	else if (cmd.is("stopgroup"))
+		return false;
+	}},
+	{"stopgroup", [](Component&, const Command& cmd)
 	{
 		int idx;
 		if (cmd.parseParams(idx) && idx < AW_MAX_NUM_PAIRS)
@@ -112,13 +322,14 @@ bool CommandConsole::processCommand(const Command& cmd)
 			gCtx.data.getGroupData(idx).setRunning(false);
 			return true;
 		}
-	}
-	else if (cmd.is("logconfig"))
+		return false;
+	}},
+	{"logconfig", [](Component&, const Command& cmd)
 	{
 		gCtx.data.logConfig();
 		return true;
-	}
-	else if (cmd.is("loggroupconfig"))
+	}},
+	{"loggroupconfig", [](Component&, const Command& cmd)
 	{
 		int idx;
 		if (cmd.parseParams(idx) && idx < AW_MAX_NUM_PAIRS)
@@ -126,8 +337,9 @@ bool CommandConsole::processCommand(const Command& cmd)
 			gCtx.data.getGroupData(idx).logConfig();
 			return true;
 		}
-	}
-	else if (cmd.is("selectgroup"))
+		return false;
+	}},
+	{"selectgroup", [](Component&, const Command& cmd)
 	{
 		int8_t idx;
 		if (cmd.parseParams(idx) && idx < AW_MAX_NUM_PAIRS)
@@ -135,8 +347,9 @@ bool CommandConsole::processCommand(const Command& cmd)
 			gCtx.data.trySetSelectedGroup(idx);
 			return true;
 		}
-	}
-	else if (cmd.is("setmocksensorerrorstatus"))
+		return false;
+	}},
+	{"setmocksensorerrorstatus", [](Component&, const Command& cmd)
 	{
 		int idx, status;
 		if (cmd.parseParams(idx, status))
@@ -151,8 +364,9 @@ bool CommandConsole::processCommand(const Command& cmd)
 				CZ_LOG(logDefault, Error, F("Invalid status value"));
 			}
 		}
-	}
-	else if (cmd.is("setmocksensor"))
+		return false;
+	}},
+	{"setmocksensor", [](Component&, const Command& cmd)
 	{
 		int idx, value;
 		if (cmd.parseParams(idx, value) && idx < AW_MAX_NUM_PAIRS)
@@ -160,8 +374,9 @@ bool CommandConsole::processCommand(const Command& cmd)
 			Component::raiseEvent(SetMockSensorValueEvent(idx, value));
 			return true;
 		}
-	}
-	else if (cmd.is("setmocksensors"))
+		return false;
+	}},
+	{"setmocksensors", [](Component&, const Command& cmd)
 	{
 		int value;
 		if (cmd.parseParams(value))
@@ -172,8 +387,9 @@ bool CommandConsole::processCommand(const Command& cmd)
 			}
 			return true;
 		}
-	}
-	else if (cmd.is("save"))
+		return false;
+	}},
+	{"save", [](Component&, const Command& cmd)
 	{
 		gCtx.data.save();
 
@@ -182,8 +398,8 @@ bool CommandConsole::processCommand(const Command& cmd)
 		prgData.load();
 		prgData.logConfig();
 		return true;
-	}
-	else if (cmd.is("savegroup"))
+	}},
+	{"savegroup", [](Component&, const Command& cmd)
 	{
 		uint8_t idx;
 		if (cmd.parseParams(idx) && idx < AW_MAX_NUM_PAIRS)
@@ -191,13 +407,14 @@ bool CommandConsole::processCommand(const Command& cmd)
 			gCtx.data.saveGroupConfig(idx);
 			return true;
 		}
-	}
-	else if (cmd.is("load"))
+		return false;
+	}},
+	{"load", [](Component&, const Command& cmd)
 	{
 		gCtx.data.load();
 		return true;
-	}
-	else if (cmd.is("setverbosity"))
+	}},
+	{"setverbosity", [](Component&, const Command& cmd)
 	{
 		char name[30];
 		int verbosity;
@@ -224,13 +441,145 @@ bool CommandConsole::processCommand(const Command& cmd)
 				CZ_LOG(logDefault, Error, F("Log category \"%s\" doesn't exist"), name);
 			}
 		}
+		return false;
+	}},
+};
+
+//
+// CommandConsole
+//
+CommandConsole::CommandConsole()
+{
+}
+
+bool CommandConsole::initImpl()
+{
+	setCommandTable(gConsoleCommands, std::size(gConsoleCommands));
+	m_serialStringReader.begin(AW_CUSTOM_SERIAL);
+#if AW_LOWPOWER_IDLE_ENABLED
+	gLowPowerIdle.addWakeSource(*this);
+#endif
+	return true;
+}
+
+bool CommandConsole::hasPendingInput()
+{
+	return AW_CUSTOM_SERIAL.available() > 0;
+}
+
+float CommandConsole::tick(float deltaSeconds)
+{
+	PROFILE_SCOPE(F("CommandConsole::tick"));
+
+	//CZ_LOG(logDefault, Log, "CommandConsole::tick");
+	while (m_serialStringReader.tryRead())
+	{
+		//CZ_LOG(logDefault, Log, "    %u", millis());
+
+		Command cmd(m_serialStringReader.retrieve());
+		// Checking before executing, so batch_begin and batch_end themselves are not counted
+		bool inBatch = m_batch.active;
+		// Errors in a batch are only reported by batch_end
+		cmd.logErrors = !inBatch;
+		bool ok = cmd.parseCmd();
+		if (ok)
+		{
+			if (cmd.targetComponent == nullptr)
+			{
+				cmd.targetComponent = this;
+			}
+
+			ok = cmd.targetComponent->executeCommand(cmd);
+			if (!ok && cmd.logErrors)
+			{
+				CZ_LOG(logDefault, Error, "Failed to execute %s.%s command", cmd.targetComponent->getName(), cmd.cmd);
+			}
+		}
+
+		if (inBatch && m_batch.active)
+		{
+			m_batch.numCommands++;
+			if (!ok)
+			{
+				addBatchFailure(cmd);
+			}
+		}
+	}
+
+	// While in a batch, we want the next commands as soon as possible
+	if (m_batch.active)
+	{
+		return 0;
 	}
 
+#if AW_LOWPOWER_IDLE_ENABLED
+	// Serial input wakes us up (see hasPendingInput), so there is no need to poll
+	return 60*60;
+#else
+	return 0.250f;
+#endif
+}
 
-	CZ_LOG(logDefault, Error, F("Command \"%s\" not recognized"), m_serialStringReader.retrieve());
+
+bool CommandConsole::processCommand(const Command& cmd)
+{
+	cmd.error = "not recognized";
+	if (cmd.logErrors)
+	{
+		CZ_LOG(logDefault, Error, F("Command \"%s\" not recognized"), cmd.line);
+	}
 	return false;
 }
 
+void CommandConsole::beginBatch()
+{
+	if (m_batch.active)
+	{
+		CZ_LOG(logDefault, Warning, F("Batch already active. Restarting it."));
+	}
+
+	m_batch.active = true;
+	m_batch.numCommands = 0;
+	m_batch.numFailures = 0;
+	m_batch.startMicros = micros();
+}
+
+void CommandConsole::endBatch()
+{
+	if (!m_batch.active)
+	{
+		CZ_LOG(logDefault, Error, F("No batch active"));
+		return;
+	}
+
+	m_batch.active = false;
+	unsigned long elapsedMicros = micros() - m_batch.startMicros;
+	CZ_LOG(logDefault, Log, F("Batch: %d commands, %d failed, %lu ms"), m_batch.numCommands, m_batch.numFailures,
+		elapsedMicros / 1000);
+
+	int numStored = std::min(m_batch.numFailures, AW_COMMAND_CONSOLE_BATCH_MAX_FAILURES);
+	for (int i = 0; i < numStored; i++)
+	{
+		CZ_LOG(logDefault, Error, F("    Failed: %s"), m_batch.failures[i]);
+	}
+
+	if (m_batch.numFailures > numStored)
+	{
+		CZ_LOG(logDefault, Error, F("    ... and %d more"), m_batch.numFailures - numStored);
+	}
+}
+
+void CommandConsole::addBatchFailure(const Command& cmd)
+{
+	if (m_batch.numFailures < AW_COMMAND_CONSOLE_BATCH_MAX_FAILURES)
+	{
+		// If the command failed while executing, only the command itself knows why
+		snprintf(m_batch.failures[m_batch.numFailures], sizeof(m_batch.failures[0]), "%s%s%s%s", cmd.line,
+			cmd.error ? " (" : "", cmd.error ? cmd.error : "", cmd.error ? ")" : "");
+	}
+	m_batch.numFailures++;
+}
+
 #if AW_COMMAND_CONSOLE_ENABLED
 	CommandConsole gCommandConsole;
 #endif
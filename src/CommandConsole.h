@@ -11,6 +11,14 @@ class CommandConsole : public Component
 public:
 	CommandConsole();
 
+	/*
+	* Batch mode.
+	* Commands between batch_begin and batch_end are processed without per-command error logging, and without waiting
+	* for the next tick. batch_end then logs a single report with the failed commands.
+	*/
+	void beginBatch();
+	void endBatch();
+
 private:
 
 	//
@@ -21,8 +29,21 @@ private:
 	virtual float tick(float deltaSeconds) override;
 	virtual void onEvent(const Event& evt) override { }
 	virtual bool processCommand(const Command& cmd);
+	virtual bool hasPendingInput() override;
+
+	void addBatchFailure(const Command& cmd);
 
 	SerialStringReader<> m_serialStringReader;
+
+	struct
+	{
+		bool active = false;
+		int numCommands = 0;
+		int numFailures = 0;
+		unsigned long startMicros = 0;
+		// The first few failed commands, to show in the report
+		char failures[AW_COMMAND_CONSOLE_BATCH_MAX_FAILURES][64];
+	} m_batch;
 };
 
 #if AW_COMMAND_CONSOLE_ENABLED
@@ -1,18 +1,38 @@
 #include "Component.h"
+#include "Timer.h"
 #include <string.h>
+#include <ctype.h>
+#include <algorithm>
 #include <crazygaze/micromuc/Logging.h>
 #include <crazygaze/micromuc/Profiler.h>
 
 namespace cz
 {
 
+extern Timer gTimer;
+
+namespace
+{
+	// Case insensitive FNV-1a, for the component and command name indexes
+	uint32_t hashName(const char* str)
+	{
+		uint32_t hash = 0x811c9dc5;
+		for (; *str; str++)
+		{
+			hash ^= static_cast<uint8_t>(tolower(*str));
+			hash *= 0x01000193;
+		}
+		return hash;
+	}
+}
+
 //
 // Command
 //
 bool Command::parseCmd()
 {
 	parse(src, fullCmd);
-	CZ_LOG(logDefault, Log, "Trying to process command: %s", fullCmd);
+	CZ_LOG(logDefault, Verbose, "Trying to process command: %s", fullCmd);
 	cmd = fullCmd;
 
 	// Check if the command is int he form of COMPONENT.COMMAND
@@ -20,7 +40,6 @@ bool Command::parseCmd()
 	if (*cmd != 0 && cmd != fullCmd)
 	{
 		int componentNameLen = cmd - fullCmd - 1;
-		CZ_LOG(logDefault, Log, "name length = %d", componentNameLen);
 		char componentName[componentNameLen + 1];
 		memcpy(componentName, fullCmd, componentNameLen);
 		componentName[componentNameLen] = 0;
@@ -28,17 +47,22 @@ bool Command::parseCmd()
 		targetComponent = Component::getByName(componentName);
 		if (!targetComponent)
 		{
-			CZ_LOG(logDefault, Error, "No component with name '%s' found", componentName);
+			error = "unknown component";
+			if (logErrors)
+			{
+				CZ_LOG(logDefault, Error, "No component with name '%s' found", componentName);
+			}
 			return false;
 		}
-		CZ_LOG(logDefault, Log, "Component '%s', command '%s'", targetComponent ? targetComponent->getName() : "", cmd);
+		CZ_LOG(logDefault, Verbose, "Component '%s', command '%s'", targetComponent ? targetComponent->getName() : "", cmd);
 	}
 	else
 	{
 		cmd = fullCmd;
-		CZ_LOG(logDefault, Log, "Command '%s'", cmd);
+		CZ_LOG(logDefault, Verbose, "Command '%s'", cmd);
 	}
 
+	cmdHash = hashName(cmd);
 	return true;
 }
 
@@ -47,6 +71,142 @@ bool Command::parseCmd()
 namespace
 {
 	DoublyLinkedList<Component> gComponents;
+	// Kept up to date by the constructor/destructor, so getCount doesn't need to go through the list
+	int gNumComponents;
+
+	//
+	// Ticking components are kept in a binary min-heap ordered by deadline, so tickAll only needs to look at the top of
+	// the heap to find what is due, instead of going through all the components.
+	// This needs to be plain zero initialized data, since components are created during static initialization.
+	//
+	Component* gHeap[AW_MAX_NUM_COMPONENTS];
+	int gHeapSize;
+
+	// Scheduler clock, in microseconds. It's advanced by tickAll
+	uint64_t gNowMicros;
+
+	struct SchedulerStats
+	{
+		uint32_t wakeups;
+		uint32_t ticks;
+		uint32_t maxTicksPerWakeup;
+		uint32_t heapOps;
+		// How many component visits the old linear scan would have done (component count per wakeup)
+		uint32_t linearVisits;
+		// Scheduler time when the stats were reset
+		uint64_t startMicros;
+	} gSchedulerStats;
+
+	//
+	// Event subscriptions.
+	// Every event type has a linked list of subscribers, in subscription order, with nodes taken from a fixed size pool.
+	// Same as the scheduler heap, this needs to be plain zero initialized data.
+	//
+	struct Subscription
+	{
+		Component* component;
+		Subscription* next;
+	};
+
+	//
+	// Dependencies declared with dependsOn. Only used by initAll.
+	//
+	struct Dependency
+	{
+		Component* component;
+		Component* dependency;
+	};
+	Dependency gDependencies[AW_MAX_NUM_COMPONENT_DEPENDENCIES];
+	int gNumDependencies;
+
+	//
+	// Hash indexes for getByName and executeCommand, using open addressing with linear probing.
+	// They are built on first use, and rebuilt whenever components or command tables change (gIndexesValid is cleared).
+	//
+	constexpr int nextPowerOfTwo(int value, int res = 1)
+	{
+		return res >= value ? res : nextPowerOfTwo(value, res * 2);
+	}
+
+	// Keeping the tables at most half full
+	constexpr int gNameIndexSize = nextPowerOfTwo(AW_MAX_NUM_COMPONENTS * 2);
+	constexpr int gCommandIndexSize = nextPowerOfTwo(AW_MAX_NUM_TABLE_COMMANDS * 2);
+
+	struct NameIndexEntry
+	{
+		Component* component;
+		uint32_t hash;
+	};
+	NameIndexEntry gNameIndex[gNameIndexSize];
+
+	struct CommandIndexEntry
+	{
+		const Component* component;
+		const Component::CommandEntry* command;
+		uint32_t hash; // Hash of the command name
+	};
+	CommandIndexEntry gCommandIndex[gCommandIndexSize];
+	int gNumTableCommands;
+
+	bool gIndexesValid;
+
+	// Commands are keyed by component and command name
+	uint32_t commandIndexKey(const Component* component, uint32_t cmdHash)
+	{
+		return cmdHash ^ (static_cast<uint32_t>(reinterpret_cast<uintptr_t>(component)) * 2654435761u);
+	}
+
+	struct
+	{
+		// millis() values
+		uint32_t initAllStart;
+		uint32_t initAllEnd;
+		uint32_t firstSoilMoistureReading;
+	} gBootTimings;
+
+	Subscription gSubscriptionPool[AW_MAX_NUM_EVENT_SUBSCRIPTIONS];
+	int gSubscriptionPoolUsed;
+	Subscription* gFreeSubscriptions;
+	Subscription* gSubscribers[Event::NumTypes];
+
+	struct EventStats
+	{
+		uint32_t raised;
+		uint32_t calls; // onEvent calls
+		uint32_t micros; // Time spent dispatching, including any nested events
+	} gEventStats[Event::NumTypes];
+
+#if AW_EVENT_DEFERRED_DISPATCH
+	//
+	// Ring buffer of events waiting for dispatch
+	//
+	struct
+	{
+		EventRecord records[AW_EVENT_QUEUE_SIZE];
+		int head;
+		int count;
+		int highWaterMark;
+		uint32_t overflows;
+	} gEventQueue;
+#endif
+
+#if AW_COMPONENT_STATS_ENABLED
+	struct
+	{
+		// Real and scheduler time when the stats were reset
+		uint64_t startRealMicros;
+		uint64_t startMicros;
+		int heapHighWater;
+		// Component that ran right before the heap high water mark was reached
+		Component* heapHighWaterComponent;
+	} gComponentStats;
+#endif
+
+	uint64_t secondsToMicros(float seconds)
+	{
+		// Rounding, so feeding a countdown returned by tickAll back into it doesn't wake up 1us before the deadline
+		return seconds > 0 ? static_cast<uint64_t>(seconds * 1000000.0f + 0.5f) : 0;
+	}
 }
 
 //
@@ -54,7 +214,6 @@ namespace
 //
 
 Component::Component(Component::ListInsertionPosition insertPos)
-	: m_ticker(this)
 {
 	if (insertPos == Component::ListInsertionPosition::Front)
 	{
@@ -64,11 +223,29 @@ Component::Component(Component::ListInsertionPosition insertPos)
 	{
 		gComponents.pushBack(this);
 	}
+	gNumComponents++;
+
+	// Components start ticking right away, unless they call stopTicking()
+	m_lastTickMicros = gNowMicros;
+	schedule(gNowMicros);
+
+	// Can't build the indexes here, since getName is virtual. They are rebuilt on the next lookup.
+	gIndexesValid = false;
 }
 
 Component::~Component()
 {
+#if AW_COMPONENT_STATS_ENABLED
+	if (gComponentStats.heapHighWaterComponent == this)
+	{
+		gComponentStats.heapHighWaterComponent = nullptr;
+	}
+#endif
+	unsubscribeAll();
+	unschedule();
 	gComponents.remove(this);
+	gNumComponents--;
+	gIndexesValid = false;
 }
 
 bool Component::init()
@@ -79,59 +256,237 @@ bool Component::init()
 	}
 	else
 	{
-		CZ_LOG(logDefault, Log, "Initializing component '%s' ...", getName());
+		// Retries are only logged when they succeed, since initAll can retry a component many times
+		if (m_initCalls == 0)
+		{
+			CZ_LOG(logDefault, Log, "Initializing component '%s' ...", getName());
+		}
+		unsigned long startMicros = micros();
 		m_initialized = initImpl();
-		CZ_LOG(logDefault, Log, "        %s", m_initialized ? "DONE" : "DELAYED");
+		m_initMicros += micros() - startMicros;
+		m_initCalls++;
+		if (m_initialized)
+		{
+			m_initReadyMillis = millis();
+			if (m_initCalls > 1)
+			{
+				CZ_LOG(logDefault, Log, "Initializing component '%s' ...", getName());
+			}
+			CZ_LOG(logDefault, Log, "        DONE");
+		}
+		else if (m_initCalls == 1)
+		{
+			CZ_LOG(logDefault, Log, "        DELAYED");
+		}
 		return m_initialized;
 	}
 }
 
 Component* Component::getByName(const char* name)
 {
-	for(auto&& component : gComponents)
+	if (!gIndexesValid)
 	{
-		if (strcasecmp(component->getName(), name) == 0)
+		buildIndexes();
+	}
+
+	uint32_t hash = hashName(name);
+	for (int i = hash & (gNameIndexSize - 1); gNameIndex[i].component; i = (i + 1) & (gNameIndexSize - 1))
+	{
+		if (gNameIndex[i].hash == hash && strcasecmp(gNameIndex[i].component->getName(), name) == 0)
 		{
-			return component;
+			return gNameIndex[i].component;
 		}
 	}
 
 	return nullptr;
 }
 
+void Component::setCommandTable(const CommandEntry* commands, int count)
+{
+	m_commands = commands;
+	m_numCommands = count;
+	gIndexesValid = false;
+}
+
+bool Component::executeCommand(const Command& cmd)
+{
+	if (m_numCommands)
+	{
+		if (!gIndexesValid)
+		{
+			buildIndexes();
+		}
+
+		uint32_t key = commandIndexKey(this, cmd.cmdHash);
+		for (int i = key & (gCommandIndexSize - 1); gCommandIndex[i].component; i = (i + 1) & (gCommandIndexSize - 1))
+		{
+			const CommandIndexEntry& entry = gCommandIndex[i];
+			if (entry.component == this && entry.hash == cmd.cmdHash && strcasecmp(entry.command->name, cmd.cmd) == 0)
+			{
+				return entry.command->handler(*this, cmd);
+			}
+		}
+	}
+
+	return processCommand(cmd);
+}
+
+void Component::buildIndexes()
+{
+	memset(gNameIndex, 0, sizeof(gNameIndex));
+	memset(gCommandIndex, 0, sizeof(gCommandIndex));
+	gNumTableCommands = 0;
+
+	for(auto&& component : gComponents)
+	{
+		// If there are components with the same name, the first one in the list wins, same as a linear search would
+		const char* name = component->getName();
+		uint32_t hash = hashName(name);
+		int i = hash & (gNameIndexSize - 1);
+		while (gNameIndex[i].component &&
+			   !(gNameIndex[i].hash == hash && strcasecmp(gNameIndex[i].component->getName(), name) == 0))
+		{
+			i = (i + 1) & (gNameIndexSize - 1);
+		}
+
+		if (!gNameIndex[i].component)
+		{
+			gNameIndex[i] = {component, hash};
+		}
+
+		for (int cmdIndex = 0; cmdIndex < component->m_numCommands; cmdIndex++)
+		{
+			CZ_ASSERT(gNumTableCommands < AW_MAX_NUM_TABLE_COMMANDS);
+			gNumTableCommands++;
+			const CommandEntry& command = component->m_commands[cmdIndex];
+			uint32_t cmdHash = hashName(command.name);
+			int j = commandIndexKey(component, cmdHash) & (gCommandIndexSize - 1);
+			while (gCommandIndex[j].component)
+			{
+				j = (j + 1) & (gCommandIndexSize - 1);
+			}
+			gCommandIndex[j] = {component, &command, cmdHash};
+		}
+	}
+
+	gIndexesValid = true;
+}
+
 void Component::initAll()
 {
-	int loopCount = 0;
+	gBootTimings.initAllStart = millis();
+
+	for(auto&& component : gComponents)
+	{
+		component->declareDependencies();
+	}
 
 	//
-	// Loop through all components until all are initialized or we detect we've tried too often
+	// Every pass initializes the components whose dependencies are all initialized. So, components are initialized in
+	// dependency order, and unless a component needs more time (initImpl returns false), init is only called once per
+	// component.
 	//
 	while(true)
 	{
-		loopCount++;
-		bool repeat = false;
-		int componentCount;
+		bool pending = false;
+		bool blocked = true;
+		bool delayed = false;
 		for(auto&& component : gComponents)
 		{
-			componentCount++;
-			if(!component->init())
+			if (component->m_initialized)
+			{
+				continue;
+			}
+
+			pending = true;
+			if (component->areDependenciesInitialized())
 			{
-				repeat = true;
+				blocked = false;
+				if (!component->init())
+				{
+					delayed = true;
+				}
 			}
 		}
 
-		if (repeat)
+		if (!pending)
+		{
+			break;
+		}
+
+		if (delayed)
 		{
-			if (loopCount >= componentCount)
+			// Give whatever the component is waiting for some time, instead of spinning. The watchdog might have been
+			// started already, and it would reset the board before we get to log what failed.
+			rp2040.wdt_reset();
+			delay(AW_COMPONENT_INIT_RETRY_INTERVAL);
+		}
+
+		bool timedOut = (millis() - gBootTimings.initAllStart) >= AW_COMPONENT_INIT_TIMEOUT * 1000;
+		if (blocked || timedOut)
+		{
+			CZ_LOG(logDefault, Error, "Failed to initialize all components (%s).",
+				blocked ? "circular dependency" : "timeout");
+			for(auto&& component : gComponents)
 			{
-				CZ_LOG(logDefault, Error, "Failed to initialize all components. Restarting in 10 seconds");
-				delay(10000);
-				rp2040.reboot();
+				if (!component->m_initialized)
+				{
+					if (component->areDependenciesInitialized())
+					{
+						CZ_LOG(logDefault, Error, "    %s: still initializing after %u attempts", component->getName(),
+							static_cast<unsigned int>(component->m_initCalls));
+					}
+					else
+					{
+						CZ_LOG(logDefault, Error, "    %s: waiting for dependencies", component->getName());
+					}
+				}
 			}
+
+			CZ_LOG(logDefault, Error, "Restarting in 10 seconds");
+			delay(10000);
+			rp2040.reboot();
 		}
-		else
+	}
+
+	gBootTimings.initAllEnd = millis();
+	logBootTimings();
+}
+
+void Component::dependsOn(Component* dependency)
+{
+	CZ_ASSERT(dependency && dependency != this);
+	CZ_ASSERT(gNumDependencies < AW_MAX_NUM_COMPONENT_DEPENDENCIES);
+	gDependencies[gNumDependencies++] = {this, dependency};
+}
+
+bool Component::areDependenciesInitialized() const
+{
+	for (int i = 0; i < gNumDependencies; i++)
+	{
+		if (gDependencies[i].component == this && !gDependencies[i].dependency->m_initialized)
 		{
-			return;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void Component::logBootTimings()
+{
+	CZ_LOG(logDefault, Log, "Boot timings (ms after reset): initAll=%u..%u, first soil moisture reading=%u",
+		gBootTimings.initAllStart, gBootTimings.initAllEnd, gBootTimings.firstSoilMoistureReading);
+	for(auto&& component : gComponents)
+	{
+		CZ_LOG(logDefault, Log, "    %s: ready=%u, init time=%uus (%u calls)", component->getName(),
+			component->m_initReadyMillis, component->m_initMicros, static_cast<unsigned int>(component->m_initCalls));
+		for (int i = 0; i < gNumDependencies; i++)
+		{
+			if (gDependencies[i].component == component)
+			{
+				CZ_LOG(logDefault, Log, "        depends on %s", gDependencies[i].dependency->getName());
+			}
 		}
 	}
 }
@@ -140,43 +495,559 @@ float Component::tickAll(float deltaSeconds)
 {
 	PROFILE_SCOPE(F("Component::tickAll"));
 
-	float countdown = 60*60;
-	Component* lowestCountdownCulprit = nullptr;
-	for(auto&& component : gComponents)
+	gNowMicros += secondsToMicros(deltaSeconds);
+	gSchedulerStats.wakeups++;
+	gSchedulerStats.linearVisits += gNumComponents;
+
+	uint32_t tickCount = 0;
+	while (gHeapSize && gHeap[0]->m_deadlineMicros <= gNowMicros)
 	{
-		float componentCountdown = component->m_ticker.tick(deltaSeconds);
-		if (componentCountdown < countdown)
+		Component* component = gHeap[0];
+		float elapsedSeconds = (gNowMicros - component->m_lastTickMicros) / 1000000.0f;
+		component->m_lastTickMicros = gNowMicros;
+
+		// Move it out of the way while ticking, so we can detect if it calls stopTicking or wakeUp from inside tick()
+		component->schedule(UINT64_MAX);
+	#if AW_COMPONENT_STATS_ENABLED
+		unsigned long tickStartMicros = micros();
+	#endif
+		float countdown = component->tick(elapsedSeconds);
+	#if AW_COMPONENT_STATS_ENABLED
+		component->updateTickStats(micros() - tickStartMicros);
+		component->updateHeapHighWater();
+	#endif
+		component->m_tickCount++;
+		tickCount++;
+
+		if (component->m_heapIndex != -1)
 		{
-			lowestCountdownCulprit = component;	
-			countdown = componentCountdown;
+			// A component returning 0 doesn't get ticked again in this same call. It will be ticked on the next wakeup.
+			uint64_t deadline = gNowMicros + std::max(secondsToMicros(countdown), uint64_t(1));
+			component->schedule(std::min(deadline, component->m_deadlineMicros));
 		}
 	}
 
-	if (lowestCountdownCulprit)
+#if AW_EVENT_DEFERRED_DISPATCH
+	// Dispatching after all due components ticked. Any components woken up by the events will tick on the next wakeup
+	dispatchQueuedEvents();
+#endif
+
+	gSchedulerStats.ticks += tickCount;
+	gSchedulerStats.maxTicksPerWakeup = std::max(gSchedulerStats.maxTicksPerWakeup, tickCount);
+
+	float countdown = 60*60;
+	if (gHeapSize)
 	{
-		CZ_LOG(logDefault, Verbose, "Component causing fastest tick rate: %s. Ticking in %d ms", lowestCountdownCulprit->getName(), static_cast<int>(countdown * 1000));
+		countdown = std::min(countdown, (gHeap[0]->m_deadlineMicros - gNowMicros) / 1000000.0f);
+		CZ_LOG(logDefault, Verbose, "Component causing fastest tick rate: %s. Ticking in %d ms", gHeap[0]->getName(), static_cast<int>(countdown * 1000));
 	}
 
 	return countdown;
 }
 
+int Component::getCount()
+{
+	return gNumComponents;
+}
+
+void Component::logSchedulerStats()
+{
+	const SchedulerStats& stats = gSchedulerStats;
+	CZ_LOG(logDefault, Log, "Scheduler: %d components, %d ticking", getCount(), gHeapSize);
+	CZ_LOG(logDefault, Log, "    wakeups=%u, ticks=%u (max %u per wakeup), heapOps=%u", stats.wakeups, stats.ticks,
+		stats.maxTicksPerWakeup, stats.heapOps);
+	CZ_LOG(logDefault, Log, "    component visits=%u (linear scan would be %u)", getSchedulerVisits(),
+		stats.linearVisits);
+}
+
+uint32_t Component::getSchedulerVisits()
+{
+	return gSchedulerStats.ticks + gSchedulerStats.heapOps;
+}
+
+void Component::resetSchedulerStats()
+{
+	gSchedulerStats = {};
+	gSchedulerStats.startMicros = gNowMicros;
+	for(auto&& component : gComponents)
+	{
+		component->m_tickCount = 0;
+	}
+}
+
+void Component::logWakeups()
+{
+	float hours = (gNowMicros - gSchedulerStats.startMicros) / (1000000.0f * 60 * 60);
+	if (hours <= 0)
+	{
+		return;
+	}
+
+	CZ_LOG(logDefault, Log, "Wakeups: %u in %s hours (%d per hour)", gSchedulerStats.wakeups, *FloatToString(hours),
+		static_cast<int>(gSchedulerStats.wakeups / hours));
+	for(auto&& component : gComponents)
+	{
+		CZ_LOG(logDefault, Log, "    %s: %d ticks per hour%s", component->getName(),
+			static_cast<int>(component->m_tickCount / hours), component->m_heapIndex == -1 ? " (not ticking)" : "");
+	}
+}
+
 void Component::raiseEvent(const Event& evt)
 {
+#if AW_EVENT_DEFERRED_DISPATCH
+	if (gEventQueue.count == AW_EVENT_QUEUE_SIZE)
+	{
+		gEventQueue.overflows++;
+	#if AW_EVENT_QUEUE_OVERFLOW_POLICY == AW_EVENT_QUEUE_OVERFLOW_DISPATCH
+		CZ_LOG(logDefault, Warning, "Event queue full. Dispatching %s right away", Event::getTypeName(evt.type));
+		dispatchEvent(evt);
+	#elif AW_EVENT_QUEUE_OVERFLOW_POLICY == AW_EVENT_QUEUE_OVERFLOW_DROP
+		CZ_LOG(logDefault, Error, "Event queue full. Dropping %s", Event::getTypeName(evt.type));
+	#elif AW_EVENT_QUEUE_OVERFLOW_POLICY == AW_EVENT_QUEUE_OVERFLOW_ASSERT
+		CZ_ASSERT(false);
+	#else
+		#error Unknown AW_EVENT_QUEUE_OVERFLOW_POLICY
+	#endif
+		return;
+	}
+
+	gEventQueue.records[(gEventQueue.head + gEventQueue.count) % AW_EVENT_QUEUE_SIZE].set(evt);
+	gEventQueue.count++;
+	gEventQueue.highWaterMark = std::max(gEventQueue.highWaterMark, gEventQueue.count);
+#else
+	dispatchEvent(evt);
+#endif
+}
+
+#if AW_EVENT_DEFERRED_DISPATCH
+void Component::dispatchQueuedEvents()
+{
+	PROFILE_SCOPE(F("Component::dispatchQueuedEvents"));
+
+	// Events raised by the handlers are added to the back of the queue, and dispatched in this same loop
+	while (gEventQueue.count)
+	{
+		// The record is only removed after the dispatch, so it can't be overwritten by events raised by the handlers
+		dispatchEvent(gEventQueue.records[gEventQueue.head].get());
+		gEventQueue.head = (gEventQueue.head + 1) % AW_EVENT_QUEUE_SIZE;
+		gEventQueue.count--;
+	}
+}
+#endif
+
+void Component::dispatchEvent(const Event& evt)
+{
+	PROFILE_SCOPE(F("Component::dispatchEvent"));
+
 	evt.log();
-	for(auto&& component : gComponents)
+	if (evt.type == Event::SoilMoistureSensorReading && gBootTimings.firstSoilMoistureReading == 0)
+	{
+		gBootTimings.firstSoilMoistureReading = millis();
+	}
+
+	EventStats& stats = gEventStats[evt.type];
+	unsigned long startMicros = micros();
+	stats.raised++;
+	for (Subscription* subscription = gSubscribers[evt.type]; subscription; subscription = subscription->next)
 	{
+		Component* component = subscription->component;
+	#if AW_COMPONENT_STATS_ENABLED
+		unsigned long eventStartMicros = micros();
+		component->onEvent(evt);
+		// NOTE: This includes the time spent in any nested events raised by the handler
+		component->m_stats.eventMicros += micros() - eventStartMicros;
+		component->m_stats.eventCount++;
+		component->updateHeapHighWater();
+	#else
 		component->onEvent(evt);
+	#endif
+		stats.calls++;
+	}
+	stats.micros += micros() - startMicros;
+}
+
+void Component::logEventStats()
+{
+	int componentCount = getCount();
+	CZ_LOG(logDefault, Log, "Event dispatch stats (subscriptions=%d/%d):", gSubscriptionPoolUsed, AW_MAX_NUM_EVENT_SUBSCRIPTIONS);
+#if AW_EVENT_DEFERRED_DISPATCH
+	CZ_LOG(logDefault, Log, "    Queue: size=%d, high water mark=%d, overflows=%u", AW_EVENT_QUEUE_SIZE,
+		gEventQueue.highWaterMark, gEventQueue.overflows);
+#endif
+	for (int type = 0; type < Event::NumTypes; type++)
+	{
+		const EventStats& stats = gEventStats[type];
+		if (stats.raised == 0)
+		{
+			continue;
+		}
+
+		CZ_LOG(logDefault, Log, "    %s: raised=%u, onEvent calls=%u (broadcast would be %u), time=%uus (%uus avg)",
+			Event::getTypeName(static_cast<Event::Type>(type)), stats.raised, stats.calls, stats.raised * componentCount,
+			stats.micros, stats.micros / stats.raised);
+	}
+}
+
+void Component::resetEventStats()
+{
+	memset(gEventStats, 0, sizeof(gEventStats));
+#if AW_EVENT_DEFERRED_DISPATCH
+	gEventQueue.highWaterMark = gEventQueue.count;
+	gEventQueue.overflows = 0;
+#endif
+}
+
+void Component::logComponentStats()
+{
+#if AW_COMPONENT_STATS_ENABLED
+	uint64_t realMicros = gTimer.getRealTotalMicros() - gComponentStats.startRealMicros;
+	if (realMicros == 0)
+	{
+		return;
+	}
+
+	CZ_LOG(logDefault, Log, "Component stats: %s real seconds, %s scheduler seconds (time scale %d)",
+		*FloatToString(realMicros / 1000000.0f), *FloatToString((gNowMicros - gComponentStats.startMicros) / 1000000.0f),
+		AW_MOCK_TIME_SCALE);
+	CZ_LOG(logDefault, Log, "    Heap: used=%d, high water=%d (after %s), total=%d", rp2040.getUsedHeap(),
+		gComponentStats.heapHighWater,
+		gComponentStats.heapHighWaterComponent ? gComponentStats.heapHighWaterComponent->getName() : "?",
+		rp2040.getTotalHeap());
+
+	for(auto&& component : gComponents)
+	{
+		const Stats& stats = component->m_stats;
+		float cpuPercentage = (stats.tickMicros + stats.eventMicros) * 100.0f / realMicros;
+		CZ_LOG(logDefault, Log, "    %s: cpu=%s%%, ticks=%u (%ums, %uus avg), events=%u (%ums), heap high water=%d",
+			component->getName(), *FloatToString(cpuPercentage), stats.tickCount,
+			static_cast<unsigned int>(stats.tickMicros / 1000),
+			static_cast<unsigned int>(stats.tickCount ? stats.tickMicros / stats.tickCount : 0), stats.eventCount,
+			static_cast<unsigned int>(stats.eventMicros / 1000), stats.heapHighWater);
+	}
+#else
+	CZ_LOG(logDefault, Warning, "Component stats are disabled. See AW_COMPONENT_STATS_ENABLED");
+#endif
+}
+
+void Component::resetComponentStats()
+{
+#if AW_COMPONENT_STATS_ENABLED
+	gComponentStats = {};
+	gComponentStats.startRealMicros = gTimer.getRealTotalMicros();
+	gComponentStats.startMicros = gNowMicros;
+	for(auto&& component : gComponents)
+	{
+		component->m_stats = {};
+	}
+#endif
+}
+
+void Component::logTickStats()
+{
+#if AW_COMPONENT_STATS_ENABLED
+	CZ_LOG(logDefault, Log, "Tick stats:");
+	for(auto&& component : gComponents)
+	{
+		const Stats& stats = component->m_stats;
+		if (stats.tickCount == 0)
+		{
+			continue;
+		}
+
+		CZ_LOG(logDefault, Log, "    %s: ticks=%u, max=%uus, budget=%uus, overruns=%u (last at %ss)", component->getName(),
+			stats.tickCount, stats.maxTickMicros, component->m_tickBudgetMicros, stats.overruns,
+			stats.overruns ? *FloatToString(stats.lastOverrunMicros / 1000000.0f) : "-");
+
+		// Only log the buckets in use, as "<upper bound in us>:count"
+		String histogram;
+		for (int bucket = 0; bucket < ms_tickHistogramNumBuckets; bucket++)
+		{
+			if (stats.tickHistogram[bucket])
+			{
+				if (bucket == ms_tickHistogramNumBuckets - 1)
+				{
+					histogram += formatString(" >=%u:%u", 1u << (bucket - 1), stats.tickHistogram[bucket]);
+				}
+				else
+				{
+					histogram += formatString(" <%u:%u", 1u << bucket, stats.tickHistogram[bucket]);
+				}
+			}
+		}
+		CZ_LOG(logDefault, Log, "        %s", histogram.c_str());
+	}
+#else
+	CZ_LOG(logDefault, Warning, "Component stats are disabled. See AW_COMPONENT_STATS_ENABLED");
+#endif
+}
+
+String Component::getTickDiagnostics(int maxComponents)
+{
+	String res;
+#if AW_COMPONENT_STATS_ENABLED
+	if (maxComponents <= 0)
+	{
+		return res;
+	}
+
+	// Pick the components with the highest max tick time, in descending order
+	const Component* slowest[maxComponents];
+	int count = 0;
+	for(auto&& component : gComponents)
+	{
+		uint32_t maxTickMicros = component->m_stats.maxTickMicros;
+		if (maxTickMicros == 0 || (count == maxComponents && slowest[count - 1]->m_stats.maxTickMicros >= maxTickMicros))
+		{
+			continue;
+		}
+
+		int index = std::min(count, maxComponents - 1);
+		while (index > 0 && slowest[index - 1]->m_stats.maxTickMicros < maxTickMicros)
+		{
+			slowest[index] = slowest[index - 1];
+			index--;
+		}
+		slowest[index] = component;
+		count = std::min(count + 1, maxComponents);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		const Stats& stats = slowest[i]->m_stats;
+		res += formatString("%s%s:max=%ums,overruns=%u,last=%us", i ? ";" : "", slowest[i]->getName(),
+			stats.maxTickMicros / 1000, stats.overruns, static_cast<unsigned int>(stats.lastOverrunMicros / 1000000));
+	}
+#endif
+	return res;
+}
+
+void Component::setTickBudget(float seconds)
+{
+#if AW_COMPONENT_STATS_ENABLED
+	m_tickBudgetMicros = static_cast<uint32_t>(secondsToMicros(seconds));
+#endif
+}
+
+#if AW_COMPONENT_STATS_ENABLED
+void Component::updateTickStats(uint32_t tickMicros)
+{
+	m_stats.tickMicros += tickMicros;
+	m_stats.tickCount++;
+
+	// Bucket is the number of significant bits, so bucket N has the [2^(N-1), 2^N) range
+	int bucket = tickMicros ? 32 - __builtin_clz(tickMicros) : 0;
+	m_stats.tickHistogram[std::min(bucket, ms_tickHistogramNumBuckets - 1)]++;
+	m_stats.maxTickMicros = std::max(m_stats.maxTickMicros, tickMicros);
+
+	if (tickMicros > m_tickBudgetMicros)
+	{
+		m_stats.overruns++;
+		m_stats.lastOverrunMicros = gNowMicros;
+		// Only logging the 1st, 2nd, 4th, 8th, etc overrun, so a component that keeps overrunning doesn't flood the log.
+		// The "tickstats" command has the full count.
+		if ((m_stats.overruns & (m_stats.overruns - 1)) == 0)
+		{
+			CZ_LOG(logDefault, Warning, "%s tick took %uus. Budget is %uus (%u overruns so far)", getName(), tickMicros,
+				m_tickBudgetMicros, m_stats.overruns);
+		}
+	}
+}
+
+void Component::updateHeapHighWater()
+{
+	int used = rp2040.getUsedHeap();
+	m_stats.heapHighWater = std::max(m_stats.heapHighWater, used);
+	if (used > gComponentStats.heapHighWater)
+	{
+		gComponentStats.heapHighWater = used;
+		gComponentStats.heapHighWaterComponent = this;
+	}
+}
+#endif
+
+void Component::subscribe(Event::Type type)
+{
+	CZ_ASSERT(type < Event::NumTypes);
+
+	// Find the tail, making sure we are not subscribing twice
+	Subscription** tail = &gSubscribers[type];
+	while (*tail)
+	{
+		if ((*tail)->component == this)
+		{
+			return;
+		}
+		tail = &(*tail)->next;
+	}
+
+	Subscription* subscription;
+	if (gFreeSubscriptions)
+	{
+		subscription = gFreeSubscriptions;
+		gFreeSubscriptions = subscription->next;
+	}
+	else
+	{
+		CZ_ASSERT(gSubscriptionPoolUsed < AW_MAX_NUM_EVENT_SUBSCRIPTIONS);
+		subscription = &gSubscriptionPool[gSubscriptionPoolUsed++];
+	}
+
+	subscription->component = this;
+	subscription->next = nullptr;
+	*tail = subscription;
+}
+
+void Component::subscribeAll()
+{
+	for (int type = 0; type < Event::NumTypes; type++)
+	{
+		subscribe(static_cast<Event::Type>(type));
+	}
+}
+
+void Component::unsubscribeAll()
+{
+	for (int type = 0; type < Event::NumTypes; type++)
+	{
+		Subscription** ptr = &gSubscribers[type];
+		while (*ptr)
+		{
+			Subscription* subscription = *ptr;
+			if (subscription->component == this)
+			{
+				*ptr = subscription->next;
+				subscription->next = gFreeSubscriptions;
+				gFreeSubscriptions = subscription;
+				break;
+			}
+			ptr = &subscription->next;
+		}
 	}
 }
 
 void Component::stopTicking()
 {
-	m_ticker.stop();
+	unschedule();
+}
+
+void Component::wakeUp()
+{
+	// Scheduling for the next wakeup instead of right now, so components waking each other up from inside tick() can't
+	// keep tickAll looping forever
+	if (m_heapIndex != -1 && m_deadlineMicros > gNowMicros + 1)
+	{
+		schedule(gNowMicros + 1);
+	}
+}
+
+float Component::getTimeSinceLastTick() const
+{
+	return (gNowMicros - m_lastTickMicros) / 1000000.0f;
 }
 
 void Component::startTicking()
 {
-	m_ticker.start(1.0f);
+	if (m_heapIndex == -1)
+	{
+		m_lastTickMicros = gNowMicros;
+	}
+	schedule(gNowMicros + secondsToMicros(1.0f));
+}
+
+void Component::schedule(uint64_t deadlineMicros)
+{
+	if (m_heapIndex == -1)
+	{
+		CZ_ASSERT(gHeapSize < AW_MAX_NUM_COMPONENTS);
+		m_deadlineMicros = deadlineMicros;
+		m_heapIndex = gHeapSize++;
+		gHeap[m_heapIndex] = this;
+		siftUp(m_heapIndex);
+	}
+	else if (deadlineMicros < m_deadlineMicros)
+	{
+		m_deadlineMicros = deadlineMicros;
+		siftUp(m_heapIndex);
+	}
+	else
+	{
+		m_deadlineMicros = deadlineMicros;
+		siftDown(m_heapIndex);
+	}
+}
+
+void Component::unschedule()
+{
+	if (m_heapIndex == -1)
+	{
+		return;
+	}
+
+	int index = m_heapIndex;
+	m_heapIndex = -1;
+	gHeapSize--;
+
+	// Fill the hole with the last element, and put it in the right place
+	if (index != gHeapSize)
+	{
+		Component* last = gHeap[gHeapSize];
+		gHeap[index] = last;
+		last->m_heapIndex = index;
+		siftUp(index);
+		siftDown(last->m_heapIndex);
+	}
+}
+
+void Component::siftUp(int index)
+{
+	Component* component = gHeap[index];
+	while (index > 0)
+	{
+		int parent = (index - 1) / 2;
+		if (gHeap[parent]->m_deadlineMicros <= component->m_deadlineMicros)
+		{
+			break;
+		}
+
+		gHeap[index] = gHeap[parent];
+		gHeap[index]->m_heapIndex = index;
+		index = parent;
+		gSchedulerStats.heapOps++;
+	}
+
+	gHeap[index] = component;
+	component->m_heapIndex = index;
+}
+
+void Component::siftDown(int index)
+{
+	Component* component = gHeap[index];
+	while (true)
+	{
+		int child = index * 2 + 1;
+		if (child >= gHeapSize)
+		{
+			break;
+		}
+
+		if (child + 1 < gHeapSize && gHeap[child + 1]->m_deadlineMicros < gHeap[child]->m_deadlineMicros)
+		{
+			child++;
+		}
+
+		if (component->m_deadlineMicros <= gHeap[child]->m_deadlineMicros)
+		{
+			break;
+		}
+
+		gHeap[index] = gHeap[child];
+		gHeap[index]->m_heapIndex = index;
+		index = child;
+		gSchedulerStats.heapOps++;
+	}
+
+	gHeap[index] = component;
+	component->m_heapIndex = index;
 }
 
 } // namespace cz
@@ -2,7 +2,6 @@
 
 #include "crazygaze/micromuc/czmicromuc.h"
 #include "crazygaze/micromuc/LinkedList.h"
-#include "crazygaze/micromuc/Ticker.h"
 #include "Events.h"
 #include <crazygaze/micromuc/StringUtils.h>
 #include <Arduino.h>
@@ -37,46 +36,237 @@ public:
 	* \return
 	*	Returns true if finished, false if it should be called again
 	*
-	* This allows our setup() to make multiple passes to initialize all components, where each component might have dependencies which are not initialized yet,
-	* so it delays it's own initialization by returning false until all dependencies are initialized.
+	* initAll only calls this once all the component's dependencies (see declareDependencies) are initialized.
+	* A component can still return false from initImpl if its own initialization takes a while (e.g: waiting for some
+	* hardware), in which case initAll carries on initializing other components and calls it again later.
 	*
 	* Derived classed should implement initImpl()
 	*/
 	bool init();
 
+	/*
+	* Called by initAll for all components, before initializing any of them.
+	* Components that need other components to be initialized first call dependsOn from here.
+	*/
+	virtual void declareDependencies() {}
+
 	virtual const char* getName() const = 0;
 	virtual float tick(float deltaSeconds) = 0;
 	virtual void onEvent(const Event& evt) = 0;
 	virtual bool processCommand(const Command& cmd) { return true; }
 
+	/*
+	* Entry in a component's command table (see setCommandTable)
+	*/
+	struct CommandEntry
+	{
+		const char* name;
+		bool (*handler)(Component& component, const Command& cmd);
+	};
+
+	/*
+	* Executes a command targeted at this component.
+	* Commands in the component's command table are found with a hash lookup. Anything else goes to processCommand.
+	*/
+	bool executeCommand(const Command& cmd);
+
+	/*
+	* Components registered as wake sources with the low power idle (see LowPowerIdle.h) return true from this when they
+	* have input to process (e.g: received serial data), so the main loop wakes up and ticks them right away.
+	*/
+	virtual bool hasPendingInput() { return false; }
+
+	/*
+	* Makes the component tick as soon as possible, instead of waiting for the countdown returned by its last tick.
+	* This allows components to return long countdowns and rely on events to wake them up.
+	* Does nothing if the component is not ticking.
+	*/
+	void wakeUp();
+
+	/*
+	* Finds a component by name (case insensitive), using a hash index.
+	*/
 	static Component* getByName(const char* name);
+	/*
+	* Calls onEvent on all the components that subscribed to the event's type.
+	* If AW_EVENT_DEFERRED_DISPATCH is enabled, the event is queued and dispatched later by tickAll.
+	*/
 	static void raiseEvent(const Event& evt);
+	/*
+	* Initializes all components in dependency order. Reboots if any component can't be initialized.
+	*/
 	static void initAll();
+
+	/*
+	* Logs how long each component took to initialize, when it was ready, and when the first soil moisture reading
+	* happened (all relative to the reset)
+	*/
+	static void logBootTimings();
 	static float tickAll(float deltaSeconds);
 	static int getCount();
+
+	/*
+	* Logs how much work the scheduler did since boot (or since the last resetSchedulerStats call).
+	*/
+	static void logSchedulerStats();
+	static void resetSchedulerStats();
+	/*
+	* How many times components were visited by the scheduler (ticked, or moved in the heap) since boot (or since the
+	* last resetSchedulerStats call).
+	*/
+	static uint32_t getSchedulerVisits();
+
+	/*
+	* Logs wakeups per hour, in total and per component, since boot (or since the last resetSchedulerStats call)
+	*/
+	static void logWakeups();
+
+	/*
+	* Logs how many times each event type was raised, how many onEvent calls that caused, and the time spent dispatching.
+	*/
+	static void logEventStats();
+	static void resetEventStats();
+
+	/*
+	* Logs per component CPU time, events handled and heap high water marks (see AW_COMPONENT_STATS_ENABLED)
+	*/
+	static void logComponentStats();
+	static void resetComponentStats();
+
+	/*
+	* Logs the tick duration histograms, max tick duration and budget overruns of all components
+	*/
+	static void logTickStats();
+
+	/*
+	* Returns a short summary of the tick stats of the components with the slowest ticks, meant for publishing as
+	* diagnostics. E.g: "MQTTCache:max=4012ms,overruns=3,last=12345s;GraphicalUI:max=..."
+	*/
+	static String getTickDiagnostics(int maxComponents);
+
+	/*
+	* Sets how long a tick is allowed to take before it counts as an overrun.
+	* Does nothing if AW_COMPONENT_STATS_ENABLED is 0
+	*/
+	void setTickBudget(float seconds);
 protected:
 	void stopTicking();
 	void startTicking();
+
+	/*
+	* Scheduler time since this component's last tick. This is what deltaSeconds will include on the next tick, so
+	* components changing state from outside their tick (e.g: from onEvent) can account for it.
+	* Returns 0 from inside tick().
+	*/
+	float getTimeSinceLastTick() const;
+
+	// Makes initAll initialize the specified component before this one. Should be called from declareDependencies.
+	void dependsOn(Component* dependency);
+
+	/*
+	* Sets the component's command table. The commands in the table are looked up by hash before falling back to
+	* processCommand.
+	* The table is not copied, so it needs to outlive the component (e.g: a static const array).
+	*/
+	void setCommandTable(const CommandEntry* commands, int count);
+
+	/*
+	* Registers interest in an event type. onEvent is only called for the event types the component subscribed to.
+	* This is safe to call from constructors.
+	*/
+	void subscribe(Event::Type type);
+	// Subscribes to all event types. Meant for components that forward all events to something else (e.g: GraphicalUI)
+	void subscribeAll();
 private:
 	virtual bool initImpl() = 0;
 
+	// Removes the component from all the event subscriber lists
+	void unsubscribeAll();
+	// Calls onEvent on the event's subscribers
+	static void dispatchEvent(const Event& evt);
+#if AW_EVENT_DEFERRED_DISPATCH
+	static void dispatchQueuedEvents();
+#endif
+	// Used by initAll to initialize components in dependency order
+	bool areDependenciesInitialized() const;
+	// Builds the name and command hash indexes
+	static void buildIndexes();
+
+	//
+	// Scheduler heap management
+	//
+	void schedule(uint64_t deadlineMicros);
+	void unschedule();
+	static void siftUp(int index);
+	static void siftDown(int index);
 
-	TTicker<Component*, float> m_ticker;
+	// Scheduler time (in microseconds) at which this component is due to be ticked
+	uint64_t m_deadlineMicros = 0;
+	// Scheduler time of the last tick, so tick() receives the time elapsed since then
+	uint64_t m_lastTickMicros = 0;
+	// How many times the component ticked since the last resetSchedulerStats
+	uint32_t m_tickCount = 0;
+	// Position in the scheduler heap, or -1 if not ticking
+	int16_t m_heapIndex = -1;
 	bool m_initialized = false;
+
+	const CommandEntry* m_commands = nullptr;
+	int m_numCommands = 0;
+
+	// Boot timings
+	uint32_t m_initMicros = 0; // Time spent in initImpl
+	uint32_t m_initReadyMillis = 0; // millis() when the component finished initializing
+	uint16_t m_initCalls = 0;
+
+#if AW_COMPONENT_STATS_ENABLED
+	// Bucket 0 is for ticks under 1us, and bucket N (N>=1) for ticks in the [2^(N-1), 2^N) us range. The last bucket
+	// also takes anything longer (>= ~4 seconds).
+	static constexpr int ms_tickHistogramNumBuckets = 24;
+
+	struct Stats
+	{
+		// Real time (not affected by AW_MOCK_TIME_SCALE) spent in tick() and onEvent()
+		uint64_t tickMicros;
+		uint64_t eventMicros;
+		uint32_t tickCount;
+		uint32_t eventCount;
+		// Highest heap usage seen right after the component ticked or handled an event
+		int heapHighWater;
+
+		uint32_t tickHistogram[ms_tickHistogramNumBuckets];
+		uint32_t maxTickMicros;
+		uint32_t overruns;
+		// Scheduler time of the last overrun
+		uint64_t lastOverrunMicros;
+	};
+	Stats m_stats = {};
+	uint32_t m_tickBudgetMicros = AW_COMPONENT_TICK_BUDGET_MS * 1000;
+	void updateHeapHighWater();
+	void updateTickStats(uint32_t tickMicros);
+#endif
 };
 
 struct Command
 {
-	// Pointer to the full command string (command + parameters)
+	// Full command line (command + parameters), as received
+	const char* line = nullptr;
+	// Where parsing continues from. parseCmd moves it past the command name, so it points to the parameters
 	const char* src = nullptr;
 
 	// Full command name (e.g: COMPONENT.COMMAND )
 	char fullCmd[60];
 	const char* cmd; // Pointer into fullCmd, where the actual command starts
+	uint32_t cmdHash = 0; // Case insensitive hash of cmd
 	Component* targetComponent = nullptr;
 
+	// If false, parsing errors are not logged, only kept in error (e.g: the console's batch mode reports them at the end)
+	bool logErrors = true;
+	// Why the command failed, if it was a parsing error
+	mutable const char* error = nullptr;
+
 	explicit Command(const char* src)
-		: src(src)
+		: line(src)
+		, src(src)
 	{
 	}
 
@@ -97,7 +287,11 @@ struct Command
 		}
 		else
 		{
-			CZ_LOG(logDefault, Error, F("Error parsing parameters for command \"%s\""), cmd);
+			error = "invalid parameters";
+			if (logErrors)
+			{
+				CZ_LOG(logDefault, Error, F("Error parsing parameters for command \"%s\""), cmd);
+			}
 			return false;
 		}
 	}
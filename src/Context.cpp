@@ -4,11 +4,13 @@
 #include "Component.h"
 #include <Arduino.h>
 #include <type_traits>
+#include <stddef.h>
 
 namespace cz
 {
 
 Context gCtx;
+Setup* gSetup;
 
 void updateEEPROM(ConfigStoragePtr& dst, const uint8_t* src, unsigned int size)
 {
@@ -97,19 +99,32 @@ void GroupConfig::log() const
 	CZ_LOG(logDefault, Log, F("    m_data.running=%u"), (unsigned int)m_data.running);
 	CZ_LOG(logDefault, Log, F("    m_data.samplingInterval=%u"), (unsigned int)m_data.samplingInterval);
 	CZ_LOG(logDefault, Log, F("    m_data.shotDuration=%u"), (unsigned int)m_data.shotDuration);
+	CZ_LOG(logDefault, Log, F("    m_data.shotVolume=%u"), (unsigned int)m_data.shotVolume);
 	CZ_LOG(logDefault, Log, F("    m_data.waterValue=%u"), (unsigned int)m_data.waterValue);
 	CZ_LOG(logDefault, Log, F("    m_data.airValue=%u"), (unsigned int)m_data.airValue);
 	CZ_LOG(logDefault, Log, F("    m_data.thresholdValue=%u, %u%%"), (unsigned int)m_data.thresholdValue, getThresholdValueAsPercentage());
+	CZ_LOG(logDefault, Log, F("    m_data.temperatureCompensation=%d/%d (ref %d)"),
+		(int)m_data.temperatureCompensation.coldSlopeQ8,
+		(int)m_data.temperatureCompensation.hotSlopeQ8,
+		(int)m_data.temperatureCompensation.referenceTemperature);
+	CZ_LOG(logDefault, Log, F("    m_data.totalVolume=%u"), (unsigned int)m_data.totalVolume);
 	CZ_LOG(logDefault, Log, F("    m_isDirty=%u"), (unsigned int)m_isDirty);
 	CZ_LOG(logDefault, Log, F("    m_currentValue=%u"), (unsigned int)m_currentValue);
 	CZ_LOG(logDefault, Log, F("    m_numReadings=%u"), (unsigned int)m_numReadings);
 }
 
+int GroupConfig::getSaveSize(uint8_t version)
+{
+	// Fields are only ever added at the end, so older versions are the beginning of the current one
+	return version < 2 ? offsetof(SaveData, temperatureCompensation) : sizeof(SaveData);
+}
+
 void GroupConfig::save(ConfigStoragePtr& dst) const
 {
 	if (m_isDirty)
 	{
 		m_isDirty = false;
+		m_unsavedVolume = 0;
 		updateEEPROM(dst, reinterpret_cast<const uint8_t*>(&m_data), sizeof(m_data));
 	}
 	else
@@ -119,10 +134,14 @@ void GroupConfig::save(ConfigStoragePtr& dst) const
 	}
 }
 
-void GroupConfig::load(ConfigStoragePtr& src)
+void GroupConfig::load(ConfigStoragePtr& src, uint8_t version)
 {
-	readEEPROM(src, reinterpret_cast<uint8_t*>(&m_data), sizeof(m_data));
-	m_isDirty = false;
+	m_data = SaveData();
+	int size = getSaveSize(version);
+	readEEPROM(src, reinterpret_cast<uint8_t*>(&m_data), size);
+	// If it's an older layout, it needs saving again in the current one
+	m_isDirty = size != sizeof(m_data);
+	m_unsavedVolume = 0;
 }
 
 bool GroupConfig::isDirty() const
@@ -243,6 +262,36 @@ void GroupConfig::setShotDuration(unsigned int value_)
 	}
 }
 
+unsigned int GroupConfig::getShotVolume() const
+{
+	return m_data.shotVolume;
+}
+
+void GroupConfig::setShotVolume(unsigned int value_)
+{
+	unsigned int value = cz::clamp<unsigned int>(value_, 0, AW_SHOT_MAX_VOLUME);
+	if (value != m_data.shotVolume)
+	{
+		SET_DIRTY("shotVolume");
+		m_data.shotVolume = value;
+	}
+}
+
+uint32_t GroupConfig::getTotalVolume() const
+{
+	return m_data.totalVolume;
+}
+
+void GroupConfig::addTotalVolume(uint32_t value)
+{
+	if (value)
+	{
+		SET_DIRTY("totalVolume");
+		m_data.totalVolume += value;
+		m_unsavedVolume += value;
+	}
+}
+
 void GroupConfig::setSensorValue(unsigned int currentValue_, bool adjustRange)
 {
 	m_numReadings++;
@@ -305,6 +354,22 @@ void GroupConfig::endCalibration()
 	Component::raiseEvent(SoilMoistureSensorCalibrationEvent(getIndex(), false));
 }
 
+const TemperatureCompensation& GroupConfig::getTemperatureCompensation() const
+{
+	return m_data.temperatureCompensation;
+}
+
+void GroupConfig::setTemperatureCompensation(const TemperatureCompensation& compensation)
+{
+	TemperatureCompensation& current = m_data.temperatureCompensation;
+	if (current.coldSlopeQ8 != compensation.coldSlopeQ8 || current.hotSlopeQ8 != compensation.hotSlopeQ8 ||
+		current.referenceTemperature != compensation.referenceTemperature)
+	{
+		SET_DIRTY("temperatureCompensation");
+		current = compensation;
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////
 // GroupData
 ///////////////////////////////////////////////////////////////////////
@@ -365,8 +430,36 @@ void GroupData::begin(uint8_t index)
 #endif
 }
 
-void GroupData::setMoistureSensorValues(const SensorReading& sample)
+SensorReading GroupData::compensate(const SensorReading& reading)
+{
+	SensorReading res = reading;
+	int16_t temperature;
+	if (!reading.isValid() || !TemperatureCompensation::toTenths(gCtx.data.getTemperatureReading(), temperature))
+	{
+		return res;
+	}
+
+	const TemperatureCompensation& compensation = m_cfg.getTemperatureCompensation();
+	if (m_cfg.isRunning() && !m_inConfigMenu)
+	{
+		m_temperatureLearner.addReading(reading.rawValue, temperature, compensation.referenceTemperature, m_wateredSinceLastReading);
+		m_wateredSinceLastReading = false;
+	}
+
+	if (compensation.isEnabled())
+	{
+		res.meanValue = compensation.apply(reading.rawValue, temperature);
+	}
+
+	return res;
+}
+
+void GroupData::setMoistureSensorValues(const SensorReading& sample_)
 {
+	// Everything from here on (calibration, history, pump decisions) uses the compensated value
+	SensorReading sample = compensate(sample_);
+	m_currentRawValue = sample.rawValue;
+
 	if (m_inConfigMenu)
 	{
 		// If we are configuring this group, then we want to ignore the readings and just raise calibration events
@@ -390,12 +483,21 @@ void GroupData::setMoistureSensorValues(const SensorReading& sample)
 		}
 		m_history.push(point);
 
-		if (!sample.isValid())
+		if (sample.isValid())
+		{
+			m_drift.addReading(sample.meanValue, sample.standardDeviation);
+		}
+		else
 		{
 			m_sensorErrors++;
 		}
 
 		Component::raiseEvent(SoilMoistureSensorReadingEvent(getIndex(), sample));
+
+		if (sample.isValid())
+		{
+			updateSensorDrift();
+		}
 	}
 }
 
@@ -408,6 +510,8 @@ void GroupData::setMotorState(bool state)
 	if (state)
 	{
 		m_pendingMotorPoint = true;
+		m_drift.onShot();
+		m_wateredSinceLastReading = true;
 	}
 
 	Component::raiseEvent(MotorEvent(getIndex(), m_motorIsOn));
@@ -433,6 +537,128 @@ void GroupData::setRunning(bool state)
 	Component::raiseEvent(GroupOnOffEvent(getIndex(), state));
 }
 
+void GroupData::updateSensorDrift()
+{
+	uint8_t flags = m_drift.calcFlags(getAirValue(), getWaterValue());
+	if (flags == m_driftFlags)
+	{
+		return;
+	}
+
+	m_driftFlags = flags;
+	m_drift.log(getIndex(), getAirValue(), getWaterValue());
+	Component::raiseEvent(SoilMoistureSensorDriftEvent(getIndex(), flags));
+
+#if AW_SENSOR_DRIFT_AUTO_APPLY
+	if (flags & (SensorDriftEstimator::Flags::AboveAir | SensorDriftEstimator::Flags::BelowWater))
+	{
+		applySensorDriftProposal();
+	}
+#endif
+}
+
+bool GroupData::applySensorDriftProposal()
+{
+	unsigned int airValue, waterValue;
+	if (!m_drift.calcProposal(getAirValue(), getWaterValue(), airValue, waterValue))
+	{
+		CZ_LOG(logDefault, Log, F("Group %u: No sensor drift proposal to apply"), static_cast<unsigned int>(getIndex()));
+		return false;
+	}
+
+	CZ_LOG(logDefault, Log, F("Group %u: Applying sensor drift proposal. air/water %u/%u -> %u/%u")
+		, static_cast<unsigned int>(getIndex())
+		, getAirValue()
+		, getWaterValue()
+		, airValue
+		, waterValue);
+
+	unsigned int thresholdPercentage = getThresholdValueAsPercentage();
+	m_cfg.setSensorAirAndWaterValues(airValue, waterValue);
+	m_cfg.setThresholdValueAsPercentage(thresholdPercentage);
+	Component::raiseEvent(GroupConfigChangedEvent(getIndex()));
+
+	// Goes through the normal save, which only writes if the config is dirty
+	gCtx.data.saveGroupConfig(getIndex());
+
+	updateSensorDrift();
+	return true;
+}
+
+void GroupData::setTemperatureCompensation(const TemperatureCompensation& compensation)
+{
+	m_cfg.setTemperatureCompensation(compensation);
+	Component::raiseEvent(GroupConfigChangedEvent(getIndex()));
+	logTemperatureCompensation();
+}
+
+bool GroupData::applyLearnedTemperatureCompensation()
+{
+	TemperatureCompensation compensation;
+	if (!m_temperatureLearner.calcCompensation(getTemperatureCompensation().referenceTemperature, compensation))
+	{
+		CZ_LOG(logDefault, Log, F("Group %u: Not enough data to learn the temperature compensation"), static_cast<unsigned int>(getIndex()));
+		return false;
+	}
+
+	setTemperatureCompensation(compensation);
+	gCtx.data.saveGroupConfig(getIndex());
+	return true;
+}
+
+void GroupData::logTemperatureCompensation() const
+{
+	const TemperatureCompensation& compensation = getTemperatureCompensation();
+	CZ_LOG(logDefault, Log, F("Group %u temperature compensation: %s, cold slope=%d, hot slope=%d (Q8 units/C), reference=%d (0.1C). Last value: raw=%u, compensated=%u")
+		, static_cast<unsigned int>(getIndex())
+		, compensation.isEnabled() ? "enabled" : "disabled"
+		, static_cast<int>(compensation.coldSlopeQ8)
+		, static_cast<int>(compensation.hotSlopeQ8)
+		, static_cast<int>(compensation.referenceTemperature)
+		, m_currentRawValue
+		, getCurrentValue());
+	m_temperatureLearner.log(getIndex());
+}
+
+void GroupData::addDeliveredVolume(uint32_t ml)
+{
+	if (ml == 0)
+	{
+		return;
+	}
+
+	m_cfg.addTotalVolume(ml);
+	// Saving after every shot wears the storage, and blocks while writing, so the total is saved in batches. A reset
+	// loses at most AW_FLOW_METER_SAVE_VOLUME.
+	if (m_cfg.getUnsavedVolume() >= AW_FLOW_METER_SAVE_VOLUME)
+	{
+		gCtx.data.saveGroupConfig(getIndex());
+	}
+}
+
+void GroupData::setSamplingInterval(unsigned int value)
+{
+	m_cfg.setSamplingInterval(value);
+	Component::raiseEvent(GroupConfigChangedEvent(getIndex()));
+}
+
+void GroupData::setConfig(GroupConfig cfg)
+{
+	m_cfg.setTo(cfg);
+	Component::raiseEvent(GroupConfigChangedEvent(getIndex()));
+}
+
+void GroupData::setInConfigMenu(bool inMenu)
+{
+	if (m_inConfigMenu == inMenu)
+	{
+		return;
+	}
+
+	m_inConfigMenu = inMenu;
+	Component::raiseEvent(GroupConfigChangedEvent(getIndex()));
+}
+
 void GroupData::resetHistory()
 {
 	m_history.clear();
@@ -453,12 +679,12 @@ void GroupData::save(ConfigStoragePtr& dst, bool saveConfig, bool saveHistory) c
 	}
 }
 
-void GroupData::load(ConfigStoragePtr& src, bool loadConfig, bool loadHistory)
+void GroupData::load(ConfigStoragePtr& src, uint8_t version, bool loadConfig, bool loadHistory)
 {
 	if (loadConfig)
 	{
 		CZ_LOG(logDefault, Log, F("Loading group %d config from address %u"), getIndex(), src.getAddress());
-		m_cfg.load(src);
+		m_cfg.load(src, version);
 	}
 
 	if (loadHistory)
@@ -470,6 +696,13 @@ void GroupData::load(ConfigStoragePtr& src, bool loadConfig, bool loadHistory)
 	m_sensorErrors = 0;
 }
 
+void GroupData::resetConfig()
+{
+	// A default config is dirty, so it gets saved
+	m_cfg.setTo(GroupConfig());
+	resetHistory();
+}
+
 ///////////////////////////////////////////////////////////////////////
 // ProgramData
 ///////////////////////////////////////////////////////////////////////
@@ -586,6 +819,8 @@ void ProgramData::save() const
 	ConfigStoragePtr ptr = m_outer.configStorage.ptrAt(0);
 
 	CZ_LOG(logDefault, Log, F("Saving full config. DeviceName: %s"), m_devicename);
+	cz::save(ptr, ms_configMagic);
+	cz::save(ptr, ms_configVersion);
 	updateEEPROM(ptr, m_devicename, sizeof(m_devicename));
 
 	// We save the configs first because they are fixed size, and so we can load/save groups individually when coming
@@ -621,12 +856,8 @@ void ProgramData::saveGroupConfig(uint8_t index)
 	unsigned long startTime = micros();
 	ConfigStoragePtr ptr = m_outer.configStorage.ptrAt(0);
 
-	ptr.inc(sizeof(m_devicename));
-
-	for(uint8_t idx = 0; idx<index; ++idx)
-	{
-		ptr.inc(m_group[idx].getConfigSaveSize());
-	}
+	// This relies on the storage already having the current layout, which load and save make sure of
+	ptr.inc(ms_configHeaderSize + sizeof(m_devicename) + index * GroupConfig::getSaveSize(ms_configVersion));
 
 	uint16_t startAddress = ptr.getAddress();
 	m_group[index].save(ptr, true, false);
@@ -649,17 +880,34 @@ void ProgramData::load()
 	m_outer.configStorage.start();
 	ConfigStoragePtr ptr = m_outer.configStorage.ptrAt(0);
 
-	readEEPROM(ptr, m_devicename, sizeof(m_devicename));
-	CZ_LOG(logDefault, Log, F("Loading config. DeviceName: %s"), m_devicename);
-
-	for(GroupData& g : m_group)
+	uint16_t magic;
+	uint8_t version = 1;
+	cz::load(ptr, magic);
+	if (magic == ms_configMagic)
+	{
+		cz::load(ptr, version);
+	}
+	else
 	{
-		g.load(ptr, true, false);
+		// Saved before the layout was versioned, so there is no header
+		ptr.inc(-static_cast<int16_t>(sizeof(magic)));
 	}
 
-	for(GroupData& g : m_group)
+	bool valid = version >= 1 && version <= ms_configVersion;
+	if (valid)
 	{
-		g.load(ptr, false, true);
+		readEEPROM(ptr, m_devicename, sizeof(m_devicename));
+		CZ_LOG(logDefault, Log, F("Loading config version %u. DeviceName: %s"), (unsigned int)version, m_devicename);
+
+		for(GroupData& g : m_group)
+		{
+			g.load(ptr, version, true, false);
+		}
+
+		for(GroupData& g : m_group)
+		{
+			g.load(ptr, version, false, true);
+		}
 	}
 
 	m_outer.configStorage.end();
@@ -667,6 +915,25 @@ void ProgramData::load()
 	unsigned long elapsedMs = (micros() - startTime) / 1000;
 	CZ_LOG(logDefault, Log, F("Loading full config from EEPROM took %u ms"), elapsedMs);
 
+	if (!valid)
+	{
+		// E.g: Saved by a newer firmware
+		CZ_LOG(logDefault, Warning, F("Unknown config version %u. Resetting to the default config."), (unsigned int)version);
+		m_devicename[0] = 0;
+		for(GroupData& g : m_group)
+		{
+			g.resetConfig();
+		}
+		save();
+	}
+	else if (version != ms_configVersion)
+	{
+		// Saving straight away in the current layout, since saveGroupConfig expects it. The group configs are dirty
+		// (see GroupConfig::load), so they all get written.
+		CZ_LOG(logDefault, Log, F("Converting config from version %u to %u"), (unsigned int)version, (unsigned int)ms_configVersion);
+		save();
+	}
+
 	logConfig();	
 
 	bool wasReady = m_isReady;
@@ -3,6 +3,8 @@
 #include <Arduino.h>
 #include "utility/MCP23017Wrapper.h"
 #include "utility/MuxNChannels.h"
+#include "utility/SensorDriftEstimator.h"
+#include "utility/TemperatureCompensation.h"
 #include <crazygaze/micromuc/Queue.h>
 #include "crazygaze/micromuc/MathUtils.h"
 #include "EEPROMUtils.h"
@@ -34,6 +36,7 @@ namespace cz
 
 		explicit SensorReading(unsigned int meanValue, float standardDeviation)
 			: meanValue(meanValue)
+			, rawValue(meanValue)
 			, standardDeviation(standardDeviation)
 		{
 			if (meanValue < AW_MOISTURESENSOR_ACCEPTABLE_MIN_VALUE)
@@ -69,6 +72,8 @@ namespace cz
 
 		Status status = Status::Valid;
 		unsigned int meanValue = 0;
+		// Value before temperature compensation. Same as meanValue if there is no compensation.
+		unsigned int rawValue = 0;
 		float standardDeviation = 0;
 	};
 
@@ -99,6 +104,8 @@ namespace cz
 
 		//
 		// Data that should be save/loaded
+		// NOTE: New fields always go at the end, and need a new config layout version (see ProgramData::ms_configVersion)
+		// so older configs can still be loaded.
 		struct SaveData
 		{
 			// Tells if this group is currently running
@@ -122,6 +129,14 @@ namespace cz
 			// NOTE: ABOVE because higher values means drier.
 			// Using a big value as initial value, which means it will not turn on the motor until things are setup properly
 			uint16_t thresholdValue = 65535;
+
+			// Added in layout version 2 (see ProgramData::ms_configVersion)
+			// Disabled by default
+			TemperatureCompensation temperatureCompensation;
+			// Motor shot volume in millilitres, if the group has a flow meter. 0 means shots are time based.
+			uint16_t shotVolume = AW_SHOT_DEFAULT_VOLUME;
+			// Total water delivered so far, in millilitres, as measured by the flow meter
+			uint32_t totalVolume = 0;
 		} m_data;
 
 		// This needs to start as true, because:
@@ -130,6 +145,9 @@ namespace cz
 		//	* If the user chooses to let the boot menu load the current saved config, then this will be reset to false as part of "load()"
 		mutable bool m_isDirty = true;
 
+		// Volume added to totalVolume since the config was last saved or loaded
+		mutable uint32_t m_unsavedVolume = 0;
+
 		// Current sensor value
 		// This doesn't need to be saved or loaded
 		unsigned int m_currentValue = START_AIR_VALUE - (START_AIR_VALUE-START_WATER_VALUE)/2;
@@ -164,14 +182,18 @@ namespace cz
 			return m_index;
 		}
 
-		int getSaveSize() const
-		{
-			return sizeof(m_data);
-		}
+		/**
+		 * How many bytes the config takes in the storage, with the specified layout version
+		 */
+		static int getSaveSize(uint8_t version);
 
 	  	void log() const;
 		void save(ConfigStoragePtr& dst) const;
-		void load(ConfigStoragePtr& src);
+		/**
+		 * Loads a config saved with the specified layout version. Fields the version didn't have are set to their
+		 * defaults.
+		 */
+		void load(ConfigStoragePtr& src, uint8_t version);
 		bool isDirty() const;
 		bool isRunning() const;
 		void setRunning(bool running);
@@ -217,6 +239,23 @@ namespace cz
 		 */
 		void setShotDuration(unsigned int value_);
 
+		/**
+		 * Returns the water shot volume in millilitres. 0 means shots are time based.
+		 */
+		unsigned int getShotVolume() const;
+
+		/**
+		 * Set the water shot volume in millilitres. 0 means shots are time based.
+		 */
+		void setShotVolume(unsigned int value_);
+
+		uint32_t getTotalVolume() const;
+		void addTotalVolume(uint32_t value);
+		uint32_t getUnsavedVolume() const
+		{
+			return m_unsavedVolume;
+		}
+
 		/**
 		 * Changes the sensor value.
 		 * \param currentValue The sensor value to save
@@ -235,6 +274,9 @@ namespace cz
 		void startCalibration();
 		void endCalibration();
 
+		const TemperatureCompensation& getTemperatureCompensation() const;
+		void setTemperatureCompensation(const TemperatureCompensation& compensation);
+
 	};
 
 	class GroupData
@@ -322,10 +364,7 @@ namespace cz
 			return m_cfg.getSamplingIntervalInMinutes();
 		}
 
-		void setSamplingInterval(unsigned int value)
-		{
-			m_cfg.setSamplingInterval(value);
-		}
+		void setSamplingInterval(unsigned int value);
 
 		unsigned int getShotDuration() const
 		{
@@ -337,6 +376,27 @@ namespace cz
 			m_cfg.setShotDuration(value);
 		}
 
+		unsigned int getShotVolume() const
+		{
+			return m_cfg.getShotVolume();
+		}
+
+		void setShotVolume(unsigned int value)
+		{
+			m_cfg.setShotVolume(value);
+		}
+
+		uint32_t getTotalVolume() const
+		{
+			return m_cfg.getTotalVolume();
+		}
+
+		/**
+		 * Adds water delivered by a shot to the group's total.
+		 * The total is only saved once AW_FLOW_METER_SAVE_VOLUME builds up (or with any other save of the group's config)
+		 */
+		void addDeliveredVolume(uint32_t ml);
+
 		void setAirAndWaterValues(unsigned int airValue, unsigned int waterValue)
 		{
 			m_cfg.setSensorAirAndWaterValues(airValue, waterValue);
@@ -359,6 +419,49 @@ namespace cz
 			return m_sensorErrors;
 		}
 
+		/**
+		 * Sensor drift flags (see SensorDriftEstimator::Flags)
+		 */
+		uint8_t getSensorDriftFlags() const
+		{
+			return m_driftFlags;
+		}
+
+		void logSensorDrift() const
+		{
+			m_drift.log(getIndex(), getAirValue(), getWaterValue());
+		}
+
+		/**
+		 * Applies the air/water values proposed by the drift estimator, keeping the threshold at the same percentage,
+		 * and saves the group config.
+		 * Returns false if there was nothing to apply.
+		 */
+		bool applySensorDriftProposal();
+
+		/**
+		 * Value of the last reading before temperature compensation
+		 */
+		unsigned int getCurrentRawValue() const
+		{
+			return m_currentRawValue;
+		}
+
+		const TemperatureCompensation& getTemperatureCompensation() const
+		{
+			return m_cfg.getTemperatureCompensation();
+		}
+
+		void setTemperatureCompensation(const TemperatureCompensation& compensation);
+
+		/**
+		 * Sets the temperature compensation to what was learned so far.
+		 * Returns false if there isn't enough data yet.
+		 */
+		bool applyLearnedTemperatureCompensation();
+
+		void logTemperatureCompensation() const;
+
 		/**
 		 * Returns a copy of the group config.
 		 * This can be used by the UI for the settings menu, so it can change values without triggering events
@@ -368,19 +471,13 @@ namespace cz
 			return m_cfg;
 		}
 
-		void setConfig(GroupConfig cfg)
-		{
-			m_cfg.setTo(cfg);
-		}
+		void setConfig(GroupConfig cfg);
 
 		// Sets this group as being configured or not at the moment.
 		// When set to being configured, the following happens:
 		//		* Sampling interval is temporarily set to AW_MOISTURESENSOR_CALIBRATION_SAMPLINGINTERVAL
 		//		* Temporarily switches to raising SoilMoistureSensorCalibration_XXX events, instead of SoilMoistureSensor_XXX events
-		void setInConfigMenu(bool inMenu)
-		{
-			m_inConfigMenu = inMenu;
-		}
+		void setInConfigMenu(bool inMenu);
 
 		bool isInConfigMenu() const
 		{
@@ -395,11 +492,9 @@ namespace cz
 	protected:
 		friend class ProgramData;
 		void save(ConfigStoragePtr& dst, bool saveConfig, bool saveHistory) const;
-		void load(ConfigStoragePtr& src, bool loadConfig, bool loadHistory);
-		int getConfigSaveSize() const
-		{
-			return m_cfg.getSaveSize();
-		}
+		void load(ConfigStoragePtr& src, uint8_t version, bool loadConfig, bool loadHistory);
+		// Sets the config to the defaults and clears the history
+		void resetConfig();
 
 	  private:
 
@@ -410,6 +505,17 @@ namespace cz
 		
 		uint32_t m_sensorErrors = 0;
 
+		SensorDriftEstimator m_drift;
+		uint8_t m_driftFlags = SensorDriftEstimator::Flags::None;
+		void updateSensorDrift();
+
+		TemperatureCompensationLearner m_temperatureLearner;
+		unsigned int m_currentRawValue = 0;
+		// Tells the learner to ignore the change between the previous and next reading
+		bool m_wateredSinceLastReading = false;
+		// Applies the temperature compensation, and feeds the learner
+		SensorReading compensate(const SensorReading& reading);
+
 		bool m_motorIsOn = false;
 		// Used so we can detect when the motor was turned on and off before a sensor data point is inserted, so we can
 		// add the motor flag to the next sensor data point when that happens.
@@ -483,6 +589,19 @@ public:
 	float getHumidityReading() const { return m_humidity; }
 	
   private:
+
+	/*
+	* The storage starts with ms_configMagic and the layout version, followed by the device name, all the group configs,
+	* and all the group histories.
+	* Bump ms_configVersion whenever the layout changes, and handle the older versions in load (see GroupConfig::load).
+	* 1 - No magic/version. Group configs up to thresholdValue
+	* 2 - Adds temperatureCompensation, shotVolume and totalVolume to the group configs
+	*/
+	// Stored as 0xFE 0xA7. 0xFE never shows up in text, so it can't be the start of a device name saved without a header
+	static constexpr uint16_t ms_configMagic = 0xA7FE;
+	static constexpr uint8_t ms_configVersion = 2;
+	static constexpr int ms_configHeaderSize = sizeof(ms_configMagic) + sizeof(ms_configVersion);
+
 	Context& m_outer;
 
 	char m_devicename[AW_DEVICENAME_MAX_LEN+1] = {0};
@@ -0,0 +1,18 @@
+#include "Core1Log.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+namespace cz
+{
+
+void Core1Log::log(LogVerbosity verbosity, const char* fmt, ...)
+{
+	m_logLine.verbosity = verbosity;
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(m_logLine.msg, sizeof(m_logLine.msg), fmt, args);
+	va_end(args);
+	m_lines.push(std::move(m_logLine));
+}
+
+} // namespace cz
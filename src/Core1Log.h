@@ -0,0 +1,84 @@
+#pragma once
+
+#include "SPSCQueue.h"
+#include "crazygaze/micromuc/Logging.h"
+
+namespace cz
+{
+
+/**
+ * Log lines written from core 1 (see AW_NETWORK_ON_CORE1).
+ *
+ * CZ_LOG isn't safe to use from core 1, since the log outputs and the string formatting buffers are shared with core 0
+ * without any locking. Instead, core 1 formats the line into the queue entry itself, and core 0 logs it with CZ_LOG when
+ * it flushes the queue (see AW_FLUSH_CORE1_LOG).
+ */
+class Core1Log
+{
+  public:
+
+	struct Line
+	{
+		LogVerbosity verbosity;
+		char msg[AW_NETWORK_LOG_LINE_SIZE];
+	};
+
+	/**
+	 * Core 1 side.
+	 * If the queue is full, the line is dropped and counted as a push failure.
+	 */
+	void log(LogVerbosity verbosity, const char* fmt, ...) __attribute__((format(printf, 3, 4)));
+
+	/**
+	 * Core 0 side.
+	 * Calls func(verbosity, msg) for every queued line.
+	 */
+	template<typename Func>
+	void flush(Func&& func)
+	{
+		while (m_lines.pop(m_flushLine))
+		{
+			func(m_flushLine.verbosity, m_flushLine.msg);
+		}
+	}
+
+	const TSPSCQueue<Line, AW_NETWORK_LOG_QUEUE_SIZE>& getQueue() const
+	{
+		return m_lines;
+	}
+
+  private:
+	TSPSCQueue<Line, AW_NETWORK_LOG_QUEUE_SIZE> m_lines;
+	// Only used by core 1
+	Line m_logLine;
+	// Only used by core 0
+	Line m_flushLine;
+};
+
+} // namespace cz
+
+/**
+ * Logs all the lines core 1 queued in the specified Core1Log, to the specified log category. Should only be called from
+ * core 0.
+ * This is a macro because CZ_LOG needs the category and verbosity at compile time.
+ */
+#define AW_FLUSH_CORE1_LOG(core1Log, category)                                \
+	(core1Log).flush([](cz::LogVerbosity verbosity, const char* msg)          \
+	{                                                                          \
+		switch (verbosity)                                                     \
+		{                                                                      \
+			case cz::LogVerbosity::Fatal:                                      \
+			case cz::LogVerbosity::Error:                                      \
+				CZ_LOG(category, Error, "%s", msg);                            \
+				break;                                                         \
+			case cz::LogVerbosity::Warning:                                    \
+				CZ_LOG(category, Warning, "%s", msg);                          \
+				break;                                                         \
+			case cz::LogVerbosity::Log:                                        \
+				CZ_LOG(category, Log, "%s", msg);                              \
+				break;                                                         \
+			default:                                                           \
+				CZ_LOG(category, Verbose, "%s", msg);                          \
+				break;                                                         \
+		}                                                                      \
+	})
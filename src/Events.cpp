@@ -1,8 +1,120 @@
 #include "Events.h"
+#include <new>
+#include <type_traits>
 
 CZ_DEFINE_LOG_CATEGORY(logEvents)
 
 namespace cz
 {
 
+namespace
+{
+	const char* const gEventTypeNames[Event::NumTypes] =
+	{
+		"ConfigReady",
+		"ConfigLoad",
+		"ConfigSave",
+		"SoilMoistureSensorReading",
+		"SoilMoistureSensorCalibration",
+		"SoilMoistureSensorCalibrationReading",
+		"TemperatureSensorReading",
+		"HumiditySensorReading",
+		"BatteryLifeReading",
+		"GroupOnOff",
+		"GroupSelected",
+		"GroupConfigChanged",
+		"Motor",
+		"PumpFault",
+		"SoilMoistureSensorDrift",
+		"WifiConnecting",
+		"WifiStatus",
+		"SetMockSensorValue",
+		"SetMockSensorErrorStatus"
+	};
+}
+
+namespace
+{
+	template<typename T>
+	void copyEvent(const Event& evt, uint8_t* dst)
+	{
+		static_assert(sizeof(T) <= EventRecord::ms_size, "EventRecord too small");
+		// Records are overwritten without calling the destructor
+		static_assert(std::is_trivially_destructible<T>::value, "Events need to be trivially destructible");
+		new (dst) T(static_cast<const T&>(evt));
+	}
+}
+
+void EventRecord::set(const Event& evt)
+{
+	switch (evt.type)
+	{
+		case Event::ConfigReady:
+			copyEvent<ConfigReadyEvent>(evt, data);
+		break;
+		case Event::ConfigLoad:
+			copyEvent<ConfigLoadEvent>(evt, data);
+		break;
+		case Event::ConfigSave:
+			copyEvent<ConfigSaveEvent>(evt, data);
+		break;
+		case Event::SoilMoistureSensorReading:
+			copyEvent<SoilMoistureSensorReadingEvent>(evt, data);
+		break;
+		case Event::SoilMoistureSensorCalibration:
+			copyEvent<SoilMoistureSensorCalibrationEvent>(evt, data);
+		break;
+		case Event::SoilMoistureSensorCalibrationReading:
+			copyEvent<SoilMoistureSensorCalibrationReadingEvent>(evt, data);
+		break;
+		case Event::TemperatureSensorReading:
+			copyEvent<TemperatureSensorReadingEvent>(evt, data);
+		break;
+		case Event::HumiditySensorReading:
+			copyEvent<HumiditySensorReadingEvent>(evt, data);
+		break;
+		case Event::BatteryLifeReading:
+			copyEvent<BatteryLifeReadingEvent>(evt, data);
+		break;
+		case Event::GroupOnOff:
+			copyEvent<GroupOnOffEvent>(evt, data);
+		break;
+		case Event::GroupSelected:
+			copyEvent<GroupSelectedEvent>(evt, data);
+		break;
+		case Event::GroupConfigChanged:
+			copyEvent<GroupConfigChangedEvent>(evt, data);
+		break;
+		case Event::Motor:
+			copyEvent<MotorEvent>(evt, data);
+		break;
+		case Event::PumpFault:
+			copyEvent<PumpFaultEvent>(evt, data);
+		break;
+		case Event::SoilMoistureSensorDrift:
+			copyEvent<SoilMoistureSensorDriftEvent>(evt, data);
+		break;
+		case Event::WifiConnecting:
+			copyEvent<WifiConnectingEvent>(evt, data);
+		break;
+		case Event::WifiStatus:
+			copyEvent<WifiStatusEvent>(evt, data);
+		break;
+		case Event::SetMockSensorValue:
+			copyEvent<SetMockSensorValueEvent>(evt, data);
+		break;
+		case Event::SetMockSensorErrorStatus:
+			copyEvent<SetMockSensorErrorStatusEvent>(evt, data);
+		break;
+		default:
+			CZ_UNEXPECTED();
+	}
+}
+
+const char* Event::getTypeName(Type type)
+{
+	CZ_ASSERT(type < NumTypes);
+	return gEventTypeNames[type];
+}
+
 } // namespace cz
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "crazygaze/micromuc/czmicromuc.h"
 #include "crazygaze/micromuc/Logging.h"
 #include "Context.h"
+#include <algorithm>
+#include <cstddef>
 
 CZ_DECLARE_LOG_CATEGORY(logEvents, Log, Verbose)
 
@@ -24,18 +26,26 @@ struct Event
 		BatteryLifeReading,
 		GroupOnOff,
 		GroupSelected,
+		GroupConfigChanged,
 		Motor,
+		PumpFault,
+		SoilMoistureSensorDrift,
 		WifiConnecting,
 		WifiStatus,
 
 		// Only used for mocking components
 		SetMockSensorValue,
-		SetMockSensorErrorStatus
+		SetMockSensorErrorStatus,
+
+		// Number of event types. Must be the last one
+		NumTypes
 	};
 
 	Event(Type type) : type(type) {}
 	virtual void log() const = 0;
 
+	static const char* getTypeName(Type type);
+
 	Type type;
 };
 
@@ -236,6 +246,24 @@ struct GroupSelectedEvent : public Event
 	int8_t previousIndex;
 };
 
+//
+// Raised when a group's settings that affect the sensor sampling change outside of a config load (e.g: sampling interval
+// changed from the MQTT UI, or the group entering/leaving the config menu)
+struct GroupConfigChangedEvent : public Event
+{
+	GroupConfigChangedEvent(uint8_t index)
+		: Event(Event::GroupConfigChanged)
+		, index(index)
+	{}
+
+	virtual void log() const override
+	{
+		CZ_LOG(logEvents, Log, F("GroupConfigChangedEvent(%d)"), (int)index);
+	}
+
+	uint8_t index;
+};
+
 struct MotorEvent : public Event
 {
 	MotorEvent(uint8_t index, bool started)
@@ -254,6 +282,47 @@ struct MotorEvent : public Event
 	bool started;
 };
 
+//
+// Raised when a pump is turned off because of a fault detected from its current (see PumpCurrentDetector)
+struct PumpFaultEvent : public Event
+{
+	PumpFaultEvent(uint8_t index, uint8_t fault)
+		: Event(Event::PumpFault)
+		, index(index)
+		, fault(fault)
+	{
+	}
+
+	virtual void log() const override
+	{
+		CZ_LOG(logEvents, Log, F("PumpFaultEvent(%d, %d)"), (int)index, (int)fault);
+	}
+
+	uint8_t index;
+	// A PumpCurrentDetector::Fault
+	uint8_t fault;
+};
+
+//
+// Raised when the sensor drift flags of a group change (see SensorDriftEstimator)
+struct SoilMoistureSensorDriftEvent : public Event
+{
+	SoilMoistureSensorDriftEvent(uint8_t index, uint8_t flags)
+		: Event(Event::SoilMoistureSensorDrift)
+		, index(index)
+		, flags(flags)
+	{
+	}
+
+	virtual void log() const override
+	{
+		CZ_LOG(logEvents, Log, F("SoilMoistureSensorDriftEvent(%d, 0x%x)"), (int)index, (unsigned int)flags);
+	}
+
+	uint8_t index;
+	uint8_t flags;
+};
+
 struct WifiConnectingEvent: public Event
 {
 	explicit WifiConnectingEvent()
@@ -319,5 +388,44 @@ struct SetMockSensorErrorStatusEvent : public Event
 	SensorReading::Status status;
 };
 
+//
+// Fixed size storage that can hold a copy of any event.
+// This is what the event queue uses when deferred dispatch is enabled (see AW_EVENT_DEFERRED_DISPATCH)
+//
+struct EventRecord
+{
+	// Copies the event into the record
+	void set(const Event& evt);
+
+	const Event& get() const
+	{
+		return *reinterpret_cast<const Event*>(data);
+	}
+
+	static constexpr size_t ms_size = std::max({
+		sizeof(ConfigReadyEvent),
+		sizeof(ConfigLoadEvent),
+		sizeof(ConfigSaveEvent),
+		sizeof(SoilMoistureSensorReadingEvent),
+		sizeof(SoilMoistureSensorCalibrationEvent),
+		sizeof(SoilMoistureSensorCalibrationReadingEvent),
+		sizeof(TemperatureSensorReadingEvent),
+		sizeof(HumiditySensorReadingEvent),
+		sizeof(BatteryLifeReadingEvent),
+		sizeof(GroupOnOffEvent),
+		sizeof(GroupSelectedEvent),
+		sizeof(GroupConfigChangedEvent),
+		sizeof(MotorEvent),
+		sizeof(PumpFaultEvent),
+		sizeof(SoilMoistureSensorDriftEvent),
+		sizeof(WifiConnectingEvent),
+		sizeof(WifiStatusEvent),
+		sizeof(SetMockSensorValueEvent),
+		sizeof(SetMockSensorErrorStatusEvent)
+	});
+
+	alignas(alignof(std::max_align_t)) uint8_t data[ms_size];
+};
+
 } // namespace cz
 
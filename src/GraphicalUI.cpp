@@ -6,6 +6,7 @@
 #include "Icons.h"
 #include "DisplayCommon.h"
 #include "Timer.h"
+#include "LowPowerIdle.h"
 #include "gfx/TouchKeyboard.h"
 
 #define YP A3  // must be an analog pin, use "An" notation!
@@ -650,6 +651,8 @@ void GraphicalUI::OverviewState::draw()
 GraphicalUI::GraphicalUI()
 	: m_states(*this)
 {
+	// All events are forwarded to the current state and menus
+	subscribeAll();
 }
 
 bool GraphicalUI::initImpl()
@@ -659,9 +662,17 @@ bool GraphicalUI::initImpl()
 	m_states.bootMenu.init();
 	m_states.overview.init();
 	changeToState(m_states.initialize);
+#if AW_LOWPOWER_IDLE_ENABLED
+	gLowPowerIdle.addWakeSource(*this);
+#endif
 	return true;
 }
 
+bool GraphicalUI::hasPendingInput()
+{
+	return gTs.irqCounter() != m_touch.lastIrqCounter;
+}
+
 float GraphicalUI::tick(float deltaSeconds)
 {
 	PROFILE_SCOPE(F("GraphicalUI::tick"));
@@ -678,6 +689,7 @@ float GraphicalUI::tick(float deltaSeconds)
 
 void GraphicalUI::updateTouch(float deltaSeconds)
 {
+	m_touch.lastIrqCounter = gTs.irqCounter();
 	gTs.updateState();
 
 	TouchState touchState = gTs.getState();
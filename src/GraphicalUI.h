@@ -35,6 +35,7 @@ class GraphicalUI : public Component
 	virtual float tick(float deltaSeconds) override;
 	virtual void onEvent(const Event& evt) override;
 	virtual bool processCommand(const Command& cmd) override;
+	virtual bool hasPendingInput() override;
 
 	//
 	// DisplayState
@@ -218,6 +219,9 @@ class GraphicalUI : public Component
 		// used to slowly dim the brightness to 0 when putting to sleep.
 		// This is better than simply turning off the backlight, so the user knows it's a fault. 
 		float currentBrightness = 0;
+
+		// Touch controller IRQ counter as of the last updateTouch, so we can tell if there was a touch since
+		unsigned lastIrqCounter = 0;
 	} m_touch;
 
 	void updateTouch(float deltaSeconds);
@@ -5,6 +5,12 @@
 namespace cz
 {
 
+LEDStatus::LEDStatus()
+{
+	subscribe(Event::WifiConnecting);
+	subscribe(Event::WifiStatus);
+}
+
 bool LEDStatus::initImpl()
 {
 	setDefaultPattern();
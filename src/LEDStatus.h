@@ -8,7 +8,7 @@ namespace cz
 class LEDStatus : public Component
 {
   public:
-	LEDStatus() = default;
+	LEDStatus();
 	virtual ~LEDStatus() = default; 
 
 	enum class PatternMode : uint8_t
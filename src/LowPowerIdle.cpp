@@ -0,0 +1,160 @@
+#include "LowPowerIdle.h"
+#include "crazygaze/micromuc/Logging.h"
+#include "crazygaze/micromuc/StringUtils.h"
+#include <algorithm>
+#include <iterator>
+#if AW_LOWPOWER_IDLE_ENABLED && !AW_NATIVE
+	#include <pico/time.h>
+#endif
+
+namespace cz
+{
+
+LowPowerIdle::LowPowerIdle(Clock& clock)
+	: m_clock(clock)
+{
+}
+
+void LowPowerIdle::addWakeSource(Component& component)
+{
+	CZ_ASSERT(m_numWakeSources < AW_LOWPOWER_IDLE_MAX_WAKESOURCES);
+	m_wakeSources[m_numWakeSources++] = &component;
+}
+
+Component* LowPowerIdle::findPendingWakeSource()
+{
+	for (int i = 0; i < m_numWakeSources; i++)
+	{
+		if (m_wakeSources[i]->hasPendingInput())
+		{
+			return m_wakeSources[i];
+		}
+	}
+
+	return nullptr;
+}
+
+bool LowPowerIdle::idle(float seconds)
+{
+	uint64_t startMicros = m_clock.getMicros();
+	uint64_t deadlineMicros = startMicros + (seconds > 0 ? static_cast<uint64_t>(seconds * 1000000.0f) : 0);
+	bool wokenUpEarly = false;
+	m_stats.sleeps++;
+
+	while (true)
+	{
+		// Checking before sleeping, so we don't miss input that arrived before we got here.
+		// Any input arriving after this check raises an event, and the wait returns right away.
+		if (Component* source = findPendingWakeSource())
+		{
+			source->wakeUp();
+			wokenUpEarly = true;
+			m_stats.earlyWakeups++;
+			break;
+		}
+
+		if (m_clock.getMicros() >= deadlineMicros)
+		{
+			break;
+		}
+
+		m_clock.waitForEvent(deadlineMicros);
+		m_stats.waits++;
+	}
+
+	m_stats.idleMicros += m_clock.getMicros() - startMicros;
+	return wokenUpEarly;
+}
+
+void LowPowerIdle::logStats() const
+{
+	uint64_t totalMicros = m_clock.getMicros() - m_stats.startMicros;
+	float idlePercentage = totalMicros ? (m_stats.idleMicros * 100.0f) / totalMicros : 0.0f;
+	CZ_LOG(logDefault, Log, "Idle: sleeps=%u, earlyWakeups=%u, waits=%u, idle=%s%%", m_stats.sleeps, m_stats.earlyWakeups,
+		m_stats.waits, *FloatToString(idlePercentage));
+}
+
+void LowPowerIdle::resetStats()
+{
+	m_stats = {};
+	m_stats.startMicros = m_clock.getMicros();
+}
+
+void LowPowerIdle::SimulatedClock::waitForEvent(uint64_t untilMicros)
+{
+	int earliest = -1;
+	for (int i = 0; i < m_numEvents; i++)
+	{
+		if (earliest == -1 || m_events[i].atMicros < m_events[earliest].atMicros)
+		{
+			earliest = i;
+		}
+	}
+
+	if (earliest == -1 || m_events[earliest].atMicros > untilMicros)
+	{
+		m_nowMicros = std::max(m_nowMicros, untilMicros);
+		return;
+	}
+
+	Event event = m_events[earliest];
+	m_events[earliest] = m_events[--m_numEvents];
+	m_nowMicros = std::max(m_nowMicros, event.atMicros);
+	if (event.callback)
+	{
+		event.callback(event.userData);
+	}
+}
+
+void LowPowerIdle::SimulatedClock::scheduleEvent(uint64_t atMicros, EventCallback callback, void* userData)
+{
+	CZ_ASSERT(m_numEvents < static_cast<int>(std::size(m_events)));
+	m_events[m_numEvents++] = {atMicros, callback, userData};
+}
+
+#if AW_LOWPOWER_IDLE_ENABLED
+
+namespace
+{
+#if AW_NATIVE
+	// The native build has no events to wait for, so it just moves the (virtual) Arduino time to the deadline
+	class NativeClock : public LowPowerIdle::Clock
+	{
+	  public:
+		virtual uint64_t getMicros() override
+		{
+			return arduino_native::getMicros();
+		}
+
+		virtual void waitForEvent(uint64_t untilMicros) override
+		{
+			if (untilMicros > arduino_native::getMicros())
+			{
+				arduino_native::setMicros(untilMicros);
+			}
+		}
+	};
+	NativeClock gPlatformClock;
+#else
+	class RP2040Clock : public LowPowerIdle::Clock
+	{
+	  public:
+		virtual uint64_t getMicros() override
+		{
+			return time_us_64();
+		}
+
+		virtual void waitForEvent(uint64_t untilMicros) override
+		{
+			best_effort_wfe_or_timeout(from_us_since_boot(untilMicros));
+		}
+	};
+	RP2040Clock gPlatformClock;
+#endif
+}
+
+LowPowerIdle gLowPowerIdle(gPlatformClock);
+
+#endif
+
+} // namespace cz
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Component.h"
+
+namespace cz
+{
+
+/*
+ * Low power idle for the main loop.
+ * Instead of a plain delay() until the next component deadline, the core sleeps waiting for an event (WFE), which any
+ * interrupt wakes it up from (touch IRQ, UART RX, WiFi, timer alarm). Once woken up, it checks the registered wake sources
+ * and if any of them has pending input, it wakes up that component and returns early, so the input is handled right away.
+ *
+ * All the time keeping and sleeping goes through a Clock, so the sleep/wake decisions can be driven by a simulated clock.
+ */
+class LowPowerIdle
+{
+  public:
+
+	class Clock
+	{
+	  public:
+		virtual ~Clock() {}
+		virtual uint64_t getMicros() = 0;
+		// Sleeps until an event happens or untilMicros is reached, whatever happens first
+		virtual void waitForEvent(uint64_t untilMicros) = 0;
+	};
+
+	/*
+	 * Clock for testing the sleep/wake decisions off-target.
+	 * Time only moves forward when waiting, and events (e.g: an interrupt) are scheduled beforehand with scheduleEvent.
+	 */
+	class SimulatedClock : public Clock
+	{
+	  public:
+		using EventCallback = void (*)(void* userData);
+
+		virtual uint64_t getMicros() override
+		{
+			return m_nowMicros;
+		}
+
+		// Jumps to the earliest scheduled event or to untilMicros, whatever comes first, and runs that event's callback.
+		// An event scheduled in the past makes it return right away, same as a pending event on the RP2040.
+		virtual void waitForEvent(uint64_t untilMicros) override;
+
+		/*
+		 * Schedules an event to happen at the specified time.
+		 * \param callback
+		 *	Called when a wait reaches the event, so it can set whatever input a wake source checks. Can be nullptr, for
+		 *	events that shouldn't wake up anything.
+		 */
+		void scheduleEvent(uint64_t atMicros, EventCallback callback = nullptr, void* userData = nullptr);
+
+	  private:
+		struct Event
+		{
+			uint64_t atMicros;
+			EventCallback callback;
+			void* userData;
+		};
+
+		uint64_t m_nowMicros = 0;
+		Event m_events[8];
+		int m_numEvents = 0;
+	};
+
+	explicit LowPowerIdle(Clock& clock);
+
+	// Disable copying
+	LowPowerIdle(const LowPowerIdle&) = delete;
+	LowPowerIdle& operator=(const LowPowerIdle&) = delete;
+
+	/*
+	 * Registers a component that should interrupt the idle when its hasPendingInput returns true.
+	 * This should be called from the component's initImpl, since it's not safe to do it during static initialization.
+	 */
+	void addWakeSource(Component& component);
+
+	/*
+	 * Sleeps for the specified time, or until a wake source has pending input.
+	 * \return true if it returned early because of a wake source
+	 */
+	bool idle(float seconds);
+
+	void logStats() const;
+	void resetStats();
+
+  private:
+
+	Component* findPendingWakeSource();
+
+	Clock& m_clock;
+	Component* m_wakeSources[AW_LOWPOWER_IDLE_MAX_WAKESOURCES] = {};
+	int m_numWakeSources = 0;
+
+	struct
+	{
+		uint64_t startMicros = 0;
+		uint64_t idleMicros = 0;
+		uint32_t sleeps = 0;
+		// How many times we returned before the deadline because of a wake source
+		uint32_t earlyWakeups = 0;
+		// How many times we woke up from WFE. If this is a lot higher than sleeps, then something is generating events
+		uint32_t waits = 0;
+	} m_stats;
+};
+
+#if AW_LOWPOWER_IDLE_ENABLED
+	extern LowPowerIdle gLowPowerIdle;
+#endif
+
+} // namespace cz
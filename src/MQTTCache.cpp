@@ -9,6 +9,13 @@
 #include "Component.h"
 #include "WifiManager.h"
 #include "Timer.h"
+#include "LowPowerIdle.h"
+
+#if AW_NETWORK_ON_CORE1
+	#include <hardware/sync.h>
+	#include <pico/time.h>
+	#include "Core1Log.h"
+#endif
 
 CZ_DEFINE_LOG_CATEGORY(logMQTTCache);
 
@@ -17,6 +24,17 @@ namespace cz
 
 extern Timer gTimer;
 
+// For code that runs on core 1 when AW_NETWORK_ON_CORE1 is set, since CZ_LOG can't be used there (see Core1Log.h)
+#if AW_NETWORK_ON_CORE1
+	namespace
+	{
+		Core1Log gCore1Log;
+	}
+	#define MQTT_LOG(verbosity, fmt, ...) gCore1Log.log(LogVerbosity::verbosity, fmt, ##__VA_ARGS__)
+#else
+	#define MQTT_LOG(verbosity, fmt, ...) CZ_LOG(logMQTTCache, verbosity, fmt, ##__VA_ARGS__)
+#endif
+
 #if AW_MQTTUI_ENABLED
 	MQTTCache gMQTTCache;
 #endif
@@ -37,7 +55,7 @@ namespace
 
 		virtual void println(const char* msg) override
 		{
-			CZ_LOG(logMQTTCache, Verbose, "MQTTCLIENT: %s", msg);
+			MQTT_LOG(Verbose, "MQTTCLIENT: %s", msg);
 		}
 	};
 
@@ -74,13 +92,18 @@ namespace
 				this->handlers_size = handlers_size;
 				handlers = new MqttClient::MessageHandler[handlers_size];
 				CZ_ASSERT(handlers);
+				topics = new char[handlers_size * AW_MQTT_MAX_TOPIC_SIZE];
+				CZ_ASSERT(topics);
 				
 				for (int i = 0; i < size(); ++i) {
 						handlers[i] = MqttClient::MessageHandler();
 				}
 			}
 
-			virtual ~MyMessageHandlers() {}
+			virtual ~MyMessageHandlers() {
+				delete[] handlers;
+				delete[] topics;
+			}
 
 			int size() const {return handlers_size;}
 
@@ -153,8 +176,14 @@ namespace
 
 		protected:
 			virtual const char* onAllocateTopic(const char *topic, int storageIdx) {
-				// Keep provided pointer
-				return topic;
+				// Keep a copy, since the caller's string doesn't necessarily live as long as the subscription (e.g: a
+				// request from core 0)
+				if (strlen(topic) >= AW_MQTT_MAX_TOPIC_SIZE) {
+					return nullptr;
+				}
+				char* t = topics + storageIdx * AW_MQTT_MAX_TOPIC_SIZE;
+				strcpy(t, topic);
+				return t;
 			}
 
 			virtual void onDeAllocateTopic(const char *topic, int storageIdx) {
@@ -164,6 +193,7 @@ namespace
 		private:
 			int handlers_size;
 			MqttClient::MessageHandler *handlers;
+			char* topics;
 	};
 }
 
@@ -173,6 +203,8 @@ MQTTCache::MQTTCache()
 {
 	CZ_ASSERT(ms_instance == nullptr);
 	ms_instance = this;
+	// MQTTCache::subscribe(const char*) hides the Component one
+	Component::subscribe(Event::WifiStatus);
 }
 
 MQTTCache::~MQTTCache()
@@ -206,7 +238,18 @@ void MQTTCache::setOptions(const MQTTCache::Options& options)
 	// with using just half the memory for the json pool. This seems to be enough.
 	m_jsondoc = std::make_unique<DynamicJsonDocument>(options.recvBufferSize / 2);
 
+#if AW_NETWORK_ON_CORE1
+	m_core1PublishValueSize = options.sendBufferSize;
+	m_core1PublishValue = std::make_unique<char[]>(m_core1PublishValueSize);
+	m_core1MessageSize = options.recvBufferSize;
+	for (int i = 0; i < AW_NETWORK_MESSAGE_SLOTS; i++)
+	{
+		m_core1Messages[i].payload = std::make_unique<char[]>(m_core1MessageSize);
+		m_core1FreeMessages.push(static_cast<uint8_t>(i));
+	}
+#else
 	m_payloadBuffer = std::make_unique<char[]>(options.recvBufferSize);
+#endif
 
 	// Allow up to X subscriptions simultaneously
 	m_mqtt.messageHandlers = std::make_unique<MyMessageHandlers>(options.maxNumSubscriptions);
@@ -326,7 +369,7 @@ void MQTTCache::subscribe(const char* topic)
 		m_subscriptions.push_back({topic, Subscription::State::NeedsSubscribe});
 		m_hasSubscriptionsChanges = true;
 	}
-	else if (it->state != Subscription::State::Subscribed)
+	else if (it->state != Subscription::State::Subscribed && it->state != Subscription::State::Subscribing)
 	{
 		it->state = Subscription::State::NeedsSubscribe;
 		m_hasSubscriptionsChanges = true;
@@ -341,7 +384,7 @@ void MQTTCache::unsubscribe(const char* topic)
 	{
 		if (it->state != Subscription::State::Unsubscribed)
 		{
-			it->state == Subscription::State::NeedsUnsubscribe;
+			it->state = Subscription::State::NeedsUnsubscribe;
 			m_hasSubscriptionsChanges = true;
 		}
 	}
@@ -392,6 +435,36 @@ void MQTTCache::doRemove(int index)
 void MQTTCache::onMqttMessage(MqttClient::MessageData& md)
 {
 	const MqttClient::Message &msg = md.message;
+
+#if AW_NETWORK_ON_CORE1
+	// We are on core 1, and the cache belongs to core 0, so copy the message into a free slot and hand it over.
+	// If core 0 still has all the slots, wait a bit for it to process one.
+	uint8_t slot;
+	absolute_time_t timeout = make_timeout_time_ms(2000);
+	while (!m_core1FreeMessages.pop(slot))
+	{
+		if (time_reached(timeout))
+		{
+			MQTT_LOG(Error, "onMqttMessage: No free message slots. Dropping message.");
+			return;
+		}
+		// Core 0 __sev()s when it gives back a slot
+		best_effort_wfe_or_timeout(make_timeout_time_ms(10));
+	}
+
+	Core1Message& dst = m_core1Messages[slot];
+	int topicLen = std::min(md.topicName.lenstring.len, AW_MQTT_MAX_TOPIC_SIZE - 1);
+	memcpy(dst.topic, md.topicName.lenstring.data, topicLen);
+	dst.topic[topicLen] = 0;
+	int payloadLen = std::min(static_cast<int>(msg.payloadLen), m_core1MessageSize - 1);
+	memcpy(dst.payload.get(), msg.payload, payloadLen);
+	dst.payload[payloadLen] = 0;
+
+	MQTT_LOG(Log, "onMqttMessage: Received: qos %d, retained %d, dup %d, packetid %d, topic:[%s], payload size:[%d]",
+		msg.qos, msg.retained, msg.dup, msg.id, dst.topic, static_cast<int>(msg.payloadLen));
+
+	postToCore0({Core1Notification::Type::Message, 0, slot});
+#else
 	char topic[md.topicName.lenstring.len + 1];
 
 	// copy payload
@@ -407,6 +480,12 @@ void MQTTCache::onMqttMessage(MqttClient::MessageData& md)
 		   "onMqttMessage: Received: qos %d, retained %d, dup %d, packetid %d, topic:[%s], payload size:[%d], payload:[%s]",
 		   msg.qos, msg.retained, msg.dup, msg.id, topic, msg.payloadLen, payload);
 
+	processMessage(topic, payload);
+#endif
+}
+
+void MQTTCache::processMessage(const char* topic, char* payload)
+{
 
 	auto processSingle = [this](const char* topic, const char* value)
 	{
@@ -551,14 +630,49 @@ bool MQTTCache::initImpl()
 		setOptions(options);
 	}
 
+#if AW_NETWORK_ON_CORE1
+	// Core 1 doesn't start until all components are initialized, so this is guaranteed to be there when it starts
+	Core1Config cfg = {};
+	strncpy(cfg.host, m_cfg.host.c_str(), sizeof(cfg.host) - 1);
+	cfg.port = m_cfg.port;
+	strncpy(cfg.clientId, m_cfg.clientId.c_str(), sizeof(cfg.clientId) - 1);
+	strncpy(cfg.username, m_cfg.username.c_str(), sizeof(cfg.username) - 1);
+	strncpy(cfg.password, m_cfg.password.c_str(), sizeof(cfg.password) - 1);
+	m_core1ConfigQueue.push(std::move(cfg));
+#endif
+
+#if AW_LOWPOWER_IDLE_ENABLED
+	gLowPowerIdle.addWakeSource(*this);
+#endif
+
 	return true;
 }
 
+bool MQTTCache::hasPendingInput()
+{
+#if AW_NETWORK_ON_CORE1
+	// Results or messages handed over by core 1
+	return !m_core1Notifications.isEmpty();
+#else
+	// Incoming data from the broker
+	return isConnected() && m_wifiClient.available() > 0;
+#endif
+}
+
 float MQTTCache::tick(float deltaSeconds)
 {
 	PROFILE_SCOPE(F("MQTTCache"));
 
 	constexpr float tickInterval = 0.25f;
+
+#if AW_NETWORK_ON_CORE1
+	AW_FLUSH_CORE1_LOG(gCore1Log, logMQTTCache);
+	processCore1Notifications();
+	if (!isConnected())
+	{
+		return tickInterval;
+	}
+#else
 	if (!isConnected())
 	{
 		if (!connectToMqttBroker(deltaSeconds))
@@ -566,34 +680,13 @@ float MQTTCache::tick(float deltaSeconds)
 			return tickInterval;
 		}
 	}
+#endif
 
-	if (m_hasSubscriptionsChanges)
-	{
-		for(auto&& subscription : m_subscriptions)
-		{
-			switch (subscription.state)
-			{
-				case Subscription::State::Unsubscribed:
-					// Nothing to do
-				break;
-				case Subscription::State::NeedsSubscribe:
-					doSubscribe(subscription.topic.c_str());
-					subscription.state = Subscription::State::Subscribed;
-				break;
-				case Subscription::State::Subscribed:
-					// Nothing to do
-				break;
-				case Subscription::State::NeedsUnsubscribe:
-					doUnsubscribe(subscription.topic.c_str());
-					subscription.state = Subscription::State::Unsubscribed;
-				break;
-			}
-		}
-
-		m_hasSubscriptionsChanges = false;
-	}
+	processSubscriptionChanges();
 
+#if !AW_NETWORK_ON_CORE1
 	m_mqtt.client->yield(1);
+#endif
 
 	m_publishCountdown -= deltaSeconds;
 	if (m_publishCountdown > 0 || m_sendQueue.size() == 0)
@@ -601,50 +694,332 @@ float MQTTCache::tick(float deltaSeconds)
 		return tickInterval;
 	}
 
+#if AW_NETWORK_ON_CORE1
+	// Only one publish at a time, the same as with the blocking publish
+	if (m_core1PublishId != 0)
+	{
+		return tickInterval;
+	}
+#endif
+
+	publishNext();
+
+	m_publishCountdown = m_cfg.publishInterval;
+	return tickInterval;
+}
+
+void MQTTCache::processSubscriptionChanges()
+{
+	if (!m_hasSubscriptionsChanges)
+	{
+		return;
+	}
+
+	for(auto&& subscription : m_subscriptions)
+	{
+		switch (subscription.state)
+		{
+			case Subscription::State::Unsubscribed:
+				// Nothing to do
+			break;
+			case Subscription::State::NeedsSubscribe:
+			#if AW_NETWORK_ON_CORE1
+			{
+				// It's only marked as Subscribed once core 1 tells us it succeeded (see onSubscriptionResult)
+				Core1Request request{Core1Request::Type::Subscribe, 0, static_cast<uint16_t>(&subscription - &m_subscriptions[0])};
+				strncpy(request.topic, subscription.topic.c_str(), sizeof(request.topic) - 1);
+				request.topic[sizeof(request.topic) - 1] = 0;
+				if (!postToCore1(std::move(request)))
+				{
+					// Try again next tick
+					return;
+				}
+				subscription.state = Subscription::State::Subscribing;
+			}
+			#else
+				doSubscribe(subscription.topic.c_str());
+				subscription.state = Subscription::State::Subscribed;
+			#endif
+			break;
+			case Subscription::State::Subscribing:
+			case Subscription::State::Subscribed:
+			case Subscription::State::Unsubscribing:
+				// Nothing to do
+			break;
+			case Subscription::State::NeedsUnsubscribe:
+			#if AW_NETWORK_ON_CORE1
+			{
+				Core1Request request{Core1Request::Type::Unsubscribe, 0, static_cast<uint16_t>(&subscription - &m_subscriptions[0])};
+				strncpy(request.topic, subscription.topic.c_str(), sizeof(request.topic) - 1);
+				request.topic[sizeof(request.topic) - 1] = 0;
+				if (!postToCore1(std::move(request)))
+				{
+					// Try again next tick
+					return;
+				}
+				subscription.state = Subscription::State::Unsubscribing;
+			}
+			#else
+				doUnsubscribe(subscription.topic.c_str());
+				subscription.state = Subscription::State::Unsubscribed;
+			#endif
+			break;
+		}
+	}
+
+	m_hasSubscriptionsChanges = false;
+}
+
+void MQTTCache::publishNext()
+{
 	auto entry = m_sendQueue.front();
 	m_sendQueue.pop();
 
 	CZ_ASSERT(entry->state == MQTTCache::State::QueuedForSend);
 	CZ_LOG(logMQTTCache, Log, "Publishing to '%s', value '%s'", entry->topic.c_str(), entry->value.c_str());
 
+#if AW_NETWORK_ON_CORE1
+	// The packet id is only used to match the result from core 1 with the entry, and 0 means "no publish in progress"
+	m_core1LastPublishId++;
+	if (m_core1LastPublishId == 0)
+	{
+		m_core1LastPublishId = 1;
+	}
+
+	// No publish is in progress, so core 1 is not using the publish buffers
+	if (entry->topic.length() >= sizeof(m_core1PublishTopic) ||
+		static_cast<int>(entry->value.length()) >= m_core1PublishValueSize)
+	{
+		CZ_LOG(logMQTTCache, Error, "Topic or value too big to publish (%u and %u bytes). Dropping it.",
+			entry->topic.length(), entry->value.length());
+		entry->state = MQTTCache::State::Synced;
+		return;
+	}
+	strcpy(m_core1PublishTopic, entry->topic.c_str());
+	strcpy(m_core1PublishValue.get(), entry->value.c_str());
+
+	entry->state = MQTTCache::State::SentAndWaitingForAck;
+	entry->packetId = m_core1LastPublishId;
+	if (postToCore1({Core1Request::Type::Publish, entry->qos, entry->packetId}))
+	{
+		m_core1PublishId = entry->packetId;
+	}
+	else
+	{
+		entry->state = MQTTCache::State::QueuedForSend;
+		entry->packetId = 0;
+		m_sendQueue.push(entry);
+	}
+#else
+	auto startPublish = millis();
+	MqttClient::Error::type rc = doPublish(entry->topic.c_str(), entry->value.c_str(), entry->qos);
+	auto endPublish = millis();
+	if (rc == MqttClient::Error::SUCCESS)
 	{
-		MqttClient::Message msg;
-		msg.qos = static_cast<MqttClient::QoS>(entry->qos);
-		msg.retained = true;
-		msg.dup = false;
-		msg.payload = (void*) entry->value.c_str();
-		msg.payloadLen = entry->value.length();
-		auto startPublish = millis();
-		MqttClient::Error::type rc = m_mqtt.client->publish(entry->topic.c_str(), msg);
-		auto endPublish = millis();
-		if (rc != MqttClient::Error::SUCCESS)
+		CZ_LOG(logMQTTCache, Verbose, "Publish time: %u ms", endPublish - startPublish);
+	}
+	onPublishResult(entry, rc);
+#endif
+}
+
+MqttClient::Error::type MQTTCache::doPublish(const char* topic, const char* value, uint8_t qos)
+{
+	MqttClient::Message msg;
+	msg.qos = static_cast<MqttClient::QoS>(qos);
+	msg.retained = true;
+	msg.dup = false;
+	msg.payload = (void*) value;
+	msg.payloadLen = strlen(value);
+	return m_mqtt.client->publish(topic, msg);
+}
+
+void MQTTCache::onPublishResult(Entry* entry, MqttClient::Error::type rc)
+{
+	if (rc != MqttClient::Error::SUCCESS)
+	{
+		CZ_LOG(logMQTTCache, Error, "Failed to publish: %i. Will retry.", rc);
+		// put back in the queue to try and publish again
+		entry->state = MQTTCache::State::QueuedForSend;
+		entry->packetId = 0;
+		m_sendQueue.push(entry);
+	}
+	else
+	{
+		// If sending with qos 0, we are not receiving any confirmation, so we set the state to Synced
+		if (entry->qos == 0)
 		{
-			CZ_LOG(logMQTTCache, Error, "Failed to publish: %i. Will retry.", rc);
-			// put back in the queue to try and publish again
-			m_sendQueue.push(entry);
+			entry->state = MQTTCache::State::Synced;
+			entry->packetId = 0;
 		}
 		else
 		{
-			CZ_LOG(logMQTTCache, Verbose, "Publish time: %u ms", endPublish - startPublish);
-			// If sending with qos 0, we are not receiving any confirmation, so we set the state to Synced
-			if (entry->qos == 0)
+			entry->state = MQTTCache::State::SentAndWaitingForAck;
+			#if HAS_BLOCKING_PUBLISH
+			onMqttPublish(entry);
+			#endif
+		}
+	}
+}
+
+#if AW_NETWORK_ON_CORE1
+
+bool MQTTCache::postToCore1(Core1Request&& request)
+{
+	if (!m_core1Requests.push(std::move(request)))
+	{
+		CZ_LOG(logMQTTCache, Error, "Core 1 request queue full.");
+		return false;
+	}
+
+	// Wake up core 1 in case it's waiting for work
+	__sev();
+	return true;
+}
+
+void MQTTCache::postToCore0(Core1Notification&& notification)
+{
+	if (!m_core1Notifications.push(std::move(notification)))
+	{
+		MQTT_LOG(Error, "Core 0 notification queue full. Dropping notification.");
+		return;
+	}
+
+	// Wake up core 0 in case it's idling
+	__sev();
+}
+
+void MQTTCache::processCore1Notifications()
+{
+	Core1Notification notification;
+	while (m_core1Notifications.pop(notification))
+	{
+		switch (notification.type)
+		{
+			case Core1Notification::Type::PublishResult:
 			{
-				entry->state = MQTTCache::State::Synced;
+				if (notification.id == m_core1PublishId)
+				{
+					m_core1PublishId = 0;
+				}
+
+				// If the entry was set again while the publish was in progress, its packetId was reset and it's already
+				// queued for another publish, so it won't be found
+				if (Entry* entry = findByPacketId(notification.id))
+				{
+					onPublishResult(entry, static_cast<MqttClient::Error::type>(notification.rc));
+				}
 			}
-			else
+			break;
+
+			case Core1Notification::Type::SubscribeResult:
+			case Core1Notification::Type::UnsubscribeResult:
+				onSubscriptionResult(notification.id, notification.type == Core1Notification::Type::SubscribeResult,
+					static_cast<MqttClient::Error::type>(notification.rc));
+			break;
+
+			case Core1Notification::Type::Message:
 			{
-				entry->state = MQTTCache::State::SentAndWaitingForAck;
-				#if HAS_BLOCKING_PUBLISH
-				onMqttPublish(entry);
-				#endif
+				Core1Message& msg = m_core1Messages[notification.id];
+				processMessage(msg.topic, msg.payload.get());
+				// Give the slot back to core 1, and wake it up in case it's waiting for one
+				m_core1FreeMessages.push(static_cast<uint8_t>(notification.id));
+				__sev();
 			}
+			break;
 		}
 	}
+}
 
-	m_publishCountdown = m_cfg.publishInterval;
+void MQTTCache::onSubscriptionResult(uint16_t index, bool subscribe, MqttClient::Error::type rc)
+{
+	CZ_ASSERT(index < m_subscriptions.size());
+	Subscription& subscription = m_subscriptions[index];
+	Subscription::State pendingState = subscribe ? Subscription::State::Subscribing : Subscription::State::Unsubscribing;
+
+	// If it changed in the meantime (e.g: unsubscribe while subscribing), it's already queued up for the new state
+	if (subscription.state != pendingState)
+	{
+		return;
+	}
+
+	if (rc == MqttClient::Error::SUCCESS)
+	{
+		subscription.state = subscribe ? Subscription::State::Subscribed : Subscription::State::Unsubscribed;
+	}
+	else
+	{
+		// Retry
+		subscription.state = subscribe ? Subscription::State::NeedsSubscribe : Subscription::State::NeedsUnsubscribe;
+		m_hasSubscriptionsChanges = true;
+	}
+}
+
+float MQTTCache::core1Tick(float deltaSeconds)
+{
+	constexpr float tickInterval = 0.25f;
+
+	if (!m_core1HasCfg)
+	{
+		m_core1HasCfg = m_core1ConfigQueue.pop(m_core1Cfg);
+		if (!m_core1HasCfg)
+		{
+			return tickInterval;
+		}
+	}
+
+	bool connected = isClientConnected() || connectToMqttBroker(deltaSeconds);
+	m_core1Connected.store(connected, std::memory_order_release);
+	if (!connected)
+	{
+		// Any requests stay queued until we connect
+		return tickInterval;
+	}
+
+	Core1Request request;
+	while (m_core1Requests.pop(request))
+	{
+		switch (request.type)
+		{
+			case Core1Request::Type::Publish:
+			{
+				auto startPublish = millis();
+				MqttClient::Error::type rc = doPublish(m_core1PublishTopic, m_core1PublishValue.get(), request.qos);
+				auto endPublish = millis();
+				MQTT_LOG(Verbose, "Publish time: %u ms", static_cast<unsigned int>(endPublish - startPublish));
+				postToCore0({Core1Notification::Type::PublishResult, static_cast<int8_t>(rc), request.id});
+			}
+			break;
+
+			case Core1Request::Type::Subscribe:
+			{
+				MqttClient::Error::type rc = doSubscribe(request.topic);
+				postToCore0({Core1Notification::Type::SubscribeResult, static_cast<int8_t>(rc), request.id});
+			}
+			break;
+
+			case Core1Request::Type::Unsubscribe:
+			{
+				MqttClient::Error::type rc = doUnsubscribe(request.topic);
+				postToCore0({Core1Notification::Type::UnsubscribeResult, static_cast<int8_t>(rc), request.id});
+			}
+			break;
+
+			case Core1Request::Type::SimulateTCPFail:
+				m_simulateTCPFail = request.id != 0;
+				if (m_simulateTCPFail)
+				{
+					m_wifiClient.stop();
+				}
+			break;
+		}
+	}
+
+	m_mqtt.client->yield(1);
 	return tickInterval;
 }
 
+#endif
+
 void MQTTCache::onEvent(const Event& evt)
 {
 	switch(evt.type)
@@ -666,15 +1041,21 @@ bool MQTTCache::processCommand(const Command& cmd)
 	}
 	else if(cmd.is("testtcpfail"))
 	{
-		if (!cmd.parseParams(m_simulateTCPFail))
+		bool simulateTCPFail;
+		if (!cmd.parseParams(simulateTCPFail))
 		{
 			return false;
 		}
 
+	#if AW_NETWORK_ON_CORE1
+		postToCore1({Core1Request::Type::SimulateTCPFail, 0, static_cast<uint16_t>(simulateTCPFail ? 1 : 0)});
+	#else
+		m_simulateTCPFail = simulateTCPFail;
 		if (m_simulateTCPFail)
 		{
 			m_wifiClient.stop();
 		}
+	#endif
 	}
 	else
 	{
@@ -704,9 +1085,30 @@ void MQTTCache::logState() const
 	{
 		CZ_LOG(logMQTTCache, Log, "    %s", toLogString(e.get()));
 	}
+
+#if AW_NETWORK_ON_CORE1
+	CZ_LOG(logMQTTCache, Log, "Core 1 requests: size=%d/%d, highWaterMark=%u, pushFailures=%u",
+		m_core1Requests.size(), m_core1Requests.capacity(), m_core1Requests.getHighWaterMark(), m_core1Requests.getPushFailures());
+	CZ_LOG(logMQTTCache, Log, "Core 1 notifications: size=%d/%d, highWaterMark=%u, pushFailures=%u",
+		m_core1Notifications.size(), m_core1Notifications.capacity(), m_core1Notifications.getHighWaterMark(),
+		m_core1Notifications.getPushFailures());
+	CZ_LOG(logMQTTCache, Log, "Core 1 log: size=%d/%d, highWaterMark=%u, dropped=%u",
+		gCore1Log.getQueue().size(), gCore1Log.getQueue().capacity(), gCore1Log.getQueue().getHighWaterMark(),
+		gCore1Log.getQueue().getPushFailures());
+#endif
 }
 
 bool MQTTCache::isConnected() const
+{
+#if AW_NETWORK_ON_CORE1
+	// Core 1 owns the MQTT client, so core 0 uses the status it last saw
+	return m_core1Connected.load(std::memory_order_acquire);
+#else
+	return isClientConnected();
+#endif
+}
+
+bool MQTTCache::isClientConnected() const
 {
 	return m_mqtt.client->isConnected();
 }
@@ -716,7 +1118,7 @@ bool MQTTCache::connectToMqttBroker(float deltaSeconds)
 	WifiManager* wifiManager = WifiManager::getInstance();
 	CZ_ASSERT(wifiManager);
 
-	if (isConnected() && wifiManager->isConnected())
+	if (isClientConnected() && wifiManager->isConnected())
 	{
 		return true;
 	}
@@ -735,7 +1137,7 @@ bool MQTTCache::connectToMqttBroker(float deltaSeconds)
 
 		if (!wifiManager->isConnected())
 		{
-			CZ_LOG(logMQTTCache, Error, "Can't connect to MQTT broker because WiFi is not connected");
+			MQTT_LOG(Error, "Can't connect to MQTT broker because WiFi is not connected");
 			return false;
 		}
 		
@@ -747,9 +1149,13 @@ bool MQTTCache::connectToMqttBroker(float deltaSeconds)
 				{
 					m_conFailCount = 0;
 					m_simulateTCPFail = false;
-					CZ_LOG(logMQTTCache, Log, "Too many connection attempts. Disconnecting/reconnecting wifi to try and fix it");
+					MQTT_LOG(Log, "Too many connection attempts. Disconnecting/reconnecting wifi to try and fix it");
 					// NOTE: The reconnect is done in AdafruitIOManager once it detects Wifi has disconnected
+				#if AW_NETWORK_ON_CORE1
+					WifiManager::getInstance()->core1Disconnect(true);
+				#else
 					WifiManager::getInstance()->disconnect(true);
+				#endif
 				}
 			#endif
 		};
@@ -757,42 +1163,57 @@ bool MQTTCache::connectToMqttBroker(float deltaSeconds)
 		// Close connection if exists
 		m_wifiClient.stop();
 
+	#if AW_NETWORK_ON_CORE1
+		// Core 1 uses its own copy of the config
+		const Core1Config& cfg = m_core1Cfg;
+		const char* cfgHost = cfg.host;
+		const char* cfgClientId = cfg.clientId;
+		const char* cfgUsername = cfg.username;
+		const char* cfgPassword = cfg.password;
+	#else
+		const Config& cfg = m_cfg;
+		const char* cfgHost = cfg.host.c_str();
+		const char* cfgClientId = cfg.clientId.c_str();
+		const char* cfgUsername = cfg.username.c_str();
+		const char* cfgPassword = cfg.password.c_str();
+	#endif
+
 		// Re-establish TCP connection with MQTT broker
-		const char* host = m_simulateTCPFail ? "hopefully-this-url-doesnt-exist.com" : m_cfg.host.c_str();
-		CZ_LOG(logMQTTCache, Log, "Creating TCP connection to %s:%u...", host , static_cast<unsigned int>(m_cfg.port));
-		m_wifiClient.connect(host, m_cfg.port);
+		const char* host = m_simulateTCPFail ? "hopefully-this-url-doesnt-exist.com" : cfgHost;
+		MQTT_LOG(Log, "Creating TCP connection to %s:%u...", host , static_cast<unsigned int>(cfg.port));
+		m_wifiClient.connect(host, cfg.port);
 		if (!m_wifiClient.connected())
 		{
-			CZ_LOG(logMQTTCache, Error, "Can't establish the TCP connection to %s:%d", host, static_cast<unsigned int>(m_cfg.port));
+			MQTT_LOG(Error, "Can't establish the TCP connection to %s:%u", host, static_cast<unsigned int>(cfg.port));
 			incrementFailCount();
 			return false;
 		}
 		else
 		{
-			CZ_LOG(logMQTTCache, Log, "TCP connection created");
+			MQTT_LOG(Log, "TCP connection created");
 		}
 
 		// Start new MQTT connection
 		{
-			CZ_LOG(logMQTTCache, Log, "Starting MQTT session...");
+			MQTT_LOG(Log, "Starting MQTT session...");
 			MqttClient::ConnectResult connectResult;
 			MQTTPacket_connectData options = MQTTPacket_connectData_initializer;
 			options.MQTTVersion = 4;
-			options.clientID.cstring = const_cast<char*>(m_cfg.clientId.c_str());
+			options.clientID.cstring = const_cast<char*>(cfgClientId);
 			options.cleansession = true;
 			options.keepAliveInterval = 15; // 15 seconds
-			options.username.cstring = const_cast<char*>(m_cfg.username.c_str());
-			options.password.cstring = const_cast<char*>(m_cfg.password.c_str());
+			options.username.cstring = const_cast<char*>(cfgUsername);
+			options.password.cstring = const_cast<char*>(cfgPassword);
 			MqttClient::Error::type rc = m_mqtt.client->connect(options, connectResult);
 			if (rc != MqttClient::Error::SUCCESS)
 			{
-				CZ_LOG(logMQTTCache, Error, "MQTT Session start error: %i", rc);
+				MQTT_LOG(Error, "MQTT Session start error: %i", rc);
 				incrementFailCount();
 				return false;
 			}
 			else
 			{
-				CZ_LOG(logMQTTCache, Log, "MQTT Session started")
+				MQTT_LOG(Log, "MQTT Session started");
 			}
 		}
 
@@ -800,14 +1221,14 @@ bool MQTTCache::connectToMqttBroker(float deltaSeconds)
 	}
 }
 
-void MQTTCache::doSubscribe(const char* topic)
+MqttClient::Error::type MQTTCache::doSubscribe(const char* topic)
 {
-	CZ_LOG(logMQTTCache, Log, "Subscribing to '%s'", topic);
+	MQTT_LOG(Log, "Subscribing to '%s'", topic);
 	MqttClient::Error::type rc = m_mqtt.client->subscribe(topic, MqttClient::QOS1, onMqttMessageCallback); 
 	if (rc != MqttClient::Error::SUCCESS)
 	{
-		CZ_LOG(logMQTTCache, Error, "Failed to subscribe to '%s'. Error %i", topic, rc);
-		return;
+		MQTT_LOG(Error, "Failed to subscribe to '%s'. Error %i", topic, rc);
+		return rc;
 	}
 
 	//
@@ -819,25 +1240,31 @@ void MQTTCache::doSubscribe(const char* topic)
 	msg.dup = false;
 	msg.payload = (void*)"";
 	msg.payloadLen = 0;
-	const char* getTopic = formatString("%s/get", topic);
-	CZ_LOG(logMQTTCache, Log, "Publishing to '%s' to get the latest value.", getTopic);
-	rc = m_mqtt.client->publish(getTopic, msg);
-	if (rc != MqttClient::Error::SUCCESS)
+	// Not using formatString, since this can run on core 1
+	char getTopic[AW_MQTT_MAX_TOPIC_SIZE + 4];
+	snprintf(getTopic, sizeof(getTopic), "%s/get", topic);
+	MQTT_LOG(Log, "Publishing to '%s' to get the latest value.", getTopic);
+	MqttClient::Error::type getRc = m_mqtt.client->publish(getTopic, msg);
+	if (getRc != MqttClient::Error::SUCCESS)
 	{
-		CZ_LOG(logMQTTCache, Error, "Failed to publish: %i", rc);
+		// We are still subscribed, so it's not an error for the caller. We just don't get the latest value right away
+		MQTT_LOG(Error, "Failed to publish: %i", getRc);
 	}
 #endif
+
+	return rc;
 }
 
-void MQTTCache::doUnsubscribe(const char* topic)
+MqttClient::Error::type MQTTCache::doUnsubscribe(const char* topic)
 {
-	CZ_LOG(logMQTTCache, Log, "Unsubscribing from '%s'", topic);
+	MQTT_LOG(Log, "Unsubscribing from '%s'", topic);
 	MqttClient::Error::type rc = m_mqtt.client->unsubscribe(topic);
 	if (rc != MqttClient::Error::SUCCESS)
 	{
-		CZ_LOG(logMQTTCache, Error, "Failed to unsubscribe from '%s'. Error %i", topic, rc);
-		return;
+		MQTT_LOG(Error, "Failed to unsubscribe from '%s'. Error %i", topic, rc);
 	}
+
+	return rc;
 }
 
 } // namespace cz
@@ -8,6 +8,8 @@
 #include <crazygaze/micromuc/Ticker.h>
 
 #include "Component.h"
+#include "SPSCQueue.h"
+#include <atomic>
 
 #define MQTT_LOG_ENABLED 1
 #include "MqttClient.h"
@@ -198,6 +200,16 @@ class MQTTCache : public Component
 	virtual float tick(float deltaSeconds) override;
 	virtual void onEvent(const Event& evt) override;
 	virtual bool processCommand(const Command& cmd) override;
+	virtual bool hasPendingInput() override;
+
+#if AW_NETWORK_ON_CORE1
+	/**
+	 * Core 1 side. Should only be called from core 1.
+	 * Keeps the broker connection alive, and does the publishes/subscriptions requested by core 0.
+	 * Returns how many seconds until it should be called again.
+	 */
+	float core1Tick(float deltaSeconds);
+#endif
 
 
 	/*
@@ -224,6 +236,8 @@ class MQTTCache : public Component
 
 	void onMqttMessage(MqttClient::MessageData& md);
 	static void onMqttMessageCallback(MqttClient::MessageData& md);
+	// payload needs to be writeable, since the json parsing is done in place
+	void processMessage(const char* topic, char* payload);
 
 	/**
 	 * NOTE: These callbacks were being used with other mqtt libraries I've tried, which actually had async publish.
@@ -245,8 +259,12 @@ class MQTTCache : public Component
 		{
 			Unsubscribed,
 			NeedsSubscribe,
+			// Waiting for core 1 to subscribe (AW_NETWORK_ON_CORE1 only)
+			Subscribing,
 			Subscribed,
-			NeedsUnsubscribe
+			NeedsUnsubscribe,
+			// Waiting for core 1 to unsubscribe (AW_NETWORK_ON_CORE1 only)
+			Unsubscribing
 		};
 		State state = State::Unsubscribed;
 	};
@@ -278,8 +296,13 @@ class MQTTCache : public Component
 	} m_mqtt;
 
 	bool connectToMqttBroker(float deltaSeconds);
-	void doSubscribe(const char* topic);
-	void doUnsubscribe(const char* topic);
+	bool isClientConnected() const;
+	void processSubscriptionChanges();
+	void publishNext();
+	MqttClient::Error::type doPublish(const char* topic, const char* value, uint8_t qos);
+	void onPublishResult(Entry* entry, MqttClient::Error::type rc);
+	MqttClient::Error::type doSubscribe(const char* topic);
+	MqttClient::Error::type doUnsubscribe(const char* topic);
 	float m_connectToMqttBrokerCountdown = 0;
 
 	// To avoid reallocating memory every time we receive a message (and possibly reduce fragmentation) we reuse the object
@@ -294,6 +317,97 @@ class MQTTCache : public Component
 	int m_conFailCount = 0;
 	bool m_simulateTCPFail = false; 
 #endif
+
+#if AW_NETWORK_ON_CORE1
+	//
+	// When the network runs on core 1, the cache itself (entries, send queue, subscriptions state) stays on core 0, and
+	// everything that touches the MQTT client or the WiFiClient is done on core 1.
+	// The only things the cores share are the queues, and buffers whose ownership is passed through the queues. Core 1
+	// gets its own copy of the config, logs through a queue (see Core1Log.h), and never allocates memory.
+	//
+
+	// Copy of m_cfg for core 1, sent once by initImpl
+	struct Core1Config
+	{
+		char host[64];
+		uint16_t port;
+		char clientId[32];
+		char username[64];
+		char password[64];
+	};
+	TSPSCQueue<Core1Config, 1> m_core1ConfigQueue;
+	// Only used by core 1
+	Core1Config m_core1Cfg;
+	bool m_core1HasCfg = false;
+
+	// core 0 -> core 1
+	struct Core1Request
+	{
+		enum class Type : uint8_t
+		{
+			Publish,
+			Subscribe,
+			Unsubscribe,
+			SimulateTCPFail
+		};
+		Type type;
+		uint8_t qos;
+		// Publish: packet id used to match the result with the entry
+		// Subscribe/Unsubscribe: index in m_subscriptions, to match the result
+		// SimulateTCPFail: 0 or 1
+		uint16_t id;
+		// Subscribe/Unsubscribe
+		char topic[AW_MQTT_MAX_TOPIC_SIZE];
+	};
+	TSPSCQueue<Core1Request, AW_NETWORK_QUEUE_SIZE> m_core1Requests;
+
+	// Topic and value of the publish in progress. Core 0 only writes to it when there is no publish in progress
+	// (m_core1PublishId is 0), and core 1 only reads it between getting the Publish request and sending the result.
+	char m_core1PublishTopic[AW_MQTT_MAX_TOPIC_SIZE];
+	std::unique_ptr<char[]> m_core1PublishValue;
+	int m_core1PublishValueSize = 0;
+
+	// core 1 -> core 0
+	struct Core1Notification
+	{
+		enum class Type : uint8_t
+		{
+			PublishResult,
+			SubscribeResult,
+			UnsubscribeResult,
+			Message
+		};
+		Type type;
+		// PublishResult/SubscribeResult/UnsubscribeResult: MqttClient::Error::type
+		int8_t rc;
+		// PublishResult/SubscribeResult/UnsubscribeResult: Same as the request's id
+		// Message: index in m_core1Messages
+		uint16_t id;
+	};
+	TSPSCQueue<Core1Notification, AW_NETWORK_QUEUE_SIZE> m_core1Notifications;
+
+	// Received messages, handed over from core 1 to core 0. The buffers are allocated by core 0 in setOptions.
+	struct Core1Message
+	{
+		char topic[AW_MQTT_MAX_TOPIC_SIZE];
+		std::unique_ptr<char[]> payload;
+	};
+	Core1Message m_core1Messages[AW_NETWORK_MESSAGE_SLOTS];
+	int m_core1MessageSize = 0;
+	// Indexes of the m_core1Messages core 1 can use. Core 0 gives them back once it processes the message
+	TSPSCQueue<uint8_t, AW_NETWORK_MESSAGE_SLOTS> m_core1FreeMessages;
+
+	bool postToCore1(Core1Request&& request);
+	void postToCore0(Core1Notification&& notification);
+	void processCore1Notifications();
+	void onSubscriptionResult(uint16_t index, bool subscribe, MqttClient::Error::type rc);
+
+	// Written by core 1 only
+	std::atomic<bool> m_core1Connected{false};
+	// Packet id of the publish core 1 is working on, or 0 if none. Only used by core 0
+	uint16_t m_core1PublishId = 0;
+	uint16_t m_core1LastPublishId = 0;
+#endif
 };
 
 #if AW_WIFI_ENABLED
@@ -102,19 +102,31 @@ MQTTUI::MQTTUI()
 {
 	// We only start ticking when we ready a ConfigReady event
 	stopTicking();
+
+	subscribe(Event::ConfigReady);
+	subscribe(Event::WifiStatus);
+	subscribe(Event::TemperatureSensorReading);
+	subscribe(Event::HumiditySensorReading);
+	subscribe(Event::SoilMoistureSensorReading);
+	subscribe(Event::SoilMoistureSensorCalibration);
+	subscribe(Event::SoilMoistureSensorCalibrationReading);
+	subscribe(Event::GroupOnOff);
+	subscribe(Event::BatteryLifeReading);
+	subscribe(Event::Motor);
+	subscribe(Event::SoilMoistureSensorDrift);
+	subscribe(Event::PumpFault);
 }
 
-bool MQTTUI::initImpl()
+void MQTTUI::declareDependencies()
 {
 	MQTTCache* mqttCache = MQTTCache::getInstance();
 	// If we are using MQTTUI, then by design there must exist an MQTTCache instance.
 	CZ_ASSERT(mqttCache);
+	dependsOn(mqttCache);
+}
 
-	if (!mqttCache->isInitialized())
-	{
-		return false;
-	}
-
+bool MQTTUI::initImpl()
+{
 	onEnterState();
 	return true;
 }
@@ -142,6 +154,15 @@ float MQTTUI::tick(float deltaSeconds)
 		}
 	}
 
+#if AW_MQTTUI_DIAGNOSTICS_INTERVAL
+	m_diagnosticsCountdown -= deltaSeconds;
+	if (m_diagnosticsCountdown <= 0.0f)
+	{
+		m_diagnosticsCountdown = AW_MQTTUI_DIAGNOSTICS_INTERVAL;
+		publishDiagnostics();
+	}
+#endif
+
 	switch(m_state)
 	{
 		case WaitingForConnection:
@@ -176,10 +197,19 @@ void MQTTUI::publishGroupData(int index)
 	mqtt->set(buildFeedName("group", index, "motoron"), 0, 2, false);
 	mqtt->set(buildFeedName("group", index, "samplinginterval"), groupData.getSamplingIntervalInMinutes(), 2, false);
 	mqtt->set(buildFeedName("group", index, "shotduration"), groupData.getShotDuration(), 2, false);
+	mqtt->set(buildFeedName("group", index, "shotvolume"), groupData.getShotVolume(), 2, false);
+	mqtt->set(buildFeedName("group", index, "totalvolume"), groupData.getTotalVolume(), 2, false);
 	mqtt->set(buildFeedName("group", index, "threshold"), groupData.getThresholdValueAsPercentage(), 2, false);
 	mqtt->set(buildFeedName("group", index, "value"), groupData.getCurrentValueAsPercentage(), 2, false);
 }
 
+void MQTTUI::publishDiagnostics()
+{
+	String diagnostics = Component::getTickDiagnostics(AW_MQTTUI_DIAGNOSTICS_NUM_COMPONENTS);
+	CZ_LOG(logMQTTUI, Log, "Publishing diagnostics: %s", diagnostics.c_str());
+	MQTTCache::getInstance()->set(buildFeedName("diagnostics"), diagnostics.c_str(), 0, false);
+}
+
 String MQTTUI::createConfigJson()
 {
 	DynamicJsonDocument& doc = *MQTTCache::getInstance()->getScratchJsonDocument();
@@ -195,6 +225,7 @@ String MQTTUI::createConfigJson()
 		obj["running"] = groupData.isRunning() ? 1 : 0;
 		obj["samplingInterval"] = groupData.getSamplingInterval();
 		obj["shotDuration"] = groupData.getShotDuration();
+		obj["shotVolume"] = groupData.getShotVolume();
 		obj["waterValue"] = groupData.getWaterValue();
 		obj["airValue"] = groupData.getAirValue();
 		obj["thresholdValue"] = groupData.getThresholdValue();
@@ -245,6 +276,8 @@ bool MQTTUI::parseConfigJson(const String& configJson)
 		int running = groups[i]["running"];
 		int samplingInterval = groups[i]["samplingInterval"];
 		int shotDuration = groups[i]["shotDuration"];
+		// Older configs don't have this
+		int shotVolume = groups[i]["shotVolume"] | 0;
 		int airValue = groups[i]["airValue"];
 		int waterValue = groups[i]["waterValue"];
 		int thresholdValue = groups[i]["thresholdValue"];
@@ -252,15 +285,17 @@ bool MQTTUI::parseConfigJson(const String& configJson)
 		data.setRunning(running == 1 ? true : false);
 		data.setSamplingInterval(samplingInterval);
 		data.setShotDuration(shotDuration);
+		data.setShotVolume(shotVolume);
 		data.setAirAndWaterValues(airValue, waterValue);
 		data.setThresholdValue(thresholdValue);
 		isDirty = isDirty || data.isDirty();
 
-		CZ_LOG(logMQTTUI, Verbose, "Group %d json: running=%d, samplingInterval=%d, shotDuration=%d, airValue=%d, waterValue=%d, thresholdValue=%d",
+		CZ_LOG(logMQTTUI, Verbose, "Group %d json: running=%d, samplingInterval=%d, shotDuration=%d, shotVolume=%d, airValue=%d, waterValue=%d, thresholdValue=%d",
 			i,
 			running,
 			samplingInterval,
 			shotDuration,
+			shotVolume,
 			airValue,
 			waterValue,
 			thresholdValue
@@ -472,6 +507,24 @@ void MQTTUI::onEvent(const Event& evt)
 			MQTTCache::getInstance()->set(buildFeedName("group", e.index, "motoron"), e.started ? 100 : 0, 2, true);
 		}
 		break;
+
+		case Event::SoilMoistureSensorDrift:
+		{
+			// So failing or drifting sensors show up on the dashboard
+			auto&& e = static_cast<const SoilMoistureSensorDriftEvent&>(evt);
+			char flags[48];
+			SensorDriftEstimator::flagsToString(e.flags, flags, sizeof(flags));
+			MQTTCache::getInstance()->set(buildFeedName("group", e.index, "sensorstatus"), flags, 0, false);
+		}
+		break;
+
+		case Event::PumpFault:
+		{
+			auto&& e = static_cast<const PumpFaultEvent&>(evt);
+			MQTTCache::getInstance()->set(buildFeedName("group", e.index, "pumpstatus"),
+				PumpCurrentDetector::faultToString(static_cast<PumpCurrentDetector::Fault>(e.fault)), 0, false);
+		}
+		break;
 	}
 } 
 
@@ -537,6 +590,10 @@ void MQTTUI::onMqttValueReceived(const MQTTCache::Entry* entry)
 			{
 				data.setShotDuration(atoi(entry->value.c_str()));
 			}
+			else if (strcmp(parsed.name, "shotvolume") == 0)
+			{
+				data.setShotVolume(atoi(entry->value.c_str()));
+			}
 			else if (strcmp(parsed.name, "motoron") == 0)
 			{
 				if (atoi(entry->value.c_str()) != 0)
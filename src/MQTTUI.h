@@ -16,6 +16,7 @@ class MQTTUI : public Component, public MQTTCache::Listener
   private:
 	// Component interface
 	virtual const char* getName() const override { return "MQTTUI"; }
+	virtual void declareDependencies() override;
 	virtual bool initImpl() override;
 	virtual float tick(float deltaSeconds) override;
 	virtual void onEvent(const Event& evt) override;
@@ -39,6 +40,8 @@ class MQTTUI : public Component, public MQTTCache::Listener
 	*/
 	void publishConfig(int groupIndex = -1);
 	void publishGroupData(int index);
+	// Publishes the tick stats of the slowest components. See AW_MQTTUI_DIAGNOSTICS_INTERVAL
+	void publishDiagnostics();
 	bool m_subscribed = false;
 
 	enum State : uint8_t
@@ -69,6 +72,8 @@ class MQTTUI : public Component, public MQTTCache::Listener
 	// This also makes it possible to fiddle with the MQTT UI to adjust values, and only after we stop fiddling it will save the changes.
 	float m_saveDelay = 0.0f;
 
+	float m_diagnosticsCountdown = AW_MQTTUI_DIAGNOSTICS_INTERVAL;
+
 	// Dummy config we act on while calibrating a sensor
 	GroupConfig m_dummyCfg;
 	// What sensor are we calibrating or -1 if not calibrating any sensor
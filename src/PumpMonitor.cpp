@@ -1,21 +1,42 @@
 #include "PumpMonitor.h"
 #include "Context.h"
+#include "Timer.h"
+#include "SharedPump.h"
+#include "utility/ADCCapture.h"
 #include <crazygaze/micromuc/StringUtils.h>
 #include "crazygaze/micromuc/Profiler.h"
+#include <algorithm>
 
 namespace cz
 {
 
-PumpMonitor::SemaphoreQueue PumpMonitor::ms_semaphoreQueue;
+extern Timer gTimer;
 
-PumpMonitor::PumpMonitor(uint8_t index, DigitalOutputPin& motorPin)
+PumpMonitor::Scheduler PumpMonitor::ms_scheduler(AW_PUMP_SCHEDULER_BUDGET, AW_PUMP_SCHEDULER_URGENCY_WEIGHT);
+PumpMonitor::ControllerMode PumpMonitor::ms_controllerMode = static_cast<PumpMonitor::ControllerMode>(AW_PUMP_CONTROLLER);
+#if AW_ADC_CAPTURE_ENABLED
+PumpMonitor* PumpMonitor::ms_currentSenseOwner = nullptr;
+#endif
+
+PumpMonitor::PumpMonitor(uint8_t index, DigitalOutputPin& motorPin, uint16_t cost)
 	: m_index(index)
 	, m_motorPin(motorPin)
 	, m_sensorValidReadingSinceLastShot(0)
-	, m_queueHandle(ms_semaphoreQueue.createHandle())
+	, m_controller(index)
+	, m_queueHandle(ms_scheduler.createHandle(cost))
 {
 	// We only start ticking when we get a ConfigReady event
 	stopTicking();
+
+	subscribe(Event::ConfigReady);
+	subscribe(Event::ConfigLoad);
+	subscribe(Event::SoilMoistureSensorReading);
+	subscribe(Event::GroupOnOff);
+	subscribe(Event::Motor);
+#if !AW_NETWORK_ON_CORE1
+	// If the network runs on core 1, connecting to WiFi doesn't block us, so there is no need to turn off the motors
+	subscribe(Event::WifiConnecting);
+#endif
 }
 
 const char* PumpMonitor::getName() const
@@ -39,7 +60,17 @@ void PumpMonitor::doShot()
 	}
 	else
 	{
+		if (m_fault != PumpCurrentDetector::Fault::None)
+		{
+			CZ_LOG(logDefault, Log, F("Group %d: Clearing pump fault %s"), m_index, PumpCurrentDetector::faultToString(m_fault));
+			m_fault = PumpCurrentDetector::Fault::None;
+			Component::raiseEvent(PumpFaultEvent(m_index, static_cast<uint8_t>(m_fault)));
+		}
+
+		m_manualShotPending = true;
 		tryTurnMotorOn(true);
+		// Either the motor is now on or we are queued, so we need to tick to handle it
+		wakeUp();
 	}
 }
 
@@ -52,12 +83,50 @@ bool PumpMonitor::tryTurnMotorOn(bool registerInterest)
 		return false;
 	}
 
-	if (m_queueHandle.tryAcquire(registerInterest))
+	if (m_queueHandle.tryAcquire(registerInterest, calcUrgency(), static_cast<uint32_t>(gTimer.getTotalMicros() / 1000000)))
 	{
+		float shotDuration = m_manualShotPending
+			? data.getShotDuration()
+			: m_controller.calcShotDuration(ms_controllerMode, m_lastValidReading.meanValue, calcTargetValue(), data.getShotDuration());
+
+		m_flowTargetPulses = 0;
+		if (m_flowMeter)
+		{
+			m_flowMeter->update();
+			m_flowStartCount = m_flowMeter->getCount();
+			// The predictive controllers size shots in seconds
+			if (data.getShotVolume() && (m_manualShotPending || ms_controllerMode == ControllerMode::Fixed))
+			{
+				m_flowTargetPulses = FlowMeter::mlToPulses(data.getShotVolume());
+				// The motor turns off once the volume is delivered. This is just in case there is not enough flow.
+				shotDuration = AW_SHOT_MAX_DURATION;
+			}
+		#if AW_FLOW_METER_SIMULATED
+			m_flowMeter->setSimulatedFlow(m_mockFlow);
+		#endif
+		}
+
+		m_manualShotPending = false;
+		if (m_flowTargetPulses)
+		{
+			CZ_LOG(logDefault, Log, F("Group %d: Motor on for %umL"), m_index, data.getShotVolume());
+		}
+		else
+		{
+			CZ_LOG(logDefault, Log, F("Group %d: Motor on for %ss"), m_index, *FloatToString(shotDuration));
+		}
+
 		m_motorPin.write(PinStatus::HIGH);
 		data.setMotorState(true);
-		m_motorOffCountdown = data.getShotDuration();
+		// When not called from our own tick (e.g: a manual shot), the next tick's deltaSeconds also includes the time
+		// before the motor turned on
+		m_motorOffCountdown = shotDuration + getTimeSinceLastTick();
+		m_shotDuration = shotDuration;
 		m_sensorValidReadingSinceLastShot = false;
+		m_controller.startShot(m_lastValidReading.meanValue, shotDuration, gTimer.getTotalMicros());
+	#if AW_ADC_CAPTURE_ENABLED
+		startCurrentSense();
+	#endif
 		return true;
 	}
 	else
@@ -78,7 +147,290 @@ void PumpMonitor::turnMotorOff()
 		m_motorPin.write(PinStatus::LOW);
 		data.setMotorState(false);
 		m_queueHandle.release();
+	#if AW_ADC_CAPTURE_ENABLED
+		stopCurrentSense();
+	#endif
+
+		// The motor might have been turned off before the countdown ended, and from outside our tick (e.g: the group was
+		// stopped), in which case the countdown doesn't include the time since the last tick yet
+		float shotDuration = std::max(m_shotDuration - std::max(m_motorOffCountdown - getTimeSinceLastTick(), 0.0f), 0.0f);
+		m_controller.setShotDuration(shotDuration);
+
+		if (m_flowMeter)
+		{
+		#if AW_FLOW_METER_SIMULATED
+			m_flowMeter->setSimulatedFlow(0);
+		#endif
+			m_flowMeter->update();
+			uint32_t volume = FlowMeter::pulsesToMl(m_flowMeter->getCount() - m_flowStartCount);
+			CZ_LOG(logDefault, Log, F("Group %d: Delivered %umL in %ss")
+				, m_index
+				, static_cast<unsigned int>(volume)
+				, *FloatToString(shotDuration));
+
+			if (m_flowTargetPulses && m_motorOffCountdown <= 0 &&
+				(m_flowMeter->getCount() - m_flowStartCount) < m_flowTargetPulses)
+			{
+				CZ_LOG(logDefault, Warning, F("Group %d: Shot timed out before delivering %umL. Not enough flow?")
+					, m_index
+					, data.getShotVolume());
+			}
+			data.addDeliveredVolume(volume);
+		}
+
+		// Wait for the sensor to show the effect of the shot before deciding on another one
+		m_soakDuration = m_controller.calcSoakDuration(ms_controllerMode, shotDuration);
+		m_motorOffCountdown = std::min(m_motorOffCountdown, 0.0f);
+	}
+}
+
+unsigned int PumpMonitor::calcTargetValue() const
+{
+	const GroupData& data = gCtx.data.getGroupData(m_index);
+	int range = static_cast<int>(data.getAirValue()) - static_cast<int>(data.getWaterValue());
+	int target = static_cast<int>(data.getThresholdValue()) - range * AW_PUMP_TARGET_PERCENT / 100;
+	return static_cast<unsigned int>(std::max(target, static_cast<int>(data.getWaterValue())));
+}
+
+void PumpMonitor::setFlowMeter(FlowMeter& flowMeter)
+{
+	m_flowMeter = &flowMeter;
+#if AW_FLOW_METER_SIMULATED
+	// Typical of small 12V pumps
+	m_mockFlow = random(100, 250) / 100.0f;
+	CZ_LOG(logDefault, Log, F("Group %d: Simulated pump flow is %sL/min"), m_index, *FloatToString(m_mockFlow));
+#endif
+}
+
+float PumpMonitor::updateFlow()
+{
+	if (!m_flowMeter || !gCtx.data.getGroupData(m_index).isMotorOn())
+	{
+		return ms_idleTickWait;
+	}
+
+	m_flowMeter->update();
+	if (m_flowTargetPulses && (m_flowMeter->getCount() - m_flowStartCount) >= m_flowTargetPulses)
+	{
+		turnMotorOff();
+		return ms_idleTickWait;
+	}
+
+	return AW_FLOW_METER_POLL_INTERVAL;
+}
+
+void PumpMonitor::onFault(PumpCurrentDetector::Fault fault)
+{
+	CZ_LOG(logDefault, Error, F("Group %d: Pump fault %s. Turning motor off, and suspending automated shots until a manual shot.")
+		, m_index
+		, PumpCurrentDetector::faultToString(fault));
+
+	turnMotorOff();
+	m_fault = fault;
+	// The shot didn't water as expected, so it can't be used to learn the soil response
+	m_controller.cancelShot();
+	Component::raiseEvent(PumpFaultEvent(m_index, static_cast<uint8_t>(fault)));
+}
+
+#if AW_ADC_CAPTURE_ENABLED
+
+void PumpMonitor::setCurrentSense(uint8_t pin, uint16_t nominalmA)
+{
+#if AW_PUMP_SHARED
+	// The group's motor pin drives a valve, and the current of the shared pump doesn't tell which valve is at fault
+	CZ_LOG(logDefault, Warning, F("PumpMonitor(%d): Current sense is not supported with a shared pump"), m_index);
+	return;
+#endif
+
+	m_currentSense.pin = pin;
+	m_currentSense.nominal = nominalmA;
+#if AW_ADC_CAPTURE_SIMULATED
+	m_currentSense.waveform.nominal = nominalmA;
+	m_currentSense.waveform.seed = m_index + 1;
+#endif
+}
+
+void PumpMonitor::startCurrentSense()
+{
+	if (m_currentSense.pin < 0)
+	{
+		return;
+	}
+
+	m_currentSense.detected = PumpCurrentDetector::Fault::None;
+#if AW_ADC_CAPTURE_SIMULATED
+	m_currentSense.motorOnMicros = gTimer.getTotalMicros();
+#endif
+	if (ms_currentSenseOwner)
+	{
+		CZ_LOG(logDefault, Log, F("Group %d: No current sense until group %d's pump is off")
+			, m_index
+			, ms_currentSenseOwner->m_index);
+	}
+	// Start capturing right away, so the inrush is captured too
+	updateCurrentSense();
+}
+
+void PumpMonitor::stopCurrentSense()
+{
+	if (m_currentSense.capturing)
+	{
+		gADCCapture.cancel();
+		m_currentSense.capturing = false;
+	}
+
+	if (ms_currentSenseOwner == this)
+	{
+		ms_currentSenseOwner = nullptr;
+	}
+}
+
+float PumpMonitor::updateCurrentSense()
+{
+	if (m_currentSense.pin < 0)
+	{
+		return ms_idleTickWait;
+	}
+
+	const float captureDuration = ADCCapture::calcDuration(AW_PUMP_CURRENT_SENSE_NUM_SAMPLES, AW_PUMP_CURRENT_SENSE_RATE);
+
+	if (m_currentSense.capturing)
+	{
+		gADCCapture.poll();
+	}
+
+	if (m_currentSense.detected != PumpCurrentDetector::Fault::None)
+	{
+		onFault(m_currentSense.detected);
+		return ms_idleTickWait;
+	}
+
+	if (ms_currentSenseOwner != this)
+	{
+		// Capturing for two pumps would interleave the captures, and each detector would only see part of its own pump's
+		// current, so we wait for the other pump to turn off
+		if (ms_currentSenseOwner)
+		{
+			return captureDuration;
+		}
+
+		ms_currentSenseOwner = this;
+		// If we are taking over from another pump, the motor has been running for a while, and the detector skips an
+		// inrush that is not there. That only delays detection.
+		m_currentSense.detector.start(m_currentSense.nominal);
+	}
+
+	if (!m_currentSense.capturing)
+	{
+	#if AW_ADC_CAPTURE_SIMULATED
+		m_currentSense.captureTime = (gTimer.getTotalMicros() - m_currentSense.motorOnMicros) / 1000000.0f;
+		gADCCapture.setSimulatedWaveform(onSimulatedCurrent, this);
+	#endif
+		m_currentSense.capturing = gADCCapture.start(m_currentSense.pin, AW_PUMP_CURRENT_SENSE_NUM_SAMPLES,
+			AW_PUMP_CURRENT_SENSE_RATE, onCurrentCaptureDone, this, ADCCapture::Priority::High);
+
+		// The ADC is busy with a sensor reading, or being kept for one. Either way, it's only a short capture.
+		if (!m_currentSense.capturing)
+		{
+			return std::max(gADCCapture.getTimeToEnd(), 0.001f);
+		}
+	}
+
+	return captureDuration;
+}
+
+void PumpMonitor::onCurrentCaptureDone(void* userData, const uint16_t* samples, int numSamples)
+{
+	auto pump = static_cast<PumpMonitor*>(userData);
+	pump->m_currentSense.capturing = false;
+
+	float current[AW_ADC_CAPTURE_MAX_SAMPLES];
+	for (int i = 0; i < numSamples; i++)
+	{
+		current[i] = samples[i] * AW_PUMP_CURRENT_SENSE_MA_PER_UNIT;
+	}
+
+	PumpCurrentDetector::Fault fault = pump->m_currentSense.detector.process(current, numSamples, AW_PUMP_CURRENT_SENSE_RATE);
+	if (fault != PumpCurrentDetector::Fault::None)
+	{
+	#if AW_ADC_CAPTURE_SIMULATED
+		CZ_LOG(logDefault, Log, F("Group %d: %s detected %sms after the motor turned on (simulated fault at %sms)")
+			, pump->m_index
+			, PumpCurrentDetector::faultToString(fault)
+			, *FloatToString((pump->m_currentSense.captureTime + numSamples / static_cast<float>(AW_PUMP_CURRENT_SENSE_RATE)) * 1000.0f)
+			, pump->m_currentSense.waveform.fault == PumpCurrentDetector::Fault::None
+				? "none" : *FloatToString(pump->m_currentSense.waveform.faultTime * 1000.0f));
+	#endif
+		// The capture might have been polled by another component, so the fault is handled from our tick
+		pump->m_currentSense.detected = fault;
+		pump->wakeUp();
+	}
+}
+
+#if AW_ADC_CAPTURE_SIMULATED
+float PumpMonitor::onSimulatedCurrent(void* userData, float t)
+{
+	auto pump = static_cast<PumpMonitor*>(userData);
+	return pump->m_currentSense.waveform.sample(pump->m_currentSense.captureTime + t) / AW_PUMP_CURRENT_SENSE_MA_PER_UNIT;
+}
+
+void PumpMonitor::setMockFault(PumpCurrentDetector::Fault fault, float faultTime)
+{
+	m_currentSense.waveform.fault = fault;
+	m_currentSense.waveform.faultTime = faultTime;
+	CZ_LOG(logDefault, Log, F("Group %d: Simulated pump fault set to %s at %ss")
+		, m_index
+		, PumpCurrentDetector::faultToString(fault)
+		, *FloatToString(faultTime));
+}
+#endif
+
+#endif
+
+unsigned int PumpMonitor::calcStartValue() const
+{
+	const GroupData& data = gCtx.data.getGroupData(m_index);
+#if AW_PUMP_SHARED
+	// If the pump is running anyway, groups that are almost due join the pump run
+	if (gSetup->getSharedPump()->isRunning())
+	{
+		int range = static_cast<int>(data.getAirValue()) - static_cast<int>(data.getWaterValue());
+		int value = static_cast<int>(data.getThresholdValue()) - range * AW_PUMP_SHARED_BATCH_PERCENT / 100;
+		return static_cast<unsigned int>(std::max(value, static_cast<int>(data.getWaterValue())));
+	}
+#endif
+	return data.getThresholdValue();
+}
+
+uint16_t PumpMonitor::calcUrgency() const
+{
+	if (m_manualShotPending)
+	{
+		return ms_manualShotUrgency;
 	}
+
+	// How far above the threshold, as a percentage of the air/water range
+	const GroupData& data = gCtx.data.getGroupData(m_index);
+	int range = std::max(static_cast<int>(data.getAirValue()) - static_cast<int>(data.getWaterValue()), 1);
+	int over = static_cast<int>(m_lastValidReading.meanValue) - static_cast<int>(data.getThresholdValue());
+	return static_cast<uint16_t>(std::clamp(over * 100 / range, 0, 100));
+}
+
+void PumpMonitor::setControllerMode(ControllerMode mode)
+{
+	ms_controllerMode = mode;
+	CZ_LOG(logDefault, Log, F("Pump controller mode set to %s"), PumpController::modeToString(mode));
+}
+
+void PumpMonitor::logScheduler()
+{
+	CZ_LOG(logDefault, Log, F("Pump scheduler: budget=%u%s, used=%u%s, waiting=%d, urgency weight=%ds")
+		, static_cast<unsigned int>(ms_scheduler.getBudget())
+		, AW_PUMP_SCHEDULER_UNITS
+		, static_cast<unsigned int>(ms_scheduler.getUsedCurrent())
+		, AW_PUMP_SCHEDULER_UNITS
+		, ms_scheduler.getNumQueued()
+		, static_cast<int>(AW_PUMP_SCHEDULER_URGENCY_WEIGHT));
 }
 
 float PumpMonitor::tick(float deltaSeconds)
@@ -92,18 +444,28 @@ float PumpMonitor::tick(float deltaSeconds)
 	// user initiated shots
 	//
 
+	float motorOnWait = ms_idleTickWait;
 	if (m_motorOffCountdown > 0) // Motor is on
 	{
 		m_motorOffCountdown -= deltaSeconds;
-		if (m_motorOffCountdown < 0)
+		if (m_motorOffCountdown <= 0)
 		{
 			turnMotorOff();
 		}
+		else
+		{
+		#if AW_ADC_CAPTURE_ENABLED
+			motorOnWait = updateCurrentSense();
+		#endif
+			// Checking the flow after the current, since a pump fault turns the motor off
+			motorOnWait = std::min(motorOnWait, updateFlow());
+		}
 	}
-	else if (m_motorOffCountdown <= -AW_MINIMUM_TIME_BETWEEN_MOTOR_ON)
+	else if (m_motorOffCountdown <= -m_soakDuration)
 	{
 		if (
-			(data.isRunning() && m_sensorValidReadingSinceLastShot && m_lastValidReading.meanValue > data.getThresholdValue()) ||
+			(data.isRunning() && m_fault == PumpCurrentDetector::Fault::None && m_sensorValidReadingSinceLastShot &&
+			 m_lastValidReading.meanValue > calcStartValue()) ||
 			// The motor might be alrady queued for turning on due to an explicit shot (e.g: From the touch UI or MQTT UI)
 			m_queueHandle.isQueued())
 		{
@@ -112,17 +474,37 @@ float PumpMonitor::tick(float deltaSeconds)
 		else
 		{
 			// If we are at a point where the motor is ready to turn on, but for some reason it didn't (group not running, no sensor reading since last shot, etc)
-			// then we need to make sure we release our slot from the semaphore queue
+			// then we need to make sure we stop waiting in the scheduler
 			m_queueHandle.release();
 		}
 	}
-	else // m_motorOffCountdown is in the ]-AW_MINIMUM_TIME_BETWEEN_MOTOR_ON, 0] range
+	else // m_motorOffCountdown is in the ]-m_soakDuration, 0] range
 	{
-		// keep counting down until we get to <= -AW_MINIMUM_TIME_BETWEEN_MOTOR_ON
+		// keep counting down until we get to <= -m_soakDuration
 		m_motorOffCountdown -= deltaSeconds;
 	}
 
-	return 0.2f;
+	if (m_motorOffCountdown > 0)
+	{
+		// Time left until the motor needs to be turned off, or to check the current/flow
+		return std::min(m_motorOffCountdown, motorOnWait);
+	}
+	else if (m_motorOffCountdown > -m_soakDuration)
+	{
+		// Time left until we can turn the motor on again
+		return m_motorOffCountdown + m_soakDuration;
+	}
+	else if (m_queueHandle.isQueued())
+	{
+		// Waiting for another motor to turn off, which wakes us up. Checking every now and then anyway, in case a slot
+		// gets released without a motor turning off.
+		return ms_queuedTickWait;
+	}
+	else
+	{
+		// Nothing to do until we get a sensor reading, a shot request or the group is started, which all wake us up
+		return ms_idleTickWait;
+	}
 }
 
 void PumpMonitor::onEvent(const Event& evt)
@@ -140,8 +522,15 @@ void PumpMonitor::onEvent(const Event& evt)
 			// to end up turning the water on.
 			if (e.index == m_index && e.reading.isValid())
 			{
-				m_sensorValidReadingSinceLastShot = true;
+				m_controller.addReading(e.reading.meanValue, gTimer.getTotalMicros());
+				// With the predictive controllers, readings taken while soaking don't show the full effect of the shot
+				// yet, so they can't be used to decide on another shot.
+				if (!m_controller.usesModel(ms_controllerMode) || m_motorOffCountdown <= -m_soakDuration)
+				{
+					m_sensorValidReadingSinceLastShot = true;
+				}
 				m_lastValidReading = e.reading;
+				wakeUp();
 			}
 		}
 		break;
@@ -149,10 +538,42 @@ void PumpMonitor::onEvent(const Event& evt)
 		case Event::GroupOnOff:
 		{
 			const GroupOnOffEvent& e = static_cast<const GroupOnOffEvent&>(evt);
-			if (e.index == m_index && e.started == false)
+			if (e.index == m_index)
+			{
+				if (e.started)
+				{
+					wakeUp();
+				}
+				else
+				{
+					turnMotorOff();
+				}
+			}
+		}
+		break;
+
+		case Event::ConfigLoad:
+		{
+			// The threshold might have changed
+			wakeUp();
+		}
+		break;
+
+		case Event::Motor:
+		{
+			// Another motor turning off frees some of the power budget
+			const MotorEvent& e = static_cast<const MotorEvent&>(evt);
+			if (e.index != m_index && !e.started && m_queueHandle.isQueued())
+			{
+				wakeUp();
+			}
+		#if AW_PUMP_SHARED
+			// The shared pump is running, so we might want to join the pump run
+			else if (e.index != m_index && e.started)
 			{
-				turnMotorOff();
+				wakeUp();
 			}
+		#endif
 		}
 		break;
 
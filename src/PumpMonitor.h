@@ -1,7 +1,10 @@
 #pragma once
 
 #include "Component.h"
-#include "SemaphoreQueue.h"
+#include "PumpScheduler.h"
+#include "utility/PumpCurrentDetector.h"
+#include "utility/FlowMeter.h"
+#include "utility/PumpController.h"
 
 namespace cz
 {
@@ -11,13 +14,58 @@ class PumpMonitor : public Component
   public:
 	PumpMonitor(const PumpMonitor&) = delete;
 	PumpMonitor& operator=(const PumpMonitor&) = delete;
-	explicit PumpMonitor(uint8_t index, DigitalOutputPin& motorPin);
+	/**
+	 * \param motorPin Pin that turns the group's pump on/off, or the group's valve if using a shared pump (see AW_PUMP_SHARED)
+	 * \param cost Current draw of the pump in mA (see AW_PUMP_CURRENT_BUDGET_MA), or the valve's flow in L/h if using a
+	 * shared pump (see AW_PUMP_SHARED_FLOW)
+	 */
+	explicit PumpMonitor(uint8_t index, DigitalOutputPin& motorPin, uint16_t cost = AW_PUMP_SCHEDULER_DEFAULT_COST);
 
 	// Initiates an explicit shot
 	// If there are too many motors on already, it will queue up
 	// If the motor is already running, it does nothing
+	// Also clears any pump fault, so automated shots resume
 	void doShot();
 
+	/**
+	 * Measures the water delivered with a flow meter. This allows shots in millilitres (see AW_SHOT_DEFAULT_VOLUME), and
+	 * keeps the group's total volume.
+	 */
+	void setFlowMeter(FlowMeter& flowMeter);
+
+#if AW_ADC_CAPTURE_ENABLED
+	/**
+	 * Enables stall/dry run/open circuit detection for this pump (see AW_PUMP_CURRENT_SENSE_RATE)
+	 * Does nothing with a shared pump (AW_PUMP_SHARED), since the groups only have valves.
+	 * There is only one ADC, so only one pump is monitored at a time: The first one to turn on. Any other pump running at
+	 * the same time goes unmonitored until that one turns off, and then takes over (see AW_PUMP_CURRENT_SENSE_RATE).
+	 * \param pin MCU pin (26..29) connected to the pump's current sense
+	 * \param nominalmA Current the pump draws when working normally
+	 */
+	void setCurrentSense(uint8_t pin, uint16_t nominalmA);
+#endif
+
+#if AW_ADC_CAPTURE_ENABLED && AW_ADC_CAPTURE_SIMULATED
+	/**
+	 * Makes the simulated current of the following shots show a fault, starting the specified seconds after the motor
+	 * turns on. Fault::None goes back to a working pump.
+	 */
+	void setMockFault(PumpCurrentDetector::Fault fault, float faultTime);
+#endif
+
+	// See AW_PUMP_CONTROLLER
+	using ControllerMode = PumpController::Mode;
+
+	/**
+	 * Changes the controller mode for all groups
+	 */
+	static void setControllerMode(ControllerMode mode);
+
+	/**
+	 * Logs the pumps' power (or flow) budget, how much of it is in use, and how many pumps are waiting for their turn
+	 */
+	static void logScheduler();
+
   protected:
 
 	void turnMotorOff();
@@ -33,11 +81,35 @@ class PumpMonitor : public Component
 
 	/**
 	 * Tries to turn the motor on
-	 * \param registerInterest If true it will register interest in the semaphore queue, so it goes up in priority as multiple tries are done
+	 * \param registerInterest If true and there isn't enough power budget left, it waits for its turn in the scheduler
 	 * \return true if motor was started
 	 */
 	bool tryTurnMotorOn(bool registerInterest);
 
+	// How low the predictive controller wants the sensor value to go
+	unsigned int calcTargetValue() const;
+	// Sensor value above which an automated shot is due
+	unsigned int calcStartValue() const;
+	// Priority in the scheduler, if waiting for other pumps to turn off
+	uint16_t calcUrgency() const;
+
+	// Checks the flow meter while the motor is on. Returns the time until the next check.
+	float updateFlow();
+
+	// Turns off the motor because of a fault, and suspends automated shots
+	void onFault(PumpCurrentDetector::Fault fault);
+
+#if AW_ADC_CAPTURE_ENABLED
+	void startCurrentSense();
+	void stopCurrentSense();
+	// Starts/polls the captures while the motor is on. Returns the time until the next capture is done.
+	float updateCurrentSense();
+	static void onCurrentCaptureDone(void* userData, const uint16_t* samples, int numSamples);
+	#if AW_ADC_CAPTURE_SIMULATED
+	static float onSimulatedCurrent(void* userData, float t);
+	#endif
+#endif
+
 	uint8_t m_index;
 	DigitalOutputPin& m_motorPin;
 
@@ -52,9 +124,62 @@ class PumpMonitor : public Component
 	//		* If <= (-AW_MINIMUM_TIME_BETWEEN_MOTOR_ON) then we can do another sensor check
 	float m_motorOffCountdown = -AW_MINIMUM_TIME_BETWEEN_MOTOR_ON;
 
-	using SemaphoreQueue = TSemaphoreQueue<uint8_t, AW_MAX_NUM_PAIRS, AW_MAX_SIMULTANEOUS_PUMPS>;
-	static SemaphoreQueue ms_semaphoreQueue;
-	SemaphoreQueue::Handle m_queueHandle;
+	// How long to wait after the motor is off before another automated shot.
+	// With the predictive controllers this is long enough for the sensor to show the effect of the shot.
+	float m_soakDuration = AW_MINIMUM_TIME_BETWEEN_MOTOR_ON;
+	// Duration of the current/last shot
+	float m_shotDuration = 0;
+
+	bool m_manualShotPending = false;
+
+	FlowMeter* m_flowMeter = nullptr;
+	// Flow meter count when the motor turned on
+	uint32_t m_flowStartCount = 0;
+	// Pulses the current shot needs to deliver, or 0 if the shot is time based
+	uint32_t m_flowTargetPulses = 0;
+#if AW_FLOW_METER_SIMULATED
+	// Flow of the simulated pump, in litres per minute
+	float m_mockFlow = 0;
+#endif
+
+	// Set when a fault turned the motor off. Automated shots are suspended until a manual shot.
+	PumpCurrentDetector::Fault m_fault = PumpCurrentDetector::Fault::None;
+
+#if AW_ADC_CAPTURE_ENABLED
+	struct CurrentSense
+	{
+		// MCU pin, or -1 if the pump has no current sense
+		int8_t pin = -1;
+		bool capturing = false;
+		uint16_t nominal;
+		// Fault found by the last capture, waiting to be handled in tick
+		PumpCurrentDetector::Fault detected = PumpCurrentDetector::Fault::None;
+		PumpCurrentDetector detector;
+	#if AW_ADC_CAPTURE_SIMULATED
+		PumpCurrentWaveform waveform;
+		uint64_t motorOnMicros;
+		// Start of the current capture, in seconds since the motor turned on
+		float captureTime;
+	#endif
+	} m_currentSense;
+
+	// Pump using the ADC for its current sense, if any
+	static PumpMonitor* ms_currentSenseOwner;
+#endif
+
+	PumpController m_controller;
+	static ControllerMode ms_controllerMode;
+
+	// How long to wait when there is nothing to do. Anything that could turn the motor on raises events that wake us up.
+	static constexpr float ms_idleTickWait = 60*60;
+	// Safety check interval while queued waiting for our turn
+	static constexpr float ms_queuedTickWait = 1.0f;
+	// Manual shots go ahead of any automated shot (which are at most 100), unless that one has been waiting for long
+	static constexpr uint16_t ms_manualShotUrgency = 1000;
+
+	using Scheduler = TPumpScheduler<AW_MAX_NUM_PAIRS>;
+	static Scheduler ms_scheduler;
+	Scheduler::Handle m_queueHandle;
 };
 
 } // namespace cz
@@ -0,0 +1,399 @@
+#pragma once
+
+#include "crazygaze/micromuc/Logging.h"
+#include <utility>
+
+namespace cz
+{
+
+/*
+ * Decides which pumps can be on, within a power budget.
+ *
+ * Each pump has a current draw (mA), and pumps are turned on as long as the total is within the budget.
+ * With a shared pump (see AW_PUMP_SHARED), the same is used for the valves, with their flow (L/h) instead.
+ * Pumps waiting for their turn are ordered by urgency (e.g: how far over the threshold the group is), plus how long they
+ * have been waiting (see AW_PUMP_SCHEDULER_URGENCY_WEIGHT). Since all waiting pumps age at the same rate, the order
+ * between two waiting pumps only changes if their urgency changes, so the waiting pumps are kept in a binary heap with
+ * a fixed key per pump, and queuing, dequeuing or changing the urgency are all O(log n).
+ *
+ * Starvation free: A pump that keeps waiting eventually has a higher priority than any pump that starts waiting after
+ * it, and the pump at the top of the heap is never skipped (even if a smaller pump would fit in the budget left).
+ */
+template<int NumSlots>
+class TPumpScheduler
+{
+  public:
+	using SchedulerType = TPumpScheduler<NumSlots>;
+
+	class Handle
+	{
+	  public:
+
+	  	enum State : uint8_t
+		{
+			Inactive,
+			Queued, // Waiting for its turn
+			Active // Pump is allowed to be on
+		};
+
+		Handle& operator=(const Handle&) = delete;
+		Handle(const Handle&) = delete;
+
+		Handle()
+		{
+		}
+
+		Handle(Handle&& other)
+		{
+			moveFrom(std::move(other));
+		}
+
+		Handle& operator=(Handle&& other)
+		{
+			if (this != &other)
+			{
+				moveFrom(std::move(other));
+			}
+			return *this;
+		}
+
+		~Handle()
+		{
+			release();
+		}
+
+		bool isActive() const
+		{
+			return m_state == State::Active;
+		}
+
+		bool isQueued() const
+		{
+			return m_state == State::Queued;
+		}
+
+		bool isActiveOrQueued() const
+		{
+			return m_state==State::Queued || m_state==State::Active ? true : false;
+		}
+
+		/**
+		 * Tries to turn on.
+		 * \param registerInterest If true and it fails, it waits for its turn.
+		 * \param urgency Higher means more urgent. If already waiting, its position is updated.
+		 * \param nowSeconds Current time, to account for how long pumps have been waiting
+		 */
+		bool tryAcquire(bool registerInterest, uint16_t urgency, uint32_t nowSeconds)
+		{
+			if (m_s == nullptr)
+			{
+				return false;
+			}
+
+			if (m_s->tryAcquire(m_id, registerInterest, urgency, nowSeconds))
+			{
+				m_state = State::Active;
+				return true;
+			}
+			else if (m_s->isQueued(m_id))
+			{
+				m_state = State::Queued;
+			}
+
+			return false;
+		}
+
+		void release()
+		{
+			if (m_s && m_state != State::Inactive)
+			{
+				m_s->release(m_id);
+				m_state = State::Inactive;
+			}
+		}
+
+	  protected:
+
+	  	friend SchedulerType;
+
+	  	Handle(SchedulerType& s, uint8_t id)
+			: m_s(&s)
+			, m_id(id)
+		{
+		}
+
+		void moveFrom(Handle&& other)
+		{
+			release();
+			m_s = other.m_s;
+			m_id = other.m_id;
+			m_state = other.m_state;
+			other.m_s = nullptr;
+			other.m_state = State::Inactive;
+		}
+
+		SchedulerType* m_s = nullptr;
+		uint8_t m_id;
+		State m_state = State::Inactive;
+	};
+
+	/**
+	 * \param budget Maximum current in mA
+	 * \param urgencyWeight How many seconds of waiting one point of urgency is worth
+	 */
+	explicit TPumpScheduler(uint32_t budget, int32_t urgencyWeight)
+		: m_budget(budget)
+		, m_urgencyWeight(urgencyWeight)
+	{
+		for (uint8_t& pos : m_pos)
+		{
+			pos = ms_notQueued;
+		}
+	}
+
+	/**
+	 * \param current Current draw of the pump in mA
+	 */
+	Handle createHandle(uint16_t current)
+	{
+		CZ_ASSERT(m_idCounter < NumSlots);
+		m_slots[m_idCounter].current = current;
+		return Handle(*this, m_idCounter++);
+	}
+
+	void setBudget(uint32_t budget)
+	{
+		m_budget = budget;
+	}
+
+	uint32_t getBudget() const
+	{
+		return m_budget;
+	}
+
+	uint32_t getUsedCurrent() const
+	{
+		return m_used;
+	}
+
+	int getNumQueued() const
+	{
+		return m_heapSize;
+	}
+
+	// Number of key comparisons done so far. Used to check the heap operations are O(log n)
+	uint32_t getNumComparisons() const
+	{
+		return m_numComparisons;
+	}
+
+  protected:
+
+	bool isQueued(uint8_t id) const
+	{
+		return m_pos[id] != ms_notQueued;
+	}
+
+	bool tryAcquire(uint8_t id, bool registerInterest, uint16_t urgency, uint32_t nowSeconds)
+	{
+		Slot& slot = m_slots[id];
+		if (slot.active)
+		{
+			return true;
+		}
+
+		if (isQueued(id))
+		{
+			int32_t key = calcKey(urgency, slot.queuedTime);
+			if (key != slot.key)
+			{
+				bool up = key > slot.key;
+				slot.key = key;
+				if (up)
+				{
+					siftUp(m_pos[id]);
+				}
+				else
+				{
+					siftDown(m_pos[id]);
+				}
+			}
+		}
+
+		// If nothing is on, any pump can turn on, even if it's over the budget by itself
+		bool fits = m_used == 0 || (m_used + slot.current) <= m_budget;
+		bool isNext = false;
+		if (fits)
+		{
+			if (m_heapSize == 0 || m_heap[0] == id)
+			{
+				isNext = true;
+			}
+			else if (!isQueued(id))
+			{
+				// Not waiting yet, but it might be more urgent than whoever is waiting
+				Slot tmp = slot;
+				tmp.key = calcKey(urgency, nowSeconds);
+				tmp.seq = m_seqCounter;
+				isNext = isHigher(tmp, m_slots[m_heap[0]]);
+			}
+		}
+
+		if (isNext)
+		{
+			if (isQueued(id))
+			{
+				removeAt(m_pos[id]);
+			}
+			slot.active = true;
+			m_used += slot.current;
+			return true;
+		}
+
+		if (registerInterest && !isQueued(id))
+		{
+			slot.queuedTime = nowSeconds;
+			slot.key = calcKey(urgency, nowSeconds);
+			slot.seq = m_seqCounter++;
+			push(id);
+		}
+
+		return false;
+	}
+
+	void release(uint8_t id)
+	{
+		Slot& slot = m_slots[id];
+		if (isQueued(id))
+		{
+			removeAt(m_pos[id]);
+		}
+
+		if (slot.active)
+		{
+			slot.active = false;
+			m_used -= slot.current;
+		}
+	}
+
+  private:
+
+	struct Slot
+	{
+		// Fixed while waiting: urgency*weight - time it started waiting. Higher goes first.
+		int32_t key = 0;
+		// Tie breaker. Lower (waiting for longer) goes first.
+		uint32_t seq = 0;
+		uint32_t queuedTime = 0;
+		uint16_t current = 0;
+		bool active = false;
+	};
+
+	static constexpr uint8_t ms_notQueued = 0xFF;
+	static_assert(NumSlots < ms_notQueued, "Too many slots");
+
+	int32_t calcKey(uint16_t urgency, uint32_t queuedTime) const
+	{
+		return static_cast<int32_t>(urgency) * m_urgencyWeight - static_cast<int32_t>(queuedTime);
+	}
+
+	bool isHigher(const Slot& a, const Slot& b)
+	{
+		m_numComparisons++;
+		return a.key > b.key || (a.key == b.key && a.seq < b.seq);
+	}
+
+	bool isHigher(int a, int b)
+	{
+		return isHigher(m_slots[m_heap[a]], m_slots[m_heap[b]]);
+	}
+
+	void swap(int a, int b)
+	{
+		std::swap(m_heap[a], m_heap[b]);
+		m_pos[m_heap[a]] = a;
+		m_pos[m_heap[b]] = b;
+	}
+
+	void siftUp(int pos)
+	{
+		while (pos > 0)
+		{
+			int parent = (pos - 1) / 2;
+			if (!isHigher(pos, parent))
+			{
+				break;
+			}
+			swap(pos, parent);
+			pos = parent;
+		}
+	}
+
+	void siftDown(int pos)
+	{
+		while (true)
+		{
+			int best = pos;
+			int left = pos * 2 + 1;
+			int right = left + 1;
+			if (left < m_heapSize && isHigher(left, best))
+			{
+				best = left;
+			}
+			if (right < m_heapSize && isHigher(right, best))
+			{
+				best = right;
+			}
+
+			if (best == pos)
+			{
+				break;
+			}
+			swap(pos, best);
+			pos = best;
+		}
+	}
+
+	void push(uint8_t id)
+	{
+		CZ_ASSERT(m_heapSize < NumSlots);
+		m_heap[m_heapSize] = id;
+		m_pos[id] = m_heapSize;
+		m_heapSize++;
+		siftUp(m_heapSize - 1);
+	}
+
+	void removeAt(int pos)
+	{
+		uint8_t id = m_heap[pos];
+		m_heapSize--;
+		if (pos != m_heapSize)
+		{
+			swap(pos, m_heapSize);
+			// The element moved into pos can need to go either way
+			uint8_t moved = m_heap[pos];
+			siftUp(pos);
+			if (m_pos[moved] == pos)
+			{
+				siftDown(pos);
+			}
+		}
+		m_pos[id] = ms_notQueued;
+	}
+
+	Slot m_slots[NumSlots];
+	// Waiting slots, as a binary heap
+	uint8_t m_heap[NumSlots];
+	// Position of each slot in the heap, or ms_notQueued
+	uint8_t m_pos[NumSlots];
+	int m_heapSize = 0;
+	uint8_t m_idCounter = 0;
+	uint32_t m_seqCounter = 0;
+	uint32_t m_used = 0;
+	uint32_t m_budget;
+	int32_t m_urgencyWeight;
+	uint32_t m_numComparisons = 0;
+};
+
+} // namespace cz
+
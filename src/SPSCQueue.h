@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include <stdint.h>
+
+namespace cz
+{
+
+/**
+ * Lock-free single producer / single consumer queue with a fixed capacity.
+ *
+ * Used to pass messages between the two RP2040 cores. One core only ever calls push, and the other core only ever calls
+ * pop. Doing anything else is undefined behaviour.
+ *
+ * It only relies on atomic loads and stores of the two indexes. That matters on the RP2040 because the Cortex-M0+ doesn't
+ * have atomic read-modify-write instructions, so anything like std::atomic::fetch_add is not lock-free there.
+ *
+ * The indexes are free running and wrap around, which is why Capacity needs to be a power of two.
+ */
+template<typename T, int Capacity>
+class TSPSCQueue
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity needs to be a power of two");
+
+  public:
+
+	/**
+	 * Producer side.
+	 * Returns false if the queue is full, in which case the item is left untouched.
+	 */
+	bool push(T&& item)
+	{
+		const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+		{
+			m_pushFailures++;
+			return false;
+		}
+
+		m_items[tail & (Capacity - 1)] = std::move(item);
+		m_tail.store(tail + 1, std::memory_order_release);
+
+		uint32_t size = tail + 1 - m_head.load(std::memory_order_relaxed);
+		if (size > m_highWaterMark)
+		{
+			m_highWaterMark = size;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Consumer side.
+	 * Returns false if the queue is empty.
+	 */
+	bool pop(T& item)
+	{
+		const uint32_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		item = std::move(m_items[head & (Capacity - 1)]);
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Can be called from either side, but the result is only a snapshot, since the other side might be changing it.
+	 */
+	bool isEmpty() const
+	{
+		return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+	}
+
+	int size() const
+	{
+		return static_cast<int>(m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire));
+	}
+
+	static constexpr int capacity()
+	{
+		return Capacity;
+	}
+
+	/**
+	 * Stats. These are only updated by the producer, so reading them from the consumer side is only approximate.
+	 */
+	uint32_t getHighWaterMark() const { return m_highWaterMark; }
+	uint32_t getPushFailures() const { return m_pushFailures; }
+
+  private:
+
+	T m_items[Capacity];
+	std::atomic<uint32_t> m_head{0};
+	std::atomic<uint32_t> m_tail{0};
+	uint32_t m_highWaterMark = 0;
+	uint32_t m_pushFailures = 0;
+};
+
+} // namespace cz
+
@@ -0,0 +1,127 @@
+#include "SharedPump.h"
+#include "Timer.h"
+#include <crazygaze/micromuc/StringUtils.h>
+#include "crazygaze/micromuc/Profiler.h"
+
+namespace cz
+{
+
+extern Timer gTimer;
+
+SharedPump::SharedPump(DigitalOutputPin& pumpPin)
+	: m_pumpPin(pumpPin)
+{
+	subscribe(Event::Motor);
+	resetStats();
+}
+
+bool SharedPump::initImpl()
+{
+	m_pumpPin.write(PinStatus::LOW);
+	return true;
+}
+
+void SharedPump::turnOn()
+{
+	if (!m_running)
+	{
+		m_running = true;
+		m_pumpPin.write(PinStatus::HIGH);
+		m_startMicros = gTimer.getTotalMicros();
+		m_stats.numStarts++;
+		CZ_LOG(logDefault, Log, F("Shared pump on"));
+	}
+}
+
+void SharedPump::turnOff()
+{
+	if (m_running)
+	{
+		m_running = false;
+		m_pumpPin.write(PinStatus::LOW);
+		uint64_t runMicros = gTimer.getTotalMicros() - m_startMicros;
+		m_stats.runMicros += runMicros;
+		CZ_LOG(logDefault, Log, F("Shared pump off after %ss"), *FloatToString(runMicros / 1000000.0f));
+		logStats();
+	}
+}
+
+float SharedPump::tick(float deltaSeconds)
+{
+	PROFILE_SCOPE(F("SharedPump"));
+
+	if (m_running && m_openValves == 0)
+	{
+		m_stopCountdown -= deltaSeconds;
+		if (m_stopCountdown <= 0)
+		{
+			turnOff();
+		}
+	}
+
+	if (m_running && m_openValves == 0)
+	{
+		return m_stopCountdown;
+	}
+	else
+	{
+		// Nothing to do until the last valve closes, which wakes us up
+		return ms_idleTickWait;
+	}
+}
+
+void SharedPump::onEvent(const Event& evt)
+{
+	switch(evt.type)
+	{
+		case Event::Motor:
+		{
+			const MotorEvent& e = static_cast<const MotorEvent&>(evt);
+			if (e.started)
+			{
+				// Valves open before the pump starts, so the pump never starts against closed valves
+				m_openValves |= 1u << e.index;
+				m_stats.numShots++;
+				turnOn();
+			}
+			else
+			{
+				m_openValves &= ~(1u << e.index);
+				if (m_openValves == 0 && m_running)
+				{
+					m_stopCountdown = AW_PUMP_SHARED_STOP_DELAY;
+					wakeUp();
+				}
+			}
+		}
+		break;
+
+		default:
+		break;
+	}
+}
+
+void SharedPump::logStats() const
+{
+	uint64_t runMicros = m_stats.runMicros + (m_running ? gTimer.getTotalMicros() - m_startMicros : 0);
+	float hours = (gTimer.getTotalMicros() - m_stats.startMicros) / (1000000.0f * 60 * 60);
+	CZ_LOG(logDefault, Log, F("Shared pump: starts=%u, runtime=%ss, shots=%u (%s per start), over %sh")
+		, static_cast<unsigned int>(m_stats.numStarts)
+		, *FloatToString(runMicros / 1000000.0f)
+		, static_cast<unsigned int>(m_stats.numShots)
+		, *FloatToString(m_stats.numStarts ? static_cast<float>(m_stats.numShots) / m_stats.numStarts : 0.0f)
+		, *FloatToString(hours));
+}
+
+void SharedPump::resetStats()
+{
+	m_stats = {};
+	m_stats.startMicros = gTimer.getTotalMicros();
+	if (m_running)
+	{
+		m_startMicros = m_stats.startMicros;
+	}
+}
+
+} // namespace cz
+
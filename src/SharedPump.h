@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Component.h"
+
+namespace cz
+{
+
+/**
+ * Pump shared by all the groups, when using a valve manifold (see AW_PUMP_SHARED)
+ *
+ * Each group's PumpMonitor opens/closes the group's valve as if it was a pump, and this runs the pump while any valve is
+ * open. When the last valve closes, the pump keeps running for AW_PUMP_SHARED_STOP_DELAY seconds, so groups waiting for
+ * their turn open their valves during the same pump run.
+ */
+class SharedPump : public Component
+{
+  public:
+	SharedPump(const SharedPump&) = delete;
+	SharedPump& operator=(const SharedPump&) = delete;
+	explicit SharedPump(DigitalOutputPin& pumpPin);
+
+	bool isRunning() const
+	{
+		return m_running;
+	}
+
+	/**
+	 * Logs the number of pump starts, the pump's total runtime, and the number of valve openings
+	 */
+	void logStats() const;
+	void resetStats();
+
+  protected:
+
+	//
+	// Component interface
+	//
+	virtual const char* getName() const override { return "SharedPump"; }
+	virtual bool initImpl() override;
+	virtual float tick(float deltaSeconds) override;
+	virtual void onEvent(const Event& evt) override;
+
+	void turnOn();
+	void turnOff();
+
+	DigitalOutputPin& m_pumpPin;
+	bool m_running = false;
+	// One bit per group, for the valves that are open
+	uint32_t m_openValves = 0;
+	// Time left until the pump stops, after the last valve closes
+	float m_stopCountdown = 0;
+	uint64_t m_startMicros;
+
+	struct Stats
+	{
+		uint64_t startMicros;
+		uint32_t numStarts;
+		uint32_t numShots;
+		uint64_t runMicros;
+	} m_stats;
+
+	static constexpr float ms_idleTickWait = 60*60;
+
+	static_assert(AW_MAX_NUM_PAIRS <= 32, "m_openValves needs more bits");
+};
+
+} // namespace cz
+
@@ -1,25 +1,38 @@
 #include "SoilMoistureSensor.h"
 #include "Context.h"
+#include "Timer.h"
+#include "utility/ADCCapture.h"
+#include "utility/IntStats.h"
+#include "utility/MCP23017Wrapper.h"
 #include "crazygaze/micromuc/Logging.h"
 #include "crazygaze/micromuc/Profiler.h"
 #include "crazygaze/micromuc/MathUtils.h"
 #include "crazygaze/micromuc/StringUtils.h"
 #include <Arduino.h>
 #include <algorithm>
-#include <crazygaze/micromuc/StringUtils.h>
 
 namespace cz
 {
 
-const char* const RealSoilMoistureSensor::ms_stateNames[3] =
+const char* const RealSoilMoistureSensor::ms_stateNames[4] =
 {
 	"Initializing",
 	"PoweredDown",
-	"QueuedForReading"
+	"QueuedForReading",
 	"Reading"
 };
 
+extern Timer gTimer;
+
 RealSoilMoistureSensor::SemaphoreQueue RealSoilMoistureSensor::ms_semaphoreQueue;
+RealSoilMoistureSensor* RealSoilMoistureSensor::ms_readWaiting[AW_MAX_NUM_PAIRS];
+int RealSoilMoistureSensor::ms_numReadWaiting;
+int RealSoilMoistureSensor::ms_numReading;
+AnalogInputPin::SweepKey RealSoilMoistureSensor::ms_lastReadKey;
+RealSoilMoistureSensor::SweepStats RealSoilMoistureSensor::ms_sweep;
+int RealSoilMoistureSensor::ms_numSamples = AW_MOISTURESENSOR_NUM_SAMPLES;
+uint32_t RealSoilMoistureSensor::ms_sampleRate = AW_MOISTURESENSOR_SAMPLE_RATE;
+bool RealSoilMoistureSensor::ms_adaptiveSampling = AW_MOISTURESENSOR_ADAPTIVE_SAMPLING;
 
 RealSoilMoistureSensor::RealSoilMoistureSensor(uint8_t index, DigitalOutputPin& vinPin, AnalogInputPin& dataPin)
 	: m_index(index)
@@ -30,6 +43,14 @@ RealSoilMoistureSensor::RealSoilMoistureSensor(uint8_t index, DigitalOutputPin&
 	m_name = formatString("soilmoisturesensor%d", m_index);
 	// We only start ticking when we ready a ConfigReady event
 	stopTicking();
+
+	subscribe(Event::ConfigReady);
+	subscribe(Event::ConfigLoad);
+	subscribe(Event::GroupOnOff);
+	subscribe(Event::GroupConfigChanged);
+	subscribe(Event::SoilMoistureSensorReading);
+	subscribe(Event::SoilMoistureSensorCalibrationReading);
+	subscribe(Event::Motor);
 }
 
 const char* RealSoilMoistureSensor::getName() const
@@ -45,6 +66,11 @@ bool RealSoilMoistureSensor::initImpl()
 
 void RealSoilMoistureSensor::tryEnterReadingState()
 {
+	if (!m_sweepPending)
+	{
+		beginSweepReading();
+	}
+
 	if (m_queueHandle.tryAcquire(true))
 	{
 		changeToState(State::Reading);
@@ -61,14 +87,6 @@ float RealSoilMoistureSensor::tick(float deltaSeconds)
 
 	m_timeInState += deltaSeconds;
 	m_timeSinceLastRead += deltaSeconds;
-	GroupData& data = gCtx.data.getGroupData(m_index);
-	bool isSelectedGroup = gCtx.data.getSelectedGroup() == &data ? true : false;
-
-#if AW_FASTER_ITERATION
-	m_nextTickWait = 0.05f;
-#else
-	m_nextTickWait = 0.2f;
-#endif
 
 	switch (m_state)
 	{
@@ -77,13 +95,9 @@ float RealSoilMoistureSensor::tick(float deltaSeconds)
 		break;
 
 	case State::PoweredDown:
-		if (data.isRunning() || data.isInConfigMenu())
+		if (getTimeToNextReading() <= 0)
 		{
-			float samplingInterval = data.isInConfigMenu() ? AW_MOISTURESENSOR_CALIBRATION_SAMPLINGINTERVAL : data.getSamplingInterval();
-			if (m_timeSinceLastRead >= samplingInterval)
-			{
-				tryEnterReadingState();
-			}
+			tryEnterReadingState();
 		}
 		break;
 
@@ -95,14 +109,37 @@ float RealSoilMoistureSensor::tick(float deltaSeconds)
 
 	case State::Reading:
 		{
-			if (m_timeInState >= AW_MOISTURESENSOR_POWERUP_WAIT)
+		#if AW_ADC_CAPTURE_ENABLED
+			if (m_capturing)
+			{
+				gADCCapture.poll();
+				if (m_captureDone)
+				{
+					finishReading(m_captureReading);
+				}
+			}
+			else if (m_timeInState >= AW_MOISTURESENSOR_POWERUP_WAIT && tryAcquireRead())
+			{
+				int pin = prepareCapture();
+				if (pin < 0)
+				{
+					finishReading(readSensor());
+				}
+				else if (gADCCapture.start(pin, ms_numSamples, ms_sampleRate, onCaptureDone, this))
+				{
+					m_capturing = true;
+					m_captureDone = false;
+					m_captureStartMicros = micros();
+				}
+				// else: The ADC is busy (e.g: with a pump's current sense), so try again once that capture is done
+			}
+		#else
+			if (m_timeInState >= AW_MOISTURESENSOR_POWERUP_WAIT && tryAcquireRead())
 			{
 				// Using a function to read the sensor, so we can provide a mock value when using the mock version
-				SensorReading sample = readSensor();
-				data.setMoistureSensorValues(sample);
-				m_timeSinceLastRead = 0;
-				changeToState(State::PoweredDown);
+				finishReading(readSensor());
 			}
+		#endif
 		}
 	break;
 
@@ -110,36 +147,344 @@ float RealSoilMoistureSensor::tick(float deltaSeconds)
 		CZ_UNEXPECTED();
 	}
 
-	return m_nextTickWait;
+	return getTimeToNextStateChange();
 }
 
-SensorReading RealSoilMoistureSensor::readSensor()
+float RealSoilMoistureSensor::getTimeToNextReading() const
 {
-	unsigned long startMicros = micros();
-	constexpr int numSamples = 30;
-	int samples[numSamples];
+	const GroupData& data = gCtx.data.getGroupData(m_index);
+	if (data.isRunning() || data.isInConfigMenu())
+	{
+		float samplingInterval = data.isInConfigMenu() ? AW_MOISTURESENSOR_CALIBRATION_SAMPLINGINTERVAL : data.getSamplingInterval();
+		if (ms_adaptiveSampling && !data.isInConfigMenu())
+		{
+			samplingInterval = m_adaptiveSampling.calcInterval(samplingInterval, data.getThresholdValue());
+		}
+		return samplingInterval - std::min(m_timeSinceLastRead, samplingInterval);
+	}
+	else
+	{
+		// Not sampling at all. We'll be woken up by an event if that changes
+		return ms_idleTickWait;
+	}
+}
+
+float RealSoilMoistureSensor::getTimeToNextStateChange() const
+{
+	switch (m_state)
+	{
+	case State::Initializing:
+		return 0;
+
+	case State::PoweredDown:
+		return getTimeToNextReading();
+
+	case State::QueuedForReading:
+		// We get woken up when another sensor finishes reading, but in case that doesn't happen (e.g: the other group
+		// was stopped and no reading event was raised), we check again once a power up wait would have finished anyway.
+		return AW_MOISTURESENSOR_POWERUP_WAIT;
+
+	case State::Reading:
+		if (m_timeInState < AW_MOISTURESENSOR_POWERUP_WAIT)
+		{
+			return AW_MOISTURESENSOR_POWERUP_WAIT - m_timeInState;
+		}
+	#if AW_ADC_CAPTURE_ENABLED
+		if (m_reading)
+		{
+			// If the ADC was busy (e.g: with a pump's current sense), retry as soon as it's free, since the ADC is kept for
+			// us once that capture ends (see ADCCapture)
+			if (!m_capturing && gADCCapture.isBusy())
+			{
+				return std::max(gADCCapture.getTimeToEnd(), 0.001f);
+			}
+			return getTimeToCaptureEnd();
+		}
+	#endif
+		// Waiting for a read slot. Same as with QueuedForReading, we get woken up when another sensor finishes reading.
+		return AW_MOISTURESENSOR_POWERUP_WAIT;
+
+	default:
+		CZ_UNEXPECTED();
+		return 0;
+	}
+}
+
+void RealSoilMoistureSensor::finishReading(const SensorReading& reading)
+{
+	GroupData& data = gCtx.data.getGroupData(m_index);
+	if (data.isRunning() && !data.isInConfigMenu() && reading.isValid())
+	{
+		m_adaptiveSampling.addReading(gTimer.getTotalMicros(), reading.meanValue);
+	}
+
+	data.setMoistureSensorValues(reading);
+	m_timeSinceLastRead = 0;
+	endSweepReading(true);
+	changeToState(State::PoweredDown);
+}
+
+bool RealSoilMoistureSensor::tryAcquireRead()
+{
+	if (m_reading)
+	{
+		return true;
+	}
+
+	bool waiting = false;
+	for (int i = 0; i < ms_numReadWaiting; i++)
+	{
+		waiting |= ms_readWaiting[i] == this;
+	}
+
+	if (!waiting)
+	{
+		CZ_ASSERT(ms_numReadWaiting < AW_MAX_NUM_PAIRS);
+		ms_readWaiting[ms_numReadWaiting++] = this;
+	}
+
+	if (ms_numReading >= AW_MAX_SIMULTANEOUS_MOISTURESENSORS || pickNextReader() != this)
+	{
+		return false;
+	}
+
+	removeFromReadWaiting();
+	ms_numReading++;
+	m_reading = true;
+	ms_lastReadKey = m_dataPin.getSweepKey();
+
+	// Enable the pin before reading This is necessary so muxed pins work when a single MCU analog pin is muxed with multiple muxes
+	m_dataPin.enable();
+	return true;
+}
+
+void RealSoilMoistureSensor::releaseRead()
+{
+	removeFromReadWaiting();
+
+	if (m_reading)
+	{
+		// Done using the pin, so disable it. This is necessary so muxed pins work when a single MCU analog pin is muxed with multiple muxes
+		// Only if we got to read, since otherwise another sensor might be using the same mux.
+		m_dataPin.disable();
+		m_reading = false;
+		ms_numReading--;
+	}
+}
+
+void RealSoilMoistureSensor::removeFromReadWaiting()
+{
+	for (int i = 0; i < ms_numReadWaiting; i++)
+	{
+		if (ms_readWaiting[i] == this)
+		{
+			// Keeping the order, since it's also the arrival order
+			for (int j = i + 1; j < ms_numReadWaiting; j++)
+			{
+				ms_readWaiting[j - 1] = ms_readWaiting[j];
+			}
+			ms_numReadWaiting--;
+			return;
+		}
+	}
+}
 
-	for(auto&& s : samples)
+RealSoilMoistureSensor* RealSoilMoistureSensor::pickNextReader()
+{
+	RealSoilMoistureSensor* best = nullptr;
+	int bestScore = 0;
+
+	for (int i = 0; i < ms_numReadWaiting; i++)
 	{
-		s = m_dataPin.read();
+		AnalogInputPin::SweepKey key = ms_readWaiting[i]->m_dataPin.getSweepKey();
+		int score;
+		if (key.group && key.group == ms_lastReadKey.group)
+		{
+			// Same group as the last reading (e.g: the mux is still enabled), so continue in order, wrapping around
+			score = (key.order - ms_lastReadKey.order - 1) & 0xFF;
+		}
+		else
+		{
+			// Starting another group. The group of the sensor waiting for the longest goes first, in order.
+			int groupArrival = i;
+			for (int j = 0; j < i; j++)
+			{
+				if (key.group && ms_readWaiting[j]->m_dataPin.getSweepKey().group == key.group)
+				{
+					groupArrival = j;
+					break;
+				}
+			}
+			score = 256 + groupArrival * 256 + (key.group ? (key.order & 0xFF) : 0);
+		}
+
+		if (!best || score < bestScore)
+		{
+			best = ms_readWaiting[i];
+			bestScore = score;
+		}
+	}
+
+	return best;
+}
+
+void RealSoilMoistureSensor::beginSweepReading()
+{
+	if (ms_sweep.numPending == 0)
+	{
+		ms_sweep.startMicros = gTimer.getTotalMicros();
+		ms_sweep.startI2CTransactions = MCP23017WrapperInterface::getNumI2CTransactions();
+		ms_sweep.numReadings = 0;
 	}
 
-	StandardDeviation res = calcStandardDeviation(samples, numSamples);
-	SensorReading sample(static_cast<unsigned int>(res.mean), res.stdDeviation);
+	ms_sweep.numPending++;
+	m_sweepPending = true;
+	m_dataPin.beginSweep();
+}
+
+void RealSoilMoistureSensor::endSweepReading(bool done)
+{
+	if (!m_sweepPending)
+	{
+		return;
+	}
+
+	m_sweepPending = false;
+	m_dataPin.endSweep();
+	ms_sweep.numPending--;
+	if (done)
+	{
+		ms_sweep.numReadings++;
+	}
+
+	if (ms_sweep.numPending == 0 && ms_sweep.numReadings)
+	{
+		uint32_t elapsed = static_cast<uint32_t>(gTimer.getTotalMicros() - ms_sweep.startMicros);
+		ms_sweep.count++;
+		ms_sweep.lastMicros = elapsed;
+		ms_sweep.maxMicros = std::max(ms_sweep.maxMicros, elapsed);
+		ms_sweep.totalMicros += elapsed;
+		ms_sweep.lastI2CTransactions = MCP23017WrapperInterface::getNumI2CTransactions() - ms_sweep.startI2CTransactions;
+		CZ_LOG(logDefault, Verbose, F("SoilMoistureSensor sweep: %d readings in %sms, %u I2C transactions"),
+			ms_sweep.numReadings, *FloatToString(elapsed / 1000.0f),
+			static_cast<unsigned int>(ms_sweep.lastI2CTransactions));
+	}
+}
+
+void RealSoilMoistureSensor::logSweepStats()
+{
+	CZ_LOG(logDefault, Log, F("SoilMoistureSensor sweeps: count=%u, last=%sms (%u I2C transactions), max=%sms, avg=%sms (power budget=%d, simultaneous reads=%d)")
+		, static_cast<unsigned int>(ms_sweep.count)
+		, *FloatToString(ms_sweep.lastMicros / 1000.0f)
+		, static_cast<unsigned int>(ms_sweep.lastI2CTransactions)
+		, *FloatToString(ms_sweep.maxMicros / 1000.0f)
+		, *FloatToString(ms_sweep.count ? ms_sweep.totalMicros / (1000.0f * ms_sweep.count) : 0.0f)
+		, AW_MOISTURESENSOR_POWER_BUDGET
+		, AW_MAX_SIMULTANEOUS_MOISTURESENSORS);
+}
+
+void RealSoilMoistureSensor::resetSweepStats()
+{
+	// Keep track of any sweep in progress
+	int numPending = ms_sweep.numPending;
+	int numReadings = ms_sweep.numReadings;
+	uint64_t startMicros = ms_sweep.startMicros;
+	uint32_t startI2CTransactions = ms_sweep.startI2CTransactions;
+	ms_sweep = {};
+	ms_sweep.numPending = numPending;
+	ms_sweep.numReadings = numReadings;
+	ms_sweep.startMicros = startMicros;
+	ms_sweep.startI2CTransactions = startI2CTransactions;
+}
+
+void RealSoilMoistureSensor::setAdaptiveSampling(bool enabled)
+{
+	ms_adaptiveSampling = enabled;
+	CZ_LOG(logDefault, Log, F("SoilMoistureSensor adaptive sampling %s. Applies after the next reading of each sensor.")
+		, enabled ? "enabled" : "disabled");
+}
+
+void RealSoilMoistureSensor::setCaptureSettings(int numSamples, uint32_t sampleRate)
+{
+	ms_numSamples = std::clamp(numSamples, 2, AW_ADC_CAPTURE_MAX_SAMPLES);
+	ms_sampleRate = std::clamp(sampleRate, 1u, ADCCapture::ms_maxSampleRate);
+	logCaptureSettings();
+}
+
+void RealSoilMoistureSensor::logCaptureSettings()
+{
+	CZ_LOG(logDefault, Log, F("SoilMoistureSensor capture: numSamples=%d, sampleRate=%u, duration=%sms")
+		, ms_numSamples
+		, static_cast<unsigned int>(ms_sampleRate)
+		, *FloatToString(ADCCapture::calcDuration(ms_numSamples, ms_sampleRate) * 1000.0f));
+}
+
+SensorReading RealSoilMoistureSensor::calcReading(int* samples, int numSamples, unsigned long durationMicros)
+{
+	IntStats res = calcTrimmedStats(samples, numSamples, numSamples * AW_MOISTURESENSOR_TRIM_PERCENT / 100);
+	SensorReading sample(static_cast<unsigned int>(res.getMean()), res.getStdDeviation());
 
-	unsigned int long endMicros = micros() - startMicros;
 	CZ_LOG(logDefault, Log, F("SoilMoistureSensor(%d) : duration=%4.2fms Mean=%u, stdDeviation=%4.2f")
 		, m_index
-		, ((float)endMicros/1000.0f)
+		, ((float)durationMicros/1000.0f)
 		, sample.meanValue
 		, sample.standardDeviation);
 
+	return sample;
+}
+
+#if AW_ADC_CAPTURE_ENABLED
+int RealSoilMoistureSensor::prepareCapture()
+{
+	return m_dataPin.beginCapture();
+}
+
+void RealSoilMoistureSensor::onCaptureDone(void* userData, const uint16_t* samples, int numSamples)
+{
+	auto sensor = static_cast<RealSoilMoistureSensor*>(userData);
+
+	int values[AW_ADC_CAPTURE_MAX_SAMPLES];
+	for (int i = 0; i < numSamples; i++)
+	{
+		values[i] = samples[i];
+	}
+
+	sensor->m_captureReading = sensor->calcReading(values, numSamples, micros() - sensor->m_captureStartMicros);
+	sensor->m_captureDone = true;
+}
+
+float RealSoilMoistureSensor::getTimeToCaptureEnd() const
+{
+	float duration = ADCCapture::calcDuration(ms_numSamples, ms_sampleRate);
+	if (m_capturing)
+	{
+		duration -= (micros() - m_captureStartMicros) / 1000000.0f;
+	}
+
+	// Not returning 0, so we don't spin while the capture finishes
+	return std::max(duration, 0.001f);
+}
+#endif
+
+SensorReading RealSoilMoistureSensor::readSensor()
+{
+	unsigned long startMicros = micros();
+	int samples[AW_ADC_CAPTURE_MAX_SAMPLES];
+	const int numSamples = ms_numSamples;
+
+	for (int i = 0; i < numSamples; i++)
+	{
+		samples[i] = m_dataPin.read();
+	}
+
+	SensorReading sample = calcReading(samples, numSamples, micros() - startMicros);
+
 #if 0
 	char buf[2048];
 	buf[0] = 0;
-	for(auto&& s : samples)
+	for (int i = 0; i < numSamples; i++)
 	{
-		strCatPrintf(buf, "%d,", s);
+		strCatPrintf(buf, "%d,", samples[i]);
 	}
 	CZ_LOG(logDefault, Log, F("Samples[%d]={%s}"), numSamples, buf);
 #endif
@@ -163,6 +508,41 @@ void RealSoilMoistureSensor::onEvent(const Event& evt)
 			if (!gCtx.data.getGroupData(m_index).isRunning())
 			{
 				changeToState(State::PoweredDown);
+				// Readings from before the group was stopped don't tell anything about the drying rate once it restarts
+				m_adaptiveSampling.reset();
+			}
+			// Sampling might have been enabled, or the sampling interval changed
+			wakeUp();
+		}
+		break;
+
+		case Event::GroupConfigChanged:
+		{
+			if (static_cast<const GroupConfigChangedEvent&>(evt).index == m_index)
+			{
+				wakeUp();
+			}
+		}
+		break;
+
+		case Event::SoilMoistureSensorReading:
+		case Event::SoilMoistureSensorCalibrationReading:
+		{
+			// Another sensor finished reading, so a slot might be available
+			if (m_state == State::QueuedForReading || (m_state == State::Reading && !m_reading))
+			{
+				wakeUp();
+			}
+		}
+		break;
+
+		case Event::Motor:
+		{
+			// Watering invalidates the drying rate, so we start over with the fixed interval until there are enough readings
+			const MotorEvent& e = static_cast<const MotorEvent&>(evt);
+			if (e.index == m_index && e.started)
+			{
+				m_adaptiveSampling.reset();
 			}
 		}
 		break;
@@ -198,10 +578,20 @@ void RealSoilMoistureSensor::onLeaveState()
 		break;
 
 	case State::Reading:
+	#if AW_ADC_CAPTURE_ENABLED
+		// We might be leaving the state before the capture is done (e.g: group was stopped)
+		if (m_capturing)
+		{
+			if (!m_captureDone)
+			{
+				gADCCapture.cancel();
+			}
+			m_capturing = false;
+		}
+	#endif
 		//  Turn power off
 		m_vinPin.write(PinStatus::LOW);
-		// Done using the pin, so disable it. This is necessary so muxed pins work when a single MCU analog pin is muxed with multiple muxes
-		m_dataPin.disable();
+		releaseRead();
 		break;
 
 	default:
@@ -221,17 +611,26 @@ void RealSoilMoistureSensor::onEnterState()
 	case State::PoweredDown:
 		// Release the semaphore queue handle, so other sensors can get their turn
 		m_queueHandle.release();
+		// If we didn't get to do the reading (e.g: the group was stopped), it doesn't count for the sweep
+		endSweepReading(false);
 		break;
 
 	case State::QueuedForReading:
 		break;
 
 	case State::Reading:
-		// Enable the pin before reading This is necessary so muxed pins work when a single MCU analog pin is muxed with multiple muxes
-		m_dataPin.enable();
+	#if AW_MOISTURESENSOR_POWER_BUDGET == AW_MAX_SIMULTANEOUS_MOISTURESENSORS
+		// Without pipelining, a powered sensor always gets a read slot, so take it right away. This enables the data pin
+		// (and mux) before powering the sensor, as reads always did.
+		if (!tryAcquireRead())
+		{
+			CZ_UNEXPECTED();
+		}
+	#else
+		// The data pin is only enabled once we get a read slot (see tryAcquireRead)
+	#endif
 		//  To take a measurement, we turn the sensor ON, wait a bit, then switch it off
 		m_vinPin.write(PinStatus::HIGH);
-		m_nextTickWait = AW_MOISTURESENSOR_POWERUP_WAIT;
 		break;
 
 	default:
@@ -243,6 +642,13 @@ void RealSoilMoistureSensor::onEnterState()
 // MockSoilMoistureSensor
 //////////////////////////////////////////////////////////////////////////
 
+MockSoilMoistureSensor::MockSoilMoistureSensor(uint8_t index, DigitalOutputPin& vinPin, AnalogInputPin& dataPin)
+	: RealSoilMoistureSensor(index, vinPin, dataPin)
+{
+	subscribe(Event::SetMockSensorValue);
+	subscribe(Event::SetMockSensorErrorStatus);
+}
+
 bool MockSoilMoistureSensor::initImpl()
 {
 	if (!RealSoilMoistureSensor::initImpl())
@@ -253,13 +659,45 @@ bool MockSoilMoistureSensor::initImpl()
 	m_mock.dryValue = random(540,590);
 	m_mock.waterValue = random(160, 210);
 	m_mock.targetValue = m_mock.currentValue = random(m_mock.waterValue, m_mock.dryValue);
+	m_mock.targetValueOnRate = random(50, 150) / 10.0f;
+	m_mock.currentValueChaseRate = random(40, 100) / 10.0f;
+	m_mock.chaseDelayOnMotor = random(3, 30);
+
+	CZ_LOG(logDefault, Log, F("MockSoilMoistureSensor(%d) : onRate=%s/s, chaseRate=%s/s, chaseDelay=%ss")
+		, m_index
+		, *FloatToString(m_mock.targetValueOnRate)
+		, *FloatToString(m_mock.currentValueChaseRate)
+		, *FloatToString(m_mock.chaseDelayOnMotor));
 	return true;
 }
 
 float MockSoilMoistureSensor::tick(float deltaSeconds)
 {
+	updateSimulation(deltaSeconds);
+
+	if (m_mock.motorIsOn != m_mock.pendingMotorIsOn)
+	{
+		m_mock.motorIsOn = m_mock.pendingMotorIsOn;
+
+		// Every time the motor turns on the water takes a while to reach the sensor, unless it's still on its way from
+		// a previous shot.
+		if (m_mock.motorIsOn && m_mock.currentValueChaseDelay <= 0)
+		{
+			m_mock.currentValueChaseDelay = m_mock.chaseDelayOnMotor;
+		}
+	}
+
 	float tickResult = RealSoilMoistureSensor::tick(deltaSeconds);
+	if (m_mock.motorIsOn || m_mock.currentValueChaseDelay > 0)
+	{
+		tickResult = std::min(tickResult, ms_simulationTickWait);
+	}
 
+	return tickResult;
+}
+
+void MockSoilMoistureSensor::updateSimulation(float deltaSeconds)
+{
 	// Note: The target value needs to be updated before the current value, so that once the motor is off and things stabilize
 	// the current value and target value will match at the end fo the tick
 	if (m_mock.motorIsOn)
@@ -292,9 +730,7 @@ float MockSoilMoistureSensor::tick(float deltaSeconds)
 		m_mock.currentValue -= m_mock.currentValueChaseRate * deltaSeconds;
 		m_mock.currentValue = std::max(m_mock.currentValue, m_mock.targetValue);
 	}
-
-	return tickResult;
-} 
+}
 
 void MockSoilMoistureSensor::onEvent(const Event& evt)
 {
@@ -305,14 +741,9 @@ void MockSoilMoistureSensor::onEvent(const Event& evt)
 		const MotorEvent& e = static_cast<const MotorEvent&>(evt);
 		if (e.index == m_index)
 		{
-			m_mock.motorIsOn = e.started;
-
-			// If things are stable (current value caught up with target value), and there is no currently active delay,
-			// then start a delay
-			if (isNearlyEqual(m_mock.currentValue, m_mock.targetValue) && m_mock.currentValueChaseDelay<=0)
-			{
-				m_mock.currentValueChaseDelay = ms_delayChaseValue;
-			}
+			// Applied on the next tick, once the simulation is up to date
+			m_mock.pendingMotorIsOn = e.started;
+			wakeUp();
 		}
 	}
 	else if (evt.type == Event::SetMockSensorValue)
@@ -334,6 +765,34 @@ void MockSoilMoistureSensor::onEvent(const Event& evt)
 	}
 }
 
+#if AW_ADC_CAPTURE_ENABLED
+int MockSoilMoistureSensor::prepareCapture()
+{
+#if AW_ADC_CAPTURE_SIMULATED
+	// Feed the simulated ADC with what the sensor would be reading, so the reading goes through the same code as
+	// the real sensor
+	if (m_mock.status == SensorReading::Status::Valid)
+	{
+		gADCCapture.setSimulatedInput(m_mock.currentValue, 3.0f);
+	}
+	else if (m_mock.status == SensorReading::Status::NoSensor)
+	{
+		gADCCapture.setSimulatedInput(random(260, 530), AW_MOISTURESENSOR_ACCEPTABLE_STANDARD_DEVIATION * 2);
+	}
+	else
+	{
+		gADCCapture.setSimulatedInput(random(10, AW_MOISTURESENSOR_ACCEPTABLE_MIN_VALUE - 1), 5.0f);
+	}
+
+	// Any ADC pin will do, since it's simulated
+	return 26;
+#else
+	// Not simulating the ADC, so use readSensor to get the mock values
+	return -1;
+#endif
+}
+#endif
+
 SensorReading MockSoilMoistureSensor::readSensor()
 {
 	if (m_mock.status == SensorReading::Status::Valid)
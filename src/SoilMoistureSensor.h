@@ -4,6 +4,7 @@
 #include <assert.h>
 #include "Component.h"
 #include "SemaphoreQueue.h"
+#include "utility/AdaptiveSampling.h"
 
 namespace cz
 {
@@ -33,6 +34,25 @@ class RealSoilMoistureSensor : public Component
 	RealSoilMoistureSensor(const RealSoilMoistureSensor&) = delete;
 	const RealSoilMoistureSensor& operator=(const RealSoilMoistureSensor&) = delete;
 
+	/**
+	 * Sets how many samples to take per reading, and at what rate (samples per second). Applies to all sensors.
+	 * The sample rate is only used when the reading is done with an ADC capture.
+	 */
+	static void setCaptureSettings(int numSamples, uint32_t sampleRate);
+	static void logCaptureSettings();
+
+	/**
+	 * A sweep is the time from a sensor needing a reading while no other sensor did, until all the pending readings are
+	 * done (e.g: all sensors being read once when they share the same sampling interval).
+	 */
+	static void logSweepStats();
+	static void resetSweepStats();
+
+	/**
+	 * Enables or disables adaptive sampling for all sensors (see AW_MOISTURESENSOR_ADAPTIVE_SAMPLING).
+	 */
+	static void setAdaptiveSampling(bool enabled);
+
 
 	//
 	// Component interface
@@ -48,11 +68,11 @@ class RealSoilMoistureSensor : public Component
 	{
 		Initializing,
 		PoweredDown,
-		QueuedForReading, // Sensor needs a reading, and it's waiting its turn, to respect AW_MAX_SIMULTANEOUS_MOISTURESENSORS
-		Reading // Sensor is powering up to perform a read
+		QueuedForReading, // Sensor needs a reading, and it's waiting its turn to power up, to respect AW_MOISTURESENSOR_POWER_BUDGET
+		Reading // Sensor is powering up, waiting its turn to read (AW_MAX_SIMULTANEOUS_MOISTURESENSORS), or reading
 	};
 
-	static const char* const ms_stateNames[3];
+	static const char* const ms_stateNames[4];
 
 	String m_name;
 
@@ -63,7 +83,6 @@ class RealSoilMoistureSensor : public Component
 	float m_timeSinceLastRead = __FLT_MAX__/2;
 
 	float m_timeInState = 0;
-	float m_nextTickWait = 0;
 	State m_state = State::Initializing;
 	uint8_t m_index;
 
@@ -71,12 +90,86 @@ class RealSoilMoistureSensor : public Component
 	DigitalOutputPin& m_vinPin;
 	AnalogInputPin& m_dataPin;
 
-	using SemaphoreQueue = TSemaphoreQueue<uint8_t, AW_MAX_NUM_PAIRS, AW_MAX_SIMULTANEOUS_MOISTURESENSORS>;
+	// Sensors that can be powered
+	using SemaphoreQueue = TSemaphoreQueue<uint8_t, AW_MAX_NUM_PAIRS, AW_MOISTURESENSOR_POWER_BUDGET>;
 	static SemaphoreQueue ms_semaphoreQueue;
 	SemaphoreQueue::Handle m_queueHandle;
 
+	//
+	// Read slots (AW_MAX_SIMULTANEOUS_MOISTURESENSORS). Only sensors that are powered up try to acquire one.
+	// Instead of first come first served, the next sensor to read is the one that continues the current sweep
+	// (see AnalogInputPin::SweepKey). E.g: Other channels of the mux that is already enabled, in Gray code order.
+	//
+	static RealSoilMoistureSensor* ms_readWaiting[AW_MAX_NUM_PAIRS];
+	static int ms_numReadWaiting;
+	static int ms_numReading;
+	static AnalogInputPin::SweepKey ms_lastReadKey;
+	bool m_reading = false;
+
+	// Tries to acquire a read slot, and enables the data pin if successful
+	bool tryAcquireRead();
+	void releaseRead();
+	void removeFromReadWaiting();
+	static RealSoilMoistureSensor* pickNextReader();
+
+	struct SweepStats
+	{
+		int numPending; // Sensors with a pending reading
+		int numReadings; // Readings done in the current sweep
+		uint64_t startMicros;
+		uint32_t startI2CTransactions;
+		uint32_t lastI2CTransactions;
+		uint32_t count;
+		uint32_t lastMicros;
+		uint32_t maxMicros;
+		uint64_t totalMicros;
+	};
+	static SweepStats ms_sweep;
+	bool m_sweepPending = false;
+	void beginSweepReading();
+	void endSweepReading(bool done);
+
+	// Readings since the last watering
+	AdaptiveSampling m_adaptiveSampling;
+	static bool ms_adaptiveSampling;
+
 	virtual SensorReading readSensor();
 
+	static int ms_numSamples;
+	static uint32_t ms_sampleRate;
+
+	// Calculates the reading from the samples and logs it. The samples are sorted in place.
+	SensorReading calcReading(int* samples, int numSamples, unsigned long durationMicros);
+
+	// Sets the reading and moves on to the PoweredDown state
+	void finishReading(const SensorReading& reading);
+
+#if AW_ADC_CAPTURE_ENABLED
+	/**
+	 * Prepares the sensor for an ADC capture.
+	 * Returns the MCU pin to capture from, or -1 if ADC captures can't be used, in which case readSensor is used.
+	 */
+	virtual int prepareCapture();
+
+	static void onCaptureDone(void* userData, const uint16_t* samples, int numSamples);
+
+	// Time in seconds until the current capture is expected to finish
+	float getTimeToCaptureEnd() const;
+
+	bool m_capturing = false;
+	bool m_captureDone = false;
+	unsigned long m_captureStartMicros = 0;
+	SensorReading m_captureReading;
+#endif
+
+	// How long to wait when the group is not running. Anything that changes that raises events that wake us up.
+	static constexpr float ms_idleTickWait = 60*60;
+
+	// Time in seconds until the sensor is due for a reading, as per the sampling interval in use
+	float getTimeToNextReading() const;
+	// Time in seconds until the state machine needs to tick again
+	float getTimeToNextStateChange() const;
+
 	void changeToState(State newState);
 	void onLeaveState();
 	void onEnterState();
@@ -86,7 +179,7 @@ class RealSoilMoistureSensor : public Component
 class MockSoilMoistureSensor : public RealSoilMoistureSensor
 {
 public:
-	using RealSoilMoistureSensor::RealSoilMoistureSensor;
+	MockSoilMoistureSensor(uint8_t index, DigitalOutputPin& vinPin, AnalogInputPin& dataPin);
 
 	//
 	// Component interface
@@ -98,8 +191,16 @@ public:
 protected:
 
 	virtual SensorReading readSensor() override;
+#if AW_ADC_CAPTURE_ENABLED
+	virtual int prepareCapture() override;
+#endif
+
+	void updateSimulation(float deltaSeconds);
+
 
-	static constexpr int ms_delayChaseValue = 5;
+	// While the motor is on or there is an active chase delay the simulation needs to be updated at this rate to behave
+	// close enough to the real thing. Otherwise the sensor only ticks as required by the sampling interval.
+	static constexpr float ms_simulationTickWait = 0.2f;
 
 	struct
 	{
@@ -125,8 +226,14 @@ protected:
 		// This is useful to simulate the fact that once the motor is turned on, it might take a bit for the soil
 		// to soak the water and for the sensor to react.
 		float currentValueChaseDelay = 0;
+		// What currentValueChaseDelay is set to when the motor turns on. Each sensor gets a random value, together with
+		// the rates, so each group responds differently to watering, like real soil would.
+		float chaseDelayOnMotor = 5;
 
 		bool motorIsOn = false;
+		// Motor state as per the last Motor event. This is only applied to the simulation in the next tick, so
+		// whatever time passed until then is simulated with the previous motor state.
+		bool pendingMotorIsOn = false;
 	} m_mock;
 };
 
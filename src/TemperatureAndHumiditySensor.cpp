@@ -2,31 +2,24 @@
 #include "Context.h"
 #include "crazygaze/micromuc/Logging.h"
 #include "crazygaze/micromuc/Profiler.h"
-#include "crazygaze/micromuc/MathUtils.h"
-#include "crazygaze/micromuc/StringUtils.h"
 #include <Arduino.h>
-#include <algorithm>
 
 namespace cz
 {
 
-const char* const TemperatureAndHumiditySensor::ms_stateNames[3] =
-{
-	"Initializing",
-	"Idle",
-	"Reading"
-};
-
 TemperatureAndHumiditySensor::TemperatureAndHumiditySensor()
 {
 	// We only start ticking once we receive a ConfigReady event
 	stopTicking();
+	subscribe(Event::ConfigReady);
 }
 
 bool TemperatureAndHumiditySensor::initImpl()
 {
 	CZ_LOG(logDefault, Log, "Initializing the temperature/humidity sensor");
-	onEnterState();
+#if !AW_MOCK_COMPONENTS
+	m_reader.begin();
+#endif
 	return true;
 }
 
@@ -34,123 +27,49 @@ float TemperatureAndHumiditySensor::tick(float deltaSeconds)
 {
 	PROFILE_SCOPE(F("TemperatureAndHumiditySensor"));
 
-	m_timeInState += deltaSeconds;
 	m_timeSinceLastRead += deltaSeconds;
 
-	m_nextTickWait = 1.0f;
-
-	switch (m_state)
+#if AW_MOCK_COMPONENTS
+	if (m_timeSinceLastRead < AW_THSENSOR_SAMPLINGINTERVAL)
 	{
-	case State::Initializing:
-		changeToState(State::Idle);
-		break;
-
-	case State::Idle:
-		if (m_timeSinceLastRead >= AW_THSENSOR_SAMPLINGINTERVAL)
-		{
-			changeToState(State::Reading);
-		}
-		break;
-
-	case State::Reading:
-		{
-			CZ_LOG(logDefault, Verbose, F("TemperatureAndHumiditySensor: Starting read"))
-			float temperature, humidity;
-			readSensor(temperature, humidity);
-			gCtx.data.setTemperatureReading(temperature);
-			gCtx.data.setHumidityReading(humidity);
-
-			if (isnan(temperature))
-			{
-				CZ_LOG(logDefault, Verbose, F("TemperatureAndHumiditySensor: Error reading temperature"));
-				resetSensor();
-			}
-			else if (isnan(humidity))
-			{
-				CZ_LOG(logDefault, Verbose, F("TemperatureAndHumiditySensor: Error reading humidity"));
-				resetSensor();
-			}
-
-			m_timeSinceLastRead = 0;
-			changeToState(State::Idle);
-		}
-		break;
-
-	default:
-		CZ_UNEXPECTED();
+		return AW_THSENSOR_SAMPLINGINTERVAL - m_timeSinceLastRead;
 	}
 
-	return m_nextTickWait;
-}
-
-void TemperatureAndHumiditySensor::readSensor(float& temperature, float& humidity)
-{
-#if AW_MOCK_COMPONENTS
 	static int counter = 0;
 	counter = (counter+1) % 10;
-	temperature = 20.0f + counter / 10.0f;
-	humidity = 50.0f + counter / 10.0f;
+	m_temperature = 20.0f + counter / 10.0f;
+	m_humidity = 50.0f + counter / 10.0f;
+	publishReadings();
+	m_timeSinceLastRead = 0;
+	return AW_THSENSOR_SAMPLINGINTERVAL;
 #else
-	temperature = m_htu.readTemperature();
-	humidity = m_htu.readHumidity();
-#endif
-}
+	float wait = m_reader.tick(deltaSeconds);
 
-void TemperatureAndHumiditySensor::changeToState(State newState)
-{
-	CZ_LOG(logDefault, Verbose, F("TemperatureAndHumiditySensor::%s: %ssec %s->%s")
-		, __FUNCTION__
-		, *FloatToString(m_timeInState)
-		, ms_stateNames[(int)m_state]
-		, ms_stateNames[(int)newState]);
-
-	onLeaveState();
-	m_state = newState;
-	m_timeInState = 0.0f;
-	onEnterState();
-}
-
-void TemperatureAndHumiditySensor::resetSensor()
-{
-	m_htu.reset();
-}
-
-void TemperatureAndHumiditySensor::onLeaveState()
-{
-	switch(m_state)
+	if (m_reader.fetchReading(m_temperature, m_humidity))
 	{
-	case State::Initializing:
-		break;
-
-	case State::Idle:
-		break;
-
-	case State::Reading:
-		break;
+		publishReadings();
+		m_timeSinceLastRead = 0;
 	}
 
-}
-
-void TemperatureAndHumiditySensor::onEnterState()
-{
-	switch (m_state)
+	if (m_reader.getState() == HTU21DFReader::State::Idle)
 	{
-	case State::Initializing:
-		if (!m_htu.begin())
+		if (m_timeSinceLastRead < AW_THSENSOR_SAMPLINGINTERVAL)
 		{
-			CZ_LOG(logDefault, Error, F("Error initializing temperature/humidity sensor"));
+			return AW_THSENSOR_SAMPLINGINTERVAL - m_timeSinceLastRead;
 		}
-		break;
 
-	case State::Idle:
-		break;
+		CZ_LOG(logDefault, Verbose, F("TemperatureAndHumiditySensor: Starting read"))
+		wait = m_reader.startReading();
+	}
 
-	case State::Reading:
-		break;
+	return wait;
+#endif
+}
 
-	default:
-		CZ_UNEXPECTED();
-	}
+void TemperatureAndHumiditySensor::publishReadings()
+{
+	gCtx.data.setTemperatureReading(m_temperature);
+	gCtx.data.setHumidityReading(m_humidity);
 }
 
 void TemperatureAndHumiditySensor::onEvent(const Event& evt)
@@ -3,13 +3,15 @@
 #include <Arduino.h>
 #include <assert.h>
 #include "Component.h"
-#include <Adafruit_HTU21DF.h>
+#include "utility/HTU21DFReader.h"
 
 namespace cz
 {
 
 /**
  * Temperature and Humidity sensor
+ *
+ * The sensor is driven without blocking (see HTU21DFReader).
  */
 class TemperatureAndHumiditySensor : public Component
 {
@@ -26,28 +28,15 @@ class TemperatureAndHumiditySensor : public Component
 	virtual float tick(float deltaSeconds) override;
 	virtual void onEvent(const Event& evt) override;
 
-	enum class State : uint8_t
-	{
-		Initializing,
-		Idle,
-		Reading
-	};
+	void publishReadings();
 
-	static const char* const ms_stateNames[3];
-
-	virtual void readSensor(float& temperature, float& humidity);
-	virtual void resetSensor();
-
-	void changeToState(State newState);
-	void onLeaveState();
-	void onEnterState();
-
-	float m_timeInState;
-	float m_nextTickWait = 0;
+	float m_temperature = NAN;
+	float m_humidity = NAN;
 	// Setting to a high value, so we do a reading at powerup
 	float m_timeSinceLastRead = __FLT_MAX__/2;
-	State m_state = State::Initializing;
-	Adafruit_HTU21DF m_htu;
+#if !AW_MOCK_COMPONENTS
+	HTU21DFReader m_reader;
+#endif
 };
 
 } // namespace cz
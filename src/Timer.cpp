@@ -9,9 +9,12 @@ void Timer::update()
 	unsigned long nowMicros = micros();
 	// NOTE: If using subtraction, there is no need to handle wrap around
 	// See: https://arduino.stackexchange.com/questions/33572/arduino-countdown-without-using-delay/33577#33577
-	unsigned long elapsedMicros = nowMicros - m_previousMicros;
-	m_deltaSeconds = elapsedMicros / 1000000.0f;
+	unsigned long realElapsedMicros = nowMicros - m_previousMicros;
 	m_previousMicros = nowMicros;
+	m_realTotalMicros += realElapsedMicros;
+
+	uint64_t elapsedMicros = static_cast<uint64_t>(realElapsedMicros) * AW_MOCK_TIME_SCALE;
+	m_deltaSeconds = elapsedMicros / 1000000.0f;
 	m_totalMicros += elapsedMicros;
 
 	//
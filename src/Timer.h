@@ -56,11 +56,21 @@ class Timer
 		return m_totalMicros / 1000000.0f;
 	}
 
+	/**
+	 * Total running time in real microseconds.
+	 * This is only different from getTotalMicros if time is being accelerated (see AW_MOCK_TIME_SCALE)
+	 */
+	uint64_t getRealTotalMicros() const
+	{
+		return m_realTotalMicros;
+	}
+
   private:
 	unsigned long m_previousMicros = 0;
 	float m_deltaSeconds = 0.0f;
 
 	uint64_t m_totalMicros = 0;
+	uint64_t m_realTotalMicros = 0;
 
 	RunningTime m_runningTime;
 };
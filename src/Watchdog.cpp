@@ -26,6 +26,7 @@ namespace cz
 Watchdog::Watchdog()
 	: Component(ListInsertionPosition::Front)
 {
+	subscribe(Event::WifiStatus);
 }
 
 Watchdog::~Watchdog()
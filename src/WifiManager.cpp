@@ -1,13 +1,30 @@
 #include "WifiManager.h"
 #include <Arduino.h>
 #include "Watchdog.h"
+#include "LowPowerIdle.h"
 #include <crazygaze/micromuc/Profiler.h>
 
+#if AW_NETWORK_ON_CORE1
+	#include <hardware/sync.h>
+	#include "Core1Log.h"
+#endif
+
 CZ_DEFINE_LOG_CATEGORY(logWifi);
 
 namespace cz
 {
 
+// For code that runs on core 1 when AW_NETWORK_ON_CORE1 is set, since CZ_LOG can't be used there (see Core1Log.h)
+#if AW_NETWORK_ON_CORE1
+	namespace
+	{
+		Core1Log gCore1Log;
+	}
+	#define WIFI_LOG(verbosity, fmt, ...) gCore1Log.log(LogVerbosity::verbosity, fmt, ##__VA_ARGS__)
+#else
+	#define WIFI_LOG(verbosity, fmt, ...) CZ_LOG(logWifi, verbosity, fmt, ##__VA_ARGS__)
+#endif
+
 #if AW_WIFI_ENABLED
 	WifiManager gWifiManager;
 #endif
@@ -21,6 +38,7 @@ WifiManager::WifiManager()
 	ms_instance = this;
 	// We only start ticking when we ready a ConfigReady event
 	stopTicking();
+	subscribe(Event::ConfigReady);
 }
 
 WifiManager::~WifiManager()
@@ -35,7 +53,12 @@ WifiManager* WifiManager::getInstance()
 
 bool WifiManager::isConnected() const
 {
+#if AW_NETWORK_ON_CORE1
+	// Core 1 owns the WiFi driver, so core 0 uses the status it last saw
+	return m_connected.load(std::memory_order_acquire);
+#else
 	return WiFi.status() == WL_CONNECTED;
+#endif
 }
 
 bool WifiManager::willReconnect() const
@@ -44,26 +67,138 @@ bool WifiManager::willReconnect() const
 }
 
 void WifiManager::disconnect(bool reconnect)
+{
+#if AW_NETWORK_ON_CORE1
+	if (!m_core1Requests.push({reconnect}))
+	{
+		CZ_LOG(logWifi, Error, "Core 1 request queue full. Ignoring disconnect.");
+		return;
+	}
+	// Wake up core 1 in case it's waiting for work
+	__sev();
+#else
+	doDisconnect(reconnect);
+#endif
+}
+
+void WifiManager::doDisconnect(bool reconnect)
 {
 	m_reconnect = reconnect;
 	WiFi.disconnect();
-	Component::raiseEvent(WifiStatusEvent(false));
+#if AW_NETWORK_ON_CORE1
+	m_connected.store(false, std::memory_order_release);
+#endif
+	notifyStatus(false);
+}
+
+void WifiManager::notifyConnecting()
+{
+#if AW_NETWORK_ON_CORE1
+	if (!m_core1Notifications.push({Notification::Type::Connecting, false}))
+	{
+		WIFI_LOG(Error, "Core 0 notification queue full. Dropping WifiConnecting.");
+	}
+	__sev();
+#else
+	Component::raiseEvent(WifiConnectingEvent());
+#endif
+}
+
+void WifiManager::notifyStatus(bool connected)
+{
+#if AW_NETWORK_ON_CORE1
+	if (!m_core1Notifications.push({Notification::Type::Status, connected}))
+	{
+		WIFI_LOG(Error, "Core 0 notification queue full. Dropping WifiStatus.");
+	}
+	__sev();
+#else
+	Component::raiseEvent(WifiStatusEvent(connected));
+#endif
 }
 
 bool WifiManager::initImpl()
 {
+#if AW_NETWORK_ON_CORE1
+	// m_multi is only touched by core 1 (see core1Tick)
+	#if AW_LOWPOWER_IDLE_ENABLED
+	gLowPowerIdle.addWakeSource(*this);
+	#endif
+#else
 	m_multi.addAP(WIFI_SSID, WIFI_PASSWORD);
+#endif
+
 	return true;
 }
 
+bool WifiManager::hasPendingInput()
+{
+#if AW_NETWORK_ON_CORE1
+	return !m_core1Notifications.isEmpty();
+#else
+	return false;
+#endif
+}
+
 float WifiManager::tick(float deltaSeconds)
 {
 	PROFILE_SCOPE(F("WifiManager"));
 
+#if AW_NETWORK_ON_CORE1
+	// We only get here after a ConfigReady and after all components were initialized, so core 1 can start
+	if (!m_core1Started.load(std::memory_order_relaxed))
+	{
+		CZ_LOG(logWifi, Log, "Starting the network on core 1");
+		m_core1Started.store(true, std::memory_order_release);
+	}
+
+	AW_FLUSH_CORE1_LOG(gCore1Log, logWifi);
+
+	Notification notification;
+	while (m_core1Notifications.pop(notification))
+	{
+		if (notification.type == Notification::Type::Connecting)
+		{
+			Component::raiseEvent(WifiConnectingEvent());
+		}
+		else
+		{
+			Component::raiseEvent(WifiStatusEvent(notification.connected));
+		}
+	}
+#else
 	checkConnection(true);
+#endif
+
 	return 0.25f;
 }
 
+#if AW_NETWORK_ON_CORE1
+float WifiManager::core1Tick(float deltaSeconds)
+{
+	if (!m_core1Initialized)
+	{
+		m_multi.addAP(WIFI_SSID, WIFI_PASSWORD);
+		m_core1Initialized = true;
+	}
+
+	DisconnectRequest request;
+	while (m_core1Requests.pop(request))
+	{
+		doDisconnect(request.reconnect);
+	}
+
+	checkConnection(true);
+	m_connected.store(WiFi.status() == WL_CONNECTED, std::memory_order_release);
+	return 0.25f;
+}
+
+void WifiManager::core1Disconnect(bool reconnect)
+{
+	doDisconnect(reconnect);
+}
+#endif
+
 void WifiManager::onEvent(const Event& evt)
 {
 	switch(evt.type)
@@ -107,18 +242,23 @@ void WifiManager::checkConnection(bool systemResetOnFail)
 	{
 		if (numTries == 0)
 		{
-			Component::raiseEvent(WifiConnectingEvent());
+			notifyConnecting();
 		}
 
 		numTries++;
-		CZ_LOG(logWifi, Log, "Connecting to %s (Attempt %d out of %d)", WIFI_SSID, numTries, AW_WIFI_CONNECT_NUM_TRIES);
+		WIFI_LOG(Log, "Connecting to %s (Attempt %d out of %d)", WIFI_SSID, numTries, AW_WIFI_CONNECT_NUM_TRIES);
 
-		// Disable the watchdog ONLY for as long as we need
 		uint8_t runRes;
+#if AW_NETWORK_ON_CORE1
+		// Core 0 keeps feeding the watchdog while we block here, so no need to pause it
+		runRes = m_multi.run();
+#else
+		// Disable the watchdog ONLY for as long as we need
 		{
 			WatchdogPauseScope wtdPause;
 			runRes = m_multi.run();
 		}
+#endif
 
 		if (runRes == WL_CONNECTED)
 		{
@@ -129,17 +269,22 @@ void WifiManager::checkConnection(bool systemResetOnFail)
 
 		if (numTries >= AW_WIFI_CONNECT_NUM_TRIES)
 		{
-			Component::raiseEvent(WifiStatusEvent(false));
+			notifyStatus(false);
 			if constexpr (AW_WIFI_REBOOT_CONNECT_FAILURE == 0)
 			{
-				CZ_LOG(logWifi, Error, "Can't connect to any WiFi.");
+				WIFI_LOG(Error, "Can't connect to any WiFi.");
 				m_reconnect = false;
 			}
 			else
 			{
 				// Restart for Portenta as something is very wrong
-				CZ_LOG(logWifi, Error, "Can't connect to any WiFi. Resetting");
+				WIFI_LOG(Error, "Can't connect to any WiFi. Resetting");
+			#if AW_NETWORK_ON_CORE1
+				// Give core 0 a chance to log it
+				delay(1000);
+			#else
 				cz::LogOutput::flush();
+			#endif
 				delay(1000);
 				rp2040.reboot();
 			}
@@ -147,26 +292,27 @@ void WifiManager::checkConnection(bool systemResetOnFail)
 		}
 		else
 		{
-			CZ_LOG(logWifi, Error, "Can't connect to any WiFi. Retrying.");
+			WIFI_LOG(Error, "Can't connect to any WiFi. Retrying.");
 			delay(200);
 		}
 	}
 
-	Component::raiseEvent(WifiStatusEvent(true));
+	notifyStatus(true);
 }
 
 void WifiManager::printWifiStatus()
 {
-	// print the SSID of the network you're attached to:
-	CZ_LOG(logWifi, Log, "Connected to SSID: %s", WiFi.SSID().c_str());
+	// print the SSID of the network you're attached to.
+	// WIFI_SSID is the only one added to m_multi, and this avoids creating Strings, which can run on core 1
+	WIFI_LOG(Log, "Connected to SSID: %s", WIFI_SSID);
 
 	// print your board's IP address:
 	IPAddress ip = WiFi.localIP();
-	CZ_LOG(logWifi, Log, "Local IP Address: %s", ip.toString().c_str());
+	WIFI_LOG(Log, "Local IP Address: %d.%d.%d.%d", ip[0], ip[1], ip[2], ip[3]);
 
 	// print the received signal strength:
 	int rssi = WiFi.RSSI();
-	CZ_LOG(logWifi, Log, "Signal strenght (RSSI): %d dBm", rssi)
+	WIFI_LOG(Log, "Signal strenght (RSSI): %d dBm", rssi);
 }
 
 } // namespace cz
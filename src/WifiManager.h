@@ -1,7 +1,9 @@
 #pragma once
 
 #include "Component.h"
+#include "SPSCQueue.h"
 #include <WiFi.h>
+#include <atomic>
 
 namespace cz
 {
@@ -27,6 +29,24 @@ class WifiManager : public Component
 	 * @param reconnect If true, it will attemp a reconnect when ticking the component
 	*/
 	void disconnect(bool reconnect);
+
+#if AW_NETWORK_ON_CORE1
+	/**
+	 * Core 1 side. These should only be called from core 1.
+	 * core1Tick does the (blocking) connection work, and returns how many seconds until it should be called again.
+	 */
+	float core1Tick(float deltaSeconds);
+	void core1Disconnect(bool reconnect);
+
+	/**
+	 * Core 1 shouldn't start doing any work until this returns true
+	 */
+	bool isCore1Started() const
+	{
+		return m_core1Started.load(std::memory_order_acquire);
+	}
+#endif
+
   private:
 
 	static WifiManager* ms_instance;
@@ -37,12 +57,48 @@ class WifiManager : public Component
 	virtual float tick(float deltaSeconds) override;
 	virtual void onEvent(const Event& evt) override;
 	virtual bool processCommand(const Command& cmd) override;
+	virtual bool hasPendingInput() override;
 
 	void checkConnection(bool systemResetOnFail);
+	void doDisconnect(bool reconnect);
 	void printWifiStatus();
 
+	// These raise the respective events, or if the network runs on core 1, queue them for core 0 to raise
+	void notifyConnecting();
+	void notifyStatus(bool connected);
+
 	WiFiMulti m_multi;
 	bool m_reconnect = true;
+
+#if AW_NETWORK_ON_CORE1
+	// core 0 -> core 1
+	struct DisconnectRequest
+	{
+		bool reconnect;
+	};
+	TSPSCQueue<DisconnectRequest, 4> m_core1Requests;
+
+	// core 1 -> core 0
+	struct Notification
+	{
+		enum class Type : uint8_t
+		{
+			Connecting,
+			Status
+		};
+		Type type;
+		bool connected;
+	};
+	TSPSCQueue<Notification, AW_NETWORK_QUEUE_SIZE> m_core1Notifications;
+
+	// Only used by core 1
+	bool m_core1Initialized = false;
+
+	// Written by core 1 only
+	std::atomic<bool> m_connected{false};
+	// Written by core 0 only
+	std::atomic<bool> m_core1Started{false};
+#endif
 };
 
 } // namespace cz
@@ -1,6 +1,7 @@
 
 #include <Arduino.h>
 #include <crazygaze/micromuc/Logging.h>
+#include "../SharedPump.h"
 
 #if AW_WIFI_ENABLED
 	static_assert(AW_WIFI_CONNECT_NUM_TRIES >= 1, "Invalid value for AW_WIFI_CONNECT_NUM_TRIES");
@@ -25,6 +26,11 @@ void Setup::createPumpMonitors()
 	{
 		m_pumpMonitors[i] = gSetup->createPumpMonitor(i);
 	}
+
+#if AW_PUMP_SHARED
+	CZ_LOG(logDefault, Log, "Creating shared pump component");
+	m_sharedPump = new SharedPump(*gSetup->createSharedPumpPin());
+#endif
 }
 
 } // namespace cz
@@ -106,6 +106,14 @@ If 1, it enabled the CommandConsole component
 	#endif
 #endif
 
+/*
+When running a batch of commands (batch_begin ... batch_end), how many of the failed commands are kept to show in the
+batch report.
+*/
+#ifndef AW_COMMAND_CONSOLE_BATCH_MAX_FAILURES
+	#define AW_COMMAND_CONSOLE_BATCH_MAX_FAILURES 8
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //                               PROFILER OPTIONS
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -125,6 +133,121 @@ If 1, it enables profiling code
 	#error CZ_PROFILER needs AW_COMMAND_CONSOLE_ENABLED
 #endif
 
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                               COMPONENT SCHEDULER OPTIONS
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*
+Maximum number of components that can exist at the same time.
+Components are kept in a fixed size deadline heap, so this needs to account for all the soil moisture sensors and pumps
+(one per pair), plus all the other components (UI, MQTT, Wifi, Watchdog, etc).
+*/
+#ifndef AW_MAX_NUM_COMPONENTS
+	#define AW_MAX_NUM_COMPONENTS (AW_MAX_NUM_PAIRS*2 + 16)
+#endif
+
+/*
+Maximum number of event subscriptions (one per component per event type it's interested in).
+Soil moisture sensors and pumps take the bulk of it, and components that forward all events (e.g: GraphicalUI) take one
+per event type.
+*/
+#ifndef AW_MAX_NUM_EVENT_SUBSCRIPTIONS
+	#define AW_MAX_NUM_EVENT_SUBSCRIPTIONS (AW_MAX_NUM_PAIRS*16 + 64)
+#endif
+
+/*
+Maximum number of commands registered with Component::setCommandTable, across all components
+*/
+#ifndef AW_MAX_NUM_TABLE_COMMANDS
+	#define AW_MAX_NUM_TABLE_COMMANDS 64
+#endif
+
+/*
+Maximum number of dependencies declared with Component::dependsOn, across all components
+*/
+#ifndef AW_MAX_NUM_COMPONENT_DEPENDENCIES
+	#define AW_MAX_NUM_COMPONENT_DEPENDENCIES 16
+#endif
+
+/*
+How long (in seconds) Component::initAll waits for components still initializing (initImpl returning false), before
+giving up and rebooting.
+*/
+#ifndef AW_COMPONENT_INIT_TIMEOUT
+	#define AW_COMPONENT_INIT_TIMEOUT 10
+#endif
+
+/*
+How long (in milliseconds) Component::initAll waits before trying again to initialize components that are still
+initializing.
+*/
+#ifndef AW_COMPONENT_INIT_RETRY_INTERVAL
+	#define AW_COMPONENT_INIT_RETRY_INTERVAL 50
+#endif
+
+/*
+If set to 1, Component::raiseEvent doesn't dispatch events right away. Instead, events are copied to a fixed size queue
+and dispatched by Component::tickAll once all the due components ticked. Events raised while dispatching are queued as
+well, so event handlers never run nested inside other handlers or inside ticks.
+*/
+#ifndef AW_EVENT_DEFERRED_DISPATCH
+	#define AW_EVENT_DEFERRED_DISPATCH 0
+#endif
+
+#if AW_EVENT_DEFERRED_DISPATCH
+	// How many events can be waiting for dispatch
+	#ifndef AW_EVENT_QUEUE_SIZE
+		#define AW_EVENT_QUEUE_SIZE 16
+	#endif
+
+	/*
+	What to do when raising an event with the queue full
+		AW_EVENT_QUEUE_OVERFLOW_DISPATCH - Log a warning and dispatch the event right away (as if deferred dispatch was disabled)
+		AW_EVENT_QUEUE_OVERFLOW_DROP - Log an error and drop the event
+		AW_EVENT_QUEUE_OVERFLOW_ASSERT - Assert. Useful during development to find the right queue size.
+	*/
+	#define AW_EVENT_QUEUE_OVERFLOW_DISPATCH 0
+	#define AW_EVENT_QUEUE_OVERFLOW_DROP 1
+	#define AW_EVENT_QUEUE_OVERFLOW_ASSERT 2
+	#ifndef AW_EVENT_QUEUE_OVERFLOW_POLICY
+		#define AW_EVENT_QUEUE_OVERFLOW_POLICY AW_EVENT_QUEUE_OVERFLOW_DISPATCH
+	#endif
+#endif
+
+/*
+If set to 1, the main loop sleeps (WFE) until the next component deadline instead of busy waiting with delay(), and
+wakes up early if there is touch, serial (command console) or network input to process.
+*/
+#ifndef AW_LOWPOWER_IDLE_ENABLED
+	#define AW_LOWPOWER_IDLE_ENABLED 0
+#endif
+
+/*
+Maximum number of components that can register themselves as wake sources for the low power idle
+*/
+#ifndef AW_LOWPOWER_IDLE_MAX_WAKESOURCES
+	#define AW_LOWPOWER_IDLE_MAX_WAKESOURCES 4
+#endif
+
+/*
+If set to 1, the scheduler keeps per component stats: CPU time spent in tick() and onEvent(), number of events handled,
+and the highest heap usage seen after the component ran. See the "componentstats" console command.
+Off by default, since every tick and every onEvent call pays for two micros() calls and a heap usage query
+(rp2040.getUsedHeap, which goes through mallinfo). The native_sim environment turns it on.
+*/
+#ifndef AW_COMPONENT_STATS_ENABLED
+	#define AW_COMPONENT_STATS_ENABLED 0
+#endif
+
+/*
+Default tick budget in milliseconds. A tick() taking longer than this counts as an overrun (see the "tickstats" console
+command). Components can change their own budget with Component::setTickBudget, or with the "tickbudget" command.
+Only used if AW_COMPONENT_STATS_ENABLED is set.
+*/
+#ifndef AW_COMPONENT_TICK_BUDGET_MS
+	#define AW_COMPONENT_TICK_BUDGET_MS 50
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //                               NETWORK OPTIONS
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -207,6 +330,56 @@ Note that this works in conjunction with AQ_MQTT_PUBLISHINTERVAL, which dictates
 	#define AW_MQTT_MOISTURESENSOR_MININTERVAL AW_MQTT_PUBLISHINTERVAL
 #endif
 
+/*
+If set to 1, the blocking network work (WiFi connection, MQTT connection, publishing, subscribing and receiving) runs on
+core 1 of the RP2040, from setup1()/loop1().
+WifiManager and MQTTCache are still components ticked by core 0 (so the rest of the code uses them the same way), but they
+only talk to their core 1 side through lock-free queues. This means a slow broker or a long WiFi reconnect doesn't stall
+the pumps, sensors or the UI, and PumpMonitor doesn't need to turn the motors off when WiFi starts connecting.
+*/
+#ifndef AW_NETWORK_ON_CORE1
+	#define AW_NETWORK_ON_CORE1 0
+#endif
+
+#if AW_NETWORK_ON_CORE1 && !AW_WIFI_ENABLED
+	#error AW_NETWORK_ON_CORE1 requires AW_WIFI_ENABLED
+#endif
+
+/*
+Size of each of the queues used to talk to core 1 when AW_NETWORK_ON_CORE1 is set.
+Needs to be a power of two.
+*/
+#ifndef AW_NETWORK_QUEUE_SIZE
+	#define AW_NETWORK_QUEUE_SIZE 16
+#endif
+
+/*
+Log lines from core 1 are queued for core 0 to log (see Core1Log.h). This is how many lines can be queued (needs to be a
+power of two), and the maximum size of each line. Lines that don't fit in the queue are dropped.
+*/
+#ifndef AW_NETWORK_LOG_QUEUE_SIZE
+	#define AW_NETWORK_LOG_QUEUE_SIZE 16
+#endif
+
+#ifndef AW_NETWORK_LOG_LINE_SIZE
+	#define AW_NETWORK_LOG_LINE_SIZE 128
+#endif
+
+/*
+How many received MQTT messages core 1 can hand over to core 0 at once. Each one takes a buffer the size of the MQTT
+receive buffer. If they are all in use, core 1 waits for core 0 to process one. Needs to be a power of two.
+*/
+#ifndef AW_NETWORK_MESSAGE_SLOTS
+	#define AW_NETWORK_MESSAGE_SLOTS 2
+#endif
+
+/*
+Maximum size of a MQTT topic (including the null terminator) passed between the cores
+*/
+#ifndef AW_MQTT_MAX_TOPIC_SIZE
+	#define AW_MQTT_MAX_TOPIC_SIZE 128
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //                               WATCHDOG COMPONENT OPTIONS
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -342,14 +515,31 @@ would be cumbersome since the user will probably want big intervals between samp
 #endif
 
 /*
-How many sensors can be active at one given time
+How many sensors can be read at one given time
 Depending on the board design, sensor readings might be sharing a single arduino pin through a mux, in which case this needs to be set to 1.
-Also, if the sensors are using pins to supply power, having this set to 1 can lower peak power usage.
 */
 #ifndef AW_MAX_SIMULTANEOUS_MOISTURESENSORS
 	#define AW_MAX_SIMULTANEOUS_MOISTURESENSORS 1
 #endif
 
+/*
+How many sensors can be powered at one given time.
+Sensors are powered through their own pins, so while a sensor is being read, the next ones can already be powering up
+(see AW_MOISTURESENSOR_POWERUP_WAIT). This makes a sweep through all the sensors considerably faster.
+Setting it to the number of sensors per board lets all the due sensors of a board warm up together, and then be read back
+to back (in Gray code order of the mux channels) with the mux enabled only once.
+The default (AW_MAX_SIMULTANEOUS_MOISTURESENSORS) disables pipelining, and reads the sensors one after the other as
+before, with the lowest peak power usage. Pipelining changes when the muxes are enabled, and hasn't been verified on
+the boards yet, so it's opt-in.
+*/
+#ifndef AW_MOISTURESENSOR_POWER_BUDGET
+	#define AW_MOISTURESENSOR_POWER_BUDGET AW_MAX_SIMULTANEOUS_MOISTURESENSORS
+#endif
+
+#if AW_MOISTURESENSOR_POWER_BUDGET < AW_MAX_SIMULTANEOUS_MOISTURESENSORS
+	#error AW_MOISTURESENSOR_POWER_BUDGET needs to be >= AW_MAX_SIMULTANEOUS_MOISTURESENSORS
+#endif
+
 /*
 Maximum sampling interval allowed in seconds (integer number)
 This also limits the the maximum value the UI will allow and show.
@@ -382,6 +572,159 @@ Any value below this, and we consider that the sensor is not getting power
 	#define AW_MOISTURESENSOR_ACCEPTABLE_MIN_VALUE 100
 #endif
 
+/*
+How many ADC samples to take per sensor reading, and at what rate (samples per second).
+More samples or a lower rate give a more stable reading, at the cost of the sensor staying powered for longer.
+These are the defaults. They can be changed at runtime with the "adccapture" console command.
+*/
+#ifndef AW_MOISTURESENSOR_NUM_SAMPLES
+	#define AW_MOISTURESENSOR_NUM_SAMPLES 30
+#endif
+
+#ifndef AW_MOISTURESENSOR_SAMPLE_RATE
+	#define AW_MOISTURESENSOR_SAMPLE_RATE 10000
+#endif
+
+/*
+Percentage of the lowest and highest samples of a reading to ignore (trimmed mean), to reject spikes.
+E.g: With 30 samples and 10%, the 3 lowest and 3 highest samples are ignored.
+*/
+#ifndef AW_MOISTURESENSOR_TRIM_PERCENT
+	#define AW_MOISTURESENSOR_TRIM_PERCENT 10
+#endif
+
+/*
+If set to 1, sensor readings use the ADC in free running mode with DMA (see ADCCapture), so the loop is not blocked
+while the samples are taken.
+Only pins that can tell what MCU pin to capture from (see AnalogInputPin::beginCapture) use it. Other pins fall back to
+analogRead.
+Only the simulated version (AW_ADC_CAPTURE_SIMULATED) has been tested, so it's only on by default for mock builds. The
+RP2040 free running ADC/DMA capture hasn't run on a board yet.
+*/
+#ifndef AW_ADC_CAPTURE_ENABLED
+	#define AW_ADC_CAPTURE_ENABLED AW_MOCK_COMPONENTS
+#endif
+
+/*
+Maximum number of samples a single ADC capture can take.
+*/
+#ifndef AW_ADC_CAPTURE_MAX_SAMPLES
+	#define AW_ADC_CAPTURE_MAX_SAMPLES 64
+#endif
+
+/*
+If set to 1, the ADC capture doesn't touch the hardware, and instead generates samples with a configurable mean and
+noise. The mock sensors use this, so the sample count/rate and noise trade-offs can be checked without a board.
+*/
+#ifndef AW_ADC_CAPTURE_SIMULATED
+	#define AW_ADC_CAPTURE_SIMULATED AW_MOCK_COMPONENTS
+#endif
+
+/*
+How long (in milliseconds) high priority ADC captures (pump current sense) hold off after a sensor failed to get the ADC,
+waiting for the sensor to retry (see ADCCapture).
+*/
+#ifndef AW_ADC_CAPTURE_YIELD_MS
+	#define AW_ADC_CAPTURE_YIELD_MS 50
+#endif
+
+#if AW_MOISTURESENSOR_NUM_SAMPLES > AW_ADC_CAPTURE_MAX_SAMPLES
+	#error AW_MOISTURESENSOR_NUM_SAMPLES needs to be <= AW_ADC_CAPTURE_MAX_SAMPLES
+#endif
+
+/*
+If set to 1, sensors use adaptive sampling instead of the group's fixed sampling interval.
+The drying rate is estimated from the last readings since the last watering, and the next reading is scheduled to land
+just before the predicted threshold crossing. Far from the threshold this means fewer readings, and close to it, more.
+This only sets the default. It can be changed at runtime with the "adaptivesampling" console command.
+*/
+#ifndef AW_MOISTURESENSOR_ADAPTIVE_SAMPLING
+	#define AW_MOISTURESENSOR_ADAPTIVE_SAMPLING 0
+#endif
+
+/*
+Bounds of the adaptive sampling interval, as a factor of the group's sampling interval.
+*/
+#ifndef AW_MOISTURESENSOR_ADAPTIVE_MIN_FACTOR
+	#define AW_MOISTURESENSOR_ADAPTIVE_MIN_FACTOR 0.25f
+#endif
+
+#ifndef AW_MOISTURESENSOR_ADAPTIVE_MAX_FACTOR
+	#define AW_MOISTURESENSOR_ADAPTIVE_MAX_FACTOR 4.0f
+#endif
+
+/*
+What fraction of the predicted time to the threshold crossing to wait for the next reading.
+The prediction gets more accurate as the reading gets closer to the threshold, so intervals shrink as it approaches.
+*/
+#ifndef AW_MOISTURESENSOR_ADAPTIVE_MARGIN
+	#define AW_MOISTURESENSOR_ADAPTIVE_MARGIN 0.75f
+#endif
+
+/*
+How many of the last readings to use to estimate the drying rate (least squares fit).
+*/
+#ifndef AW_MOISTURESENSOR_ADAPTIVE_NUM_POINTS
+	#define AW_MOISTURESENSOR_ADAPTIVE_NUM_POINTS 4
+#endif
+
+/*
+Sensor drift detection (see SensorDriftEstimator).
+How far (as a percentage of the air/water range) the readings need to go past the air/water values to be considered
+drift.
+*/
+#ifndef AW_SENSOR_DRIFT_TOLERANCE_PERCENT
+	#define AW_SENSOR_DRIFT_TOLERANCE_PERCENT 10
+#endif
+
+/*
+Readings needed before drift is checked.
+*/
+#ifndef AW_SENSOR_DRIFT_MIN_READINGS
+	#define AW_SENSOR_DRIFT_MIN_READINGS 50
+#endif
+
+/*
+How many readings it takes the envelope of the readings to forget an old minimum/maximum (roughly).
+*/
+#ifndef AW_SENSOR_DRIFT_ENVELOPE_READINGS
+	#define AW_SENSOR_DRIFT_ENVELOPE_READINGS 500
+#endif
+
+/*
+How many readings after a shot to look for the saturation level (lowest reading).
+*/
+#ifndef AW_SENSOR_DRIFT_SATURATION_READINGS
+	#define AW_SENSOR_DRIFT_SATURATION_READINGS 5
+#endif
+
+/*
+How many shots in a row without an effect on the readings to flag the sensor as not responding.
+*/
+#ifndef AW_SENSOR_DRIFT_MAX_SHOTS_WITHOUT_RESPONSE
+	#define AW_SENSOR_DRIFT_MAX_SHOTS_WITHOUT_RESPONSE 3
+#endif
+
+/*
+If set to 1, proposed air/water values are applied and saved as soon as drift is detected. The threshold is kept at
+the same percentage.
+If set to 0, they are only logged, and can be applied with the "driftapply" console command.
+*/
+#ifndef AW_SENSOR_DRIFT_AUTO_APPLY
+	#define AW_SENSOR_DRIFT_AUTO_APPLY 0
+#endif
+
+/*
+Temperature compensation of the sensor values (see TemperatureCompensation).
+It's configured per group, and disabled by default (slopes of 0). The slopes can be set with the "tempcomp" console
+command, or learned from the readings and applied with "tempcomp_learn".
+This is how many pairs of readings (with a temperature change in between) a side of the reference temperature needs
+before its slope is learned.
+*/
+#ifndef AW_TEMPERATURE_COMPENSATION_MIN_SAMPLES
+	#define AW_TEMPERATURE_COMPENSATION_MIN_SAMPLES 20
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //                               WATER PUMP COMPONENT OPTIONS
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -389,11 +732,124 @@ Any value below this, and we consider that the sensor is not getting power
 /*
 How many motors can be active at one given time
 This is to control the peak power usage, depending on what power supply it is being used
+Only used to calculate the default AW_PUMP_CURRENT_BUDGET_MA.
 */
 #ifndef AW_MAX_SIMULTANEOUS_PUMPS
 	#define AW_MAX_SIMULTANEOUS_PUMPS 2
 #endif
 
+/*
+Current draw (in mA) of a pump, unless specified when creating the PumpMonitor
+*/
+#ifndef AW_PUMP_DEFAULT_CURRENT_MA
+	#define AW_PUMP_DEFAULT_CURRENT_MA 500
+#endif
+
+/*
+Maximum current (in mA) all the pumps that are on can draw together. Pumps wait for their turn until there is enough
+budget left.
+If no pump is on, a pump is allowed to turn on even if it alone is over the budget.
+*/
+#ifndef AW_PUMP_CURRENT_BUDGET_MA
+	#define AW_PUMP_CURRENT_BUDGET_MA (AW_MAX_SIMULTANEOUS_PUMPS*AW_PUMP_DEFAULT_CURRENT_MA)
+#endif
+
+/*
+When pumps are waiting for their turn, the more urgent goes first. Urgency is how far above the threshold the sensor
+reads, in % of the sensor's air/water range (manual shots are the most urgent).
+This is how many seconds of waiting one point of urgency is worth. E.g: With 10, a group that is 1% further above the
+threshold goes ahead of a group that started waiting up to 10 seconds earlier.
+Since waiting time always counts, no pump waits forever.
+*/
+#ifndef AW_PUMP_SCHEDULER_URGENCY_WEIGHT
+	#define AW_PUMP_SCHEDULER_URGENCY_WEIGHT 10
+#endif
+
+/*
+If set to 1, pump motors driven directly from MCU pins can use PWMMotorPin, which ramps the motor up/down instead of
+switching it hard on and off. This avoids the inrush spikes that can brown out the board.
+Boards need to create the motor pins as PWMMotorPin for this to have any effect.
+Only the simulated version (AW_PUMP_PWM_SIMULATED) has been tested. The RP2040 DMA/PWM ramps haven't run on a board yet.
+*/
+#ifndef AW_PUMP_PWM
+	#define AW_PUMP_PWM 0
+#endif
+
+/*
+PWM frequency (in Hz) of the motor pins. Above 20kHz the motors don't whine.
+*/
+#ifndef AW_PUMP_PWM_FREQUENCY
+	#define AW_PUMP_PWM_FREQUENCY 20000
+#endif
+
+/*
+How long (in milliseconds) motors take to go from off to full speed, and from full speed to off.
+*/
+#ifndef AW_PUMP_PWM_RAMP_UP_MS
+	#define AW_PUMP_PWM_RAMP_UP_MS 500
+#endif
+
+#ifndef AW_PUMP_PWM_RAMP_DOWN_MS
+	#define AW_PUMP_PWM_RAMP_DOWN_MS 200
+#endif
+
+/*
+Shape of the ramps (see PWMMotorPin::Curve):
+0 - Linear
+1 - SCurve: Slow at the start and end of the ramp
+2 - Quadratic: Slow at the start. Most of the current increase happens once the motor is already spinning
+*/
+#ifndef AW_PUMP_PWM_RAMP_CURVE
+	#define AW_PUMP_PWM_RAMP_CURVE 1
+#endif
+
+/*
+Duty cycle (in %) ramps start from when turning on. Below this, motors don't spin and just get hot.
+*/
+#ifndef AW_PUMP_PWM_MIN_DUTY
+	#define AW_PUMP_PWM_MIN_DUTY 30
+#endif
+
+/*
+Time (in milliseconds) between each change in duty cycle while ramping.
+*/
+#ifndef AW_PUMP_PWM_RAMP_STEP_MS
+	#define AW_PUMP_PWM_RAMP_STEP_MS 10
+#endif
+#if AW_PUMP_PWM_RAMP_STEP_MS<1 || AW_PUMP_PWM_RAMP_STEP_MS>100
+	#error AW_PUMP_PWM_RAMP_STEP_MS needs to be between 1 and 100
+#endif
+
+/*
+Minimum time (in milliseconds) between motor starts. When several pumps turn on at the same time, their ramps are
+delayed so the start up currents don't add up. The delay (and the ramps) are part of the shot duration.
+*/
+#ifndef AW_PUMP_PWM_STAGGER_MS
+	#define AW_PUMP_PWM_STAGGER_MS 250
+#endif
+
+/*
+PWM slice used as the clock of the ramps. It doesn't drive any pin, but the pins of this slice can't be used for PWM.
+*/
+#ifndef AW_PUMP_PWM_STEP_CLOCK_SLICE
+	#define AW_PUMP_PWM_STEP_CLOCK_SLICE 7
+#endif
+
+/*
+If set to 1, PWMMotorPin doesn't use the hardware, and records the duty cycle timeline instead (see the "pumppwm"
+console command).
+*/
+#ifndef AW_PUMP_PWM_SIMULATED
+	#define AW_PUMP_PWM_SIMULATED AW_MOCK_COMPONENTS
+#endif
+
+/*
+How many duty cycle changes the simulated pins remember
+*/
+#ifndef AW_PUMP_PWM_TIMELINE_SIZE
+	#define AW_PUMP_PWM_TIMELINE_SIZE 128
+#endif
+
 /*
 Maximum allowed value for water shots (in seconds). Needs to be an integer number
 */
@@ -411,6 +867,64 @@ One-off shot duration in seconds. Need to be an integer number
 	#error Invalid values
 #endif
 
+/*
+Maximum allowed value for volumetric water shots (in millilitres). See AW_SHOT_DEFAULT_VOLUME
+*/
+#ifndef AW_SHOT_MAX_VOLUME
+	#define AW_SHOT_MAX_VOLUME 5000
+#endif
+
+/*
+Shot volume in millilitres, for groups with a flow meter (see PumpMonitor::setFlowMeter).
+The motor is turned off once the volume is delivered, or after AW_SHOT_MAX_DURATION seconds if the flow is too low.
+0 means shots are time based (see AW_SHOT_DEFAULT_DURATION), even for groups with a flow meter.
+Only manual shots and the Fixed controller (see AW_PUMP_CONTROLLER) use it. The predictive controllers size shots in
+seconds.
+*/
+#ifndef AW_SHOT_DEFAULT_VOLUME
+	#define AW_SHOT_DEFAULT_VOLUME 0
+#endif
+#if AW_SHOT_DEFAULT_VOLUME>AW_SHOT_MAX_VOLUME
+	#error Invalid values
+#endif
+
+/*
+Flow meter pulses per litre. E.g: About 450 for a YF-S201
+*/
+#ifndef AW_FLOW_METER_PULSES_PER_LITRE
+	#define AW_FLOW_METER_PULSES_PER_LITRE 450
+#endif
+
+/*
+How much water (in millilitres) is delivered before a group's total volume is saved again. Saving after every shot would
+wear out the flash and stall the main loop, so a reset can lose up to this much of the total.
+*/
+#ifndef AW_FLOW_METER_SAVE_VOLUME
+	#define AW_FLOW_METER_SAVE_VOLUME 1000
+#endif
+
+/*
+How often (in seconds) the flow meter is checked while the motor is on, to turn the motor off once the shot volume is
+delivered.
+*/
+#ifndef AW_FLOW_METER_POLL_INTERVAL
+	#define AW_FLOW_METER_POLL_INTERVAL 0.1f
+#endif
+
+/*
+If set to 1, flow meters don't use the hardware, and generate pulses at a realistic rate instead (see FlowMeter)
+*/
+#ifndef AW_FLOW_METER_SIMULATED
+	#define AW_FLOW_METER_SIMULATED AW_MOCK_COMPONENTS
+#endif
+
+/*
+Size (in litres) of the simulated water tank. The simulated flow goes down as the tank empties.
+*/
+#ifndef AW_FLOW_METER_SIMULATED_TANK_LITRES
+	#define AW_FLOW_METER_SIMULATED_TANK_LITRES 20
+#endif
+
 /*
 Minimum time required to pass (in seconds) before a group turns the motor ON again.
 This is useful so a group doesn't keep giving motor shots before the sensor reacts properly. It forces a minimum wait
@@ -421,6 +935,169 @@ This does NOT affect manual shots.
 	#define AW_MINIMUM_TIME_BETWEEN_MOTOR_ON (AW_SHOT_DEFAULT_DURATION*2.0f)
 #endif
 
+/*
+How automated shots are decided (see PumpController):
+0 - Fixed: Shots of the group's shot duration, while the sensor reads above the threshold
+1 - Predictive: Each group learns how much the moisture changes per second of pumping, and how long the sensor takes to
+	show it. Shots are sized to bring the moisture a bit below the threshold, followed by a soak wait long enough for
+	the sensor to show the result before deciding again.
+2 - Pulse and soak: Same as Predictive, but shots are limited to the group's shot duration, so the water is given in
+	pulses with soak waits in between. Better for soils that drain fast or don't absorb water quickly.
+This is the default. It can be changed at runtime with the "pumpcontroller" console command.
+*/
+#ifndef AW_PUMP_CONTROLLER
+	#define AW_PUMP_CONTROLLER 0
+#endif
+
+/*
+How far below the threshold the predictive controller aims for, as a percentage of the sensor's air/water range
+*/
+#ifndef AW_PUMP_TARGET_PERCENT
+	#define AW_PUMP_TARGET_PERCENT 5
+#endif
+
+/*
+How much a new shot response changes the learned model (0..1). Higher values adapt faster but are noisier.
+*/
+#ifndef AW_PUMP_MODEL_LEARNING_RATE
+	#define AW_PUMP_MODEL_LEARNING_RATE 0.3f
+#endif
+
+/*
+Maximum time in seconds after a shot to keep looking for its effect on the sensor.
+*/
+#ifndef AW_PUMP_MODEL_MAX_RESPONSE_TIME
+	#define AW_PUMP_MODEL_MAX_RESPONSE_TIME (10*60)
+#endif
+
+/*
+A reading needs to be this much drier (in sensor units) than the lowest reading after a shot, to consider the soil is
+drying again and the shot's full effect was seen.
+*/
+#ifndef AW_PUMP_MODEL_NOISE
+	#define AW_PUMP_MODEL_NOISE 3
+#endif
+
+/*
+Pump current sensing (see PumpCurrentDetector)
+Pumps with a current sense input (see PumpMonitor::setCurrentSense) have their current sampled with the ADC while the
+motor is on, to detect stalls, dry runs and open circuits. On a fault, the pump is turned off, a PumpFault event is
+raised, and automated shots are suspended until a manual shot is done.
+Requires AW_ADC_CAPTURE_ENABLED.
+
+Sample rate (Hz) and number of samples per capture. Each capture is processed as soon as it's done, so the number of
+samples divided by the sample rate is how often the detector runs.
+
+The ADC is shared with the soil moisture sensors (see ADCCapture), so the current is not monitored all the time:
+- Each sensor reading while a pump runs leaves a gap of about one sensor capture (AW_MOISTURESENSOR_NUM_SAMPLES at
+  AW_MOISTURESENSOR_SAMPLE_RATE), and the sensor reading is delayed by up to one pump capture.
+- Only one pump is monitored at a time. Pumps that turn on while another one is monitored are not, until that one
+  turns off. After taking over, the detector skips AW_PUMP_CURRENT_INRUSH_MS again.
+The detector's timings (inrush, confirmation) count captured samples only, so gaps make detection slower, never
+faster.
+*/
+#ifndef AW_PUMP_CURRENT_SENSE_RATE
+	#define AW_PUMP_CURRENT_SENSE_RATE 4000
+#endif
+#ifndef AW_PUMP_CURRENT_SENSE_NUM_SAMPLES
+	#define AW_PUMP_CURRENT_SENSE_NUM_SAMPLES 64
+#endif
+#if AW_PUMP_CURRENT_SENSE_NUM_SAMPLES > AW_ADC_CAPTURE_MAX_SAMPLES
+	#error AW_PUMP_CURRENT_SENSE_NUM_SAMPLES needs to be <= AW_ADC_CAPTURE_MAX_SAMPLES
+#endif
+
+/*
+How many mA each ADC unit is. Depends on the shunt resistor and amplifier used.
+E.g: A 0.1 ohm shunt with a x20 amplifier gives 2V per A, and with a 10 bits ADC at 3.3V, that's 1.6mA per unit.
+*/
+#ifndef AW_PUMP_CURRENT_SENSE_MA_PER_UNIT
+	#define AW_PUMP_CURRENT_SENSE_MA_PER_UNIT 1.6f
+#endif
+
+/*
+Current sense detection timings, in milliseconds:
+- INRUSH: Time after the motor turns on during which the current is ignored
+- FILTER: Time constant of the low pass filter, to remove the motor's ripple and noise
+- CONFIRM: How long the current needs to stay out of range before reporting a fault
+*/
+#ifndef AW_PUMP_CURRENT_INRUSH_MS
+	#define AW_PUMP_CURRENT_INRUSH_MS 150
+#endif
+#ifndef AW_PUMP_CURRENT_FILTER_MS
+	#define AW_PUMP_CURRENT_FILTER_MS 10
+#endif
+#ifndef AW_PUMP_CURRENT_CONFIRM_MS
+	#define AW_PUMP_CURRENT_CONFIRM_MS 100
+#endif
+
+/*
+Current ranges for the faults, as a percentage of the pump's nominal current.
+Above STALL is a stall. Below DRYRUN is a dry run, and below OPEN is an open circuit.
+*/
+#ifndef AW_PUMP_CURRENT_STALL_PERCENT
+	#define AW_PUMP_CURRENT_STALL_PERCENT 180
+#endif
+#ifndef AW_PUMP_CURRENT_DRYRUN_PERCENT
+	#define AW_PUMP_CURRENT_DRYRUN_PERCENT 60
+#endif
+#ifndef AW_PUMP_CURRENT_OPEN_PERCENT
+	#define AW_PUMP_CURRENT_OPEN_PERCENT 10
+#endif
+
+/*
+Shared pump mode: A single pump feeds all the groups through a valve manifold.
+If set to 1, the pins given to each PumpMonitor open/close the group's valve, and the SharedPump component runs the pump
+while any valve is open. The setup needs to implement Setup::createSharedPumpPin.
+Valves open in parallel as long as their flow fits in the pump's flow (see AW_PUMP_SHARED_FLOW), otherwise they wait
+for their turn, and open in sequence during the same pump run.
+*/
+#ifndef AW_PUMP_SHARED
+	#define AW_PUMP_SHARED 0
+#endif
+
+/*
+Shared pump flow, in L/h. This is the budget for the valves that are open at the same time.
+*/
+#ifndef AW_PUMP_SHARED_FLOW
+	#define AW_PUMP_SHARED_FLOW 240
+#endif
+
+/*
+Flow of a valve (in L/h), unless specified when creating the PumpMonitor
+*/
+#ifndef AW_VALVE_DEFAULT_FLOW
+	#define AW_VALVE_DEFAULT_FLOW 120
+#endif
+
+/*
+While the shared pump is running, groups that are this close to the threshold (in % of the sensor's air/water range)
+also get a shot, instead of starting the pump again a bit later.
+Set to 0 to disable.
+*/
+#ifndef AW_PUMP_SHARED_BATCH_PERCENT
+	#define AW_PUMP_SHARED_BATCH_PERCENT 3
+#endif
+
+/*
+How long (in seconds) the shared pump keeps running after the last valve closes, so any group waiting for its turn can
+open its valve without a pump stop/start cycle.
+Keep it short, since the pump is running against closed valves.
+*/
+#ifndef AW_PUMP_SHARED_STOP_DELAY
+	#define AW_PUMP_SHARED_STOP_DELAY 2.0f
+#endif
+
+// What the pump scheduler budget is (see PumpScheduler.h)
+#if AW_PUMP_SHARED
+	#define AW_PUMP_SCHEDULER_BUDGET AW_PUMP_SHARED_FLOW
+	#define AW_PUMP_SCHEDULER_DEFAULT_COST AW_VALVE_DEFAULT_FLOW
+	#define AW_PUMP_SCHEDULER_UNITS "L/h"
+#else
+	#define AW_PUMP_SCHEDULER_BUDGET AW_PUMP_CURRENT_BUDGET_MA
+	#define AW_PUMP_SCHEDULER_DEFAULT_COST AW_PUMP_DEFAULT_CURRENT_MA
+	#define AW_PUMP_SCHEDULER_UNITS "mA"
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //                               MQTT UI COMPONENT OPTIONS
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -428,6 +1105,16 @@ This does NOT affect manual shots.
 	#define AW_MQTTUI_ENABLED 1
 #endif
 
+#if AW_MOCK_TIME_SCALE != 1
+	#if !AW_MOCK_COMPONENTS
+		#error AW_MOCK_TIME_SCALE requires AW_MOCK_COMPONENTS
+	#endif
+	// Publishing rate limits are in seconds too, so an accelerated time would flood the broker
+	#if AW_MQTTUI_ENABLED
+		#error AW_MOCK_TIME_SCALE requires AW_MQTTUI_ENABLED set to 0
+	#endif
+#endif
+
 #if AW_MQTTUI_ENABLED
 	#if !AW_WIFI_ENABLED
 		#error MQTT requires WIFI
@@ -453,6 +1140,26 @@ If the config is not received within this time window, the local config is publi
 	#define AW_MQTTUI_WAITFORCONFIG_TIMEOUT 5.0f
 #endif
 
+/*
+Interval in seconds between publishes of the "diagnostics" feed, which has the tick stats of the components with the
+slowest ticks (see AW_COMPONENT_STATS_ENABLED).
+Set to 0 to disable.
+*/
+#ifndef AW_MQTTUI_DIAGNOSTICS_INTERVAL
+	#if AW_COMPONENT_STATS_ENABLED
+		#define AW_MQTTUI_DIAGNOSTICS_INTERVAL (10*60)
+	#else
+		#define AW_MQTTUI_DIAGNOSTICS_INTERVAL 0
+	#endif
+#endif
+
+/*
+How many components to include in the diagnostics feed
+*/
+#ifndef AW_MQTTUI_DIAGNOSTICS_NUM_COMPONENTS
+	#define AW_MQTTUI_DIAGNOSTICS_NUM_COMPONENTS 4
+#endif
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //                               GRAPHICAL UI COMPONENT OPTIONS
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -739,6 +1446,16 @@ How many sensor/motor pairs fit on the screen
 	#endif
 #endif
 
+/*
+If set to 1, the MCP23017 IO expanders keep a copy of their registers, so pin changes are sent with a single write,
+and several changes can be combined into one write (see MCP23017CachedWrapper).
+If set to 0, every pin change does a read-modify-write of the register (3 I2C transactions).
+This is only the default. See MCP23017CachedWrapper::setWriteCombining.
+*/
+#ifndef AW_MCP23017_WRITE_COMBINING
+	#define AW_MCP23017_WRITE_COMBINING 1
+#endif
+
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //                               Make sure the user config defined mandatory things
@@ -768,10 +1485,12 @@ How many sensor/motor pairs fit on the screen
 // IMPORTANT:
 // The user config header must typedef "Setup" to the actual setup class
 #ifdef __cplusplus 
+class DigitalOutputPin;
 namespace cz
 {
 	class SoilMoistureSensor;
 	class PumpMonitor;
+	class SharedPump;
 
 	/*
 	A custom setup must implement this interface
@@ -805,6 +1524,11 @@ namespace cz
 		virtual SoilMoistureSensor* createSoilMoistureSensor(int index) = 0;
 		virtual PumpMonitor* createPumpMonitor(int index) = 0;
 
+	#if AW_PUMP_SHARED
+		// Pin that turns on/off the pump shared by all the groups (see AW_PUMP_SHARED)
+		virtual DigitalOutputPin* createSharedPumpPin() = 0;
+	#endif
+
 		// These are called by setup() after calling gSetup->begin()
 		void createSoilMoistureSensors();
 		void createPumpMonitors();
@@ -819,9 +1543,19 @@ namespace cz
 			return m_pumpMonitors[index];
 		}
 
+	#if AW_PUMP_SHARED
+		SharedPump* getSharedPump()
+		{
+			return m_sharedPump;
+		}
+	#endif
+
 	  protected:
 		SoilMoistureSensor* m_soilMoistureSensors[AW_MAX_NUM_PAIRS];
 		PumpMonitor* m_pumpMonitors[AW_MAX_NUM_PAIRS];
+	#if AW_PUMP_SHARED
+		SharedPump* m_sharedPump = nullptr;
+	#endif
 	};
 
 	extern Setup* gSetup;
@@ -22,6 +22,23 @@ For example, sensor intervals can be shortened.
 	#endif
 #endif
 
+/*
+Set to 1 by the native PlatformIO environment (see platformio.ini), when building for the host instead of the RP2040.
+Anything that uses the pico-sdk or the RP2040 hardware directly needs to be left out when this is set.
+*/
+#ifndef AW_NATIVE
+	#define AW_NATIVE 0
+#endif
+
+/*
+How many seconds of simulated time the native simulation (native_sim environment) runs setup()/loop() for, before
+logging the scheduler and component stats and exiting.
+Idle time is skipped, so a week of operation takes only as long as the actual work done in that week.
+*/
+#ifndef AW_NATIVE_SIM_SECONDS
+	#define AW_NATIVE_SIM_SECONDS (7 * 24 * 60 * 60)
+#endif
+
 /*
 To make things during development, setting this to 1 will use mock components for some things
 This hasn't been used for a while, so not sure if working
@@ -30,6 +47,15 @@ This hasn't been used for a while, so not sure if working
 	#define AW_MOCK_COMPONENTS 0
 #endif
 
+/*
+When using mock components, time can be accelerated by this factor. E.g: With 1000, one real second is 1000 seconds
+for the components, so weeks of operation (watering, drying, history graphs) can be simulated in minutes.
+Only the time the components see is scaled. Any real hardware still in use (display, I2C, etc) works as normal.
+*/
+#ifndef AW_MOCK_TIME_SCALE
+	#define AW_MOCK_TIME_SCALE 1
+#endif
+
 /**
  * How many bits to set the ADC readings to.
  * E.g: The RP2040 has a 12-bit ADC
@@ -22,8 +22,13 @@ Overview of this board:
 
 // No need for graphical UI
 #define AW_TOUCHUI_ENABLED 0
-#define AW_WIFI_ENABLED 1
-#define AW_MQTTUI_ENABLED 1
+// These can be overridden from the build flags (e.g: the native environment doesn't have WiFi)
+#ifndef AW_WIFI_ENABLED
+	#define AW_WIFI_ENABLED 1
+#endif
+#ifndef AW_MQTTUI_ENABLED
+	#define AW_MQTTUI_ENABLED 1
+#endif
 #define AW_MQTT_PUBLISHINTERVAL 1.25f
 
 /**
@@ -4,6 +4,11 @@
 #include "../../SoilMoistureSensor.h"
 #include "../../PumpMonitor.h"
 #include "../../utility/PinTypes.h"
+#include "../../utility/PWMMotorPin.h"
+
+#if AW_PUMP_PWM && !AW_PUMP_PWM_SIMULATED
+	#error "The motors are behind the IO expander, which can't do PWM. Only AW_PUMP_PWM_SIMULATED is supported."
+#endif
 
 /**
  * Note. Internally it adds 0x20, which is the base address
@@ -34,6 +39,12 @@
 #define IO_EXPANDER_MOTOR4 cz::IOExpanderPin(0+7)
 #define IO_EXPANDER_MOTOR5 cz::IOExpanderPin(8+6)
 
+/**
+ * With a shared pump (AW_PUMP_SHARED), the pump is connected to the last board's last motor pin, and the motor pins
+ * of each group drive the group's valve.
+ */
+#define IO_EXPANDER_SHARED_PUMP IO_EXPANDER_MOTOR5
+
 /**
  * Pins of the IO Expander used to power the capacitive soil moisture sensors
  */
@@ -139,12 +150,41 @@ class GreenhouseSetup : public Setup
 	
 	PumpMonitor* createPumpMonitor(int index)
 	{
+	#if AW_PUMP_PWM && !AW_PUMP_SHARED
+		// Simulated, so the pin number is only used for logging. With a shared pump, these are valves and don't ramp.
+		DigitalOutputPin* pin = new PWMMotorPin(index);
+	#else
 		DigitalOutputPin* pin = new MCP23xxxOutputPin(
 			m_i2cBoards[index / sensorsPerBoard].ioExpander,
 			motorPins[index % sensorsPerBoard].raw);
-		return new PumpMonitor(index, *pin);
+	#endif
+		PumpMonitor* monitor = new PumpMonitor(index, *pin);
+	#if AW_ADC_CAPTURE_ENABLED && AW_ADC_CAPTURE_SIMULATED && !AW_PUMP_SHARED
+		// The boards have no pump current sense, but with the simulated ADC the pin is not used, and the mock pumps get
+		// stall/dry run detection (see the "pumpfault" command)
+		monitor->setCurrentSense(MCU_TO_MUX_ZPIN.raw, AW_PUMP_DEFAULT_CURRENT_MA);
+	#endif
+	#if AW_FLOW_METER_SIMULATED
+		// The boards have no flow meters either, and the pin is not used by the simulated ones
+		monitor->setFlowMeter(*new FlowMeter(MCU_TO_MUX_ZPIN.raw));
+	#endif
+		return monitor;
 	}
 
+#if AW_PUMP_SHARED
+	DigitalOutputPin* createSharedPumpPin()
+	{
+		static_assert(AW_MAX_NUM_PAIRS < sensorsPerBoard * MAX_NUM_I2C_BOARDS, "The shared pump pin is in use by a group");
+	#if AW_PUMP_PWM
+		return new PWMMotorPin(IO_EXPANDER_SHARED_PUMP.raw);
+	#else
+		return new MCP23xxxOutputPin(
+			m_i2cBoards[MAX_NUM_I2C_BOARDS - 1].ioExpander,
+			IO_EXPANDER_SHARED_PUMP.raw);
+	#endif
+	}
+#endif
+
 	struct I2CBoard
 	{
 	#if AW_MOCK_COMPONENTS
@@ -10,10 +10,17 @@
 
 #define MAX_NUM_I2C_BOARDS 2
 
-#define AW_WIFI_ENABLED 1
-#define AW_MQTTUI_ENABLED 1
+// These can be overridden from the build flags (e.g: the native environment doesn't have WiFi or a display)
+#ifndef AW_WIFI_ENABLED
+	#define AW_WIFI_ENABLED 1
+#endif
+#ifndef AW_MQTTUI_ENABLED
+	#define AW_MQTTUI_ENABLED 1
+#endif
 
-#define AW_TOUCHUI_ENABLED 1
+#ifndef AW_TOUCHUI_ENABLED
+	#define AW_TOUCHUI_ENABLED 1
+#endif
 
 /**
  * How many sensor/motor pairs to support
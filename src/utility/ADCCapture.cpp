@@ -0,0 +1,215 @@
+#include <Arduino.h>
+
+#include "ADCCapture.h"
+#include <crazygaze/micromuc/Logging.h>
+#include <algorithm>
+#include <math.h>
+
+#if !AW_ADC_CAPTURE_SIMULATED
+	#include <hardware/adc.h>
+	#include <hardware/dma.h>
+#endif
+
+namespace cz
+{
+
+namespace
+{
+#if AW_ADC_CAPTURE_SIMULATED
+	// Approximates a gaussian distribution with mean 0 and standard deviation 1, by adding 12 uniform random numbers
+	float gaussianNoise()
+	{
+		float sum = 0;
+		for (int i = 0; i < 12; i++)
+		{
+			sum += random(0, 10000) / 10000.0f;
+		}
+		return sum - 6.0f;
+	}
+
+	// Sample rate at which the simulated noise doubles in variance
+	constexpr float gSimulatedSettlingRate = 100000.0f;
+#else
+	// The ADC always samples at 12 bits. Converting to what analogRead would return.
+	uint16_t toAnalogReadResolution(uint16_t value)
+	{
+	#if AW_ADC_NUM_BITS <= 12
+		return value >> (12 - AW_ADC_NUM_BITS);
+	#else
+		return value << (AW_ADC_NUM_BITS - 12);
+	#endif
+	}
+#endif
+}
+
+float ADCCapture::calcDuration(int numSamples, uint32_t sampleRate)
+{
+	return numSamples / static_cast<float>(std::clamp(sampleRate, 1u, ms_maxSampleRate));
+}
+
+float ADCCapture::getTimeToEnd() const
+{
+	if (!isBusy())
+	{
+		return 0;
+	}
+
+	unsigned long elapsed = micros() - m_startMicros;
+	return elapsed < m_durationMicros ? (m_durationMicros - elapsed) / 1000000.0f : 0.0f;
+}
+
+bool ADCCapture::start(uint8_t pin, int numSamples, uint32_t sampleRate, Callback callback, void* userData, Priority priority)
+{
+	CZ_ASSERT(callback);
+	if (isBusy())
+	{
+		if (priority == Priority::Low && !m_lowWaiting)
+		{
+			m_lowWaiting = true;
+			m_lowWaitingMicros = micros();
+		}
+		return false;
+	}
+
+	if (m_lowWaiting)
+	{
+		if (priority == Priority::High && (micros() - m_lowWaitingMicros) < AW_ADC_CAPTURE_YIELD_MS * 1000UL)
+		{
+			return false;
+		}
+		// Either the Low priority capture is getting its turn, or it gave up
+		m_lowWaiting = false;
+	}
+
+	m_numSamples = std::clamp(numSamples, 1, AW_ADC_CAPTURE_MAX_SAMPLES);
+	sampleRate = std::clamp(sampleRate, 1u, ms_maxSampleRate);
+	m_startMicros = micros();
+	m_durationMicros = static_cast<unsigned long>(calcDuration(m_numSamples, sampleRate) * 1000000.0f);
+
+#if AW_ADC_CAPTURE_SIMULATED
+
+	m_sampleRate = sampleRate;
+	m_input = m_nextInput;
+
+#else
+
+	m_dmaChannel = dma_claim_unused_channel(false);
+	if (m_dmaChannel < 0)
+	{
+		CZ_LOG(logDefault, Error, F("ADCCapture: No DMA channel available"));
+		return false;
+	}
+
+	adc_init();
+	adc_gpio_init(pin);
+	adc_select_input(pin - 26);
+	// Push every sample into the FIFO and request DMA as soon as there is one
+	adc_fifo_setup(true, true, 1, false, false);
+	adc_fifo_drain();
+	// The ADC runs at 48MHz, and a conversion takes 96 cycles. A divider of 0 means back to back conversions.
+	float div = 48000000.0f / sampleRate - 1.0f;
+	adc_set_clkdiv(div < 96.0f ? 0 : div);
+
+	dma_channel_config cfg = dma_channel_get_default_config(m_dmaChannel);
+	channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+	channel_config_set_read_increment(&cfg, false);
+	channel_config_set_write_increment(&cfg, true);
+	channel_config_set_dreq(&cfg, DREQ_ADC);
+	dma_channel_configure(m_dmaChannel, &cfg, m_samples, &adc_hw->fifo, m_numSamples, true);
+
+	adc_run(true);
+
+#endif
+
+	m_callback = callback;
+	m_userData = userData;
+	return true;
+}
+
+bool ADCCapture::poll()
+{
+	if (!isBusy())
+	{
+		return false;
+	}
+
+#if AW_ADC_CAPTURE_SIMULATED
+	if ((micros() - m_startMicros) < m_durationMicros)
+	{
+		return false;
+	}
+
+	float noise = m_input.noise * sqrtf(1.0f + m_sampleRate / gSimulatedSettlingRate);
+	for (int i = 0; i < m_numSamples; i++)
+	{
+		float value = m_input.waveform
+			? m_input.waveform(m_input.waveformUserData, i / static_cast<float>(m_sampleRate))
+			: m_input.value + gaussianNoise() * noise;
+		m_samples[i] = static_cast<uint16_t>(std::clamp(value, 0.0f, static_cast<float>((1 << AW_ADC_NUM_BITS) - 1)));
+	}
+#else
+	if (dma_channel_is_busy(m_dmaChannel))
+	{
+		return false;
+	}
+
+	for (int i = 0; i < m_numSamples; i++)
+	{
+		m_samples[i] = toAnalogReadResolution(m_samples[i]);
+	}
+#endif
+
+	// Stopping before calling the callback, so the callback can start another capture
+	Callback callback = m_callback;
+	void* userData = m_userData;
+	stop();
+	callback(userData, m_samples, m_numSamples);
+	return true;
+}
+
+void ADCCapture::cancel()
+{
+	if (isBusy())
+	{
+		stop();
+	}
+}
+
+void ADCCapture::stop()
+{
+#if !AW_ADC_CAPTURE_SIMULATED
+	adc_run(false);
+	dma_channel_abort(m_dmaChannel);
+	dma_channel_unclaim(m_dmaChannel);
+	m_dmaChannel = -1;
+	// Leave the ADC as analogRead expects it
+	adc_fifo_setup(false, false, 0, false, false);
+	adc_fifo_drain();
+	adc_set_clkdiv(0);
+#endif
+
+	m_callback = nullptr;
+	m_userData = nullptr;
+}
+
+#if AW_ADC_CAPTURE_SIMULATED
+void ADCCapture::setSimulatedInput(float value, float noise)
+{
+	m_nextInput.value = value;
+	m_nextInput.noise = noise;
+	m_nextInput.waveform = nullptr;
+}
+
+void ADCCapture::setSimulatedWaveform(Waveform waveform, void* userData)
+{
+	m_nextInput.waveform = waveform;
+	m_nextInput.waveformUserData = userData;
+}
+#endif
+
+#if AW_ADC_CAPTURE_ENABLED
+	ADCCapture gADCCapture;
+#endif
+
+} // namespace cz
+
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace cz
+{
+
+/**
+ * Takes a number of ADC samples at a fixed rate, without keeping the CPU busy.
+ *
+ * On the RP2040, the ADC runs in free running mode, pushing samples into its FIFO, and a DMA channel moves them to a
+ * buffer. Once all samples are in, the callback passed to start() is called from poll(), so it runs in the main loop
+ * and not in an interrupt.
+ *
+ * There is only one ADC, so only one capture can be active at a given time. Who gets it is decided by the priority
+ * passed to start():
+ * - High priority captures (the pump current sense) can run back to back, so a running pump is monitored without gaps.
+ * - A Low priority start (sensor readings) that fails because the ADC is busy is remembered, and the next High priority
+ *   start is refused so the Low priority one gets its turn. If it doesn't retry within AW_ADC_CAPTURE_YIELD_MS (e.g:
+ *   the sensor stopped reading), High priority captures carry on.
+ * So while a pump is being monitored, each sensor reading leaves a gap in the pump's current of about one sensor
+ * capture, and sensor readings are delayed by up to one pump capture.
+ *
+ * With AW_ADC_CAPTURE_SIMULATED, no hardware is used. The samples are generated from the value set with
+ * setSimulatedInput, plus gaussian noise that grows with the sample rate (to mimic an input that doesn't have enough
+ * time to settle). This allows checking the sample rate/noise trade-offs without a board.
+ * Alternatively, setSimulatedWaveform provides the value of each sample as a function of time.
+ */
+class ADCCapture
+{
+  public:
+
+	// Maximum sample rate the RP2040 ADC supports
+	static constexpr uint32_t ms_maxSampleRate = 500000;
+
+	/**
+	 * Called once all samples are captured.
+	 * The samples are already adjusted to AW_ADC_NUM_BITS, like analogRead would return.
+	 */
+	using Callback = void (*)(void* userData, const uint16_t* samples, int numSamples);
+
+	enum class Priority : uint8_t
+	{
+		Low,
+		High
+	};
+
+	ADCCapture() = default;
+	ADCCapture(const ADCCapture&) = delete;
+	ADCCapture& operator=(const ADCCapture&) = delete;
+
+	/**
+	 * Starts a capture.
+	 * @param pin MCU pin to capture from. Needs to be an ADC capable pin (26..29)
+	 * @param numSamples How many samples to take. Clamped to AW_ADC_CAPTURE_MAX_SAMPLES
+	 * @param sampleRate Samples per second
+	 * @return false if a capture is already active, the ADC was left for a Low priority capture (see class comment), or
+	 * the hardware couldn't be setup.
+	 */
+	bool start(uint8_t pin, int numSamples, uint32_t sampleRate, Callback callback, void* userData, Priority priority = Priority::Low);
+
+	/**
+	 * Checks if the active capture is finished, and if so, calls the callback.
+	 * Returns true if the callback was called.
+	 */
+	bool poll();
+
+	/**
+	 * Cancels the active capture (if any) without calling the callback.
+	 */
+	void cancel();
+
+	bool isBusy() const
+	{
+		return m_callback != nullptr;
+	}
+
+	/**
+	 * How long in seconds until the active capture is done, or 0 if there is none
+	 */
+	float getTimeToEnd() const;
+
+	/**
+	 * How long in seconds a capture with the specified parameters takes
+	 */
+	static float calcDuration(int numSamples, uint32_t sampleRate);
+
+#if AW_ADC_CAPTURE_SIMULATED
+	/**
+	 * Sets what the simulated ADC reads, for the captures started from now on. A capture already active keeps reading
+	 * what was set when it started, since it might belong to someone else (e.g: a pump's current sense).
+	 * @param value Mean value
+	 * @param noise Standard deviation of the noise at low sample rates
+	 */
+	void setSimulatedInput(float value, float noise);
+
+	/**
+	 * Returns the simulated ADC value at the specified time (in seconds, since the capture started)
+	 */
+	using Waveform = float (*)(void* userData, float t);
+
+	/**
+	 * Sets what the simulated ADC reads, as a function of time. Stays in use until the next call to setSimulatedInput.
+	 * Same as setSimulatedInput, only applies to the captures started from now on.
+	 */
+	void setSimulatedWaveform(Waveform waveform, void* userData);
+#endif
+
+  private:
+
+	void stop();
+
+	uint16_t m_samples[AW_ADC_CAPTURE_MAX_SAMPLES];
+	Callback m_callback = nullptr;
+	void* m_userData = nullptr;
+	int m_numSamples = 0;
+	unsigned long m_startMicros = 0;
+	unsigned long m_durationMicros = 0;
+	// Set when a Low priority start failed because the ADC was busy
+	bool m_lowWaiting = false;
+	unsigned long m_lowWaitingMicros = 0;
+
+#if AW_ADC_CAPTURE_SIMULATED
+	uint32_t m_sampleRate = 0;
+	struct SimulatedInput
+	{
+		float value = 0;
+		float noise = 0;
+		Waveform waveform = nullptr;
+		void* waveformUserData = nullptr;
+	};
+	// What the next capture reads, and what the active capture reads
+	SimulatedInput m_nextInput;
+	SimulatedInput m_input;
+#else
+	int m_dmaChannel = -1;
+#endif
+};
+
+#if AW_ADC_CAPTURE_ENABLED
+	extern ADCCapture gADCCapture;
+#endif
+
+} // namespace cz
+
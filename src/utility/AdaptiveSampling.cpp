@@ -0,0 +1,113 @@
+#include <Arduino.h>
+
+#include "AdaptiveSampling.h"
+#include <algorithm>
+#include <math.h>
+
+namespace cz
+{
+
+void AdaptiveSampling::addReading(uint64_t micros, unsigned int value)
+{
+	if (m_numPoints == AW_MOISTURESENSOR_ADAPTIVE_NUM_POINTS)
+	{
+		for (int i = 1; i < m_numPoints; i++)
+		{
+			m_points[i - 1] = m_points[i];
+		}
+		m_numPoints--;
+	}
+
+	m_points[m_numPoints++] = {micros, value};
+}
+
+bool AdaptiveSampling::calcDryingRate(float& rate, float& rateError, float& noise) const
+{
+	if (m_numPoints < 2)
+	{
+		return false;
+	}
+
+	// Least squares fit. Times are relative to the first point, so they fit in a float.
+	float meanTime = 0;
+	float meanValue = 0;
+	for (int i = 0; i < m_numPoints; i++)
+	{
+		meanTime += (m_points[i].micros - m_points[0].micros) / 1000000.0f;
+		meanValue += m_points[i].value;
+	}
+	meanTime /= m_numPoints;
+	meanValue /= m_numPoints;
+
+	float num = 0;
+	float den = 0;
+	for (int i = 0; i < m_numPoints; i++)
+	{
+		float t = (m_points[i].micros - m_points[0].micros) / 1000000.0f - meanTime;
+		num += t * (m_points[i].value - meanValue);
+		den += t * t;
+	}
+
+	if (den <= 0)
+	{
+		return false;
+	}
+
+	rate = num / den;
+
+	// How far the readings are from the fitted line, and so how uncertain the rate is
+	noise = 0;
+	rateError = 0;
+	if (m_numPoints > 2)
+	{
+		float residuals = 0;
+		for (int i = 0; i < m_numPoints; i++)
+		{
+			float t = (m_points[i].micros - m_points[0].micros) / 1000000.0f - meanTime;
+			float residual = m_points[i].value - (meanValue + rate * t);
+			residuals += residual * residual;
+		}
+		noise = sqrtf(residuals / (m_numPoints - 2));
+		rateError = noise / sqrtf(den);
+	}
+
+	return true;
+}
+
+float AdaptiveSampling::calcInterval(float samplingInterval, unsigned int thresholdValue) const
+{
+	float rate, rateError, noise;
+	if (!calcDryingRate(rate, rateError, noise))
+	{
+		// Not enough readings since the last watering, so use the fixed interval
+		return samplingInterval;
+	}
+
+	const float minInterval = std::max(samplingInterval * AW_MOISTURESENSOR_ADAPTIVE_MIN_FACTOR, 1.0f);
+	const float maxInterval = std::max(
+		std::min(samplingInterval * AW_MOISTURESENSOR_ADAPTIVE_MAX_FACTOR, static_cast<float>(AW_MOISTURESENSOR_MAX_SAMPLINGINTERVAL)),
+		minInterval);
+
+	// Noisy readings make both the last reading and the rate less certain, so this plans for the soil being as close to
+	// the threshold and drying as fast as the readings allow. Otherwise, a reading that happened to be low would push the
+	// next one well past the threshold crossing.
+	// NOTE: Higher values means drier, so the distance is positive while below the threshold
+	float distance = static_cast<float>(thresholdValue) - m_points[m_numPoints - 1].value - 2 * noise;
+	if (distance <= 0)
+	{
+		// At the threshold already, or close enough. The pump takes care of it, but keep a close eye on it
+		return minInterval;
+	}
+
+	rate += 2 * rateError;
+	if (rate <= 0)
+	{
+		// Not drying
+		return maxInterval;
+	}
+
+	// The interval is measured from the last reading, which is also the point the distance is measured from
+	return std::clamp(distance / rate * AW_MOISTURESENSOR_ADAPTIVE_MARGIN, minInterval, maxInterval);
+}
+
+} // namespace cz
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace cz
+{
+
+/**
+ * Adaptive soil moisture sampling interval (see AW_MOISTURESENSOR_ADAPTIVE_SAMPLING).
+ *
+ * Keeps the last valid readings since the last watering, and fits the drying rate with least squares. The next reading
+ * is scheduled at a fraction (AW_MOISTURESENSOR_ADAPTIVE_MARGIN) of the predicted time to the threshold crossing,
+ * clamped to [MIN_FACTOR, MAX_FACTOR] times the group's sampling interval. The prediction assumes the soil is as close
+ * to the threshold and drying as fast as the readings' noise allows.
+ * Without enough readings (e.g: right after watering), the group's sampling interval is used.
+ */
+class AdaptiveSampling
+{
+  public:
+
+	/**
+	 * Forgets the readings. Should be called when the soil gets watered, or readings stop for a while.
+	 */
+	void reset()
+	{
+		m_numPoints = 0;
+	}
+
+	void addReading(uint64_t micros, unsigned int value);
+
+	/**
+	 * Calculates the drying rate in sensor units per second (positive means drying) with a least squares fit.
+	 * @param rateError Standard error of the rate
+	 * @param noise Standard deviation of the readings around the fitted line
+	 * Both are 0 with only 2 readings. Returns false if there aren't enough readings.
+	 */
+	bool calcDryingRate(float& rate, float& rateError, float& noise) const;
+
+	/**
+	 * Time in seconds from the last reading to the next one
+	 * @param samplingInterval The group's sampling interval
+	 * @param thresholdValue Sensor value at which the group needs watering
+	 */
+	float calcInterval(float samplingInterval, unsigned int thresholdValue) const;
+
+  private:
+
+	struct Point
+	{
+		uint64_t micros;
+		unsigned int value;
+	};
+
+	Point m_points[AW_MOISTURESENSOR_ADAPTIVE_NUM_POINTS];
+	int m_numPoints = 0;
+};
+
+} // namespace cz
@@ -1,6 +1,8 @@
 #include <Arduino.h>
 
 #include "BatteryLifeCalculator.h"
+#include "IntStats.h"
+#include <algorithm>
 
 namespace cz
 {
@@ -79,13 +81,24 @@ int BatteryLifeCalculator::sampleADC(int pin, int numSamples)
 	analogReadResolution(m_adcBits);
 	pinMode(pin, INPUT);
 
-	int adcVal = 0;
+	// Median of 3 before averaging, to reject spikes.
+	// The number of samples is rounded up to a multiple of 3, so no samples are left out of a median, and there is
+	// always at least one median.
+	constexpr int medianSize = 3;
+	numSamples = std::max((numSamples + medianSize - 1) / medianSize, 1) * medianSize;
+
+	TMedianOfK<medianSize> median;
+	IntStatsAccumulator acc;
 	for (int i = 0; i < numSamples; i++)
 	{
-		adcVal += analogRead(pin);
+		int32_t value;
+		if (median.add(analogRead(pin), value))
+		{
+			acc.add(value);
+		}
 	}
-	adcVal = adcVal / numSamples;
-	return adcVal;
+
+	return acc.get().getMean();
 }
 
 } // namespace cz
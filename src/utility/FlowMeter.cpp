@@ -0,0 +1,121 @@
+#include <Arduino.h>
+
+#include "FlowMeter.h"
+#include "../Timer.h"
+#include <crazygaze/micromuc/Logging.h>
+
+#if !AW_FLOW_METER_SIMULATED
+	#include <hardware/gpio.h>
+	#include <hardware/pwm.h>
+#endif
+
+namespace cz
+{
+
+extern Timer gTimer;
+
+#if AW_FLOW_METER_SIMULATED
+namespace
+{
+	// How much the flow drops with an empty tank, since the pump needs to lift the water higher
+	constexpr float gEmptyTankFlowFactor = 0.6f;
+	// Random variation of the time between pulses
+	constexpr float gPulseJitter = 0.1f;
+
+	float calcSimulatedPeriod(float litresPerMinute, float tankLevel)
+	{
+		float flow = litresPerMinute * (gEmptyTankFlowFactor + (1.0f - gEmptyTankFlowFactor) * tankLevel);
+		float period = 60.0f / (flow * AW_FLOW_METER_PULSES_PER_LITRE);
+		return period * (1.0f + random(-1000, 1000) / 1000.0f * gPulseJitter);
+	}
+}
+
+float FlowMeter::ms_tankLevel = 1.0f;
+#endif
+
+FlowMeter::FlowMeter(uint8_t pin)
+{
+#if AW_FLOW_METER_SIMULATED
+	m_lastMicros = gTimer.getTotalMicros();
+#else
+	CZ_ASSERT(pwm_gpio_to_channel(pin) == PWM_CHAN_B);
+	m_slice = pwm_gpio_to_slice_num(pin);
+	gpio_set_function(pin, GPIO_FUNC_PWM);
+	pwm_config cfg = pwm_get_default_config();
+	// Count rising edges of the B input, without a divider
+	pwm_config_set_clkdiv_mode(&cfg, PWM_DIV_B_RISING);
+	pwm_config_set_clkdiv(&cfg, 1);
+	pwm_init(m_slice, &cfg, false);
+	pwm_set_counter(m_slice, 0);
+	pwm_set_enabled(m_slice, true);
+#endif
+}
+
+void FlowMeter::update()
+{
+#if AW_FLOW_METER_SIMULATED
+	uint64_t now = gTimer.getTotalMicros();
+	float elapsed = (now - m_lastMicros) / 1000000.0f;
+	m_lastMicros = now;
+	if (m_simulatedFlow <= 0)
+	{
+		return;
+	}
+
+	constexpr float pulseVolume = 1.0f / (AW_FLOW_METER_PULSES_PER_LITRE * AW_FLOW_METER_SIMULATED_TANK_LITRES);
+	while (elapsed >= m_timeToNextPulse)
+	{
+		elapsed -= m_timeToNextPulse;
+		m_count++;
+		ms_tankLevel -= pulseVolume;
+		if (ms_tankLevel < 0.1f)
+		{
+			CZ_LOG(logDefault, Log, F("Simulated water tank refilled"));
+			ms_tankLevel = 1.0f;
+		}
+		m_timeToNextPulse = calcSimulatedPeriod(m_simulatedFlow, ms_tankLevel);
+	}
+	m_timeToNextPulse -= elapsed;
+#else
+	addCounter(pwm_get_counter(m_slice));
+#endif
+}
+
+void FlowMeter::addCounter(uint16_t counter)
+{
+	// The counter wraps around at 16 bits, and the unsigned subtraction takes care of that
+	m_count += static_cast<uint16_t>(counter - m_lastCounter);
+	m_lastCounter = counter;
+}
+
+uint32_t FlowMeter::pulsesToMl(uint32_t pulses)
+{
+	return static_cast<uint32_t>((static_cast<uint64_t>(pulses) * 1000 + AW_FLOW_METER_PULSES_PER_LITRE / 2) / AW_FLOW_METER_PULSES_PER_LITRE);
+}
+
+uint32_t FlowMeter::mlToPulses(uint32_t ml)
+{
+	return static_cast<uint32_t>((static_cast<uint64_t>(ml) * AW_FLOW_METER_PULSES_PER_LITRE + 500) / 1000);
+}
+
+#if AW_FLOW_METER_SIMULATED
+void FlowMeter::setSimulatedFlow(float litresPerMinute)
+{
+	// Bring the count up to date with the previous flow, before changing it
+	update();
+	if (m_simulatedFlow <= 0 && litresPerMinute > 0)
+	{
+		// The first pulse comes at a random point, since the turbine could be anywhere when it starts
+		m_timeToNextPulse = calcSimulatedPeriod(litresPerMinute, ms_tankLevel) * random(0, 1000) / 1000.0f;
+	}
+	m_simulatedFlow = litresPerMinute;
+}
+
+float FlowMeter::getSimulatedTankLevel()
+{
+	return ms_tankLevel;
+}
+#endif
+
+} // namespace cz
+
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace cz
+{
+
+/**
+ * Counts the pulses of a flow sensor (e.g: YF-S201), to measure how much water a pump delivered.
+ *
+ * On the RP2040, the pulses are counted by a PWM slice with the pin as its clock (rising edges of the B input), so there
+ * is no CPU work per pulse. The hardware counter is 16 bits, so update() needs to be called before it wraps around
+ * (e.g: At 450 pulses per litre, that's every 145 litres).
+ * Because of this, the pin needs to be a PWM B pin (odd GPIO numbers).
+ *
+ * With AW_FLOW_METER_SIMULATED, no hardware is used, and the pulses are generated at the rate set with
+ * setSimulatedFlow, with some jitter between pulses like a real sensor. The flow also goes down as a simulated water tank
+ * empties, to mimic the pump head going up, so the same shot duration delivers different volumes.
+ */
+class FlowMeter
+{
+  public:
+
+	FlowMeter(const FlowMeter&) = delete;
+	FlowMeter& operator=(const FlowMeter&) = delete;
+	/**
+	 * @param pin MCU pin the sensor's pulse output is connected to. Needs to be a PWM B pin (odd GPIO numbers)
+	 */
+	explicit FlowMeter(uint8_t pin);
+
+	/**
+	 * Brings the pulse count up to date. Needs to be called often enough for the hardware counter not to wrap around.
+	 */
+	void update();
+
+	/**
+	 * Adds the pulses the 16 bits hardware counter counted since the previous call, taking care of it wrapping around.
+	 * update() calls this with the hardware counter. Without the hardware (AW_FLOW_METER_SIMULATED), it can be used to
+	 * feed the counter values directly.
+	 */
+	void addCounter(uint16_t counter);
+
+	/**
+	 * Total number of pulses so far, as of the last update()
+	 */
+	uint32_t getCount() const
+	{
+		return m_count;
+	}
+
+	/**
+	 * Converts pulses to millilitres, as per AW_FLOW_METER_PULSES_PER_LITRE
+	 */
+	static uint32_t pulsesToMl(uint32_t pulses);
+	static uint32_t mlToPulses(uint32_t ml);
+
+#if AW_FLOW_METER_SIMULATED
+	/**
+	 * Sets the flow (in litres per minute) of the simulated pulses, for when the tank is full. 0 stops the pulses.
+	 */
+	void setSimulatedFlow(float litresPerMinute);
+
+	/**
+	 * Level of the simulated tank (0..1), shared by all the flow meters
+	 */
+	static float getSimulatedTankLevel();
+#endif
+
+  private:
+
+	uint32_t m_count = 0;
+	uint16_t m_lastCounter = 0;
+
+#if AW_FLOW_METER_SIMULATED
+	float m_simulatedFlow = 0;
+	// Time until the next simulated pulse, in seconds
+	float m_timeToNextPulse = 0;
+	uint64_t m_lastMicros = 0;
+	static float ms_tankLevel;
+#else
+	uint8_t m_slice;
+#endif
+};
+
+} // namespace cz
+
@@ -0,0 +1,196 @@
+#include <Arduino.h>
+
+#include "HTU21DFReader.h"
+#include <crazygaze/micromuc/Logging.h>
+#include <crazygaze/micromuc/StringUtils.h>
+
+namespace cz
+{
+
+namespace
+{
+	const char* const gStateNames[5] =
+	{
+		"Initializing",
+		"Idle",
+		"ReadingTemperature",
+		"ReadingHumidity",
+		"Resetting"
+	};
+
+	// If a conversion is not done after this long, something is wrong with the sensor
+	constexpr float gMeasurementTimeout = 0.5f;
+	// How often to check again if the sensor is still converting after the expected time
+	constexpr float gMeasurementRetryWait = 0.005f;
+}
+
+const char* HTU21DFReader::stateToString(State state)
+{
+	return gStateNames[static_cast<int>(state)];
+}
+
+void HTU21DFReader::begin()
+{
+	m_state = State::Initializing;
+	m_timeInState = 0;
+	m_htu.startReset();
+}
+
+float HTU21DFReader::startReading()
+{
+	CZ_ASSERT(m_state == State::Idle);
+	changeToState(State::ReadingTemperature);
+	return m_nextTickWait;
+}
+
+float HTU21DFReader::getStateWait(State state)
+{
+	switch (state)
+	{
+	case State::Initializing:
+	case State::Resetting:
+		return HTU21DF_RESET_MS / 1000.0f;
+	case State::ReadingTemperature:
+		return HTU21DF_TEMP_MEASUREMENT_MS / 1000.0f;
+	case State::ReadingHumidity:
+		return HTU21DF_HUM_MEASUREMENT_MS / 1000.0f;
+	default:
+		return 0;
+	}
+}
+
+float HTU21DFReader::tick(float deltaSeconds)
+{
+	m_timeInState += deltaSeconds;
+
+	// Still waiting for the sensor
+	if (m_timeInState < getStateWait(m_state))
+	{
+		return getStateWait(m_state) - m_timeInState;
+	}
+
+	m_nextTickWait = 0;
+
+	switch (m_state)
+	{
+	case State::Initializing:
+		if (!m_htu.checkAfterReset())
+		{
+			CZ_LOG(logDefault, Error, F("Error initializing temperature/humidity sensor"));
+		}
+		changeToState(State::Idle);
+		break;
+
+	case State::Idle:
+		break;
+
+	case State::ReadingTemperature:
+		if (fetchMeasurement(m_temperature))
+		{
+			if (isnan(m_temperature))
+			{
+				CZ_LOG(logDefault, Verbose, F("HTU21DFReader: Error reading temperature"));
+			}
+			changeToState(State::ReadingHumidity);
+		}
+		break;
+
+	case State::ReadingHumidity:
+		if (fetchMeasurement(m_humidity))
+		{
+			if (isnan(m_humidity))
+			{
+				CZ_LOG(logDefault, Verbose, F("HTU21DFReader: Error reading humidity"));
+			}
+
+			m_hasReading = true;
+			changeToState(isnan(m_temperature) || isnan(m_humidity) ? State::Resetting : State::Idle);
+		}
+		break;
+
+	case State::Resetting:
+		changeToState(State::Idle);
+		break;
+
+	default:
+		CZ_UNEXPECTED();
+	}
+
+	return m_nextTickWait;
+}
+
+bool HTU21DFReader::fetchReading(float& temperature, float& humidity)
+{
+	if (!m_hasReading)
+	{
+		return false;
+	}
+
+	m_hasReading = false;
+	temperature = m_temperature;
+	humidity = m_humidity;
+	return true;
+}
+
+bool HTU21DFReader::fetchMeasurement(float& value)
+{
+	uint16_t raw;
+	switch (m_htu.fetchMeasurement(raw))
+	{
+	case Adafruit_HTU21DF::FetchOk:
+		value = m_state == State::ReadingTemperature ? Adafruit_HTU21DF::rawToTemperature(raw)
+		                                             : Adafruit_HTU21DF::rawToHumidity(raw);
+		return true;
+
+	case Adafruit_HTU21DF::FetchNotReady:
+		if (m_timeInState < gMeasurementTimeout)
+		{
+			m_nextTickWait = gMeasurementRetryWait;
+			return false;
+		}
+		CZ_LOG(logDefault, Verbose, F("HTU21DFReader: Timeout"));
+		break;
+
+	case Adafruit_HTU21DF::FetchCRCError:
+		CZ_LOG(logDefault, Verbose, F("HTU21DFReader: CRC error"));
+		break;
+	}
+
+	value = NAN;
+	return true;
+}
+
+void HTU21DFReader::changeToState(State newState)
+{
+	CZ_LOG(logDefault, Verbose, F("HTU21DFReader::%s: %ssec %s->%s")
+		, __FUNCTION__
+		, *FloatToString(m_timeInState)
+		, stateToString(m_state)
+		, stateToString(newState));
+
+	m_state = newState;
+	m_timeInState = 0.0f;
+
+	switch (m_state)
+	{
+	case State::Resetting:
+		m_htu.startReset();
+		break;
+
+	case State::ReadingTemperature:
+		m_htu.startTemperature();
+		break;
+
+	case State::ReadingHumidity:
+		m_htu.startHumidity();
+		break;
+
+	default:
+		break;
+	}
+
+	// The next state might need to wait for the sensor, or can run right away
+	m_nextTickWait = getStateWait(m_state);
+}
+
+} // namespace cz
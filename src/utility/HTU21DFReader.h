@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Adafruit_HTU21DF.h>
+
+namespace cz
+{
+
+/**
+ * Reads a HTU21DF temperature and humidity sensor without blocking.
+ *
+ * A measurement is triggered in no hold master mode, and the result is fetched in a later tick, once the conversion
+ * time has passed. Resets are also waited on by the state machine, so no call ever waits for the sensor, as long as the
+ * caller ticks it again after the time tick returns.
+ * If the sensor doesn't answer, or a reading fails the CRC check, that value is NAN and the sensor is reset.
+ */
+class HTU21DFReader
+{
+  public:
+
+	enum class State : uint8_t
+	{
+		Initializing, // Waiting for the initial reset to finish
+		Idle,
+		ReadingTemperature, // Waiting for the temperature conversion
+		ReadingHumidity, // Waiting for the humidity conversion
+		Resetting // Waiting for a reset to finish, after a failed reading
+	};
+
+	static const char* stateToString(State state);
+
+	// Starts the initial reset
+	void begin();
+
+	/**
+	 * Starts a temperature and humidity reading. Only valid if idle.
+	 * Returns how long to wait (seconds) before ticking again.
+	 */
+	float startReading();
+
+	/**
+	 * Checks the sensor, if whatever it's doing should be done by now
+	 * Returns how long to wait (seconds) before ticking again, or 0 if idle.
+	 */
+	float tick(float deltaSeconds);
+
+	/**
+	 * If a reading finished since the last call, sets `temperature` and `humidity` and returns true.
+	 * A value that couldn't be read is NAN.
+	 */
+	bool fetchReading(float& temperature, float& humidity);
+
+	State getState() const
+	{
+		return m_state;
+	}
+
+  private:
+
+	// Time in seconds a state needs to wait for the sensor before checking the result
+	static float getStateWait(State state);
+
+	// Returns false if the sensor is still measuring. Otherwise `value` is set, or set to NAN if there was an error
+	bool fetchMeasurement(float& value);
+	void changeToState(State newState);
+
+	float m_timeInState = 0;
+	float m_nextTickWait = 0;
+	float m_temperature = NAN;
+	float m_humidity = NAN;
+	bool m_hasReading = false;
+	State m_state = State::Idle;
+	Adafruit_HTU21DF m_htu;
+};
+
+} // namespace cz
@@ -0,0 +1,87 @@
+#include <Arduino.h>
+
+#include "IntStats.h"
+#include <algorithm>
+
+namespace cz
+{
+
+IntStats IntStatsAccumulator::get() const
+{
+	IntStats res;
+	res.count = m_count;
+	if (m_count == 0)
+	{
+		return res;
+	}
+
+	const int64_t n = m_count;
+	res.meanQ8 = static_cast<int32_t>(((m_sum << IntStats::ms_fractionalBits) + n / 2) / n);
+
+	if (m_count > 1)
+	{
+		// variance = (n*sum(x^2) - sum(x)^2) / (n*(n-1))
+		// Shifting by 2*fractionalBits before the division, so the sqrt gives the result in Q8
+		uint64_t num = static_cast<uint64_t>(n * m_sumSq - m_sum * m_sum);
+		uint64_t variance = (num << (2 * IntStats::ms_fractionalBits)) / static_cast<uint64_t>(n * (n - 1));
+		res.stdDeviationQ8 = static_cast<int32_t>(isqrt64(variance));
+	}
+
+	return res;
+}
+
+IntStats calcTrimmedStats(int* samples, int numSamples, int trim)
+{
+	// Insertion sort, since this is used with small arrays, and they tend to be nearly sorted already
+	for (int i = 1; i < numSamples; i++)
+	{
+		int value = samples[i];
+		int j = i;
+		for (; j > 0 && samples[j - 1] > value; j--)
+		{
+			samples[j] = samples[j - 1];
+		}
+		samples[j] = value;
+	}
+
+	// Always leave at least one sample
+	trim = std::clamp(trim, 0, (numSamples - 1) / 2);
+
+	IntStatsAccumulator acc;
+	for (int i = trim; i < numSamples - trim; i++)
+	{
+		acc.add(samples[i]);
+	}
+
+	return acc.get();
+}
+
+uint32_t isqrt64(uint64_t value)
+{
+	uint64_t res = 0;
+	uint64_t bit = uint64_t(1) << 62;
+
+	while (bit > value)
+	{
+		bit >>= 2;
+	}
+
+	while (bit)
+	{
+		if (value >= res + bit)
+		{
+			value -= res + bit;
+			res = (res >> 1) + bit;
+		}
+		else
+		{
+			res >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return static_cast<uint32_t>(res);
+}
+
+} // namespace cz
+
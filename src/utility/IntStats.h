@@ -0,0 +1,131 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace cz
+{
+
+/**
+ * Integer only statistics, for ADC samples.
+ *
+ * The RP2040 has no FPU, so calculating the mean and standard deviation with floats means soft-float division and
+ * sqrt for every reading. The classes here only use integer math. Results are in fixed point (Q8: 8 fractional bits).
+ */
+
+/**
+ * Result of IntStatsAccumulator or calcTrimmedStats
+ */
+struct IntStats
+{
+	static constexpr int ms_fractionalBits = 8;
+
+	int count = 0;
+	int32_t meanQ8 = 0;
+	int32_t stdDeviationQ8 = 0;
+
+	// Mean rounded to the nearest integer
+	int32_t getMean() const
+	{
+		return (meanQ8 + (1 << (ms_fractionalBits - 1))) >> ms_fractionalBits;
+	}
+
+	float getStdDeviation() const
+	{
+		return stdDeviationQ8 / static_cast<float>(1 << ms_fractionalBits);
+	}
+};
+
+/**
+ * Single pass mean/standard deviation accumulator.
+ *
+ * Samples don't need to be kept in a buffer. Welford's algorithm is the usual choice for single pass variance, because
+ * it avoids the catastrophic cancellation of sum(x^2) - sum(x)^2 with floats. With integer samples the sums are exact
+ * if they fit in 64 bits (which for 12 bits samples is millions of samples), so we can keep the plain sums, which
+ * is exact and avoids Welford's per sample division.
+ */
+class IntStatsAccumulator
+{
+  public:
+
+	void reset()
+	{
+		m_count = 0;
+		m_sum = 0;
+		m_sumSq = 0;
+	}
+
+	void add(int32_t value)
+	{
+		m_count++;
+		m_sum += value;
+		m_sumSq += static_cast<int64_t>(value) * value;
+	}
+
+	int getCount() const
+	{
+		return m_count;
+	}
+
+	/**
+	 * Standard deviation is the sample standard deviation (divides by count-1)
+	 */
+	IntStats get() const;
+
+  private:
+	int m_count = 0;
+	int64_t m_sum = 0;
+	int64_t m_sumSq = 0;
+};
+
+/**
+ * Streaming median of K, for spike rejection without keeping a buffer of all the samples.
+ * Every K samples added, it outputs the median of those K samples.
+ */
+template<int K>
+class TMedianOfK
+{
+	static_assert(K > 0 && (K % 2) == 1, "K needs to be an odd number");
+
+  public:
+
+	/**
+	 * Returns true if a median is available, in which case it's put in `median`
+	 */
+	bool add(int32_t value, int32_t& median)
+	{
+		// Insertion sort as values come in, since K is small
+		int i = m_count++;
+		for (; i > 0 && m_values[i - 1] > value; i--)
+		{
+			m_values[i] = m_values[i - 1];
+		}
+		m_values[i] = value;
+
+		if (m_count < K)
+		{
+			return false;
+		}
+
+		median = m_values[K / 2];
+		m_count = 0;
+		return true;
+	}
+
+  private:
+	int32_t m_values[K];
+	int m_count = 0;
+};
+
+/**
+ * Calculates the stats ignoring the `trim` lowest and `trim` highest samples (trimmed mean).
+ * The samples array is sorted in place.
+ */
+IntStats calcTrimmedStats(int* samples, int numSamples, int trim);
+
+/**
+ * Integer square root (floor)
+ */
+uint32_t isqrt64(uint64_t value);
+
+} // namespace cz
+
@@ -20,52 +20,306 @@ public:
 	virtual void digitalWrite(IOExpanderPin pin, uint8_t value) = 0;
 	virtual void pullUp(IOExpanderPin pin, uint8_t value) = 0;
 	virtual uint8_t digitalRead(IOExpanderPin pin) = 0;
+
+	/**
+	 * Write combining.
+	 * Between beginWrites and endWrites, pinMode/digitalWrite/pullUp only change the cached registers, and the changes
+	 * are sent at endWrites (or at an explicit flush). Outside of that, changes are sent right away.
+	 * Calls can be nested. See also MCP23017WriteScope.
+	 */
+	virtual void beginWrites() = 0;
+	virtual void endWrites() = 0;
+	virtual void flush() = 0;
+
+	/**
+	 * Number of I2C transactions and bytes (including the address byte of each transaction) done by all the IO
+	 * expanders so far.
+	 * The mock version counts what the real one would do, so this can be checked without a board.
+	 */
+	static uint32_t getNumI2CTransactions()
+	{
+		return ms_numI2CTransactions;
+	}
+
+	static uint32_t getNumI2CBytes()
+	{
+		return ms_numI2CBytes;
+	}
+
+protected:
+
+	static void countI2C(int transactions, int bytes)
+	{
+		ms_numI2CTransactions += transactions;
+		ms_numI2CBytes += bytes;
+	}
+
+	// What the Adafruit_MCP23017 methods take
+	// pinMode/digitalWrite/pullUp do a read-modify-write of the register: Select register, read, write.
+	static void countReadModifyWrite()
+	{
+		countI2C(3, 2 + 2 + 3);
+	}
+
+	// Select register, read 1 byte
+	static void countRead()
+	{
+		countI2C(2, 2 + 2);
+	}
+
+	// Write both registers of a pair in one go
+	static void countWriteAB()
+	{
+		countI2C(1, 4);
+	}
+
+	inline static uint32_t ms_numI2CTransactions = 0;
+	inline static uint32_t ms_numI2CBytes = 0;
 };
 
-class MCP23017Wrapper : public MCP23017WrapperInterface
+/**
+ * Calls beginWrites/endWrites for the scope
+ */
+class MCP23017WriteScope
 {
   public:
+	explicit MCP23017WriteScope(MCP23017WrapperInterface& ioExpander)
+		: m_ioExpander(ioExpander)
+	{
+		m_ioExpander.beginWrites();
+	}
 
-	virtual void begin(uint8_t addr) override
+	~MCP23017WriteScope()
 	{
-		m_inner.begin(addr);
+		m_ioExpander.endWrites();
 	}
 
-	virtual void begin(void) override
+	MCP23017WriteScope(const MCP23017WriteScope&) = delete;
+	MCP23017WriteScope& operator=(const MCP23017WriteScope&) = delete;
+
+  private:
+	MCP23017WrapperInterface& m_ioExpander;
+};
+
+/**
+ * Keeps a copy of the registers we write to (IODIR, GPPU and OLAT), so that pin changes don't need a read-modify-write
+ * of the register, and several changes can be sent with one 16 bits write (see beginWrites/endWrites).
+ * Changes that don't actually change anything aren't sent at all.
+ *
+ * The copy is only valid if nothing else writes to the IO expander.
+ *
+ * With write combining off (see setWriteCombining and AW_MCP23017_WRITE_COMBINING), changes are sent right away with a
+ * read-modify-write as before, which is useful to compare the I2C traffic.
+ */
+class MCP23017CachedWrapper : public MCP23017WrapperInterface
+{
+  public:
+
+	MCP23017CachedWrapper()
 	{
-		m_inner.begin();
+		resetCache();
 	}
 
 	virtual void pinMode(IOExpanderPin pin, uint8_t mode) override
 	{
-		//CZ_LOG(logDefault, Log, F("ioExpander%d.pinMode(%d, %d)"), (int)m_inner.getAddress(), (int)pin.raw, (int)mode);
-		m_inner.pinMode(pin.raw, mode);
+		updateRegister(Reg::IODIR, pin, mode == INPUT);
 	}
 
 	virtual void digitalWrite(IOExpanderPin pin, uint8_t value) override
 	{
-		//CZ_LOG(logDefault, Log, F("ioExpander%d.digitalWrite(%d, %s)"), (int)m_inner.getAddress(), (int)pin.raw, value==LOW ? "LOW":"HIGH");
-		m_inner.digitalWrite(pin.raw, value);
+		updateRegister(Reg::OLAT, pin, value == HIGH);
 	}
 
 	virtual void pullUp(IOExpanderPin pin, uint8_t value) override
 	{
-		m_inner.pullUp(pin.raw, value);
+		updateRegister(Reg::GPPU, pin, value == HIGH);
+	}
+
+	virtual void beginWrites() override
+	{
+		m_writeDepth++;
+	}
+
+	virtual void endWrites() override
+	{
+		CZ_ASSERT(m_writeDepth > 0);
+		if (--m_writeDepth == 0)
+		{
+			flush();
+		}
+	}
+
+	/**
+	 * Turns write combining on or off. Anything pending is sent first.
+	 */
+	void setWriteCombining(bool enabled)
+	{
+		flush();
+		m_writeCombining = enabled;
+	}
+
+	virtual void flush() override
+	{
+		// Sending the latches before the directions, so a pin becoming an output doesn't glitch
+		for (Register& reg : m_regs)
+		{
+			if (reg.dirty)
+			{
+				reg.dirty = false;
+				writeRegisterAB(reg.addr, reg.value);
+			}
+		}
+	}
+
+  protected:
+
+	enum Reg
+	{
+		GPPU,
+		OLAT,
+		IODIR,
+		Count
+	};
+
+	// Sets the cached registers to what they are after a power-on reset
+	void resetCache()
+	{
+		m_regs[Reg::GPPU] = {MCP23017_GPPUA, 0x0000, false};
+		m_regs[Reg::OLAT] = {MCP23017_OLATA, 0x0000, false};
+		m_regs[Reg::IODIR] = {MCP23017_IODIRA, 0xFFFF, false};
+	}
+
+	/**
+	 * To be called at the end of begin.
+	 * Begin only sets IODIR (all inputs), and if only the MCU was reset, GPPU and OLAT still have whatever they had
+	 * before. Since unchanged pins are never sent, a pin becoming an output would then drive the old latch (e.g: a
+	 * pump left running), so they are written explicitly here, and from then on the cache matches the expander.
+	 */
+	void resetRegisters()
+	{
+		resetCache();
+		writeRegisterAB(MCP23017_GPPUA, m_regs[Reg::GPPU].value);
+		writeRegisterAB(MCP23017_OLATA, m_regs[Reg::OLAT].value);
+	}
+
+	void setCachedOLAT(uint16_t value)
+	{
+		m_regs[Reg::OLAT].value = value;
+		m_regs[Reg::OLAT].dirty = false;
+	}
+
+	// Writes both registers of a pair (e.g: IODIRA and IODIRB) in one go
+	virtual void writeRegisterAB(uint8_t regA, uint16_t value) = 0;
+	// Changes a single pin with a read-modify-write (only used with write combining off)
+	virtual void writePinUncached(Reg reg, IOExpanderPin pin, bool set) = 0;
+
+  private:
+
+	void updateRegister(Reg index, IOExpanderPin pin, bool set)
+	{
+		Register& reg = m_regs[index];
+		uint16_t value = set ? (reg.value | (1 << pin.raw)) : (reg.value & ~(1 << pin.raw));
+
+		if (!m_writeCombining)
+		{
+			reg.value = value;
+			writePinUncached(index, pin, set);
+			return;
+		}
+
+		if (value != reg.value)
+		{
+			reg.value = value;
+			reg.dirty = true;
+		}
+
+		if (m_writeDepth == 0)
+		{
+			flush();
+		}
+	}
+
+	struct Register
+	{
+		uint8_t addr;
+		uint16_t value;
+		bool dirty;
+	};
+
+	Register m_regs[Reg::Count];
+	int m_writeDepth = 0;
+	bool m_writeCombining = AW_MCP23017_WRITE_COMBINING;
+};
+
+class MCP23017Wrapper : public MCP23017CachedWrapper
+{
+  public:
+
+	virtual void begin(uint8_t addr) override
+	{
+		// Sets IODIRA and IODIRB
+		countI2C(2, 6);
+		m_inner.begin(addr);
+		resetRegisters();
+	}
+
+	virtual void begin(void) override
+	{
+		begin(0);
 	}
 
 	virtual uint8_t digitalRead(IOExpanderPin pin) override
 	{
+		countRead();
 		return m_inner.digitalRead(pin.raw);
 	}
 
-	void writeGPIOAB(uint16_t d) { m_inner.writeGPIOAB(d); }
-	uint16_t readGPIOAB() { return m_inner.readGPIOAB(); }
+	void writeGPIOAB(uint16_t d)
+	{
+		countWriteAB();
+		setCachedOLAT(d);
+		m_inner.writeGPIOAB(d);
+	}
+
+	uint16_t readGPIOAB()
+	{
+		countI2C(2, 2 + 3);
+		return m_inner.readGPIOAB();
+	}
+
+  protected:
+
+	virtual void writeRegisterAB(uint8_t regA, uint16_t value) override
+	{
+		//CZ_LOG(logDefault, Log, F("ioExpander%d.writeRegisterAB(0x%x, 0x%x)"), (int)m_inner.getAddress(), (int)regA, (int)value);
+		countWriteAB();
+		m_inner.writeRegisterAB(regA, value);
+	}
+
+	virtual void writePinUncached(Reg reg, IOExpanderPin pin, bool set) override
+	{
+		countReadModifyWrite();
+		switch (reg)
+		{
+		case Reg::GPPU:
+			m_inner.pullUp(pin.raw, set ? HIGH : LOW);
+			break;
+		case Reg::OLAT:
+			m_inner.digitalWrite(pin.raw, set ? HIGH : LOW);
+			break;
+		case Reg::IODIR:
+			m_inner.pinMode(pin.raw, set ? INPUT : OUTPUT);
+			break;
+		default:
+			CZ_UNEXPECTED();
+		}
+	}
 
   private:
 	Adafruit_MCP23017 m_inner;
 };
 
-class MockMCP23017Wrapper : public MCP23017WrapperInterface
+class MockMCP23017Wrapper : public MCP23017CachedWrapper
 {
 public:
 	/**
@@ -74,27 +328,31 @@ public:
 	 */
 	virtual void begin(uint8_t addr) override
 	{
+		countI2C(2, 6);
+		resetRegisters();
 	}
 
 	virtual void begin(void) override
 	{
+		begin(0);
 	}
 
-	virtual void pinMode(IOExpanderPin p, uint8_t d) override
+	virtual uint8_t digitalRead(IOExpanderPin p) override
 	{
+		countRead();
+		return 0;
 	}
 
-	virtual void digitalWrite(IOExpanderPin p, uint8_t d) override
-	{
-	}
+protected:
 
-	virtual void pullUp(IOExpanderPin p, uint8_t d) override
+	virtual void writeRegisterAB(uint8_t regA, uint16_t value) override
 	{
+		countWriteAB();
 	}
 
-	virtual uint8_t digitalRead(IOExpanderPin p) override
+	virtual void writePinUncached(Reg reg, IOExpanderPin pin, bool set) override
 	{
-		return 0;
+		countReadModifyWrite();
 	}
 };
 
@@ -1,9 +1,19 @@
 #include "PinTypes.h"
 #include "MCP23017Wrapper.h"
+#include "crazygaze/micromuc/Logging.h"
 
 namespace cz
 {
 
+/**
+ * Position of a channel when walking the channels in Gray code order (0, 1, 3, 2, 6, 7, 5, 4, ...).
+ * Going through the channels in this order only changes one S pin at a time.
+ */
+constexpr uint8_t muxChannelToGrayCodeOrder(uint8_t channel)
+{
+	return channel ^ (channel >> 1) ^ (channel >> 2) ^ (channel >> 3);
+}
+
 class MuxInterface
 {
   public:
@@ -11,6 +21,30 @@ class MuxInterface
 	virtual void setChannel(MultiplexerPin channel) = 0;
 	virtual int analogRead(MultiplexerPin channel, PinMode zPinMode = INPUT) = 0;
 	virtual void setEnabled(bool enabled) = 0;
+
+	/**
+	 * Sweep window.
+	 * Enabling/disabling the mux is an I2C write. While a sweep is active, disabling the mux is deferred until the
+	 * sweep ends, so reading several channels in a row only enables it once.
+	 * If another mux sharing the same Z pin needs to be enabled in the meantime, this one is disabled anyway.
+	 */
+	virtual void beginSweep() = 0;
+	virtual void endSweep() = 0;
+
+  protected:
+	virtual void writeEnable(bool enabled) = 0;
+
+	// Mux currently enabled, if any. Muxes sharing a Z pin can't be enabled at the same time
+	inline static MuxInterface* ms_enabledMux = nullptr;
+
+	// Disables the mux currently enabled, if it's sharing the specified Z pin
+	static void disableSharedMux(const MuxInterface* except, MCUPin zPin)
+	{
+		if (ms_enabledMux && ms_enabledMux != except && ms_enabledMux->getMCUZPin().raw == zPin.raw)
+		{
+			ms_enabledMux->writeEnable(false);
+		}
+	}
 };
 
 namespace detail
@@ -91,14 +125,58 @@ namespace detail
 
 		virtual void setEnabled(bool enabled) override
 		{
+			MCP23017WriteScope writeScope(*m_ioExpander);
+			if (enabled)
+			{
+				disableSharedMux(this, m_zPin);
+				writeEnable(true);
+			}
+			else if (m_sweepCount == 0)
+			{
+				writeEnable(false);
+			}
+		}
+
+		virtual void beginSweep() override
+		{
+			m_sweepCount++;
+		}
+
+		virtual void endSweep() override
+		{
+			CZ_ASSERT(m_sweepCount > 0);
+			if (--m_sweepCount == 0)
+			{
+				writeEnable(false);
+			}
+		}
+
+	protected:
+		virtual void writeEnable(bool enabled) override
+		{
+			if (m_enabled == enabled)
+			{
+				return;
+			}
+
+			m_enabled = enabled;
 			// LOW - enabled
 			// HIGH - disabled
 			m_ioExpander->digitalWrite(m_enablePin, enabled ? LOW : HIGH);
+
+			if (enabled)
+			{
+				ms_enabledMux = this;
+			}
+			else if (ms_enabledMux == this)
+			{
+				ms_enabledMux = nullptr;
+			}
 		}
 
-	protected:
 		void doBegin()
 		{
+			MCP23017WriteScope writeScope(*m_ioExpander);
 			pinMode(m_zPin.raw, m_zPinMode);
 
 			m_ioExpander->pinMode(m_enablePin, OUTPUT);
@@ -107,7 +185,9 @@ namespace detail
 				m_ioExpander->pinMode(pin, OUTPUT);
 			}
 
-			setEnabled(false);
+			// The IO expander's latches are LOW after begin (enabled), so this disables it
+			m_enabled = true;
+			writeEnable(false);
 		}
 
 		void setChannelImpl(MultiplexerPin channel)
@@ -117,14 +197,20 @@ namespace detail
 				return;
 			}
 
-			m_currChannel = channel.raw;
-
-			// Set s0-sN
-			for (uint8_t i = 0; i < NUM_SPINS ; i++)
+			// Set s0-sN. Only the ones that changed, and all in one I2C write, since they are all in the same IO expander
 			{
-				m_ioExpander->digitalWrite(m_sPins[i], muxChannel[channel.raw][i]);
+				MCP23017WriteScope writeScope(*m_ioExpander);
+				for (uint8_t i = 0; i < NUM_SPINS ; i++)
+				{
+					if (m_currChannel == 255 || muxChannel[m_currChannel][i] != muxChannel[channel.raw][i])
+					{
+						m_ioExpander->digitalWrite(m_sPins[i], muxChannel[channel.raw][i]);
+					}
+				}
 			}
 
+			m_currChannel = channel.raw;
+
 			// Seems like I need this delay after setting the channel ?
 			// In some occasions if the pinMode changed externally and is set above, the first call to this function
 			// after the external use of the MCU's pin wouldn't give the right result.
@@ -139,6 +225,8 @@ namespace detail
 		MCUPin m_zPin;
 		IOExpanderPin m_enablePin;
 		int m_currChannel = 255;
+		bool m_enabled = false;
+		int m_sweepCount = 0;
 
 		union
 		{
@@ -184,11 +272,33 @@ class MuxAnalogInputPin : public AnalogInputPin
 		return m_outer.analogRead(MultiplexerPin(m_pin), PinMode::INPUT);
 	}
 
+	virtual int beginCapture() override
+	{
+		// setChannel leaves the MCU pin's mode as unknown, so the next analogRead sets it up again
+		m_outer.setChannel(MultiplexerPin(m_pin));
+		return m_outer.getMCUZPin().raw;
+	}
+
 	virtual void disable() override
 	{
 		m_outer.setEnabled(false);
 	}
 
+	virtual SweepKey getSweepKey() const override
+	{
+		return {&m_outer, muxChannelToGrayCodeOrder(m_pin)};
+	}
+
+	virtual void beginSweep() override
+	{
+		m_outer.beginSweep();
+	}
+
+	virtual void endSweep() override
+	{
+		m_outer.endSweep();
+	}
+
   private:
 	MuxInterface& m_outer;
 	uint8_t m_pin;
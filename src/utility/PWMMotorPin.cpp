@@ -0,0 +1,274 @@
+#include <Arduino.h>
+
+#include "PWMMotorPin.h"
+#include "../Timer.h"
+#include <crazygaze/micromuc/Logging.h>
+#include <crazygaze/micromuc/StringUtils.h>
+
+#if !AW_PUMP_PWM_SIMULATED
+	#include <hardware/clocks.h>
+	#include <hardware/dma.h>
+	#include <hardware/gpio.h>
+	#include <hardware/pwm.h>
+#endif
+
+namespace cz
+{
+
+extern Timer gTimer;
+
+#if AW_PUMP_PWM_SIMULATED
+// Simulated levels are the duty cycle in 1/10 of a %
+uint16_t PWMMotorPin::ms_top = 1000;
+#else
+// Set when the first pin is created, since it depends on the system clock
+uint16_t PWMMotorPin::ms_top = 0;
+#endif
+uint64_t PWMMotorPin::ms_nextStartMicros = 0;
+PWMMotorPin* PWMMotorPin::ms_first = nullptr;
+
+PWMMotorPin::PWMMotorPin(uint8_t pin)
+	: m_pin(pin)
+{
+	m_next = ms_first;
+	ms_first = this;
+
+#if !AW_PUMP_PWM_SIMULATED
+	const uint32_t sysHz = clock_get_hz(clk_sys);
+	if (ms_top == 0)
+	{
+		CZ_ASSERT(sysHz / AW_PUMP_PWM_FREQUENCY <= 65535);
+		ms_top = sysHz / AW_PUMP_PWM_FREQUENCY;
+
+		// The clock of the ramps. Each time it wraps around, the DMA channels of the pins that are ramping copy the next
+		// step. E.g: At 125MHz, a divider of 250 counts at 500kHz, so a 10ms step is 5000 counts.
+		pwm_config clockCfg = pwm_get_default_config();
+		pwm_config_set_clkdiv(&clockCfg, 250);
+		pwm_config_set_wrap(&clockCfg, sysHz / 250 / 1000 * AW_PUMP_PWM_RAMP_STEP_MS - 1);
+		pwm_init(AW_PUMP_PWM_STEP_CLOCK_SLICE, &clockCfg, true);
+	}
+
+	m_slice = pwm_gpio_to_slice_num(pin);
+	CZ_ASSERT(m_slice != AW_PUMP_PWM_STEP_CLOCK_SLICE);
+	gpio_set_function(pin, GPIO_FUNC_PWM);
+	pwm_config cfg = pwm_get_default_config();
+	// A level of ms_top keeps the output always high
+	pwm_config_set_wrap(&cfg, ms_top - 1);
+	pwm_init(m_slice, &cfg, false);
+	pwm_set_both_levels(m_slice, 0, 0);
+	pwm_set_enabled(m_slice, true);
+
+	m_dmaChannel = dma_claim_unused_channel(true);
+#endif
+}
+
+PWMMotorPin::~PWMMotorPin()
+{
+	PWMMotorPin** ptr = &ms_first;
+	while (*ptr != this)
+	{
+		ptr = &(*ptr)->m_next;
+	}
+	*ptr = m_next;
+
+#if !AW_PUMP_PWM_SIMULATED
+	dma_channel_abort(m_dmaChannel);
+	dma_channel_unclaim(m_dmaChannel);
+	pwm_set_both_levels(m_slice, 0, 0);
+#endif
+}
+
+void PWMMotorPin::write(PinStatus status)
+{
+	write(status, gTimer.getTotalMicros());
+}
+
+void PWMMotorPin::write(PinStatus status, uint64_t nowMicros)
+{
+	bool on = status == PinStatus::HIGH;
+	if (on == m_on)
+	{
+		return;
+	}
+	m_on = on;
+
+	if (on)
+	{
+		// Delay the start if another motor started recently, but only up to what fits in the table
+		uint64_t startMicros = std::max(nowMicros, ms_nextStartMicros);
+		int delaySteps = static_cast<int>((startMicros - nowMicros + ms_stepMicros - 1) / ms_stepMicros);
+		delaySteps = std::min(delaySteps, ms_maxDelaySteps);
+		ms_nextStartMicros = nowMicros + delaySteps * ms_stepMicros + AW_PUMP_PWM_STAGGER_MS * 1000;
+		startRamp(nowMicros, ms_top, delaySteps, (AW_PUMP_PWM_RAMP_UP_MS + AW_PUMP_PWM_RAMP_STEP_MS - 1) / AW_PUMP_PWM_RAMP_STEP_MS);
+	}
+	else
+	{
+		startRamp(nowMicros, 0, 0, (AW_PUMP_PWM_RAMP_DOWN_MS + AW_PUMP_PWM_RAMP_STEP_MS - 1) / AW_PUMP_PWM_RAMP_STEP_MS);
+	}
+}
+
+uint16_t PWMMotorPin::getDuty(uint64_t nowMicros) const
+{
+	return static_cast<uint16_t>(static_cast<uint32_t>(getLevel(nowMicros)) * 1000 / ms_top);
+}
+
+uint16_t PWMMotorPin::getLevel(uint64_t nowMicros) const
+{
+#if AW_PUMP_PWM_SIMULATED
+	if (m_numSteps == 0)
+	{
+		return 0;
+	}
+
+	uint64_t step = nowMicros > m_rampStartMicros ? (nowMicros - m_rampStartMicros) / ms_stepMicros : 0;
+	return m_table[std::min(step, static_cast<uint64_t>(m_numSteps - 1))];
+#else
+	// Both channels have the same level, since the DMA writes 16 bits
+	return static_cast<uint16_t>(pwm_hw->slice[m_slice].cc);
+#endif
+}
+
+float PWMMotorPin::applyCurve(float x)
+{
+	switch (static_cast<Curve>(AW_PUMP_PWM_RAMP_CURVE))
+	{
+		case Curve::SCurve:
+			return x * x * (3.0f - 2.0f * x);
+		case Curve::Quadratic:
+			return x * x;
+		default:
+			return x;
+	}
+}
+
+void PWMMotorPin::startRamp(uint64_t nowMicros, uint16_t to, int delaySteps, int fullRampSteps)
+{
+#if AW_PUMP_PWM_SIMULATED
+	recordTimeline(nowMicros);
+#else
+	// Stop where it is, so the new ramp continues from there
+	dma_channel_abort(m_dmaChannel);
+#endif
+
+	const int from = getLevel(nowMicros);
+	const int minLevel = ms_top * AW_PUMP_PWM_MIN_DUTY / 100;
+	int numSteps = 0;
+	for (; numSteps < delaySteps; numSteps++)
+	{
+		m_table[numSteps] = from;
+	}
+
+	// Ramps go between the minimum level and full, since the motor doesn't spin below the minimum. If a previous ramp
+	// didn't finish, only the remaining part of the ramp is done.
+	const int start = to ? std::max(from, minLevel) : from;
+	const int end = to ? to : std::min(from, minLevel);
+	const int rampSteps = std::max((fullRampSteps * std::abs(end - start) + (ms_top - minLevel) - 1) / (ms_top - minLevel), 1);
+	for (int i = 1; i <= rampSteps; i++)
+	{
+		m_table[numSteps++] = static_cast<uint16_t>(start + (end - start) * applyCurve(i / static_cast<float>(rampSteps)));
+	}
+
+	if (to == 0)
+	{
+		m_table[numSteps - 1] = 0;
+	}
+
+	CZ_ASSERT(numSteps <= static_cast<int>(std::size(m_table)));
+	m_numSteps = numSteps;
+
+#if AW_PUMP_PWM_SIMULATED
+	m_rampStartMicros = nowMicros;
+	m_numRecorded = 0;
+#else
+	// NOTE: Unverified. No board drives the motors from MCU pins yet, so this has never run on real hardware.
+	dma_channel_config cfg = dma_channel_get_default_config(m_dmaChannel);
+	channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+	channel_config_set_read_increment(&cfg, true);
+	channel_config_set_write_increment(&cfg, false);
+	channel_config_set_dreq(&cfg, pwm_get_dreq(AW_PUMP_PWM_STEP_CLOCK_SLICE));
+	dma_channel_configure(m_dmaChannel, &cfg, &pwm_hw->slice[m_slice].cc, m_table, numSteps, true);
+#endif
+}
+
+#if AW_PUMP_PWM_SIMULATED
+
+void PWMMotorPin::recordTimeline(uint64_t nowMicros)
+{
+	if (m_numSteps == 0)
+	{
+		return;
+	}
+
+	int reached = m_numSteps;
+	if (nowMicros < m_rampStartMicros + (m_numSteps - 1) * ms_stepMicros)
+	{
+		reached = nowMicros > m_rampStartMicros ? static_cast<int>((nowMicros - m_rampStartMicros) / ms_stepMicros) + 1 : 1;
+	}
+
+	for (; m_numRecorded < reached; m_numRecorded++)
+	{
+		uint16_t duty = static_cast<uint16_t>(static_cast<uint32_t>(m_table[m_numRecorded]) * 1000 / ms_top);
+		uint32_t timeMs = static_cast<uint32_t>((m_rampStartMicros + m_numRecorded * ms_stepMicros) / 1000);
+		if (m_timelineCount)
+		{
+			TimelineEntry& last = m_timeline[(m_timelineStart + m_timelineCount - 1) % AW_PUMP_PWM_TIMELINE_SIZE];
+			if (last.timeMs == timeMs)
+			{
+				// A new ramp started at the same time as a step of the previous one, and replaced it
+				last.duty = duty;
+				continue;
+			}
+			else if (last.duty == duty)
+			{
+				continue;
+			}
+		}
+
+		if (m_timelineCount == AW_PUMP_PWM_TIMELINE_SIZE)
+		{
+			// Full, so drop the oldest
+			m_timelineStart = (m_timelineStart + 1) % AW_PUMP_PWM_TIMELINE_SIZE;
+			m_timelineCount--;
+		}
+
+		TimelineEntry& entry = m_timeline[(m_timelineStart + m_timelineCount) % AW_PUMP_PWM_TIMELINE_SIZE];
+		entry.timeMs = timeMs;
+		entry.duty = duty;
+		m_timelineCount++;
+	}
+}
+
+int PWMMotorPin::getTimeline(TimelineEntry* dst, int maxEntries, uint64_t nowMicros)
+{
+	recordTimeline(nowMicros);
+	int count = std::min(m_timelineCount, maxEntries);
+	for (int i = 0; i < count; i++)
+	{
+		dst[i] = m_timeline[(m_timelineStart + i) % AW_PUMP_PWM_TIMELINE_SIZE];
+	}
+	return count;
+}
+
+void PWMMotorPin::logTimeline()
+{
+	recordTimeline(gTimer.getTotalMicros());
+	CZ_LOG(logDefault, Log, F("PWMMotorPin %u: %d duty cycle changes"), static_cast<unsigned int>(m_pin), m_timelineCount);
+	for (int i = 0; i < m_timelineCount; i++)
+	{
+		const TimelineEntry& entry = m_timeline[(m_timelineStart + i) % AW_PUMP_PWM_TIMELINE_SIZE];
+		CZ_LOG(logDefault, Log, F("    %ums: %s%%"), static_cast<unsigned int>(entry.timeMs), *FloatToString(entry.duty / 10.0f));
+	}
+}
+
+void PWMMotorPin::clearTimeline()
+{
+	// Record first, so what was already played doesn't show up later
+	recordTimeline(gTimer.getTotalMicros());
+	m_timelineStart = 0;
+	m_timelineCount = 0;
+}
+
+#endif
+
+} // namespace cz
+
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "PinTypes.h"
+#include <algorithm>
+
+namespace cz
+{
+
+/**
+ * Motor output that ramps the motor up/down with PWM, instead of switching it hard on and off (see AW_PUMP_PWM).
+ *
+ * Turning on ramps the duty cycle from AW_PUMP_PWM_MIN_DUTY to 100% in AW_PUMP_PWM_RAMP_UP_MS, and turning off ramps it
+ * down to 0 in AW_PUMP_PWM_RAMP_DOWN_MS, following the AW_PUMP_PWM_RAMP_CURVE shape. Changing direction half way
+ * continues from the current duty cycle.
+ * Motor starts are staggered: If another motor started less than AW_PUMP_PWM_STAGGER_MS ago, the ramp is delayed, so
+ * the start up currents don't add up.
+ *
+ * On the RP2040, the whole ramp is computed when write() is called, and a DMA channel copies it into the PWM level
+ * register one step at a time, paced by another PWM slice (AW_PUMP_PWM_STEP_CLOCK_SLICE) used as a clock. There is no
+ * CPU work while ramping.
+ * The DMA writes 16 bits to the slice's level register, which sets both channels, so the pin's slice can't be used by
+ * anything else.
+ * NOTE: The hardware path is unverified. No board uses it yet (the Greenhouse motors are behind the IO expander, so it
+ * only supports AW_PUMP_PWM_SIMULATED), so the DMA and PWM setup have never run on a real RP2040.
+ *
+ * With AW_PUMP_PWM_SIMULATED, no hardware is used, and the duty cycle changes are recorded in a timeline instead.
+ */
+class PWMMotorPin : public DigitalOutputPin
+{
+  public:
+
+	enum class Curve : uint8_t
+	{
+		Linear,
+		SCurve,
+		Quadratic
+	};
+
+	PWMMotorPin(const PWMMotorPin&) = delete;
+	PWMMotorPin& operator=(const PWMMotorPin&) = delete;
+	explicit PWMMotorPin(uint8_t pin);
+	virtual ~PWMMotorPin();
+
+	//
+	// DigitalOutputPin interface
+	//
+	virtual void write(PinStatus status) override;
+
+	/**
+	 * Same as write(status), but at the specified time instead of now
+	 */
+	void write(PinStatus status, uint64_t nowMicros);
+
+	/**
+	 * Duty cycle at the specified time, in 1/10 of a % (0..1000)
+	 */
+	uint16_t getDuty(uint64_t nowMicros) const;
+
+	uint8_t getPin() const
+	{
+		return m_pin;
+	}
+
+	/**
+	 * For iterating through all the pins
+	 */
+	static PWMMotorPin* getFirst()
+	{
+		return ms_first;
+	}
+
+	PWMMotorPin* getNext() const
+	{
+		return m_next;
+	}
+
+#if AW_PUMP_PWM_SIMULATED
+	struct TimelineEntry
+	{
+		// Time since boot, in milliseconds
+		uint32_t timeMs;
+		// 1/10 of a % (0..1000)
+		uint16_t duty;
+	};
+
+	/**
+	 * Copies the oldest duty cycle changes up to the specified time into dst, and returns how many were copied.
+	 * Only changes are recorded, so the duty cycle stays the same until the next entry.
+	 */
+	int getTimeline(TimelineEntry* dst, int maxEntries, uint64_t nowMicros);
+	void logTimeline();
+	void clearTimeline();
+#endif
+
+  private:
+
+	// How many ramp steps a full ramp up/down takes
+	static constexpr int ms_rampSteps = (std::max(AW_PUMP_PWM_RAMP_UP_MS, AW_PUMP_PWM_RAMP_DOWN_MS) + AW_PUMP_PWM_RAMP_STEP_MS - 1) / AW_PUMP_PWM_RAMP_STEP_MS;
+	// How many ramp steps a start can be delayed by. More pumps than AW_MAX_SIMULTANEOUS_PUMPS starting at once will
+	// overlap.
+	static constexpr int ms_maxDelaySteps = ((AW_MAX_SIMULTANEOUS_PUMPS - 1) * AW_PUMP_PWM_STAGGER_MS + AW_PUMP_PWM_RAMP_STEP_MS - 1) / AW_PUMP_PWM_RAMP_STEP_MS;
+	static constexpr uint32_t ms_stepMicros = AW_PUMP_PWM_RAMP_STEP_MS * 1000;
+
+	// Current PWM level. Level ms_top is 100%
+	uint16_t getLevel(uint64_t nowMicros) const;
+
+	/**
+	 * Fills m_table with delaySteps steps at the current level, followed by the ramp to the specified level, and starts
+	 * playing it.
+	 */
+	void startRamp(uint64_t nowMicros, uint16_t to, int delaySteps, int fullRampSteps);
+
+	static float applyCurve(float x);
+
+	uint8_t m_pin;
+	bool m_on = false;
+	uint16_t m_table[ms_maxDelaySteps + ms_rampSteps];
+	int m_numSteps = 0;
+	PWMMotorPin* m_next;
+
+#if AW_PUMP_PWM_SIMULATED
+	// Adds the ramp steps played until the specified time to the timeline
+	void recordTimeline(uint64_t nowMicros);
+
+	uint64_t m_rampStartMicros = 0;
+	// How many steps of the current ramp are already in the timeline
+	int m_numRecorded = 0;
+	TimelineEntry m_timeline[AW_PUMP_PWM_TIMELINE_SIZE];
+	// Ring buffer
+	int m_timelineStart = 0;
+	int m_timelineCount = 0;
+#else
+	uint8_t m_slice;
+	int m_dmaChannel;
+#endif
+
+	// PWM level for 100% duty cycle
+	static uint16_t ms_top;
+	// Time before which no other motor should start
+	static uint64_t ms_nextStartMicros;
+	static PWMMotorPin* ms_first;
+};
+
+} // namespace cz
+
@@ -74,6 +74,43 @@ class AnalogInputPin
 	*/
 	virtual int read() = 0;
 
+	/**
+	 * Prepares the pin to be sampled directly with the MCU's ADC (e.g: with ADCCapture) instead of with read().
+	 * Returns what MCU pin to sample, or -1 if this pin doesn't support it, in which case read() needs to be used.
+	 * Like read(), this can only be used between enable() and disable().
+	 */
+	virtual int beginCapture()
+	{
+		return -1;
+	}
+
+	/**
+	 * Batch sweep support.
+	 * When reading several pins in a row, pins that share something expensive to enable (e.g: a mux behind an IO
+	 * expander) should be read together, in the order given by the key, and can keep it enabled between beginSweep and
+	 * endSweep instead of around every reading.
+	 */
+	struct SweepKey
+	{
+		// Pins with the same group share whatever is kept enabled. nullptr if the pin doesn't belong to any group.
+		const void* group = nullptr;
+		// Order in which to read the pins of the same group
+		int order = 0;
+	};
+
+	virtual SweepKey getSweepKey() const
+	{
+		return {};
+	}
+
+	virtual void beginSweep()
+	{
+	}
+
+	virtual void endSweep()
+	{
+	}
+
 	/**
 	 * This is called when done using the pin. No further calls to read() are done until another call to enable() happens.
 	*/
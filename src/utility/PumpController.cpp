@@ -0,0 +1,133 @@
+#include <Arduino.h>
+
+#include "PumpController.h"
+#include <crazygaze/micromuc/Logging.h>
+#include <crazygaze/micromuc/StringUtils.h>
+#include <algorithm>
+
+namespace cz
+{
+
+namespace
+{
+	const char* const gModeNames[3] =
+	{
+		"Fixed",
+		"Predictive",
+		"PulseAndSoak"
+	};
+}
+
+const char* PumpController::modeToString(Mode mode)
+{
+	return gModeNames[static_cast<int>(mode)];
+}
+
+float PumpController::calcShotDuration(Mode mode, unsigned int value, unsigned int targetValue, float shotDuration) const
+{
+	if (!usesModel(mode))
+	{
+		// Nothing learned yet, so the predictive modes do a normal shot too
+		return shotDuration;
+	}
+
+	float needed = static_cast<float>(value) - targetValue;
+	float duration = needed / m_model.gain;
+	float maxDuration = mode == Mode::PulseAndSoak ? shotDuration : AW_SHOT_MAX_DURATION;
+	return std::clamp(duration, 1.0f, std::max(maxDuration, 1.0f));
+}
+
+float PumpController::calcSoakDuration(Mode mode, float shotDuration) const
+{
+	float soakDuration = AW_MINIMUM_TIME_BETWEEN_MOTOR_ON;
+	if (usesModel(mode))
+	{
+		soakDuration = std::max(soakDuration, m_model.delay - shotDuration);
+	}
+	return soakDuration;
+}
+
+void PumpController::startShot(unsigned int value, float shotDuration, uint64_t micros)
+{
+	finishResponse();
+
+	if (value == 0)
+	{
+		// No reading to compare against
+		return;
+	}
+
+	m_response.active = true;
+	m_response.startValue = m_response.minValue = value;
+	m_response.shotDuration = shotDuration;
+	m_response.startMicros = m_response.minMicros = micros;
+}
+
+void PumpController::setShotDuration(float shotDuration)
+{
+	if (m_response.active)
+	{
+		m_response.shotDuration = shotDuration;
+	}
+}
+
+void PumpController::addReading(unsigned int value, uint64_t micros)
+{
+	if (!m_response.active)
+	{
+		return;
+	}
+
+	if (value < m_response.minValue)
+	{
+		m_response.minValue = value;
+		m_response.minMicros = micros;
+	}
+	else if (
+		// Drying again, so we already saw the full effect
+		(m_response.minValue < m_response.startValue && value > m_response.minValue + AW_PUMP_MODEL_NOISE) ||
+		(micros - m_response.startMicros) > static_cast<uint64_t>(AW_PUMP_MODEL_MAX_RESPONSE_TIME) * 1000000)
+	{
+		finishResponse();
+	}
+}
+
+void PumpController::finishResponse()
+{
+	if (!m_response.active)
+	{
+		return;
+	}
+	m_response.active = false;
+
+	if (m_response.minValue >= m_response.startValue || m_response.shotDuration <= 0)
+	{
+		// The shot had no visible effect (e.g: Empty reservoir). Not something the model should learn.
+		CZ_LOG(logDefault, Warning, F("Group %d: Shot had no effect on the sensor"), m_index);
+		return;
+	}
+
+	float gain = (m_response.startValue - m_response.minValue) / m_response.shotDuration;
+	float delay = (m_response.minMicros - m_response.startMicros) / 1000000.0f;
+	if (m_model.numSamples == 0)
+	{
+		m_model.gain = gain;
+		m_model.delay = delay;
+	}
+	else
+	{
+		m_model.gain += (gain - m_model.gain) * AW_PUMP_MODEL_LEARNING_RATE;
+		m_model.delay += (delay - m_model.delay) * AW_PUMP_MODEL_LEARNING_RATE;
+	}
+	m_model.numSamples++;
+
+	CZ_LOG(logDefault, Log, F("Group %d: Shot response gain=%s/s delay=%ss (model gain=%s/s delay=%ss), drop=%u")
+		, m_index
+		, *FloatToString(gain)
+		, *FloatToString(delay)
+		, *FloatToString(m_model.gain)
+		, *FloatToString(m_model.delay)
+		, m_response.startValue - m_response.minValue);
+}
+
+} // namespace cz
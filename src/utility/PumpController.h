@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace cz
+{
+
+/**
+ * Decides how long automated shots are, and how long to wait after them, for one group (see AW_PUMP_CONTROLLER).
+ *
+ * The predictive modes learn, online, how much the sensor value drops per second of pumping (gain), and how long the
+ * sensor takes to show the full effect of a shot (delay). Both are taken from the lowest reading after each shot, and
+ * blended in with an EMA (AW_PUMP_MODEL_LEARNING_RATE).
+ * Until something was learned, all modes behave like Fixed.
+ */
+class PumpController
+{
+  public:
+
+	// See AW_PUMP_CONTROLLER
+	enum class Mode : uint8_t
+	{
+		Fixed,
+		Predictive,
+		PulseAndSoak
+	};
+
+	static const char* modeToString(Mode mode);
+
+	struct Model
+	{
+		// Sensor units the value drops per second of pumping
+		float gain = 0;
+		// Seconds from the motor turning on until the sensor shows the full effect
+		float delay = 0;
+		int numSamples = 0;
+	};
+
+	explicit PumpController(uint8_t index)
+		: m_index(index)
+	{
+	}
+
+	/**
+	 * Tells if the mode sizes the shots with the learned model, and so readings taken while soaking should not be used to
+	 * decide on another shot, since they don't show the full effect of the last shot yet.
+	 */
+	bool usesModel(Mode mode) const
+	{
+		return mode != Mode::Fixed && m_model.numSamples && m_model.gain > 0;
+	}
+
+	/**
+	 * Duration in seconds of the next automated shot
+	 * \param value Last valid sensor reading
+	 * \param targetValue How low the sensor value should go
+	 * \param shotDuration The group's shot duration
+	 */
+	float calcShotDuration(Mode mode, unsigned int value, unsigned int targetValue, float shotDuration) const;
+
+	/**
+	 * How long to wait after the motor turns off, before another automated shot.
+	 * With the predictive modes this is long enough for the sensor to show the effect of the shot.
+	 */
+	float calcSoakDuration(Mode mode, float shotDuration) const;
+
+	/**
+	 * Starts looking for the effect of a shot on the sensor.
+	 * If the previous shot's full effect wasn't seen yet, it learns from what was seen so far.
+	 * \param value Last valid sensor reading, or 0 if there is none, in which case nothing is learned from this shot
+	 */
+	void startShot(unsigned int value, float shotDuration, uint64_t micros);
+
+	// Updates the duration of the current shot, if the motor was turned off sooner than planned
+	void setShotDuration(float shotDuration);
+
+	// Forgets the current shot (e.g: a pump fault), so the model doesn't learn from it
+	void cancelShot()
+	{
+		m_response.active = false;
+	}
+
+	void addReading(unsigned int value, uint64_t micros);
+
+	const Model& getModel() const
+	{
+		return m_model;
+	}
+
+  private:
+
+	void finishResponse();
+
+	uint8_t m_index;
+	Model m_model;
+
+	// Response to the last shot, while we are still looking for its full effect
+	struct Response
+	{
+		bool active = false;
+		unsigned int startValue;
+		unsigned int minValue;
+		float shotDuration;
+		uint64_t startMicros;
+		uint64_t minMicros;
+	} m_response;
+};
+
+} // namespace cz
@@ -0,0 +1,150 @@
+#include <Arduino.h>
+
+#include "PumpCurrentDetector.h"
+#include <algorithm>
+#include <math.h>
+
+namespace cz
+{
+
+namespace
+{
+	const char* const gFaultNames[4] =
+	{
+		"None",
+		"Stall",
+		"DryRun",
+		"OpenCircuit"
+	};
+
+	// Generated waveform parameters, as a factor of the nominal current
+	constexpr float gInrushPeak = 2.0f;
+	constexpr float gInrushDecay = 0.04f; // seconds
+	constexpr float gLockedRotor = 3.0f;
+	constexpr float gNoLoad = 0.35f;
+	constexpr float gRipple = 0.1f;
+	constexpr float gRippleFrequency = 120.0f;
+	constexpr float gNoise = 0.08f;
+
+	// Deterministic pseudo random numbers, so the generated waveforms are the same every time
+	float waveformRandom(uint32_t& seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) / static_cast<float>(1 << 24);
+	}
+}
+
+const char* PumpCurrentDetector::faultToString(Fault fault)
+{
+	return gFaultNames[static_cast<int>(fault)];
+}
+
+void PumpCurrentDetector::start(float nominal)
+{
+	m_nominal = nominal;
+	m_filtered = nominal;
+	m_elapsed = 0;
+	m_candidate = Fault::None;
+	m_candidateTime = 0;
+}
+
+PumpCurrentDetector::Fault PumpCurrentDetector::classify(float current) const
+{
+	if (current < m_nominal * AW_PUMP_CURRENT_OPEN_PERCENT / 100.0f)
+	{
+		return Fault::OpenCircuit;
+	}
+	else if (current < m_nominal * AW_PUMP_CURRENT_DRYRUN_PERCENT / 100.0f)
+	{
+		return Fault::DryRun;
+	}
+	else if (current > m_nominal * AW_PUMP_CURRENT_STALL_PERCENT / 100.0f)
+	{
+		return Fault::Stall;
+	}
+	else
+	{
+		return Fault::None;
+	}
+}
+
+PumpCurrentDetector::Fault PumpCurrentDetector::process(const float* samples, int numSamples, uint32_t sampleRate)
+{
+	const float dt = 1.0f / sampleRate;
+	if (sampleRate != m_sampleRate)
+	{
+		m_sampleRate = sampleRate;
+		m_alpha = 1.0f - expf(-dt / (AW_PUMP_CURRENT_FILTER_MS / 1000.0f));
+	}
+
+	constexpr float inrush = AW_PUMP_CURRENT_INRUSH_MS / 1000.0f;
+	constexpr float confirm = AW_PUMP_CURRENT_CONFIRM_MS / 1000.0f;
+
+	for (int i = 0; i < numSamples; i++)
+	{
+		m_elapsed += dt;
+		m_filtered += (samples[i] - m_filtered) * m_alpha;
+		if (m_elapsed < inrush)
+		{
+			continue;
+		}
+
+		Fault fault = classify(m_filtered);
+		if (fault != m_candidate)
+		{
+			m_candidate = fault;
+			m_candidateTime = 0;
+		}
+		else if (fault != Fault::None)
+		{
+			m_candidateTime += dt;
+			if (m_candidateTime >= confirm)
+			{
+				return fault;
+			}
+		}
+	}
+
+	return Fault::None;
+}
+
+float PumpCurrentWaveform::sample(float t)
+{
+	if (t < 0)
+	{
+		return 0;
+	}
+
+	float level = 1.0f;
+	bool inrush = true;
+	if (fault != PumpCurrentDetector::Fault::None && t >= faultTime)
+	{
+		switch (fault)
+		{
+			case PumpCurrentDetector::Fault::Stall:
+				level = gLockedRotor;
+				inrush = false;
+			break;
+			case PumpCurrentDetector::Fault::DryRun:
+				level = gNoLoad;
+			break;
+			default:
+				// Nothing but noise
+				level = 0;
+				inrush = false;
+			break;
+		}
+	}
+
+	float value = level;
+	if (inrush)
+	{
+		value += gInrushPeak * expf(-t / gInrushDecay);
+	}
+	value += level * gRipple * sinf(2.0f * PI * gRippleFrequency * t);
+	value += (waveformRandom(seed) * 2.0f - 1.0f) * std::max(level, 0.1f) * gNoise;
+	return std::max(value * nominal, 0.0f);
+}
+
+} // namespace cz
+
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace cz
+{
+
+/**
+ * Detects pump faults from the pump's current, sampled while the motor runs.
+ *
+ * Samples are fed in blocks as they are captured. Each sample goes through a low pass filter (to remove the motor's
+ * ripple and noise), and the filtered current is compared against the pump's nominal current:
+ * - Stall: Well above nominal (e.g: Something blocking the impeller)
+ * - DryRun: Well below nominal. The pump is spinning without load (e.g: The reservoir is empty)
+ * - OpenCircuit: About 0. The motor is not connected, or the driver didn't turn it on
+ *
+ * A fault is only reported once the current stays in the same range for AW_PUMP_CURRENT_CONFIRM_MS. The first
+ * AW_PUMP_CURRENT_INRUSH_MS after the motor turns on are ignored, since the current at startup is always high.
+ */
+class PumpCurrentDetector
+{
+  public:
+
+	enum class Fault : uint8_t
+	{
+		None,
+		Stall,
+		DryRun,
+		OpenCircuit
+	};
+
+	static const char* faultToString(Fault fault);
+
+	/**
+	 * Starts detecting, for a motor that just turned on
+	 * @param nominal Current (mA) the pump draws when working normally
+	 */
+	void start(float nominal);
+
+	/**
+	 * Feeds a block of samples, in mA.
+	 * Returns the fault once it's confirmed, or Fault::None
+	 */
+	Fault process(const float* samples, int numSamples, uint32_t sampleRate);
+
+	// Time since start() (as per the samples fed so far), in seconds
+	float getElapsed() const
+	{
+		return m_elapsed;
+	}
+
+	float getFilteredCurrent() const
+	{
+		return m_filtered;
+	}
+
+  private:
+
+	Fault classify(float current) const;
+
+	float m_nominal = 0;
+	float m_filtered = 0;
+	float m_elapsed = 0;
+	Fault m_candidate = Fault::None;
+	float m_candidateTime = 0;
+	// Sample rate and filter coefficient of the last block, so it's only calculated when the sample rate changes
+	uint32_t m_sampleRate = 0;
+	float m_alpha = 0;
+};
+
+/**
+ * Generates what a pump's current looks like, for the mock components and the tests.
+ *
+ * A normal run has an inrush at startup, followed by the nominal current with the motor's ripple plus noise.
+ * At the specified time a fault kicks in: A stall goes to the locked rotor current, a dry run drops to the no load
+ * current, and an open circuit drops to 0.
+ */
+struct PumpCurrentWaveform
+{
+	// Nominal current (mA)
+	float nominal = AW_PUMP_DEFAULT_CURRENT_MA;
+	PumpCurrentDetector::Fault fault = PumpCurrentDetector::Fault::None;
+	// Seconds since the motor turned on
+	float faultTime = 0;
+	uint32_t seed = 1;
+
+	/**
+	 * Current (mA) at the specified time since the motor turned on
+	 */
+	float sample(float t);
+};
+
+} // namespace cz
+
@@ -0,0 +1,194 @@
+#include <Arduino.h>
+
+#include "SensorDriftEstimator.h"
+#include <crazygaze/micromuc/Logging.h>
+#include <crazygaze/micromuc/StringUtils.h>
+#include <algorithm>
+#include <iterator>
+
+namespace cz
+{
+
+namespace
+{
+	// Minimum tolerance in sensor units, so a group with a very narrow range (e.g: not calibrated yet) doesn't flag
+	// drift because of noise alone
+	constexpr float gMinTolerance = 5.0f;
+	// How fast the noise estimate follows the readings
+	constexpr float gNoiseRate = 1.0f / 16;
+	// How fast the saturation level follows new samples
+	constexpr float gSaturationRate = 0.25f;
+	// How much a shot needs to lower the readings to count as having an effect
+	constexpr unsigned int gMinShotResponse = 3;
+}
+
+void SensorDriftEstimator::reset()
+{
+	*this = SensorDriftEstimator();
+}
+
+void SensorDriftEstimator::addReading(unsigned int value, float standardDeviation)
+{
+	const float v = static_cast<float>(value);
+	if (m_numReadings == 0)
+	{
+		m_envelopeMin = m_envelopeMax = v;
+		m_noise = standardDeviation;
+	}
+	else
+	{
+		// Values outside the envelope expand it right away. Values inside slowly pull it in.
+		constexpr float rate = 1.0f / AW_SENSOR_DRIFT_ENVELOPE_READINGS;
+		m_envelopeMin = v < m_envelopeMin ? v : m_envelopeMin + (v - m_envelopeMin) * rate;
+		m_envelopeMax = v > m_envelopeMax ? v : m_envelopeMax + (v - m_envelopeMax) * rate;
+		m_noise += (standardDeviation - m_noise) * gNoiseRate;
+	}
+
+	m_numReadings++;
+	m_lastValue = value;
+
+	if (m_saturationReadingsLeft)
+	{
+		m_shotMinValue = std::min(m_shotMinValue, value);
+		if (--m_saturationReadingsLeft == 0)
+		{
+			if (m_shotMinValue + gMinShotResponse > m_shotStartValue)
+			{
+				m_numShotsWithoutResponse = std::min(m_numShotsWithoutResponse + 1, 255);
+			}
+			else
+			{
+				m_numShotsWithoutResponse = 0;
+				m_saturation = m_numSaturationSamples
+					? m_saturation + (m_shotMinValue - m_saturation) * gSaturationRate
+					: m_shotMinValue;
+				m_numSaturationSamples++;
+			}
+		}
+	}
+}
+
+void SensorDriftEstimator::onShot()
+{
+	if (m_numReadings == 0)
+	{
+		return;
+	}
+
+	// If a shot happens while still looking at the previous one, it's the same watering as far as saturation goes
+	if (m_saturationReadingsLeft == 0)
+	{
+		m_shotStartValue = m_lastValue;
+		m_shotMinValue = m_lastValue;
+	}
+	m_saturationReadingsLeft = AW_SENSOR_DRIFT_SATURATION_READINGS;
+}
+
+float SensorDriftEstimator::calcTolerance(unsigned int airValue, unsigned int waterValue) const
+{
+	float range = static_cast<float>(airValue) - static_cast<float>(waterValue);
+	return std::max(range * AW_SENSOR_DRIFT_TOLERANCE_PERCENT / 100.0f, gMinTolerance);
+}
+
+uint8_t SensorDriftEstimator::calcFlags(unsigned int airValue, unsigned int waterValue) const
+{
+	if (m_numReadings < AW_SENSOR_DRIFT_MIN_READINGS)
+	{
+		return Flags::None;
+	}
+
+	const float tolerance = calcTolerance(airValue, waterValue);
+	uint8_t flags = Flags::None;
+
+	if (m_envelopeMax > airValue + tolerance)
+	{
+		flags |= Flags::AboveAir;
+	}
+
+	float wettest = m_numSaturationSamples ? std::min(m_envelopeMin, m_saturation) : m_envelopeMin;
+	if (wettest < waterValue - tolerance)
+	{
+		flags |= Flags::BelowWater;
+	}
+
+	if (m_noise > AW_MOISTURESENSOR_ACCEPTABLE_STANDARD_DEVIATION / 2.0f)
+	{
+		flags |= Flags::Noisy;
+	}
+
+	if (m_numShotsWithoutResponse >= AW_SENSOR_DRIFT_MAX_SHOTS_WITHOUT_RESPONSE)
+	{
+		flags |= Flags::NoResponse;
+	}
+
+	return flags;
+}
+
+bool SensorDriftEstimator::calcProposal(unsigned int airValue, unsigned int waterValue, unsigned int& proposedAirValue,
+                                        unsigned int& proposedWaterValue) const
+{
+	uint8_t flags = calcFlags(airValue, waterValue);
+	proposedAirValue = airValue;
+	proposedWaterValue = waterValue;
+
+	if (flags & Flags::AboveAir)
+	{
+		proposedAirValue = static_cast<unsigned int>(m_envelopeMax + 0.5f);
+	}
+
+	if (flags & Flags::BelowWater)
+	{
+		float wettest = m_numSaturationSamples ? std::min(m_envelopeMin, m_saturation) : m_envelopeMin;
+		proposedWaterValue = static_cast<unsigned int>(std::max(wettest + 0.5f, 0.0f));
+	}
+
+	return proposedAirValue != airValue || proposedWaterValue != waterValue;
+}
+
+void SensorDriftEstimator::flagsToString(uint8_t flags, char* buf, int bufSize)
+{
+	static const char* const names[] = {"AboveAir", "BelowWater", "Noisy", "NoResponse"};
+
+	CZ_ASSERT(bufSize > 0);
+	buf[0] = 0;
+	for (int i = 0; i < static_cast<int>(std::size(names)); i++)
+	{
+		if (flags & (1 << i))
+		{
+			int len = strlen(buf);
+			snprintf(buf + len, bufSize - len, "%s%s", len ? "," : "", names[i]);
+		}
+	}
+
+	if (buf[0] == 0)
+	{
+		snprintf(buf, bufSize, "OK");
+	}
+}
+
+void SensorDriftEstimator::log(uint8_t index, unsigned int airValue, unsigned int waterValue) const
+{
+	char flags[48];
+	flagsToString(calcFlags(airValue, waterValue), flags, sizeof(flags));
+	unsigned int proposedAir, proposedWater;
+	bool hasProposal = calcProposal(airValue, waterValue, proposedAir, proposedWater);
+
+	CZ_LOG(logDefault, Log, F("Group %u sensor drift: %s. readings=%u, envelope=[%s,%s], saturation=%s (%u shots), noise=%s, shots without response=%u, air/water=%u/%u, proposed=%u/%u%s")
+		, static_cast<unsigned int>(index)
+		, flags
+		, static_cast<unsigned int>(m_numReadings)
+		, *FloatToString(m_envelopeMin)
+		, *FloatToString(m_envelopeMax)
+		, *FloatToString(m_saturation)
+		, static_cast<unsigned int>(m_numSaturationSamples)
+		, *FloatToString(m_noise)
+		, static_cast<unsigned int>(m_numShotsWithoutResponse)
+		, airValue
+		, waterValue
+		, proposedAir
+		, proposedWater
+		, hasProposal ? "" : " (no change)");
+}
+
+} // namespace cz
+
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace cz
+{
+
+/**
+ * Detects soil moisture sensor drift, and failing sensors.
+ *
+ * Capacitive sensors drift with temperature and age, so the air/water values set when calibrating slowly become wrong.
+ * This tracks, from the normal readings:
+ * - The envelope (lowest and highest values) of the readings. Values outside the envelope move it right away, and
+ *   values inside slowly pull it in, so it follows the sensor over time.
+ * - The saturation level: The lowest reading after a shot, which is the wettest the sensor gets in practice.
+ * - The noise (standard deviation) of the readings, and how many shots in a row had no effect. Both grow when a sensor
+ *   is failing (e.g: water getting into the electronics, or the sensor coming out of the soil).
+ *
+ * Drift is flagged when the envelope or saturation level goes past the air/water values by more than
+ * AW_SENSOR_DRIFT_TOLERANCE_PERCENT of the air/water range, in which case new air/water values are proposed.
+ */
+class SensorDriftEstimator
+{
+  public:
+
+	enum Flags : uint8_t
+	{
+		None = 0,
+		// Readings are drier than the air value
+		AboveAir = 1 << 0,
+		// Readings are wetter than the water value
+		BelowWater = 1 << 1,
+		// The readings are noisier than usual for a working sensor
+		Noisy = 1 << 2,
+		// Several shots in a row didn't change the readings
+		NoResponse = 1 << 3
+	};
+
+	void reset();
+
+	/**
+	 * Feeds a reading.
+	 * @param value Raw sensor value (before being clamped to the air/water values)
+	 */
+	void addReading(unsigned int value, float standardDeviation);
+
+	/**
+	 * Should be called when a shot starts
+	 */
+	void onShot();
+
+	/**
+	 * Calculates the flags for the specified air/water values
+	 */
+	uint8_t calcFlags(unsigned int airValue, unsigned int waterValue) const;
+
+	/**
+	 * Proposes new air/water values if there is drift. Returns false if there is nothing to propose.
+	 * Only widens the range, since readings not reaching the air/water values is expected (e.g: the soil is never
+	 * completely dry).
+	 */
+	bool calcProposal(unsigned int airValue, unsigned int waterValue, unsigned int& proposedAirValue,
+	                  unsigned int& proposedWaterValue) const;
+
+	uint32_t getNumReadings() const
+	{
+		return m_numReadings;
+	}
+
+	void log(uint8_t index, unsigned int airValue, unsigned int waterValue) const;
+
+	static void flagsToString(uint8_t flags, char* buf, int bufSize);
+
+  private:
+
+	float calcTolerance(unsigned int airValue, unsigned int waterValue) const;
+
+	uint32_t m_numReadings = 0;
+	float m_envelopeMin = 0;
+	float m_envelopeMax = 0;
+	float m_noise = 0;
+
+	// Readings left in the current shot's saturation window. 0 if not looking for the saturation level.
+	uint8_t m_saturationReadingsLeft = 0;
+	// Lowest reading in the current shot's window
+	unsigned int m_shotMinValue;
+	// Reading before the current shot
+	unsigned int m_shotStartValue;
+	unsigned int m_lastValue = 0;
+	float m_saturation = 0;
+	uint16_t m_numSaturationSamples = 0;
+	uint8_t m_numShotsWithoutResponse = 0;
+};
+
+} // namespace cz
+
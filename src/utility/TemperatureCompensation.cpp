@@ -0,0 +1,112 @@
+#include <Arduino.h>
+
+#include "TemperatureCompensation.h"
+#include <crazygaze/micromuc/Logging.h>
+#include <algorithm>
+#include <math.h>
+
+namespace cz
+{
+
+unsigned int TemperatureCompensation::apply(unsigned int value, int16_t temperature) const
+{
+	int32_t delta = static_cast<int32_t>(temperature) - referenceTemperature;
+	int32_t slope = delta < 0 ? coldSlopeQ8 : hotSlopeQ8;
+
+	// slope is Q8 per degree, and delta is in tenths of a degree
+	constexpr int32_t div = 10 << ms_fractionalBits;
+	int32_t offset = slope * delta;
+	offset = (offset + (offset >= 0 ? div / 2 : -div / 2)) / div;
+
+	return static_cast<unsigned int>(std::max(static_cast<int32_t>(value) - offset, 0));
+}
+
+bool TemperatureCompensation::toTenths(float temperatureC, int16_t& temperature)
+{
+	// The HTU21DF works from -40 to 125
+	if (isnan(temperatureC) || temperatureC < -40.0f || temperatureC > 125.0f)
+	{
+		return false;
+	}
+
+	temperature = static_cast<int16_t>(lroundf(temperatureC * 10.0f));
+	return true;
+}
+
+void TemperatureCompensationLearner::reset()
+{
+	*this = TemperatureCompensationLearner();
+}
+
+void TemperatureCompensationLearner::addReading(unsigned int rawValue, int16_t temperature, int16_t referenceTemperature, bool watered)
+{
+	if (m_hasLast && !watered)
+	{
+		int32_t dt = static_cast<int32_t>(temperature) - m_lastTemperature;
+		int32_t dv = static_cast<int32_t>(rawValue) - static_cast<int32_t>(m_lastValue);
+		if (dt != 0)
+		{
+			Side& side = (static_cast<int32_t>(temperature) + m_lastTemperature) < 2 * referenceTemperature ? m_cold : m_hot;
+			side.sumTV += static_cast<int64_t>(dt) * dv;
+			side.sumTT += static_cast<int64_t>(dt) * dt;
+			side.count++;
+		}
+	}
+
+	m_hasLast = true;
+	m_lastValue = rawValue;
+	m_lastTemperature = temperature;
+}
+
+bool TemperatureCompensationLearner::Side::calcSlope(int16_t& slopeQ8) const
+{
+	if (count < AW_TEMPERATURE_COMPENSATION_MIN_SAMPLES || sumTT == 0)
+	{
+		return false;
+	}
+
+	// Temperatures are in tenths of a degree, so multiply by 10 to get it per degree
+	int64_t slope = (sumTV * (10 << TemperatureCompensation::ms_fractionalBits)) / sumTT;
+	slopeQ8 = static_cast<int16_t>(std::clamp<int64_t>(slope, INT16_MIN, INT16_MAX));
+	return true;
+}
+
+bool TemperatureCompensationLearner::calcCompensation(int16_t referenceTemperature, TemperatureCompensation& res) const
+{
+	bool hasCold = m_cold.calcSlope(res.coldSlopeQ8);
+	bool hasHot = m_hot.calcSlope(res.hotSlopeQ8);
+	res.referenceTemperature = referenceTemperature;
+
+	if (!hasCold && !hasHot)
+	{
+		return false;
+	}
+	else if (!hasCold)
+	{
+		res.coldSlopeQ8 = res.hotSlopeQ8;
+	}
+	else if (!hasHot)
+	{
+		res.hotSlopeQ8 = res.coldSlopeQ8;
+	}
+
+	return true;
+}
+
+void TemperatureCompensationLearner::log(uint8_t index) const
+{
+	int16_t cold = 0, hot = 0;
+	bool hasCold = m_cold.calcSlope(cold);
+	bool hasHot = m_hot.calcSlope(hot);
+	CZ_LOG(logDefault, Log, F("Group %u learned temperature compensation: cold slope=%d (%s, %u samples), hot slope=%d (%s, %u samples)")
+		, static_cast<unsigned int>(index)
+		, static_cast<int>(cold)
+		, hasCold ? "ok" : "not enough data"
+		, static_cast<unsigned int>(m_cold.count)
+		, static_cast<int>(hot)
+		, hasHot ? "ok" : "not enough data"
+		, static_cast<unsigned int>(m_hot.count));
+}
+
+} // namespace cz
+
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Arduino.h>
+
+namespace cz
+{
+
+/**
+ * Temperature compensation of soil moisture sensor values.
+ *
+ * Capacitive sensors read differently at different temperatures, even if the moisture is the same. The compensated
+ * value is what the sensor would read at a reference temperature.
+ *
+ * The correction is piecewise linear, with a slope below and another above the reference temperature (the same slope
+ * for both makes it linear). Everything is integer math: Temperatures are in tenths of a degree Celsius, and slopes
+ * are sensor units per degree Celsius in Q8 fixed point.
+ */
+struct TemperatureCompensation
+{
+	// How much the sensor value goes up per degree Celsius, below and above the reference temperature. Q8.
+	int16_t coldSlopeQ8 = 0;
+	int16_t hotSlopeQ8 = 0;
+	// Reference temperature, in tenths of a degree Celsius
+	int16_t referenceTemperature = 250;
+
+	static constexpr int ms_fractionalBits = 8;
+
+	bool isEnabled() const
+	{
+		return coldSlopeQ8 != 0 || hotSlopeQ8 != 0;
+	}
+
+	/**
+	 * Returns the compensated value
+	 * @param temperature In tenths of a degree Celsius
+	 */
+	unsigned int apply(unsigned int value, int16_t temperature) const;
+
+	/**
+	 * Converts a temperature reading to tenths of a degree.
+	 * Returns false if the reading is not valid (e.g: No reading yet, or the sensor failed)
+	 */
+	static bool toTenths(float temperatureC, int16_t& temperature);
+};
+
+/**
+ * Learns the compensation slopes from the readings.
+ *
+ * For consecutive readings without watering in between, the change in value is regressed against the change in
+ * temperature (least squares through the origin), separately for pairs below and above the reference temperature.
+ * The soil drying also changes the values, but that doesn't depend on whether the temperature is going up or down, so
+ * over day/night cycles it mostly cancels out.
+ */
+class TemperatureCompensationLearner
+{
+  public:
+
+	void reset();
+
+	/**
+	 * Feeds a raw (uncompensated) value
+	 * @param watered true if there was watering since the previous reading
+	 */
+	void addReading(unsigned int rawValue, int16_t temperature, int16_t referenceTemperature, bool watered);
+
+	/**
+	 * Calculates the learned slopes. Returns false if there isn't enough data yet.
+	 * If only one side of the reference temperature has enough data, its slope is used for both.
+	 */
+	bool calcCompensation(int16_t referenceTemperature, TemperatureCompensation& res) const;
+
+	void log(uint8_t index) const;
+
+  private:
+
+	struct Side
+	{
+		int64_t sumTV = 0;
+		int64_t sumTT = 0;
+		uint32_t count = 0;
+
+		bool calcSlope(int16_t& slopeQ8) const;
+	};
+
+	Side m_cold;
+	Side m_hot;
+	bool m_hasLast = false;
+	unsigned int m_lastValue;
+	int16_t m_lastTemperature;
+};
+
+} // namespace cz
+
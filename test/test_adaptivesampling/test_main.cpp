@@ -0,0 +1,211 @@
+#include "utility/AdaptiveSampling.h"
+#include "Timer.h"
+#include "crazygaze/micromuc/StringUtils.h"
+#include <unity.h>
+#include <algorithm>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+constexpr float gSamplingInterval = 60;
+constexpr unsigned int gWetValue = 300;
+constexpr unsigned int gThreshold = 450;
+
+// Deterministic pseudo random numbers, so the runs are the same every time
+uint32_t gSeed;
+float testRandom(float minValue, float maxValue)
+{
+	gSeed = gSeed * 1664525u + 1013904223u;
+	return minValue + (maxValue - minValue) * ((gSeed >> 8) / static_cast<float>(1 << 24));
+}
+
+struct SimResult
+{
+	int numReadings;
+	// Time from the soil crossing the threshold until a reading reports it
+	float detectionDelay;
+};
+
+/**
+ * Simulates soil drying from just after a watering at a constant rate, with some noise in the readings, and reads it
+ * until a reading is above the threshold.
+ */
+SimResult simulate(bool adaptive, float rate, float noise)
+{
+	AdaptiveSampling sampling;
+	// When the soil reads above the threshold, without noise
+	const float crossingTime = (gThreshold + 1 - gWetValue) / rate;
+
+	SimResult res = {};
+	// The first reading is at a random point of the sampling interval, as it would be after a watering
+	float t = testRandom(0, gSamplingInterval);
+	while (true)
+	{
+		res.numReadings++;
+		unsigned int value = static_cast<unsigned int>(gWetValue + rate * t + testRandom(-noise, noise));
+		if (value > gThreshold)
+		{
+			res.detectionDelay = std::max(t - crossingTime, 0.0f);
+			return res;
+		}
+
+		sampling.addReading(static_cast<uint64_t>(t * 1000000.0f), value);
+		t += adaptive ? sampling.calcInterval(gSamplingInterval, gThreshold) : gSamplingInterval;
+	}
+}
+
+} // namespace
+
+void setUp()
+{
+	gSeed = 12345;
+}
+
+void tearDown()
+{
+}
+
+void test_fixedIntervalWithoutReadings()
+{
+	AdaptiveSampling sampling;
+	TEST_ASSERT_EQUAL_FLOAT(gSamplingInterval, sampling.calcInterval(gSamplingInterval, gThreshold));
+	sampling.addReading(0, 400);
+	TEST_ASSERT_EQUAL_FLOAT(gSamplingInterval, sampling.calcInterval(gSamplingInterval, gThreshold));
+
+	// Watering starts over
+	sampling.addReading(60 * 1000000, 410);
+	TEST_ASSERT_TRUE(sampling.calcInterval(gSamplingInterval, gThreshold) != gSamplingInterval);
+	sampling.reset();
+	TEST_ASSERT_EQUAL_FLOAT(gSamplingInterval, sampling.calcInterval(gSamplingInterval, gThreshold));
+}
+
+void test_dryingRate()
+{
+	AdaptiveSampling sampling;
+	// Only the last AW_MOISTURESENSOR_ADAPTIVE_NUM_POINTS readings count, so the fit follows changes in the rate
+	for (int i = 0; i < AW_MOISTURESENSOR_ADAPTIVE_NUM_POINTS; i++)
+	{
+		sampling.addReading(i * 60 * 1000000ull, 300 - i * 6);
+	}
+	for (int i = 0; i < AW_MOISTURESENSOR_ADAPTIVE_NUM_POINTS; i++)
+	{
+		sampling.addReading((i + 10) * 60 * 1000000ull, 300 + i * 6);
+	}
+
+	float rate, rateError, noise;
+	TEST_ASSERT_TRUE(sampling.calcDryingRate(rate, rateError, noise));
+	TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.1f, rate);
+	TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.0f, rateError);
+	TEST_ASSERT_FLOAT_WITHIN(0.0001f, 0.0f, noise);
+}
+
+void test_intervalBounds()
+{
+	const float minInterval = gSamplingInterval * AW_MOISTURESENSOR_ADAPTIVE_MIN_FACTOR;
+	const float maxInterval = gSamplingInterval * AW_MOISTURESENSOR_ADAPTIVE_MAX_FACTOR;
+
+	// Not drying
+	AdaptiveSampling sampling;
+	sampling.addReading(0, 350);
+	sampling.addReading(60 * 1000000, 340);
+	TEST_ASSERT_EQUAL_FLOAT(maxInterval, sampling.calcInterval(gSamplingInterval, gThreshold));
+
+	// Drying slowly, far from the threshold
+	sampling.reset();
+	sampling.addReading(0, 300);
+	sampling.addReading(60 * 1000000, 301);
+	TEST_ASSERT_EQUAL_FLOAT(maxInterval, sampling.calcInterval(gSamplingInterval, gThreshold));
+
+	// Half way there
+	sampling.reset();
+	sampling.addReading(0, 390);
+	sampling.addReading(60 * 1000000, 400);
+	TEST_ASSERT_FLOAT_WITHIN(0.01f, 300 * AW_MOISTURESENSOR_ADAPTIVE_MARGIN, sampling.calcInterval(gSamplingInterval, gThreshold));
+
+	// Nearly there, and past it
+	sampling.addReading(120 * 1000000, 449);
+	TEST_ASSERT_EQUAL_FLOAT(minInterval, sampling.calcInterval(gSamplingInterval, gThreshold));
+	sampling.addReading(180 * 1000000, 460);
+	TEST_ASSERT_EQUAL_FLOAT(minInterval, sampling.calcInterval(gSamplingInterval, gThreshold));
+}
+
+/**
+ * Compares the threshold detection delay and number of readings of fixed and adaptive sampling, for soil drying at
+ * different rates (from reaching the threshold in ~1 hour to ~1 day)
+ */
+void test_detectionDelay()
+{
+	constexpr int numRuns = 50;
+	SimResult fixed[numRuns];
+	SimResult adaptive[numRuns];
+
+	float rates[numRuns];
+	for (int i = 0; i < numRuns; i++)
+	{
+		rates[i] = (gThreshold - gWetValue) / testRandom(60 * 60, 24 * 60 * 60);
+	}
+
+	for (int noise = 0; noise <= 3; noise += 3)
+	{
+		uint32_t seed = gSeed;
+		for (int i = 0; i < numRuns; i++)
+		{
+			fixed[i] = simulate(false, rates[i], noise);
+		}
+		gSeed = seed;
+		for (int i = 0; i < numRuns; i++)
+		{
+			adaptive[i] = simulate(true, rates[i], noise);
+		}
+
+		float fixedDelay = 0, adaptiveDelay = 0, maxAdaptiveDelay = 0;
+		int fixedReadings = 0, adaptiveReadings = 0;
+		for (int i = 0; i < numRuns; i++)
+		{
+			fixedDelay += fixed[i].detectionDelay / numRuns;
+			fixedReadings += fixed[i].numReadings;
+			adaptiveDelay += adaptive[i].detectionDelay / numRuns;
+			adaptiveReadings += adaptive[i].numReadings;
+			maxAdaptiveDelay = std::max(maxAdaptiveDelay, adaptive[i].detectionDelay);
+		}
+
+		TEST_MESSAGE(formatString("Noise +/-%d: fixed: %d readings, %ss avg delay. adaptive: %d readings, %ss avg delay, %ss max", noise,
+			fixedReadings, *FloatToString(fixedDelay), adaptiveReadings, *FloatToString(adaptiveDelay),
+			*FloatToString(maxAdaptiveDelay)));
+
+		if (noise == 0)
+		{
+			// The fixed interval detects the crossing half an interval later on average, and adaptive sampling well
+			// within an interval
+			TEST_ASSERT_FLOAT_WITHIN(gSamplingInterval * 0.15f, gSamplingInterval / 2, fixedDelay);
+			TEST_ASSERT_TRUE(adaptiveDelay < fixedDelay / 2);
+			TEST_ASSERT_TRUE(maxAdaptiveDelay < gSamplingInterval);
+		}
+		else
+		{
+			// With noise, the more readings the sooner one of them happens to be above the threshold, which helps the
+			// fixed interval. Adaptive sampling still gets there sooner.
+			TEST_ASSERT_TRUE(adaptiveDelay < fixedDelay);
+		}
+
+		// And with a fraction of the readings
+		TEST_ASSERT_TRUE(adaptiveReadings < fixedReadings / 2);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_fixedIntervalWithoutReadings);
+	RUN_TEST(test_dryingRate);
+	RUN_TEST(test_intervalBounds);
+	RUN_TEST(test_detectionDelay);
+	return UNITY_END();
+}
@@ -0,0 +1,147 @@
+#include "utility/ADCCapture.h"
+#include "Timer.h"
+#include <unity.h>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+constexpr uint8_t gPin = 26;
+constexpr int gNumSamples = 10;
+// 1ms per capture
+constexpr uint32_t gSampleRate = 10000;
+
+int gNumDone;
+uint16_t gLastSample;
+void onDone(void* userData, const uint16_t* samples, int numSamples)
+{
+	gNumDone++;
+	gLastSample = samples[numSamples - 1];
+}
+
+bool startHigh(ADCCapture& adc)
+{
+	return adc.start(gPin, gNumSamples, gSampleRate, onDone, nullptr, ADCCapture::Priority::High);
+}
+
+bool startLow(ADCCapture& adc)
+{
+	return adc.start(gPin, gNumSamples, gSampleRate, onDone, nullptr, ADCCapture::Priority::Low);
+}
+
+// Waits for the active capture to finish
+void finish(ADCCapture& adc)
+{
+	arduino_native::advanceMicros(1000);
+	TEST_ASSERT_TRUE(adc.poll());
+}
+
+} // namespace
+
+void setUp()
+{
+	gNumDone = 0;
+	arduino_native::setMicros(0);
+}
+
+void tearDown()
+{
+}
+
+void test_onlyOneCapture()
+{
+	ADCCapture adc;
+	TEST_ASSERT_TRUE(startLow(adc));
+	TEST_ASSERT_FALSE(startLow(adc));
+	TEST_ASSERT_FALSE(startHigh(adc));
+
+	arduino_native::advanceMicros(400);
+	TEST_ASSERT_FALSE(adc.poll());
+	TEST_ASSERT_EQUAL_UINT32(600, static_cast<uint32_t>(adc.getTimeToEnd() * 1000000.0f + 0.5f));
+
+	arduino_native::advanceMicros(600);
+	TEST_ASSERT_TRUE(adc.poll());
+	TEST_ASSERT_EQUAL_INT(1, gNumDone);
+	TEST_ASSERT_FALSE(adc.isBusy());
+	TEST_ASSERT_TRUE(adc.getTimeToEnd() == 0);
+}
+
+void test_highPriorityBackToBack()
+{
+	ADCCapture adc;
+	for (int i = 0; i < 10; i++)
+	{
+		TEST_ASSERT_TRUE(startHigh(adc));
+		finish(adc);
+	}
+	TEST_ASSERT_EQUAL_INT(10, gNumDone);
+}
+
+void test_highPriorityYieldsToWaitingLow()
+{
+	ADCCapture adc;
+	TEST_ASSERT_TRUE(startHigh(adc));
+	// e.g: A sensor wants to read while a pump is being monitored
+	TEST_ASSERT_FALSE(startLow(adc));
+	finish(adc);
+
+	// The pump can't start another capture until the sensor had its turn
+	TEST_ASSERT_FALSE(startHigh(adc));
+	TEST_ASSERT_TRUE(startLow(adc));
+	finish(adc);
+
+	TEST_ASSERT_TRUE(startHigh(adc));
+	finish(adc);
+	TEST_ASSERT_EQUAL_INT(3, gNumDone);
+}
+
+void test_waitingLowGivesUp()
+{
+	ADCCapture adc;
+	TEST_ASSERT_TRUE(startHigh(adc));
+	TEST_ASSERT_FALSE(startLow(adc));
+	finish(adc);
+
+	// The sensor never retries (e.g: the group was stopped), so eventually the pump carries on
+	TEST_ASSERT_FALSE(startHigh(adc));
+	arduino_native::advanceMicros(AW_ADC_CAPTURE_YIELD_MS * 1000UL);
+	TEST_ASSERT_TRUE(startHigh(adc));
+	finish(adc);
+
+	// And doesn't yield again until another sensor fails to get the ADC
+	TEST_ASSERT_TRUE(startHigh(adc));
+}
+
+void test_simulatedInputIsPerCapture()
+{
+	ADCCapture adc;
+	adc.setSimulatedInput(100, 0);
+	TEST_ASSERT_TRUE(startHigh(adc));
+
+	// e.g: A sensor setting up its reading while a pump's capture is active
+	adc.setSimulatedInput(500, 0);
+	TEST_ASSERT_FALSE(startLow(adc));
+	finish(adc);
+	TEST_ASSERT_EQUAL_UINT16(100, gLastSample);
+
+	TEST_ASSERT_TRUE(startLow(adc));
+	finish(adc);
+	TEST_ASSERT_EQUAL_UINT16(500, gLastSample);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_onlyOneCapture);
+	RUN_TEST(test_highPriorityBackToBack);
+	RUN_TEST(test_highPriorityYieldsToWaitingLow);
+	RUN_TEST(test_waitingLowGivesUp);
+	RUN_TEST(test_simulatedInputIsPerCapture);
+	return UNITY_END();
+}
@@ -0,0 +1,363 @@
+#include "Context.h"
+#include "Timer.h"
+#include <Wire.h>
+#include <unity.h>
+#include <string.h>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+/**
+ * AT24C256 on the native I2C bus.
+ * A transmission starts with the 2 address bytes (MSB first), followed by the bytes to write, if any. Reads continue
+ * from the last address set.
+ */
+class FakeAT24C : public arduino_native::I2CDevice
+{
+  public:
+	FakeAT24C()
+	{
+		memset(memory, 0xFF, sizeof(memory));
+		Wire.setDevice(0x50, this);
+	}
+
+	~FakeAT24C()
+	{
+		Wire.setDevice(0x50, nullptr);
+	}
+
+	uint8_t memory[32 * 1024];
+
+	virtual bool onWrite(const uint8_t* data, size_t len) override
+	{
+		// An empty transmission is the library checking if the IC is ready
+		if (len == 0)
+		{
+			return true;
+		}
+
+		if (len < 2)
+		{
+			return false;
+		}
+
+		m_address = ((data[0] << 8) | data[1]) % sizeof(memory);
+		for (size_t i = 2; i < len; i++)
+		{
+			memory[m_address] = data[i];
+			m_address = (m_address + 1) % sizeof(memory);
+		}
+		return true;
+	}
+
+	virtual size_t onRead(uint8_t* data, size_t quantity) override
+	{
+		for (size_t i = 0; i < quantity; i++)
+		{
+			data[i] = memory[m_address];
+			m_address = (m_address + 1) % sizeof(memory);
+		}
+		return quantity;
+	}
+
+  private:
+	uint16_t m_address = 0;
+};
+
+/**
+ * Only here because the config logs the default device name when there is none
+ */
+class TestSetup : public Setup
+{
+  public:
+	virtual void begin() override
+	{
+	}
+
+	virtual SoilMoistureSensor* createSoilMoistureSensor(int index) override
+	{
+		return nullptr;
+	}
+
+	virtual PumpMonitor* createPumpMonitor(int index) override
+	{
+		return nullptr;
+	}
+
+#if AW_PUMP_SHARED
+	virtual DigitalOutputPin* createSharedPumpPin() override
+	{
+		return nullptr;
+	}
+#endif
+};
+
+TestSetup gTestSetup;
+
+constexpr const char* gDeviceName = "greenhouse";
+constexpr int gNameSize = AW_DEVICENAME_MAX_LEN + 1;
+constexpr int gVersion1GroupSize = 12;
+// Same as ProgramData's. This needs updating when the layout version is bumped.
+constexpr uint8_t gCurrentVersion = 2;
+// Magic (0xA7FE) and layout version
+constexpr int gHeaderSize = 3;
+
+// Writes the storage by hand, in little endian like the RP2040
+class ImageWriter
+{
+  public:
+	explicit ImageWriter(FakeAT24C& eeprom)
+		: m_eeprom(eeprom)
+	{
+	}
+
+	void write8(uint8_t v)
+	{
+		m_eeprom.memory[m_address++] = v;
+	}
+
+	void write16(uint16_t v)
+	{
+		write8(v & 0xFF);
+		write8(v >> 8);
+	}
+
+	void write32(uint32_t v)
+	{
+		write16(v & 0xFFFF);
+		write16(v >> 16);
+	}
+
+	void writeName(const char* name)
+	{
+		char buf[gNameSize] = {0};
+		strncpy(buf, name, AW_DEVICENAME_MAX_LEN);
+		for (char c : buf)
+		{
+			write8(c);
+		}
+	}
+
+  private:
+	FakeAT24C& m_eeprom;
+	uint16_t m_address = 0;
+};
+
+// Version 1 group config values, made different for each group
+struct Version1Config
+{
+	explicit Version1Config(int index)
+		: running(index % 2)
+		, samplingInterval(60 + index)
+		, shotDuration(5 + index)
+		, airValue(600 + index)
+		, waterValue(300 + index)
+		, thresholdValue(450 + index)
+	{
+	}
+
+	bool running;
+	uint16_t samplingInterval;
+	uint16_t shotDuration;
+	uint16_t airValue;
+	uint16_t waterValue;
+	uint16_t thresholdValue;
+};
+
+GraphPoint makePoint(int index, int point)
+{
+	GraphPoint p;
+	p.val = (index * 7 + point) % (AW_TOUCHUI_GRAPH_POINT_MAXVAL + 1);
+	p.motorOn = point % 3 == 0;
+	p.status = SensorReading::Status::Valid;
+	return p;
+}
+
+int getNumPoints(int index)
+{
+	return 3 + index;
+}
+
+/**
+ * Config as saved before the layout was versioned: No header, and the group configs only go up to the threshold
+ */
+void writeVersion1(FakeAT24C& eeprom)
+{
+	ImageWriter writer(eeprom);
+	writer.writeName(gDeviceName);
+
+	for (int i = 0; i < AW_MAX_NUM_PAIRS; i++)
+	{
+		Version1Config cfg(i);
+		writer.write8(cfg.running);
+		// Padding
+		writer.write8(0);
+		writer.write16(cfg.samplingInterval);
+		writer.write16(cfg.shotDuration);
+		writer.write16(cfg.airValue);
+		writer.write16(cfg.waterValue);
+		writer.write16(cfg.thresholdValue);
+	}
+
+	for (int i = 0; i < AW_MAX_NUM_PAIRS; i++)
+	{
+		writer.write32(getNumPoints(i));
+		for (int p = 0; p < getNumPoints(i); p++)
+		{
+			GraphPoint point = makePoint(i, p);
+			uint8_t byte;
+			memcpy(&byte, &point, 1);
+			writer.write8(byte);
+		}
+	}
+}
+
+void checkVersion1Values()
+{
+	TEST_ASSERT_EQUAL_STRING(gDeviceName, gCtx.data.getDeviceName());
+	for (int i = 0; i < AW_MAX_NUM_PAIRS; i++)
+	{
+		Version1Config cfg(i);
+		GroupData& group = gCtx.data.getGroupData(i);
+		TEST_ASSERT_EQUAL(cfg.running, group.isRunning());
+		TEST_ASSERT_EQUAL_UINT(cfg.samplingInterval, group.getSamplingInterval());
+		TEST_ASSERT_EQUAL_UINT(cfg.shotDuration, group.getShotDuration());
+		TEST_ASSERT_EQUAL_UINT(cfg.airValue, group.getAirValue());
+		TEST_ASSERT_EQUAL_UINT(cfg.waterValue, group.getWaterValue());
+		TEST_ASSERT_EQUAL_UINT(cfg.thresholdValue, group.getThresholdValue());
+
+		// What version 1 didn't have gets the defaults
+		TEST_ASSERT_EQUAL_UINT(AW_SHOT_DEFAULT_VOLUME, group.getShotVolume());
+		TEST_ASSERT_EQUAL_UINT32(0, group.getTotalVolume());
+
+		const HistoryQueue& history = group.getHistory();
+		TEST_ASSERT_EQUAL_INT(getNumPoints(i), history.size());
+		for (int p = 0; p < history.size(); p++)
+		{
+			GraphPoint expected = makePoint(i, p);
+			TEST_ASSERT_EQUAL_UINT(expected.val, history.getAtIndex(p).val);
+			TEST_ASSERT_EQUAL(expected.motorOn, history.getAtIndex(p).motorOn);
+			TEST_ASSERT_EQUAL(expected.status, history.getAtIndex(p).status);
+		}
+	}
+}
+
+void checkHeader(const FakeAT24C& eeprom, uint8_t version)
+{
+	TEST_ASSERT_EQUAL_HEX8(0xFE, eeprom.memory[0]);
+	TEST_ASSERT_EQUAL_HEX8(0xA7, eeprom.memory[1]);
+	TEST_ASSERT_EQUAL_UINT8(version, eeprom.memory[2]);
+}
+
+} // namespace
+
+void setUp()
+{
+	gSetup = &gTestSetup;
+	gCtx.begin();
+}
+
+void tearDown()
+{
+}
+
+void test_version1Layout()
+{
+	// The hand written image above relies on this
+	TEST_ASSERT_EQUAL_INT(gVersion1GroupSize, GroupConfig::getSaveSize(1));
+	TEST_ASSERT_TRUE(GroupConfig::getSaveSize(2) > GroupConfig::getSaveSize(1));
+}
+
+void test_upgradeFromVersion1()
+{
+	FakeAT24C eeprom;
+	writeVersion1(eeprom);
+
+	gCtx.data.load();
+	checkVersion1Values();
+
+	// It was saved straight away with the current layout
+	checkHeader(eeprom, gCurrentVersion);
+	TEST_ASSERT_EQUAL_STRING(gDeviceName, reinterpret_cast<const char*>(&eeprom.memory[gHeaderSize]));
+	for (int i = 0; i < AW_MAX_NUM_PAIRS; i++)
+	{
+		TEST_ASSERT_FALSE(gCtx.data.getGroupData(i).isDirty());
+	}
+
+	// The histories come after the configs, which are bigger now
+	int historyStart = gHeaderSize + gNameSize +
+		AW_MAX_NUM_PAIRS * GroupConfig::getSaveSize(gCurrentVersion);
+	int32_t numPoints;
+	memcpy(&numPoints, &eeprom.memory[historyStart], sizeof(numPoints));
+	TEST_ASSERT_EQUAL_INT32(getNumPoints(0), numPoints);
+
+	// And it loads the same thing again, without needing another conversion
+	gCtx.data.load();
+	checkVersion1Values();
+}
+
+void test_saveGroupConfigAfterUpgrade()
+{
+	FakeAT24C eeprom;
+	writeVersion1(eeprom);
+	gCtx.data.load();
+
+	// saveGroupConfig writes at a fixed offset, so it only works if the storage has the current layout
+	const int index = AW_MAX_NUM_PAIRS - 1;
+	GroupData& group = gCtx.data.getGroupData(index);
+	group.setShotDuration(42);
+	group.setShotVolume(250);
+	gCtx.data.saveGroupConfig(index);
+
+	gCtx.data.load();
+	TEST_ASSERT_EQUAL_UINT(42, group.getShotDuration());
+	TEST_ASSERT_EQUAL_UINT(250, group.getShotVolume());
+	TEST_ASSERT_EQUAL_UINT(Version1Config(index).thresholdValue, group.getThresholdValue());
+
+	// Nothing else was overwritten
+	group.setShotDuration(Version1Config(index).shotDuration);
+	group.setShotVolume(AW_SHOT_DEFAULT_VOLUME);
+	checkVersion1Values();
+}
+
+void test_unknownVersionResets()
+{
+	FakeAT24C eeprom;
+	writeVersion1(eeprom);
+	gCtx.data.load();
+
+	// As if saved by a newer firmware
+	eeprom.memory[2] = gCurrentVersion + 1;
+	gCtx.data.load();
+
+	TEST_ASSERT_EQUAL_STRING(gTestSetup.getDefaultName(), gCtx.data.getDeviceName());
+	for (int i = 0; i < AW_MAX_NUM_PAIRS; i++)
+	{
+		GroupData& group = gCtx.data.getGroupData(i);
+		TEST_ASSERT_FALSE(group.isRunning());
+		TEST_ASSERT_EQUAL_UINT(AW_SHOT_DEFAULT_DURATION, group.getShotDuration());
+		TEST_ASSERT_EQUAL_UINT(AW_SHOT_DEFAULT_VOLUME, group.getShotVolume());
+		TEST_ASSERT_EQUAL_UINT(65535, group.getThresholdValue());
+		TEST_ASSERT_EQUAL_INT(0, group.getHistory().size());
+	}
+
+	// And the defaults were saved with the current version
+	checkHeader(eeprom, gCurrentVersion);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_version1Layout);
+	RUN_TEST(test_upgradeFromVersion1);
+	RUN_TEST(test_saveGroupConfigAfterUpgrade);
+	RUN_TEST(test_unknownVersionResets);
+	return UNITY_END();
+}
@@ -0,0 +1,315 @@
+#include "SPSCQueue.h"
+#include "Core1Log.h"
+#include "Timer.h"
+#include <unity.h>
+#include <atomic>
+#include <memory>
+#include <string.h>
+#include <stdio.h>
+#include <thread>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+// Core 1 runs on a host thread, and the test's thread plays core 0. On the RP2040 the cores __sev()/__wfe() to wake each
+// other up. Here they just yield, which makes them race each other more.
+// Unity's asserts can only be used from the test's thread, so both sides count errors while core 1 is running, and they
+// are checked once it's joined.
+
+// Enough round trips for the queues to be full and empty many times
+constexpr uint32_t gNumRoundTrips = 100000;
+
+// Same idea as MQTTCache's core 1 requests, notifications and received messages
+struct Request
+{
+	uint32_t id;
+	char topic[AW_MQTT_MAX_TOPIC_SIZE];
+};
+
+struct Notification
+{
+	uint32_t id;
+	// Index in the message slots
+	uint8_t slot;
+};
+
+struct Message
+{
+	char topic[AW_MQTT_MAX_TOPIC_SIZE];
+	std::unique_ptr<char[]> payload;
+};
+
+constexpr int gPayloadSize = 64;
+
+void formatTopic(char* dst, uint32_t id)
+{
+	snprintf(dst, AW_MQTT_MAX_TOPIC_SIZE, "autowatering/group%u/value", static_cast<unsigned int>(id));
+}
+
+void formatPayload(char* dst, uint32_t id)
+{
+	snprintf(dst, gPayloadSize, "{\"id\":%u,\"check\":%u}", static_cast<unsigned int>(id), static_cast<unsigned int>(~id));
+}
+
+template<typename T, int Capacity>
+void pushOrWait(TSPSCQueue<T, Capacity>& queue, T&& item)
+{
+	while (!queue.push(std::move(item)))
+	{
+		std::this_thread::yield();
+	}
+}
+
+} // namespace
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_fullAndEmpty()
+{
+	TSPSCQueue<int, 4> queue;
+	int item;
+	TEST_ASSERT_TRUE(queue.isEmpty());
+	TEST_ASSERT_FALSE(queue.pop(item));
+
+	for (int i = 0; i < 4; i++)
+	{
+		TEST_ASSERT_TRUE(queue.push(int(i)));
+	}
+	TEST_ASSERT_EQUAL_INT(4, queue.size());
+	TEST_ASSERT_FALSE(queue.push(100));
+	TEST_ASSERT_EQUAL_UINT32(1, queue.getPushFailures());
+	TEST_ASSERT_EQUAL_UINT32(4, queue.getHighWaterMark());
+
+	// Items come out in order, and there is room again once one is popped
+	TEST_ASSERT_TRUE(queue.pop(item));
+	TEST_ASSERT_EQUAL_INT(0, item);
+	TEST_ASSERT_TRUE(queue.push(4));
+	for (int i = 1; i <= 4; i++)
+	{
+		TEST_ASSERT_TRUE(queue.pop(item));
+		TEST_ASSERT_EQUAL_INT(i, item);
+	}
+	TEST_ASSERT_TRUE(queue.isEmpty());
+}
+
+/**
+ * Core 0 posts requests, and core 1 answers each one with a notification, like MQTTCache does for publishes and
+ * subscriptions. Nothing can be lost, duplicated, reordered or torn, with both queues running full.
+ */
+void test_requestRoundTrip()
+{
+	TSPSCQueue<Request, AW_NETWORK_QUEUE_SIZE> requests;
+	TSPSCQueue<Notification, AW_NETWORK_QUEUE_SIZE> notifications;
+	uint32_t core1Errors = 0;
+	uint32_t core0Errors = 0;
+
+	std::thread core1([&]()
+	{
+		char expectedTopic[AW_MQTT_MAX_TOPIC_SIZE];
+		uint32_t expectedId = 0;
+		Request request;
+		while (expectedId < gNumRoundTrips)
+		{
+			if (!requests.pop(request))
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			formatTopic(expectedTopic, expectedId);
+			if (request.id != expectedId || strcmp(request.topic, expectedTopic) != 0)
+			{
+				core1Errors++;
+			}
+			expectedId++;
+
+			pushOrWait(notifications, Notification{request.id, 0});
+		}
+	});
+
+	uint32_t nextRequest = 0;
+	uint32_t expectedId = 0;
+	while (expectedId < gNumRoundTrips)
+	{
+		bool progress = false;
+		if (nextRequest < gNumRoundTrips)
+		{
+			Request request;
+			request.id = nextRequest;
+			formatTopic(request.topic, nextRequest);
+			if (requests.push(std::move(request)))
+			{
+				nextRequest++;
+				progress = true;
+			}
+		}
+
+		Notification notification;
+		while (notifications.pop(notification))
+		{
+			if (notification.id != expectedId)
+			{
+				core0Errors++;
+			}
+			expectedId++;
+			progress = true;
+		}
+
+		if (!progress)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	core1.join();
+	TEST_ASSERT_EQUAL_UINT32(0, core1Errors);
+	TEST_ASSERT_EQUAL_UINT32(0, core0Errors);
+	TEST_ASSERT_TRUE(requests.isEmpty());
+	TEST_ASSERT_TRUE(notifications.isEmpty());
+	// Core 0 kept trying while the queue was full
+	TEST_ASSERT_TRUE(requests.getPushFailures() > 0);
+}
+
+/**
+ * Received messages, as MQTTCache hands them over: Core 1 takes a free slot, fills it in, and tells core 0 which one.
+ * Core 0 processes it and gives the slot back. Each slot belongs to only one core at a time, so the contents have to
+ * arrive intact.
+ */
+void test_messageSlotRoundTrip()
+{
+	Message messages[AW_NETWORK_MESSAGE_SLOTS];
+	TSPSCQueue<uint8_t, AW_NETWORK_MESSAGE_SLOTS> freeMessages;
+	TSPSCQueue<Notification, AW_NETWORK_QUEUE_SIZE> notifications;
+	uint32_t core0Errors = 0;
+
+	// Core 0 allocates the buffers and owns all the slots at first
+	for (int i = 0; i < AW_NETWORK_MESSAGE_SLOTS; i++)
+	{
+		messages[i].payload = std::make_unique<char[]>(gPayloadSize);
+		TEST_ASSERT_TRUE(freeMessages.push(static_cast<uint8_t>(i)));
+	}
+
+	std::thread core1([&]()
+	{
+		for (uint32_t id = 0; id < gNumRoundTrips; id++)
+		{
+			uint8_t slot;
+			while (!freeMessages.pop(slot))
+			{
+				std::this_thread::yield();
+			}
+
+			Message& dst = messages[slot];
+			formatTopic(dst.topic, id);
+			formatPayload(dst.payload.get(), id);
+			pushOrWait(notifications, Notification{id, slot});
+		}
+	});
+
+	char expectedTopic[AW_MQTT_MAX_TOPIC_SIZE];
+	char expectedPayload[gPayloadSize];
+	uint32_t expectedId = 0;
+	while (expectedId < gNumRoundTrips)
+	{
+		Notification notification;
+		if (!notifications.pop(notification))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		formatTopic(expectedTopic, expectedId);
+		formatPayload(expectedPayload, expectedId);
+		if (notification.id != expectedId || notification.slot >= AW_NETWORK_MESSAGE_SLOTS ||
+			strcmp(messages[notification.slot].topic, expectedTopic) != 0 ||
+			strcmp(messages[notification.slot].payload.get(), expectedPayload) != 0)
+		{
+			core0Errors++;
+		}
+		expectedId++;
+
+		// Give the slot back
+		if (!freeMessages.push(uint8_t(notification.slot)))
+		{
+			core0Errors++;
+		}
+	}
+
+	core1.join();
+	TEST_ASSERT_EQUAL_UINT32(0, core0Errors);
+	// All the slots are back with core 0, and there were never more messages in flight than slots
+	TEST_ASSERT_EQUAL_INT(AW_NETWORK_MESSAGE_SLOTS, freeMessages.size());
+	TEST_ASSERT_TRUE(notifications.getHighWaterMark() <= AW_NETWORK_MESSAGE_SLOTS);
+}
+
+/**
+ * Core 1 logs faster than core 0 flushes. Lines that don't fit are dropped and counted, but the ones that arrive are
+ * whole and in order.
+ */
+void test_core1Log()
+{
+	Core1Log log;
+	uint32_t numReceived = 0;
+	uint32_t core0Errors = 0;
+	unsigned int lastIndex = 0;
+	std::atomic<bool> core1Done{false};
+
+	auto flush = [&]()
+	{
+		log.flush([&](LogVerbosity verbosity, const char* msg)
+		{
+			unsigned int index, check;
+			if (verbosity != LogVerbosity::Log || sscanf(msg, "Core 1 line %u, check %u", &index, &check) != 2 ||
+				check != ~index || (numReceived && index <= lastIndex))
+			{
+				core0Errors++;
+			}
+			lastIndex = index;
+			numReceived++;
+		});
+	};
+
+	std::thread core1([&]()
+	{
+		for (uint32_t i = 0; i < gNumRoundTrips; i++)
+		{
+			log.log(LogVerbosity::Log, "Core 1 line %u, check %u", static_cast<unsigned int>(i), static_cast<unsigned int>(~i));
+		}
+		core1Done = true;
+	});
+
+	while (!core1Done)
+	{
+		flush();
+		std::this_thread::yield();
+	}
+
+	core1.join();
+	flush();
+	TEST_ASSERT_EQUAL_UINT32(0, core0Errors);
+	TEST_ASSERT_TRUE(numReceived > 0);
+	TEST_ASSERT_EQUAL_UINT32(gNumRoundTrips, numReceived + log.getQueue().getPushFailures());
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_fullAndEmpty);
+	RUN_TEST(test_requestRoundTrip);
+	RUN_TEST(test_messageSlotRoundTrip);
+	RUN_TEST(test_core1Log);
+	return UNITY_END();
+}
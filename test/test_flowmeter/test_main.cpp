@@ -0,0 +1,106 @@
+#include "utility/FlowMeter.h"
+#include "Timer.h"
+#include <unity.h>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_counterWrapsAround()
+{
+	FlowMeter meter(1);
+	meter.addCounter(1000);
+	TEST_ASSERT_EQUAL_UINT32(1000, meter.getCount());
+	meter.addCounter(1000);
+	TEST_ASSERT_EQUAL_UINT32(1000, meter.getCount());
+
+	// Right up to the wrap around, and past it
+	meter.addCounter(65535);
+	TEST_ASSERT_EQUAL_UINT32(65535, meter.getCount());
+	meter.addCounter(0);
+	TEST_ASSERT_EQUAL_UINT32(65536, meter.getCount());
+	meter.addCounter(500);
+	TEST_ASSERT_EQUAL_UINT32(66036, meter.getCount());
+
+	// Up to 65535 pulses between updates are counted, even if the counter ends up below where it was
+	meter.addCounter(499);
+	TEST_ASSERT_EQUAL_UINT32(66036 + 65535, meter.getCount());
+}
+
+void test_countKeepsGoingPast16Bits()
+{
+	FlowMeter meter(1);
+	uint16_t counter = 0;
+	uint32_t expected = 0;
+	// ~33 wrap arounds, in uneven steps so the counter lands on different values each time
+	for (int i = 0; i < 1000; i++)
+	{
+		uint16_t pulses = static_cast<uint16_t>(1000 + (i * 7919) % 3000);
+		counter += pulses;
+		expected += pulses;
+		meter.addCounter(counter);
+	}
+	TEST_ASSERT_EQUAL_UINT32(expected, meter.getCount());
+	TEST_ASSERT_TRUE(expected > 30 * 65536u);
+}
+
+void test_pulsesToMlRounding()
+{
+	// The conversions round to the nearest, so a pulse under/over doesn't add up over many shots
+	constexpr uint32_t ppl = AW_FLOW_METER_PULSES_PER_LITRE;
+	TEST_ASSERT_EQUAL_UINT32(0, FlowMeter::pulsesToMl(0));
+	TEST_ASSERT_EQUAL_UINT32(1000, FlowMeter::pulsesToMl(ppl));
+	TEST_ASSERT_EQUAL_UINT32(0, FlowMeter::mlToPulses(0));
+	TEST_ASSERT_EQUAL_UINT32(ppl, FlowMeter::mlToPulses(1000));
+
+	for (uint32_t pulses = 0; pulses < 10 * ppl; pulses++)
+	{
+		// Exact value is pulses * 1000 / ppl. Rounding to nearest (half up) means being at most half a millilitre off
+		int64_t error = static_cast<int64_t>(FlowMeter::pulsesToMl(pulses)) * 2 * ppl - static_cast<int64_t>(pulses) * 2000;
+		TEST_ASSERT_TRUE(error > -static_cast<int64_t>(ppl) && error <= static_cast<int64_t>(ppl));
+	}
+
+	for (uint32_t ml = 0; ml < 10000; ml++)
+	{
+		// Exact value is ml * ppl / 1000. Rounding to nearest (half up) means being at most half a pulse off
+		int64_t error = static_cast<int64_t>(FlowMeter::mlToPulses(ml)) * 2000 - static_cast<int64_t>(ml) * 2 * ppl;
+		TEST_ASSERT_TRUE(error > -1000 && error <= 1000);
+	}
+
+	// The intermediate values don't overflow, as long as the result fits
+	TEST_ASSERT_EQUAL_UINT32(static_cast<uint32_t>((1900000000ull * 1000 + ppl / 2) / ppl), FlowMeter::pulsesToMl(1900000000u));
+	TEST_ASSERT_EQUAL_UINT32(static_cast<uint32_t>((4000000000ull * ppl + 500) / 1000), FlowMeter::mlToPulses(4000000000u));
+}
+
+void test_shotVolumeRoundTrip()
+{
+	// A shot of N millilitres turns the motor off after mlToPulses(N) pulses, and reports pulsesToMl of that, which can
+	// be off by half a pulse, plus half a millilitre
+	constexpr float tolerance = 500.0f / AW_FLOW_METER_PULSES_PER_LITRE + 0.5f;
+	for (uint32_t ml = 0; ml <= AW_SHOT_MAX_VOLUME; ml++)
+	{
+		uint32_t reported = FlowMeter::pulsesToMl(FlowMeter::mlToPulses(ml));
+		TEST_ASSERT_FLOAT_WITHIN(tolerance, static_cast<float>(ml), static_cast<float>(reported));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_counterWrapsAround);
+	RUN_TEST(test_countKeepsGoingPast16Bits);
+	RUN_TEST(test_pulsesToMlRounding);
+	RUN_TEST(test_shotVolumeRoundTrip);
+	return UNITY_END();
+}
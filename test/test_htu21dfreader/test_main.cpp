@@ -0,0 +1,271 @@
+#include "utility/HTU21DFReader.h"
+#include "Timer.h"
+#include <Wire.h>
+#include <unity.h>
+#include <math.h>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+/**
+ * HTU21DF on the native I2C bus.
+ * While resetting or converting, it NACKs everything, like the real one does in no hold master mode.
+ */
+class FakeHTU21DF : public arduino_native::I2CDevice
+{
+  public:
+	FakeHTU21DF()
+	{
+		Wire.setDevice(HTU21DF_I2CADDR, this);
+	}
+
+	~FakeHTU21DF()
+	{
+		Wire.setDevice(HTU21DF_I2CADDR, nullptr);
+	}
+
+	// How long the sensor actually takes
+	uint32_t resetMicros = 12000;
+	uint32_t temperatureMicros = 44000;
+	uint32_t humidityMicros = 14000;
+
+	float temperature = 21.5f;
+	float humidity = 55.0f;
+	bool corruptCRC = false;
+	int numResets = 0;
+
+	virtual bool onWrite(const uint8_t* data, size_t len) override
+	{
+		if (isBusy() || len != 1)
+		{
+			return false;
+		}
+
+		switch (data[0])
+		{
+		case HTU21DF_RESET:
+			numResets++;
+			startBusy(resetMicros, Pending::None);
+			break;
+		case HTU21DF_READREG:
+			m_pending = Pending::UserRegister;
+			break;
+		case HTU21DF_TRIGGERTEMP_NOHOLD:
+			startBusy(temperatureMicros, Pending::Temperature);
+			break;
+		case HTU21DF_TRIGGERHUM_NOHOLD:
+			startBusy(humidityMicros, Pending::Humidity);
+			break;
+		default:
+			TEST_FAIL_MESSAGE("Unexpected command");
+		}
+		return true;
+	}
+
+	virtual size_t onRead(uint8_t* data, size_t quantity) override
+	{
+		if (isBusy() || m_pending == Pending::None)
+		{
+			return 0;
+		}
+
+		Pending pending = m_pending;
+		m_pending = Pending::None;
+		if (pending == Pending::UserRegister)
+		{
+			data[0] = 0x02;
+			return 1;
+		}
+
+		float raw = pending == Pending::Temperature ? (temperature + 46.85f) * 65536.0f / 175.72f
+		                                            : (humidity + 6.0f) * 65536.0f / 125.0f;
+		// The 2 status bits are 0 for temperature, and 2 for humidity
+		uint16_t value = (static_cast<uint16_t>(lroundf(raw)) & 0xFFFC) | (pending == Pending::Humidity ? 2 : 0);
+		data[0] = value >> 8;
+		data[1] = value & 0xFF;
+		data[2] = Adafruit_HTU21DF::calcCRC(data, 2) ^ (corruptCRC ? 1 : 0);
+		return 3;
+	}
+
+  private:
+	enum class Pending
+	{
+		None,
+		UserRegister,
+		Temperature,
+		Humidity
+	};
+
+	bool isBusy() const
+	{
+		return arduino_native::getMicros() < m_busyUntil;
+	}
+
+	void startBusy(uint32_t micros, Pending pending)
+	{
+		m_busyUntil = arduino_native::getMicros() + micros;
+		m_pending = pending;
+	}
+
+	uint64_t m_busyUntil = 0;
+	Pending m_pending = Pending::None;
+};
+
+/**
+ * Drives the reader the way the component does: Ticking it again only after the time it asks for.
+ * None of the calls can take any time. Anything waiting on the sensor (e.g: delay) moves the native clock forward.
+ */
+class ReaderDriver
+{
+  public:
+	ReaderDriver()
+	{
+		uint64_t start = arduino_native::getMicros();
+		reader.begin();
+		TEST_ASSERT_EQUAL_UINT64(start, arduino_native::getMicros());
+		waitUntilIdle();
+	}
+
+	void advance(float seconds)
+	{
+		arduino_native::advanceMicros(static_cast<uint64_t>(lroundf(seconds * 1000000.0f)));
+		elapsed += seconds;
+	}
+
+	// Ticks until there is a reading, and returns how long it took, in seconds
+	float read()
+	{
+		elapsed = 0;
+		numTicks = 0;
+		uint64_t start = arduino_native::getMicros();
+		float wait = reader.startReading();
+		TEST_ASSERT_EQUAL_UINT64(start, arduino_native::getMicros());
+
+		while (!reader.fetchReading(temperature, humidity))
+		{
+			TEST_ASSERT_TRUE(wait > 0);
+			advance(wait);
+			wait = tick(wait);
+		}
+		return elapsed;
+	}
+
+	void waitUntilIdle()
+	{
+		float wait = tick(0);
+		while (reader.getState() != HTU21DFReader::State::Idle)
+		{
+			advance(wait);
+			wait = tick(wait);
+		}
+	}
+
+	HTU21DFReader reader;
+	float temperature = 0;
+	float humidity = 0;
+	float elapsed = 0;
+	int numTicks = 0;
+
+  private:
+	float tick(float deltaSeconds)
+	{
+		uint64_t start = arduino_native::getMicros();
+		float wait = reader.tick(deltaSeconds);
+		TEST_ASSERT_EQUAL_UINT64(start, arduino_native::getMicros());
+		numTicks++;
+		TEST_ASSERT_LESS_THAN(1000, numTicks);
+		return wait;
+	}
+};
+
+} // namespace
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_readingDoesNotBlock()
+{
+	FakeHTU21DF sensor;
+	ReaderDriver driver;
+
+	// One tick when each conversion should be done, after the datasheet's maximum conversion time
+	float elapsed = driver.read();
+	TEST_ASSERT_EQUAL_INT(2, driver.numTicks);
+	TEST_ASSERT_FLOAT_WITHIN(0.0001f, (HTU21DF_TEMP_MEASUREMENT_MS + HTU21DF_HUM_MEASUREMENT_MS) / 1000.0f, elapsed);
+	TEST_ASSERT_FLOAT_WITHIN(0.01f, 21.5f, driver.temperature);
+	TEST_ASSERT_FLOAT_WITHIN(0.01f, 55.0f, driver.humidity);
+	TEST_ASSERT_TRUE(driver.reader.getState() == HTU21DFReader::State::Idle);
+}
+
+void test_slowConversionIsRetried()
+{
+	FakeHTU21DF sensor;
+	sensor.temperatureMicros = 58000;
+	ReaderDriver driver;
+
+	// The temperature is checked again every 5ms, until the sensor answers
+	float elapsed = driver.read();
+	TEST_ASSERT_EQUAL_INT(4, driver.numTicks);
+	TEST_ASSERT_FLOAT_WITHIN(0.0001f, (HTU21DF_TEMP_MEASUREMENT_MS + 10 + HTU21DF_HUM_MEASUREMENT_MS) / 1000.0f, elapsed);
+	TEST_ASSERT_FLOAT_WITHIN(0.01f, 21.5f, driver.temperature);
+	TEST_ASSERT_FLOAT_WITHIN(0.01f, 55.0f, driver.humidity);
+}
+
+void test_missingSensorTimesOut()
+{
+	ReaderDriver driver;
+
+	// Gives up on each value after 0.5 seconds, without ever waiting in a tick, and resets the sensor
+	float elapsed = driver.read();
+	TEST_ASSERT_TRUE(isnan(driver.temperature));
+	TEST_ASSERT_TRUE(isnan(driver.humidity));
+	TEST_ASSERT_FLOAT_WITHIN(0.01f, 1.0f, elapsed);
+	TEST_ASSERT_TRUE(driver.reader.getState() == HTU21DFReader::State::Resetting);
+	driver.waitUntilIdle();
+
+	// Once the sensor is back, the readings are too
+	FakeHTU21DF sensor;
+	driver.read();
+	TEST_ASSERT_FLOAT_WITHIN(0.01f, 21.5f, driver.temperature);
+	TEST_ASSERT_FLOAT_WITHIN(0.01f, 55.0f, driver.humidity);
+}
+
+void test_crcErrorResets()
+{
+	FakeHTU21DF sensor;
+	ReaderDriver driver;
+	TEST_ASSERT_EQUAL_INT(1, sensor.numResets);
+
+	sensor.corruptCRC = true;
+	driver.read();
+	TEST_ASSERT_TRUE(isnan(driver.temperature));
+	TEST_ASSERT_TRUE(isnan(driver.humidity));
+	TEST_ASSERT_EQUAL_INT(2, sensor.numResets);
+	driver.waitUntilIdle();
+
+	sensor.corruptCRC = false;
+	driver.read();
+	TEST_ASSERT_FLOAT_WITHIN(0.01f, 21.5f, driver.temperature);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_readingDoesNotBlock);
+	RUN_TEST(test_slowConversionIsRetried);
+	RUN_TEST(test_missingSensorTimesOut);
+	RUN_TEST(test_crcErrorResets);
+	return UNITY_END();
+}
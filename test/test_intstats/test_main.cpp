@@ -0,0 +1,236 @@
+#include "utility/IntStats.h"
+#include "Timer.h"
+#include <crazygaze/micromuc/MathUtils.h>
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+// Deterministic pseudo random numbers, so the tests use the same sample sets every time
+uint32_t gSeed;
+int testRandom(int minValue, int maxValue)
+{
+	gSeed = gSeed * 1664525u + 1013904223u;
+	return minValue + static_cast<int>((gSeed >> 8) % static_cast<uint32_t>(maxValue - minValue + 1));
+}
+
+struct SampleSet
+{
+	const char* name;
+	int mean;
+	int noise;
+	// How many samples are replaced with a spike
+	int numSpikes;
+};
+
+const SampleSet gSets[] =
+{
+	// Typical readings of a sensor in dry and wet soil
+	{"dry", 560, 3, 0},
+	{"wet", 190, 3, 0},
+	{"spikes", 400, 3, 2},
+	// Floating pin (no sensor)
+	{"floating", 2000, 1000, 0}
+};
+
+constexpr int gNumSamples = 30;
+
+void fillSamples(const SampleSet& set, int* samples)
+{
+	for (int i = 0; i < gNumSamples; i++)
+	{
+		samples[i] = set.mean + testRandom(-set.noise, set.noise);
+	}
+	for (int i = 0; i < set.numSpikes; i++)
+	{
+		samples[testRandom(0, gNumSamples - 1)] = testRandom(0, (1 << AW_ADC_NUM_BITS) - 1);
+	}
+}
+
+// Reference (sample) standard deviation, in double precision
+void calcReference(const int* samples, int numSamples, double& mean, double& stdDeviation)
+{
+	mean = 0;
+	for (int i = 0; i < numSamples; i++)
+	{
+		mean += samples[i];
+	}
+	mean /= numSamples;
+
+	double sum = 0;
+	for (int i = 0; i < numSamples; i++)
+	{
+		sum += (samples[i] - mean) * (samples[i] - mean);
+	}
+	stdDeviation = numSamples > 1 ? sqrt(sum / (numSamples - 1)) : 0;
+}
+
+} // namespace
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_knownValues()
+{
+	IntStatsAccumulator acc;
+	for (int v : {2, 4, 4, 4, 5, 5, 7, 9})
+	{
+		acc.add(v);
+	}
+
+	IntStats res = acc.get();
+	TEST_ASSERT_EQUAL_INT(8, res.count);
+	TEST_ASSERT_EQUAL_INT(5 << IntStats::ms_fractionalBits, res.meanQ8);
+	TEST_ASSERT_EQUAL_INT(5, res.getMean());
+	// sqrt(32/7)
+	TEST_ASSERT_FLOAT_WITHIN(1.0f / (1 << IntStats::ms_fractionalBits), 2.13809f, res.getStdDeviation());
+}
+
+void test_emptyAndSingleSample()
+{
+	IntStatsAccumulator acc;
+	TEST_ASSERT_EQUAL_INT(0, acc.get().count);
+	TEST_ASSERT_EQUAL_INT(0, acc.get().meanQ8);
+
+	acc.add(1234);
+	IntStats res = acc.get();
+	TEST_ASSERT_EQUAL_INT(1, res.count);
+	TEST_ASSERT_EQUAL_INT(1234, res.getMean());
+	TEST_ASSERT_EQUAL_INT(0, res.stdDeviationQ8);
+}
+
+void test_meanRoundsToNearest()
+{
+	IntStatsAccumulator acc;
+	acc.add(1);
+	acc.add(2);
+	acc.add(2);
+	// 1.666
+	TEST_ASSERT_EQUAL_INT(2, acc.get().getMean());
+}
+
+void test_matchesReference()
+{
+	gSeed = 12345;
+	for (const SampleSet& set : gSets)
+	{
+		int samples[gNumSamples];
+		fillSamples(set, samples);
+
+		double mean, stdDeviation;
+		calcReference(samples, gNumSamples, mean, stdDeviation);
+
+		IntStatsAccumulator acc;
+		for (int s : samples)
+		{
+			acc.add(s);
+		}
+		IntStats res = acc.get();
+
+		// Q8 results are truncated, so they are within 1/256 of the exact values
+		TEST_ASSERT_FLOAT_WITHIN_MESSAGE(1.0f / 256, mean, res.meanQ8 / 256.0f, set.name);
+		TEST_ASSERT_FLOAT_WITHIN_MESSAGE(1.0f / 256, stdDeviation, res.getStdDeviation(), set.name);
+	}
+}
+
+void test_matchesCalcStandardDeviation()
+{
+	gSeed = 12345;
+	for (const SampleSet& set : gSets)
+	{
+		int samples[gNumSamples];
+		fillSamples(set, samples);
+
+		StandardDeviation floatRes = calcStandardDeviation(samples, gNumSamples);
+		IntStatsAccumulator acc;
+		for (int s : samples)
+		{
+			acc.add(s);
+		}
+		IntStats intRes = acc.get();
+
+		TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.5f, floatRes.mean, static_cast<float>(intRes.getMean()), set.name);
+		// calcStandardDeviation is the population standard deviation (divides by n instead of n-1), so it can be up to
+		// sqrt(n/(n-1)) smaller
+		float tolerance = floatRes.stdDeviation * (sqrtf(gNumSamples / (gNumSamples - 1.0f)) - 1.0f) + 0.01f;
+		TEST_ASSERT_FLOAT_WITHIN_MESSAGE(tolerance, floatRes.stdDeviation, intRes.getStdDeviation(), set.name);
+	}
+}
+
+void test_trimmedStatsRejectSpikes()
+{
+	int samples[10] = {400, 401, 399, 4095, 400, 402, 398, 0, 401, 399};
+	IntStats res = calcTrimmedStats(samples, 10, 1);
+	TEST_ASSERT_EQUAL_INT(8, res.count);
+	TEST_ASSERT_EQUAL_INT(400, res.getMean());
+	TEST_ASSERT_LESS_THAN_INT(2 << IntStats::ms_fractionalBits, res.stdDeviationQ8);
+
+	// Sorted in place
+	for (int i = 1; i < 10; i++)
+	{
+		TEST_ASSERT_LESS_OR_EQUAL_INT(samples[i], samples[i - 1]);
+	}
+}
+
+void test_trimmedStatsLeaveOneSample()
+{
+	int samples[3] = {5, 1, 9};
+	IntStats res = calcTrimmedStats(samples, 3, 10);
+	TEST_ASSERT_EQUAL_INT(1, res.count);
+	TEST_ASSERT_EQUAL_INT(5, res.getMean());
+}
+
+void test_medianOfK()
+{
+	TMedianOfK<3> median;
+	int32_t value = -1;
+	TEST_ASSERT_FALSE(median.add(10, value));
+	TEST_ASSERT_FALSE(median.add(4000, value));
+	TEST_ASSERT_TRUE(median.add(12, value));
+	TEST_ASSERT_EQUAL_INT(12, value);
+
+	// Starts over with the next 3
+	TEST_ASSERT_FALSE(median.add(0, value));
+	TEST_ASSERT_FALSE(median.add(7, value));
+	TEST_ASSERT_TRUE(median.add(8, value));
+	TEST_ASSERT_EQUAL_INT(7, value);
+}
+
+void test_isqrt64()
+{
+	TEST_ASSERT_EQUAL_UINT32(0, isqrt64(0));
+	TEST_ASSERT_EQUAL_UINT32(1, isqrt64(3));
+	TEST_ASSERT_EQUAL_UINT32(2, isqrt64(4));
+	TEST_ASSERT_EQUAL_UINT32(65535, isqrt64(65536ull * 65536ull - 1));
+	TEST_ASSERT_EQUAL_UINT32(65536, isqrt64(65536ull * 65536ull));
+	TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, isqrt64(UINT64_MAX));
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_knownValues);
+	RUN_TEST(test_emptyAndSingleSample);
+	RUN_TEST(test_meanRoundsToNearest);
+	RUN_TEST(test_matchesReference);
+	RUN_TEST(test_matchesCalcStandardDeviation);
+	RUN_TEST(test_trimmedStatsRejectSpikes);
+	RUN_TEST(test_trimmedStatsLeaveOneSample);
+	RUN_TEST(test_medianOfK);
+	RUN_TEST(test_isqrt64);
+	return UNITY_END();
+}
@@ -0,0 +1,144 @@
+#include "LowPowerIdle.h"
+#include "Timer.h"
+#include <unity.h>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+class TestWakeSource : public Component
+{
+  public:
+	virtual const char* getName() const override
+	{
+		return "TestWakeSource";
+	}
+
+	virtual float tick(float deltaSeconds) override
+	{
+		ticks++;
+		pendingInput = false;
+		return 60 * 60;
+	}
+
+	virtual void onEvent(const Event& evt) override
+	{
+	}
+
+	virtual bool hasPendingInput() override
+	{
+		return pendingInput;
+	}
+
+	bool pendingInput = false;
+	int ticks = 0;
+
+  private:
+	virtual bool initImpl() override
+	{
+		return true;
+	}
+};
+
+void setPendingInput(void* userData)
+{
+	static_cast<TestWakeSource*>(userData)->pendingInput = true;
+}
+
+} // namespace
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_sleepsUntilDeadline()
+{
+	LowPowerIdle::SimulatedClock clock;
+	LowPowerIdle idle(clock);
+	TestWakeSource source;
+	idle.addWakeSource(source);
+
+	TEST_ASSERT_FALSE(idle.idle(1.5f));
+	TEST_ASSERT_EQUAL_UINT64(1500000, clock.getMicros());
+}
+
+void test_eventWithoutInputKeepsSleeping()
+{
+	LowPowerIdle::SimulatedClock clock;
+	LowPowerIdle idle(clock);
+	TestWakeSource source;
+	idle.addWakeSource(source);
+
+	// e.g: some other interrupt
+	clock.scheduleEvent(200000);
+	clock.scheduleEvent(500000);
+
+	TEST_ASSERT_FALSE(idle.idle(1.0f));
+	TEST_ASSERT_EQUAL_UINT64(1000000, clock.getMicros());
+}
+
+void test_inputWakesUpEarly()
+{
+	LowPowerIdle::SimulatedClock clock;
+	LowPowerIdle idle(clock);
+	TestWakeSource source;
+	idle.addWakeSource(source);
+
+	// First tick happens straight away, and then the component waits for an hour
+	Component::tickAll(0);
+	TEST_ASSERT_EQUAL_INT(1, source.ticks);
+
+	clock.scheduleEvent(300000, setPendingInput, &source);
+	TEST_ASSERT_TRUE(idle.idle(10.0f));
+	TEST_ASSERT_EQUAL_UINT64(300000, clock.getMicros());
+
+	// The wake source should have been woken up, so it ticks now instead of an hour from now
+	Component::tickAll(0.3f);
+	TEST_ASSERT_EQUAL_INT(2, source.ticks);
+}
+
+void test_inputBeforeSleepingReturnsRightAway()
+{
+	LowPowerIdle::SimulatedClock clock;
+	LowPowerIdle idle(clock);
+	TestWakeSource source;
+	idle.addWakeSource(source);
+
+	source.pendingInput = true;
+	TEST_ASSERT_TRUE(idle.idle(10.0f));
+	TEST_ASSERT_EQUAL_UINT64(0, clock.getMicros());
+}
+
+void test_eventAlreadyDueReturnsRightAway()
+{
+	LowPowerIdle::SimulatedClock clock;
+	LowPowerIdle idle(clock);
+	TestWakeSource source;
+	idle.addWakeSource(source);
+
+	// Input that arrives after the check but before the wait still wakes it up, since the event is already pending
+	clock.scheduleEvent(0, setPendingInput, &source);
+	TEST_ASSERT_TRUE(idle.idle(10.0f));
+	TEST_ASSERT_EQUAL_UINT64(0, clock.getMicros());
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_sleepsUntilDeadline);
+	RUN_TEST(test_eventWithoutInputKeepsSleeping);
+	RUN_TEST(test_inputWakesUpEarly);
+	RUN_TEST(test_inputBeforeSleepingReturnsRightAway);
+	RUN_TEST(test_eventAlreadyDueReturnsRightAway);
+	return UNITY_END();
+}
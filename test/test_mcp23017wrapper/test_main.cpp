@@ -0,0 +1,251 @@
+#include "utility/MCP23017Wrapper.h"
+#include "utility/MuxNChannels.h"
+#include "Timer.h"
+#include "crazygaze/micromuc/StringUtils.h"
+#include <unity.h>
+#include <optional>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+/**
+ * What the IO expander itself has in its registers.
+ * This survives the wrapper, the same way the real one keeps its registers through an MCU only reset.
+ */
+struct FakeExpander
+{
+	uint16_t iodir = 0xFFFF;
+	uint16_t gppu = 0x0000;
+	uint16_t olat = 0x0000;
+	// Every pin that was an output driving HIGH at any point
+	uint16_t drivenHigh = 0x0000;
+
+	void update()
+	{
+		drivenHigh |= ~iodir & olat;
+	}
+};
+
+/**
+ * Mock wrapper that applies the writes to a FakeExpander
+ */
+class TestMCP23017Wrapper : public MockMCP23017Wrapper
+{
+  public:
+	explicit TestMCP23017Wrapper(FakeExpander& expander)
+		: m_expander(expander)
+	{
+	}
+
+	virtual void begin(uint8_t addr) override
+	{
+		// Adafruit_MCP23017::begin only sets all pins as inputs
+		m_expander.iodir = 0xFFFF;
+		MockMCP23017Wrapper::begin(addr);
+	}
+
+	int numWrites = 0;
+
+  protected:
+	uint16_t& getRegister(uint8_t regA)
+	{
+		switch (regA)
+		{
+		case MCP23017_GPPUA:
+			return m_expander.gppu;
+		case MCP23017_OLATA:
+			return m_expander.olat;
+		default:
+			TEST_ASSERT_EQUAL_HEX8(MCP23017_IODIRA, regA);
+			return m_expander.iodir;
+		}
+	}
+
+	virtual void writeRegisterAB(uint8_t regA, uint16_t value) override
+	{
+		MockMCP23017Wrapper::writeRegisterAB(regA, value);
+		numWrites++;
+		getRegister(regA) = value;
+		m_expander.update();
+	}
+
+	virtual void writePinUncached(Reg reg, IOExpanderPin pin, bool set) override
+	{
+		MockMCP23017Wrapper::writePinUncached(reg, pin, set);
+		numWrites++;
+		uint16_t& value = getRegister(reg == Reg::GPPU ? MCP23017_GPPUA : (reg == Reg::OLAT ? MCP23017_OLATA : MCP23017_IODIRA));
+		value = set ? (value | (1 << pin.raw)) : (value & ~(1 << pin.raw));
+		m_expander.update();
+	}
+
+	FakeExpander& m_expander;
+};
+
+constexpr uint8_t gMotorPin = 3;
+
+} // namespace
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+/**
+ * A pump pin was HIGH when the MCU reset, so the expander's latch is still HIGH. Setting the pin as an output again and
+ * writing LOW must never drive it HIGH.
+ */
+void beginClearsStaleLatches(bool writeCombining)
+{
+	FakeExpander expander;
+	expander.iodir = ~(1 << gMotorPin);
+	expander.olat = 1 << gMotorPin;
+	expander.gppu = 0x00F0;
+
+	TestMCP23017Wrapper ioExpander(expander);
+	ioExpander.setWriteCombining(writeCombining);
+	ioExpander.begin(0);
+	TEST_ASSERT_EQUAL_HEX16(0xFFFF, expander.iodir);
+	TEST_ASSERT_EQUAL_HEX16(0x0000, expander.olat);
+	TEST_ASSERT_EQUAL_HEX16(0x0000, expander.gppu);
+
+	expander.drivenHigh = 0;
+	MCP23xxxOutputPin motorPin(ioExpander, gMotorPin);
+	TEST_ASSERT_EQUAL_HEX16(static_cast<uint16_t>(~(1 << gMotorPin)), expander.iodir);
+	motorPin.write(LOW);
+	TEST_ASSERT_EQUAL_HEX16(0x0000, expander.drivenHigh);
+
+	// From then on, the cache matches the expander
+	motorPin.write(HIGH);
+	TEST_ASSERT_EQUAL_HEX16(1 << gMotorPin, expander.olat);
+	motorPin.write(LOW);
+	TEST_ASSERT_EQUAL_HEX16(0x0000, expander.olat);
+}
+
+void test_beginClearsStaleLatches()
+{
+	beginClearsStaleLatches(true);
+	beginClearsStaleLatches(false);
+}
+
+/**
+ * After begin, only the changes are sent
+ */
+void test_unchangedWritesAreSkipped()
+{
+	FakeExpander expander;
+	TestMCP23017Wrapper ioExpander(expander);
+	ioExpander.setWriteCombining(true);
+	ioExpander.begin(0);
+	MCP23xxxOutputPin motorPin(ioExpander, gMotorPin);
+	motorPin.write(HIGH);
+
+	int numWrites = ioExpander.numWrites;
+	motorPin.write(HIGH);
+	ioExpander.pinMode(IOExpanderPin(gMotorPin), OUTPUT);
+	TEST_ASSERT_EQUAL_INT(numWrites, ioExpander.numWrites);
+
+	{
+		MCP23017WriteScope writeScope(ioExpander);
+		ioExpander.digitalWrite(IOExpanderPin(0), HIGH);
+		ioExpander.digitalWrite(IOExpanderPin(1), HIGH);
+		motorPin.write(LOW);
+	}
+	TEST_ASSERT_EQUAL_HEX16(0x0003, expander.olat);
+}
+
+struct SweepTraffic
+{
+	uint32_t transactions;
+	uint32_t bytes;
+};
+
+/**
+ * Reads 8 sensors behind a mux the way RealSoilMoistureSensor does in a sweep (channels in Gray code order, each
+ * sensor powered only while it's read), and returns the I2C traffic it took.
+ */
+SweepTraffic sweep(bool writeCombining)
+{
+	FakeExpander expander;
+	TestMCP23017Wrapper ioExpander(expander);
+	ioExpander.setWriteCombining(writeCombining);
+	ioExpander.begin(0);
+
+	Mux8Channels mux;
+	mux.begin(ioExpander, IOExpanderPin(8), IOExpanderPin(9), IOExpanderPin(10), MCUPin(26), IOExpanderPin(11));
+
+	std::optional<MuxAnalogInputPin> dataPins[8];
+	std::optional<MCP23xxxOutputPin> vinPins[8];
+	for (int i = 0; i < 8; i++)
+	{
+		// Sorted by sweep key, which is what the sensors waiting to read are
+		int channel = 0;
+		while (muxChannelToGrayCodeOrder(channel) != i)
+		{
+			channel++;
+		}
+		dataPins[i].emplace(mux, channel);
+		vinPins[i].emplace(ioExpander, i);
+	}
+
+	SweepTraffic start = {MCP23017WrapperInterface::getNumI2CTransactions(), MCP23017WrapperInterface::getNumI2CBytes()};
+	for (int i = 0; i < 8; i++)
+	{
+		dataPins[i]->beginSweep();
+	}
+	for (int i = 0; i < 8; i++)
+	{
+		vinPins[i]->write(HIGH);
+		dataPins[i]->enable();
+		dataPins[i]->read();
+		dataPins[i]->disable();
+		vinPins[i]->write(LOW);
+	}
+	for (int i = 0; i < 8; i++)
+	{
+		dataPins[i]->endSweep();
+	}
+	SweepTraffic res = {MCP23017WrapperInterface::getNumI2CTransactions() - start.transactions,
+		MCP23017WrapperInterface::getNumI2CBytes() - start.bytes};
+
+	// The sensors are left powered off, and the mux disabled
+	TEST_ASSERT_EQUAL_HEX16(1 << 11, expander.olat & 0x08FF);
+	TEST_ASSERT_EQUAL_HEX16(0x00FF, expander.drivenHigh & 0x00FF);
+	return res;
+}
+
+void test_sweepI2CTraffic()
+{
+	SweepTraffic combined = sweep(true);
+	SweepTraffic uncached = sweep(false);
+	TEST_MESSAGE(formatString("8 readings: %u I2C transactions (%u bytes) with write combining, %u (%u bytes) without",
+		static_cast<unsigned int>(combined.transactions), static_cast<unsigned int>(combined.bytes),
+		static_cast<unsigned int>(uncached.transactions), static_cast<unsigned int>(uncached.bytes)));
+
+	// With write combining, every change is one write: Powering each sensor on and off, the 7 channel changes (one S pin
+	// each), and enabling and disabling the mux once.
+	TEST_ASSERT_EQUAL_UINT32(8 * 2 + 7 + 2, combined.transactions);
+	TEST_ASSERT_EQUAL_UINT32(combined.transactions * 4, combined.bytes);
+	// Without, each of those is a read-modify-write, plus the first channel setting all 3 S pins, since the mux doesn't
+	// know what they were (with the cache, they are already LOW)
+	TEST_ASSERT_EQUAL_UINT32((combined.transactions + 3) * 3, uncached.transactions);
+	TEST_ASSERT_EQUAL_UINT32((combined.transactions + 3) * 7, uncached.bytes);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_beginClearsStaleLatches);
+	RUN_TEST(test_unchangedWritesAreSkipped);
+	RUN_TEST(test_sweepI2CTraffic);
+	return UNITY_END();
+}
@@ -0,0 +1,345 @@
+#include "utility/PumpController.h"
+#include "Timer.h"
+#include "crazygaze/micromuc/StringUtils.h"
+#include <unity.h>
+#include <algorithm>
+#include <climits>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+constexpr float gShotDuration = 5;
+constexpr float gSamplingInterval = 60;
+constexpr unsigned int gWaterValue = 180;
+constexpr unsigned int gAirValue = 560;
+constexpr unsigned int gThreshold = 400;
+constexpr unsigned int gTargetValue = gThreshold - (gAirValue - gWaterValue) * AW_PUMP_TARGET_PERCENT / 100;
+
+// Deterministic pseudo random numbers, so the runs are the same every time
+uint32_t gSeed;
+float testRandom(float minValue, float maxValue)
+{
+	gSeed = gSeed * 1664525u + 1013904223u;
+	return minValue + (maxValue - minValue) * ((gSeed >> 8) / static_cast<float>(1 << 24));
+}
+
+uint64_t toMicros(float seconds)
+{
+	return static_cast<uint64_t>(seconds * 1000000.0f);
+}
+
+/**
+ * Soil and sensor, like MockSoilMoistureSensor: The soil's moisture drops while pumping and rises slowly while drying.
+ * The sensor follows it at a limited rate, and only some time after the motor turns on.
+ */
+struct Soil
+{
+	Soil()
+	{
+		onRate = testRandom(5, 15);
+		chaseRate = testRandom(4, 10);
+		chaseDelayOnMotor = testRandom(3, 30);
+		// Reaches the threshold from the target in 1 to 6 hours
+		offRate = (gThreshold - gTargetValue) / testRandom(60 * 60, 6 * 60 * 60);
+		// Starts dry, as if just planted
+		targetValue = currentValue = testRandom(gThreshold, gAirValue);
+	}
+
+	void update(float deltaSeconds, bool motorIsOn)
+	{
+		if (motorIsOn && !this->motorIsOn && chaseDelay <= 0)
+		{
+			chaseDelay = chaseDelayOnMotor;
+		}
+		this->motorIsOn = motorIsOn;
+
+		targetValue += (motorIsOn ? -onRate : offRate) * deltaSeconds;
+		targetValue = std::clamp(targetValue, static_cast<float>(gWaterValue), static_cast<float>(gAirValue));
+
+		if (chaseDelay > 0)
+		{
+			chaseDelay -= deltaSeconds;
+		}
+		else if (currentValue < targetValue)
+		{
+			currentValue = std::min(currentValue + chaseRate * deltaSeconds, targetValue);
+		}
+		else
+		{
+			currentValue = std::max(currentValue - chaseRate * deltaSeconds, targetValue);
+		}
+	}
+
+	float onRate;
+	float chaseRate;
+	float chaseDelayOnMotor;
+	float offRate;
+	float targetValue;
+	float currentValue;
+	float chaseDelay = 0;
+	bool motorIsOn = false;
+};
+
+struct SimResult
+{
+	int numShots;
+	float pumpSeconds;
+	float maxShotDuration;
+	// How far below the target the readings went after each shot, as a percentage of the air/water range
+	float avgOvershoot;
+	float maxOvershoot;
+};
+
+/**
+ * Runs the soil with the controller in the specified mode, making the same decisions PumpMonitor::tick does:
+ * An automated shot is done when the soak wait is over and there was a valid reading above the threshold since the last
+ * shot.
+ */
+SimResult simulate(PumpController::Mode mode, Soil soil, float days)
+{
+	PumpController controller(0);
+	SimResult res = {};
+	int numOvershoots = 0;
+
+	// See PumpMonitor::m_motorOffCountdown
+	float motorOffCountdown = -AW_MINIMUM_TIME_BETWEEN_MOTOR_ON;
+	float soakDuration = AW_MINIMUM_TIME_BETWEEN_MOTOR_ON;
+	float shotDuration = 0;
+	bool validReadingSinceLastShot = false;
+	unsigned int lastValue = 0;
+	// Lowest reading since the last shot
+	unsigned int minValue = UINT_MAX;
+
+	auto finishShot = [&]()
+	{
+		if (minValue != UINT_MAX)
+		{
+			float overshoot = std::max(static_cast<int>(gTargetValue) - static_cast<int>(minValue), 0) * 100.0f / (gAirValue - gWaterValue);
+			res.avgOvershoot += overshoot;
+			res.maxOvershoot = std::max(res.maxOvershoot, overshoot);
+			numOvershoots++;
+		}
+	};
+
+	constexpr float step = 1;
+	const int numSteps = static_cast<int>(days * 24 * 60 * 60 / step);
+	for (int i = 0; i < numSteps; i++)
+	{
+		const float t = i * step;
+		soil.update(step, motorOffCountdown > 0);
+
+		if (i % static_cast<int>(gSamplingInterval / step) == 0)
+		{
+			lastValue = static_cast<unsigned int>(soil.currentValue);
+			controller.addReading(lastValue, toMicros(t));
+			if (!controller.usesModel(mode) || motorOffCountdown <= -soakDuration)
+			{
+				validReadingSinceLastShot = true;
+			}
+			if (res.numShots)
+			{
+				minValue = std::min(minValue, lastValue);
+			}
+		}
+
+		if (motorOffCountdown > 0)
+		{
+			motorOffCountdown -= step;
+			if (motorOffCountdown <= 0)
+			{
+				soakDuration = controller.calcSoakDuration(mode, shotDuration);
+				motorOffCountdown = 0;
+			}
+		}
+		else if (motorOffCountdown <= -soakDuration)
+		{
+			if (validReadingSinceLastShot && lastValue > gThreshold)
+			{
+				finishShot();
+				minValue = UINT_MAX;
+
+				shotDuration = controller.calcShotDuration(mode, lastValue, gTargetValue, gShotDuration);
+				controller.startShot(lastValue, shotDuration, toMicros(t));
+				motorOffCountdown = shotDuration;
+				validReadingSinceLastShot = false;
+				res.numShots++;
+				res.pumpSeconds += shotDuration;
+				res.maxShotDuration = std::max(res.maxShotDuration, shotDuration);
+			}
+		}
+		else
+		{
+			motorOffCountdown -= step;
+		}
+	}
+
+	finishShot();
+	res.avgOvershoot /= std::max(numOvershoots, 1);
+	return res;
+}
+
+// Feeds the controller a shot and the readings after it
+void doShot(PumpController& controller, float shotDuration, uint64_t& micros, std::initializer_list<unsigned int> values)
+{
+	bool first = true;
+	for (unsigned int value : values)
+	{
+		if (first)
+		{
+			controller.startShot(value, shotDuration, micros);
+			first = false;
+		}
+		else
+		{
+			controller.addReading(value, micros);
+		}
+		micros += toMicros(gSamplingInterval);
+	}
+}
+
+} // namespace
+
+void setUp()
+{
+	gSeed = 12345;
+}
+
+void tearDown()
+{
+}
+
+void test_withoutModelAllModesAreFixed()
+{
+	PumpController controller(0);
+	for (auto mode : {PumpController::Mode::Fixed, PumpController::Mode::Predictive, PumpController::Mode::PulseAndSoak})
+	{
+		TEST_ASSERT_FALSE(controller.usesModel(mode));
+		TEST_ASSERT_EQUAL_FLOAT(gShotDuration, controller.calcShotDuration(mode, 450, gTargetValue, gShotDuration));
+		TEST_ASSERT_EQUAL_FLOAT(AW_MINIMUM_TIME_BETWEEN_MOTOR_ON, controller.calcSoakDuration(mode, gShotDuration));
+	}
+}
+
+void test_learnsGainAndDelay()
+{
+	PumpController controller(0);
+	uint64_t micros = 0;
+
+	// 5 seconds dropping the value by 50, seen 2 readings later. Drying again after that.
+	doShot(controller, 5, micros, {420, 400, 370, 375, 380});
+	const PumpController::Model& model = controller.getModel();
+	TEST_ASSERT_EQUAL_INT(1, model.numSamples);
+	TEST_ASSERT_FLOAT_WITHIN(0.001f, 10.0f, model.gain);
+	TEST_ASSERT_FLOAT_WITHIN(0.001f, 2 * gSamplingInterval, model.delay);
+
+	// The next responses are blended in
+	doShot(controller, 5, micros, {420, 395, 400, 410});
+	TEST_ASSERT_EQUAL_INT(2, model.numSamples);
+	TEST_ASSERT_FLOAT_WITHIN(0.001f, 10.0f - 5.0f * AW_PUMP_MODEL_LEARNING_RATE, model.gain);
+	TEST_ASSERT_FLOAT_WITHIN(0.001f, 2 * gSamplingInterval - gSamplingInterval * AW_PUMP_MODEL_LEARNING_RATE, model.delay);
+
+	// A shot with no effect (e.g: empty reservoir) is not learned
+	doShot(controller, 5, micros, {420, 425, 430});
+	controller.startShot(0, 5, micros);
+	TEST_ASSERT_EQUAL_INT(2, model.numSamples);
+
+	// Nor one cut short by a fault
+	doShot(controller, 5, micros, {420, 380});
+	controller.cancelShot();
+	controller.startShot(0, 5, micros);
+	TEST_ASSERT_EQUAL_INT(2, model.numSamples);
+}
+
+void test_shotAndSoakDuration()
+{
+	PumpController controller(0);
+	uint64_t micros = 0;
+	doShot(controller, 5, micros, {420, 400, 370, 375, 380});
+
+	// Sized to reach the target
+	TEST_ASSERT_FLOAT_WITHIN(0.001f, 3.0f, controller.calcShotDuration(PumpController::Mode::Predictive, gTargetValue + 30, gTargetValue, gShotDuration));
+	TEST_ASSERT_FLOAT_WITHIN(0.001f, 3.0f, controller.calcShotDuration(PumpController::Mode::PulseAndSoak, gTargetValue + 30, gTargetValue, gShotDuration));
+	// Pulse and soak gives at most a normal shot at a time
+	TEST_ASSERT_FLOAT_WITHIN(0.001f, (gAirValue - gTargetValue) / 10.0f, controller.calcShotDuration(PumpController::Mode::Predictive, gAirValue, gTargetValue, gShotDuration));
+	TEST_ASSERT_EQUAL_FLOAT(AW_SHOT_MAX_DURATION, controller.calcShotDuration(PumpController::Mode::Predictive, gTargetValue + 2000, gTargetValue, gShotDuration));
+	TEST_ASSERT_EQUAL_FLOAT(gShotDuration, controller.calcShotDuration(PumpController::Mode::PulseAndSoak, gAirValue, gTargetValue, gShotDuration));
+	// Fixed ignores the model
+	TEST_ASSERT_EQUAL_FLOAT(gShotDuration, controller.calcShotDuration(PumpController::Mode::Fixed, gTargetValue + 30, gTargetValue, gShotDuration));
+
+	// Waits for the sensor to show the effect
+	TEST_ASSERT_FLOAT_WITHIN(0.001f, 2 * gSamplingInterval - 3, controller.calcSoakDuration(PumpController::Mode::Predictive, 3));
+	TEST_ASSERT_EQUAL_FLOAT(AW_MINIMUM_TIME_BETWEEN_MOTOR_ON, controller.calcSoakDuration(PumpController::Mode::Fixed, 3));
+}
+
+/**
+ * Compares the overshoot, water used and shots per day of the controller modes, for soils with different responses
+ */
+void test_overshoot()
+{
+	constexpr int numSoils = 20;
+	constexpr float days = 3;
+	SimResult results[3][numSoils];
+
+	for (int i = 0; i < numSoils; i++)
+	{
+		Soil soil;
+		for (int mode = 0; mode < 3; mode++)
+		{
+			results[mode][i] = simulate(static_cast<PumpController::Mode>(mode), soil, days);
+		}
+	}
+
+	SimResult totals[3] = {};
+	for (int mode = 0; mode < 3; mode++)
+	{
+		for (int i = 0; i < numSoils; i++)
+		{
+			totals[mode].numShots += results[mode][i].numShots;
+			totals[mode].pumpSeconds += results[mode][i].pumpSeconds;
+			totals[mode].maxShotDuration = std::max(totals[mode].maxShotDuration, results[mode][i].maxShotDuration);
+			totals[mode].avgOvershoot += results[mode][i].avgOvershoot / numSoils;
+			totals[mode].maxOvershoot = std::max(totals[mode].maxOvershoot, results[mode][i].maxOvershoot);
+		}
+
+		TEST_MESSAGE(formatString("%s: %s shots/day, %ss pumping/day, longest shot %ss, overshoot avg=%s%% max=%s%%",
+			PumpController::modeToString(static_cast<PumpController::Mode>(mode)),
+			*FloatToString(totals[mode].numShots / (numSoils * days)),
+			*FloatToString(totals[mode].pumpSeconds / (numSoils * days)),
+			*FloatToString(totals[mode].maxShotDuration),
+			*FloatToString(totals[mode].avgOvershoot),
+			*FloatToString(totals[mode].maxOvershoot)));
+	}
+
+	const SimResult& fixed = totals[static_cast<int>(PumpController::Mode::Fixed)];
+	const SimResult& predictive = totals[static_cast<int>(PumpController::Mode::Predictive)];
+	const SimResult& pulseAndSoak = totals[static_cast<int>(PumpController::Mode::PulseAndSoak)];
+
+	// Overshooting less means less water, and only a fraction of the overshoot
+	TEST_ASSERT_TRUE(predictive.avgOvershoot < fixed.avgOvershoot / 2);
+	TEST_ASSERT_TRUE(pulseAndSoak.avgOvershoot < fixed.avgOvershoot / 2);
+	TEST_ASSERT_TRUE(predictive.pumpSeconds < fixed.pumpSeconds);
+	TEST_ASSERT_TRUE(pulseAndSoak.pumpSeconds < fixed.pumpSeconds);
+
+	// The soils start dry, so the predictive controller needs long shots at first. Pulse and soak gets there with the
+	// same overshoot, in more, shorter shots.
+	TEST_ASSERT_TRUE(predictive.maxShotDuration > gShotDuration);
+	TEST_ASSERT_EQUAL_FLOAT(gShotDuration, pulseAndSoak.maxShotDuration);
+	TEST_ASSERT_TRUE(pulseAndSoak.numShots > predictive.numShots);
+	TEST_ASSERT_FLOAT_WITHIN(0.5f, predictive.avgOvershoot, pulseAndSoak.avgOvershoot);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_withoutModelAllModesAreFixed);
+	RUN_TEST(test_learnsGainAndDelay);
+	RUN_TEST(test_shotAndSoakDuration);
+	RUN_TEST(test_overshoot);
+	return UNITY_END();
+}
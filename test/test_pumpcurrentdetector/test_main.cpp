@@ -0,0 +1,151 @@
+#include "utility/PumpCurrentDetector.h"
+#include "Timer.h"
+#include <unity.h>
+#include <algorithm>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+constexpr uint32_t gSampleRate = AW_PUMP_CURRENT_SENSE_RATE;
+constexpr int gBlockSize = AW_PUMP_CURRENT_SENSE_NUM_SAMPLES;
+constexpr float gNominal = AW_PUMP_DEFAULT_CURRENT_MA;
+constexpr int gNumRuns = 100;
+// How long to keep going after the fault, before considering it undetected
+constexpr float gTimeout = 2.0f;
+// The fault can't be detected before the inrush is over and the fault was confirmed, but should be detected soon after
+constexpr float gMinLatency = AW_PUMP_CURRENT_CONFIRM_MS / 1000.0f;
+constexpr float gMaxLatency = (AW_PUMP_CURRENT_INRUSH_MS + AW_PUMP_CURRENT_CONFIRM_MS + 5 * AW_PUMP_CURRENT_FILTER_MS) / 1000.0f
+	+ gBlockSize / static_cast<float>(gSampleRate);
+
+// Deterministic pseudo random numbers, so the runs are the same every time
+uint32_t gSeed;
+float testRandom()
+{
+	gSeed = gSeed * 1664525u + 1013904223u;
+	return (gSeed >> 8) / static_cast<float>(1 << 24);
+}
+
+struct RunResult
+{
+	PumpCurrentDetector::Fault detected = PumpCurrentDetector::Fault::None;
+	// Time from the fault until it was detected
+	float latency = 0;
+};
+
+/**
+ * Feeds the detector with the waveform, in capture sized blocks, until a fault is detected or the duration is reached
+ */
+RunResult run(PumpCurrentWaveform& waveform, float duration)
+{
+	PumpCurrentDetector detector;
+	detector.start(waveform.nominal);
+
+	RunResult res;
+	float samples[gBlockSize];
+	float t = 0;
+	while (t < duration && res.detected == PumpCurrentDetector::Fault::None)
+	{
+		for (float& s : samples)
+		{
+			s = waveform.sample(t);
+			t += 1.0f / gSampleRate;
+		}
+
+		res.detected = detector.process(samples, gBlockSize, gSampleRate);
+		res.latency = detector.getElapsed() - waveform.faultTime;
+	}
+
+	return res;
+}
+
+/**
+ * Runs the specified fault gNumRuns times, half of them with the fault present from the start (e.g: reservoir already
+ * empty), and the other half with the fault starting at a random time while running.
+ */
+void testFault(PumpCurrentDetector::Fault fault)
+{
+	gSeed = 12345;
+	float maxLatency = 0;
+	for (int i = 0; i < gNumRuns; i++)
+	{
+		PumpCurrentWaveform waveform;
+		waveform.nominal = gNominal;
+		waveform.fault = fault;
+		waveform.faultTime = i % 2 ? testRandom() * 2.0f : 0.0f;
+		waveform.seed = gSeed;
+
+		RunResult res = run(waveform, waveform.faultTime + gTimeout);
+		TEST_ASSERT_EQUAL_STRING(PumpCurrentDetector::faultToString(fault), PumpCurrentDetector::faultToString(res.detected));
+		TEST_ASSERT_TRUE(res.latency >= gMinLatency);
+		maxLatency = std::max(maxLatency, res.latency);
+	}
+
+	TEST_ASSERT_TRUE(maxLatency <= gMaxLatency);
+}
+
+} // namespace
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_stall()
+{
+	testFault(PumpCurrentDetector::Fault::Stall);
+}
+
+void test_dryRun()
+{
+	testFault(PumpCurrentDetector::Fault::DryRun);
+}
+
+void test_openCircuit()
+{
+	testFault(PumpCurrentDetector::Fault::OpenCircuit);
+}
+
+void test_noFalsePositives()
+{
+	for (int i = 0; i < gNumRuns; i++)
+	{
+		PumpCurrentWaveform waveform;
+		waveform.nominal = gNominal;
+		waveform.seed = i + 1;
+
+		RunResult res = run(waveform, 10.0f);
+		TEST_ASSERT_EQUAL_STRING("None", PumpCurrentDetector::faultToString(res.detected));
+	}
+}
+
+void test_inrushIsIgnored()
+{
+	// A normal start peaks well above the stall threshold
+	PumpCurrentWaveform waveform;
+	waveform.nominal = gNominal;
+	TEST_ASSERT_TRUE(waveform.sample(0) > gNominal * AW_PUMP_CURRENT_STALL_PERCENT / 100.0f);
+
+	RunResult res = run(waveform, AW_PUMP_CURRENT_INRUSH_MS / 1000.0f);
+	TEST_ASSERT_EQUAL_STRING("None", PumpCurrentDetector::faultToString(res.detected));
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_stall);
+	RUN_TEST(test_dryRun);
+	RUN_TEST(test_openCircuit);
+	RUN_TEST(test_noFalsePositives);
+	RUN_TEST(test_inrushIsIgnored);
+	return UNITY_END();
+}
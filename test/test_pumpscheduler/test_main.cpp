@@ -0,0 +1,253 @@
+#include "PumpScheduler.h"
+#include "Timer.h"
+#include <unity.h>
+#include <algorithm>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+// Deterministic pseudo random numbers, so the simulation runs the same every time
+uint32_t gSeed;
+int testRandom(int minValue, int maxValue)
+{
+	gSeed = gSeed * 1664525u + 1013904223u;
+	return minValue + static_cast<int>((gSeed >> 8) % static_cast<uint32_t>(maxValue - minValue + 1));
+}
+
+} // namespace
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_staysWithinBudget()
+{
+	TPumpScheduler<3> scheduler(1000, 10);
+	auto a = scheduler.createHandle(600);
+	auto b = scheduler.createHandle(300);
+	auto c = scheduler.createHandle(200);
+
+	TEST_ASSERT_TRUE(a.tryAcquire(true, 0, 0));
+	TEST_ASSERT_TRUE(b.tryAcquire(true, 0, 0));
+	TEST_ASSERT_FALSE(c.tryAcquire(true, 0, 0));
+	TEST_ASSERT_TRUE(c.isQueued());
+	TEST_ASSERT_EQUAL_UINT32(900, scheduler.getUsedCurrent());
+
+	b.release();
+	TEST_ASSERT_TRUE(c.tryAcquire(true, 0, 1));
+	TEST_ASSERT_EQUAL_UINT32(800, scheduler.getUsedCurrent());
+	TEST_ASSERT_EQUAL_INT(0, scheduler.getNumQueued());
+}
+
+void test_pumpOverBudgetRunsAlone()
+{
+	TPumpScheduler<2> scheduler(1000, 10);
+	auto big = scheduler.createHandle(1500);
+	auto small = scheduler.createHandle(100);
+
+	// Nothing else is on, so it's allowed, otherwise it would never run
+	TEST_ASSERT_TRUE(big.tryAcquire(true, 0, 0));
+	TEST_ASSERT_FALSE(small.tryAcquire(true, 0, 0));
+
+	big.release();
+	TEST_ASSERT_TRUE(small.tryAcquire(true, 0, 1));
+}
+
+void test_mostUrgentGoesFirst()
+{
+	TPumpScheduler<3> scheduler(1000, 10);
+	auto running = scheduler.createHandle(1000);
+	auto lowUrgency = scheduler.createHandle(500);
+	auto highUrgency = scheduler.createHandle(500);
+
+	TEST_ASSERT_TRUE(running.tryAcquire(true, 0, 0));
+	TEST_ASSERT_FALSE(lowUrgency.tryAcquire(true, 10, 0));
+	// Waiting for less time, but the urgency is worth more than the 5 seconds difference
+	TEST_ASSERT_FALSE(highUrgency.tryAcquire(true, 20, 5));
+
+	running.release();
+	TEST_ASSERT_FALSE(lowUrgency.tryAcquire(true, 10, 6));
+	TEST_ASSERT_TRUE(highUrgency.tryAcquire(true, 20, 6));
+}
+
+void test_waitingLongerGoesFirst()
+{
+	TPumpScheduler<3> scheduler(1000, 10);
+	auto running = scheduler.createHandle(1000);
+	auto first = scheduler.createHandle(500);
+	auto second = scheduler.createHandle(500);
+
+	TEST_ASSERT_TRUE(running.tryAcquire(true, 0, 0));
+	TEST_ASSERT_FALSE(first.tryAcquire(true, 10, 0));
+	// More urgent, but the first one has been waiting for longer than the difference is worth
+	TEST_ASSERT_FALSE(second.tryAcquire(true, 12, 100));
+
+	running.release();
+	TEST_ASSERT_FALSE(second.tryAcquire(true, 12, 101));
+	TEST_ASSERT_TRUE(first.tryAcquire(true, 10, 101));
+}
+
+void test_smallPumpDoesntSkipTheQueue()
+{
+	TPumpScheduler<3> scheduler(1000, 10);
+	auto running = scheduler.createHandle(600);
+	auto big = scheduler.createHandle(600);
+	auto small = scheduler.createHandle(300);
+
+	TEST_ASSERT_TRUE(running.tryAcquire(true, 0, 0));
+	TEST_ASSERT_FALSE(big.tryAcquire(true, 50, 0));
+	// Fits in what is left, but the big one is waiting and more urgent, so it would starve
+	TEST_ASSERT_FALSE(small.tryAcquire(true, 10, 1));
+	TEST_ASSERT_EQUAL_INT(2, scheduler.getNumQueued());
+}
+
+void test_releaseWhileQueued()
+{
+	TPumpScheduler<2> scheduler(1000, 10);
+	auto running = scheduler.createHandle(1000);
+	auto waiting = scheduler.createHandle(500);
+
+	TEST_ASSERT_TRUE(running.tryAcquire(true, 0, 0));
+	TEST_ASSERT_FALSE(waiting.tryAcquire(true, 0, 0));
+	TEST_ASSERT_EQUAL_INT(1, scheduler.getNumQueued());
+
+	waiting.release();
+	TEST_ASSERT_FALSE(waiting.isActiveOrQueued());
+	TEST_ASSERT_EQUAL_INT(0, scheduler.getNumQueued());
+
+	// Without registering interest, it doesn't get queued
+	TEST_ASSERT_FALSE(waiting.tryAcquire(false, 0, 1));
+	TEST_ASSERT_EQUAL_INT(0, scheduler.getNumQueued());
+}
+
+/**
+ * Simulates pumps with random urgencies, shot durations and current draws, and checks the budget is never exceeded, no
+ * pump waits for longer than the starvation bound, and the heap operations are O(log n)
+ */
+void test_randomPumpsDontStarve()
+{
+	constexpr int numPumps = 12;
+	constexpr uint32_t budget = 1000;
+	constexpr int32_t urgencyWeight = 10;
+	constexpr int maxUrgency = 100;
+	constexpr int maxShot = 30;
+	// Simulated seconds
+	constexpr uint32_t duration = 2*24*60*60;
+
+	using Scheduler = TPumpScheduler<numPumps>;
+	Scheduler scheduler(budget, urgencyWeight);
+
+	struct Pump
+	{
+		Scheduler::Handle handle;
+		bool wants = false;
+		uint16_t urgency;
+		uint32_t waitStart;
+		int shotLeft = 0;
+		int cooldown = 0;
+	} pumps[numPumps];
+
+	gSeed = 12345;
+	for (Pump& p : pumps)
+	{
+		p.handle = scheduler.createHandle(testRandom(200, 900));
+	}
+
+	uint32_t numGrants = 0;
+	uint32_t maxComparisonsPerOp = 0;
+
+	auto countOp = [&](uint32_t comparisonsBefore)
+	{
+		maxComparisonsPerOp = std::max(maxComparisonsPerOp, scheduler.getNumComparisons() - comparisonsBefore);
+	};
+
+	for (uint32_t t = 0; t < duration; t++)
+	{
+		// Rotate who goes first, like the components ticking in different orders
+		int first = testRandom(0, numPumps - 1);
+		for (int n = 0; n < numPumps; n++)
+		{
+			Pump& p = pumps[(first + n) % numPumps];
+			uint32_t comparisons = scheduler.getNumComparisons();
+
+			if (p.handle.isActive())
+			{
+				if (--p.shotLeft <= 0)
+				{
+					p.handle.release();
+					countOp(comparisons);
+					p.wants = false;
+					p.cooldown = testRandom(10, 600);
+				}
+			}
+			else if (p.wants)
+			{
+				// Soil keeps drying while waiting
+				if (testRandom(0, 60) == 0)
+				{
+					p.urgency = std::min(p.urgency + 1, maxUrgency);
+				}
+
+				if (p.handle.tryAcquire(true, p.urgency, t))
+				{
+					// After (maxUrgency-urgency)*weight seconds, nothing that starts waiting can go ahead, and everything
+					// that is ahead holds the pumps for at most maxShot seconds each.
+					uint32_t bound = (maxUrgency - p.urgency) * urgencyWeight + numPumps * maxShot;
+					TEST_ASSERT_LESS_OR_EQUAL_UINT32(bound, t - p.waitStart);
+					numGrants++;
+					p.shotLeft = testRandom(1, maxShot);
+				}
+				countOp(comparisons);
+			}
+			else if (--p.cooldown <= 0)
+			{
+				p.wants = true;
+				p.urgency = testRandom(0, maxUrgency);
+				p.waitStart = t;
+				if (p.handle.tryAcquire(true, p.urgency, t))
+				{
+					numGrants++;
+					p.shotLeft = testRandom(1, maxShot);
+				}
+				countOp(comparisons);
+			}
+
+			TEST_ASSERT_LESS_OR_EQUAL_UINT32(budget, scheduler.getUsedCurrent());
+		}
+	}
+
+	// Pumps need to be waiting a fair amount for this to test anything
+	TEST_ASSERT_GREATER_THAN_UINT32(1000, numGrants);
+
+	// A sift is at most log2(n) levels, with 2 comparisons per level when going down
+	int log2n = 0;
+	while ((1 << log2n) < numPumps)
+	{
+		log2n++;
+	}
+	TEST_ASSERT_LESS_OR_EQUAL_UINT32(4 * log2n + 2, maxComparisonsPerOp);
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_staysWithinBudget);
+	RUN_TEST(test_pumpOverBudgetRunsAlone);
+	RUN_TEST(test_mostUrgentGoesFirst);
+	RUN_TEST(test_waitingLongerGoesFirst);
+	RUN_TEST(test_smallPumpDoesntSkipTheQueue);
+	RUN_TEST(test_releaseWhileQueued);
+	RUN_TEST(test_randomPumpsDontStarve);
+	return UNITY_END();
+}
@@ -0,0 +1,175 @@
+#include "utility/PWMMotorPin.h"
+#include "Timer.h"
+#include <unity.h>
+#include <algorithm>
+#include <memory>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+constexpr uint64_t gStepMicros = AW_PUMP_PWM_RAMP_STEP_MS * 1000;
+constexpr uint64_t gRampUp = AW_PUMP_PWM_RAMP_UP_MS * 1000;
+constexpr uint64_t gRampDown = AW_PUMP_PWM_RAMP_DOWN_MS * 1000;
+// The stagger delay is in whole steps, and limited to what fits in a pin's table
+constexpr int gMaxDelaySteps = ((AW_MAX_SIMULTANEOUS_PUMPS - 1) * AW_PUMP_PWM_STAGGER_MS + AW_PUMP_PWM_RAMP_STEP_MS - 1) / AW_PUMP_PWM_RAMP_STEP_MS;
+constexpr uint64_t gStagger = std::min<uint64_t>((AW_PUMP_PWM_STAGGER_MS * 1000 + gStepMicros - 1) / gStepMicros, gMaxDelaySteps) * gStepMicros;
+constexpr uint16_t gMinDuty = AW_PUMP_PWM_MIN_DUTY * 10;
+
+// Start time of each test. Moved forward on every test, so motors started by a test don't delay the next one
+uint64_t gT0 = 0;
+
+// Checks the duty cycle only goes in one direction between the specified times
+bool isMonotonic(const PWMMotorPin& pin, uint64_t start, uint64_t end, bool up)
+{
+	uint16_t previous = pin.getDuty(start);
+	for (uint64_t t = start; t <= end; t += gStepMicros / 2)
+	{
+		uint16_t duty = pin.getDuty(t);
+		if (up ? duty < previous : duty > previous)
+		{
+			return false;
+		}
+		previous = duty;
+	}
+	return true;
+}
+
+} // namespace
+
+void setUp()
+{
+	gT0 += 60 * 1000000;
+}
+
+void tearDown()
+{
+}
+
+void test_rampUp()
+{
+	auto pin = std::make_unique<PWMMotorPin>(0);
+	TEST_ASSERT_EQUAL_UINT16(0, pin->getDuty(gT0));
+
+	pin->write(PinStatus::HIGH, gT0);
+	TEST_ASSERT_GREATER_OR_EQUAL_UINT16(gMinDuty, pin->getDuty(gT0));
+	TEST_ASSERT_TRUE(isMonotonic(*pin, gT0, gT0 + gRampUp, true));
+	TEST_ASSERT_LESS_THAN_UINT16(1000, pin->getDuty(gT0 + gRampUp / 2));
+	TEST_ASSERT_EQUAL_UINT16(1000, pin->getDuty(gT0 + gRampUp));
+}
+
+void test_rampDown()
+{
+	auto pin = std::make_unique<PWMMotorPin>(0);
+	pin->write(PinStatus::HIGH, gT0);
+
+	const uint64_t tOff = gT0 + gRampUp;
+	pin->write(PinStatus::LOW, tOff);
+	TEST_ASSERT_TRUE(isMonotonic(*pin, tOff, tOff + gRampDown, false));
+	TEST_ASSERT_EQUAL_UINT16(0, pin->getDuty(tOff + gRampDown));
+}
+
+void test_writingTheSameStatusDoesNothing()
+{
+	auto pin = std::make_unique<PWMMotorPin>(0);
+	pin->write(PinStatus::HIGH, gT0);
+	// Doesn't restart the ramp
+	pin->write(PinStatus::HIGH, gT0 + gRampUp);
+	TEST_ASSERT_EQUAL_UINT16(1000, pin->getDuty(gT0 + gRampUp));
+}
+
+void test_startsAreStaggered()
+{
+	auto a = std::make_unique<PWMMotorPin>(0);
+	auto b = std::make_unique<PWMMotorPin>(1);
+
+	// Two motors granted at the same time
+	a->write(PinStatus::HIGH, gT0);
+	b->write(PinStatus::HIGH, gT0);
+	TEST_ASSERT_GREATER_OR_EQUAL_UINT16(gMinDuty, a->getDuty(gT0));
+	// Stagger is 0 if only one pump is allowed at a time
+	if (gStagger)
+	{
+		TEST_ASSERT_EQUAL_UINT16(0, b->getDuty(gT0 + gStagger - 1));
+	}
+	TEST_ASSERT_GREATER_OR_EQUAL_UINT16(gMinDuty, b->getDuty(gT0 + gStagger));
+	TEST_ASSERT_EQUAL_UINT16(1000, b->getDuty(gT0 + gStagger + gRampUp));
+}
+
+void test_turningOffHalfWayContinuesFromTheCurrentDuty()
+{
+	auto pin = std::make_unique<PWMMotorPin>(0);
+	pin->write(PinStatus::HIGH, gT0);
+
+	const uint64_t tOff = gT0 + gRampUp / 2;
+	const uint16_t dutyOff = pin->getDuty(tOff);
+	pin->write(PinStatus::LOW, tOff);
+	TEST_ASSERT_LESS_OR_EQUAL_UINT16(dutyOff, pin->getDuty(tOff));
+	TEST_ASSERT_TRUE(isMonotonic(*pin, tOff, tOff + gRampDown, false));
+	TEST_ASSERT_EQUAL_UINT16(0, pin->getDuty(tOff + gRampDown));
+}
+
+void test_turningOnHalfWayDownContinuesFromTheCurrentDuty()
+{
+	auto pin = std::make_unique<PWMMotorPin>(0);
+	pin->write(PinStatus::HIGH, gT0);
+	const uint64_t tOff = gT0 + gRampUp;
+	pin->write(PinStatus::LOW, tOff);
+
+	// Turning on half way down goes back up from there
+	const uint64_t tOn = tOff + gStepMicros * 2;
+	const uint16_t dutyOn = pin->getDuty(tOn);
+	TEST_ASSERT_GREATER_THAN_UINT16(0, dutyOn);
+	pin->write(PinStatus::HIGH, tOn);
+	TEST_ASSERT_GREATER_OR_EQUAL_UINT16(dutyOn, pin->getDuty(tOn));
+	TEST_ASSERT_TRUE(isMonotonic(*pin, tOn, tOn + gRampUp, true));
+	TEST_ASSERT_EQUAL_UINT16(1000, pin->getDuty(tOn + gRampUp));
+}
+
+void test_timeline()
+{
+	auto a = std::make_unique<PWMMotorPin>(0);
+	auto b = std::make_unique<PWMMotorPin>(1);
+	std::unique_ptr<PWMMotorPin::TimelineEntry[]> timeline(new PWMMotorPin::TimelineEntry[AW_PUMP_PWM_TIMELINE_SIZE]);
+
+	a->write(PinStatus::HIGH, gT0);
+	b->write(PinStatus::HIGH, gT0);
+	const uint64_t tOff = gT0 + gStagger + gRampUp / 2;
+	b->write(PinStatus::LOW, tOff);
+
+	// Off, delayed start, ramp up, and ramp down
+	int numEntries = b->getTimeline(timeline.get(), AW_PUMP_PWM_TIMELINE_SIZE, tOff + gRampDown);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(3, numEntries);
+	// If the timeline is too small to have it all, the oldest entries are gone
+	if (numEntries < AW_PUMP_PWM_TIMELINE_SIZE)
+	{
+		const int startEntry = gStagger ? 1 : 0;
+		TEST_ASSERT_EQUAL_UINT32(gT0 / 1000, timeline[0].timeMs);
+		TEST_ASSERT_EQUAL_UINT32((gT0 + gStagger) / 1000, timeline[startEntry].timeMs);
+		TEST_ASSERT_GREATER_OR_EQUAL_UINT16(gMinDuty, timeline[startEntry].duty);
+	}
+	TEST_ASSERT_EQUAL_UINT16(0, timeline[numEntries - 1].duty);
+	for (int i = 1; i < numEntries; i++)
+	{
+		TEST_ASSERT_GREATER_THAN_UINT32(timeline[i - 1].timeMs, timeline[i].timeMs);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_rampUp);
+	RUN_TEST(test_rampDown);
+	RUN_TEST(test_writingTheSameStatusDoesNothing);
+	RUN_TEST(test_startsAreStaggered);
+	RUN_TEST(test_turningOffHalfWayContinuesFromTheCurrentDuty);
+	RUN_TEST(test_turningOnHalfWayDownContinuesFromTheCurrentDuty);
+	RUN_TEST(test_timeline);
+	return UNITY_END();
+}
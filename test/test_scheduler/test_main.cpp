@@ -0,0 +1,264 @@
+#include "Component.h"
+#include "Timer.h"
+#include <unity.h>
+#include <algorithm>
+
+namespace cz
+{
+	Timer gTimer;
+}
+
+using namespace cz;
+
+namespace
+{
+
+// Names of the components that ticked, in order
+char gTickLog[64];
+int gTickLogSize;
+
+void clearTickLog()
+{
+	gTickLogSize = 0;
+	gTickLog[0] = 0;
+}
+
+class TestComponent : public Component
+{
+  public:
+	TestComponent(char name = '?', float countdown = 60 * 60)
+		: m_countdown(countdown)
+	{
+		m_name[0] = name;
+		m_name[1] = 0;
+	}
+
+	virtual const char* getName() const override
+	{
+		return m_name;
+	}
+
+	virtual float tick(float deltaSeconds) override
+	{
+		ticks++;
+		lastDeltaSeconds = deltaSeconds;
+		if (gTickLogSize < static_cast<int>(sizeof(gTickLog)) - 1)
+		{
+			gTickLog[gTickLogSize++] = m_name[0];
+			gTickLog[gTickLogSize] = 0;
+		}
+		return m_countdown;
+	}
+
+	virtual void onEvent(const Event& evt) override
+	{
+	}
+
+	void setCountdown(float countdown)
+	{
+		m_countdown = countdown;
+	}
+
+	using Component::stopTicking;
+	using Component::startTicking;
+
+	int ticks = 0;
+	float lastDeltaSeconds = 0;
+
+  private:
+	virtual bool initImpl() override
+	{
+		return true;
+	}
+
+	char m_name[2];
+	float m_countdown;
+};
+
+// Ticks the components created since the last call, which are due right away
+void tickNew()
+{
+	Component::tickAll(0);
+	clearTickLog();
+}
+
+// Deterministic pseudo random numbers, so the runs are the same every time
+uint32_t gSeed;
+int testRandom(int minValue, int maxValue)
+{
+	gSeed = gSeed * 1664525u + 1013904223u;
+	return minValue + static_cast<int>((gSeed >> 8) % static_cast<uint32_t>(maxValue - minValue + 1));
+}
+
+} // namespace
+
+void setUp()
+{
+	clearTickLog();
+}
+
+void tearDown()
+{
+}
+
+void test_ticksInDeadlineOrder()
+{
+	TestComponent a('a', 3), b('b', 1.25f), c('c', 2);
+
+	// New components are due right away
+	TEST_ASSERT_EQUAL_FLOAT(1.25f, Component::tickAll(0));
+	TEST_ASSERT_EQUAL_INT(3, gTickLogSize);
+	clearTickLog();
+
+	// Each call ticks whatever is due, and returns how long until the next deadline
+	TEST_ASSERT_EQUAL_FLOAT(0.75f, Component::tickAll(1.25f));
+	TEST_ASSERT_EQUAL_FLOAT(0.5f, Component::tickAll(0.75f));
+	TEST_ASSERT_EQUAL_FLOAT(0.5f, Component::tickAll(0.5f));
+	TEST_ASSERT_EQUAL_FLOAT(0.75f, Component::tickAll(0.5f));
+	TEST_ASSERT_EQUAL_STRING("bcba", gTickLog);
+	TEST_ASSERT_EQUAL_FLOAT(2.0f, c.lastDeltaSeconds);
+
+	// Oversleeping ticks everything that is due, most overdue first, with the real elapsed time
+	clearTickLog();
+	Component::tickAll(10);
+	TEST_ASSERT_EQUAL_STRING("bca", gTickLog);
+	TEST_ASSERT_EQUAL_FLOAT(10.5f, b.lastDeltaSeconds);
+	TEST_ASSERT_EQUAL_FLOAT(11.0f, c.lastDeltaSeconds);
+	TEST_ASSERT_EQUAL_FLOAT(10.0f, a.lastDeltaSeconds);
+}
+
+void test_wakeUp()
+{
+	TestComponent a('a'), b('b');
+	tickNew();
+
+	b.wakeUp();
+	TEST_ASSERT_TRUE(Component::tickAll(0) < 0.001f);
+	// Not due yet, since wakeUp schedules for the next wakeup
+	TEST_ASSERT_EQUAL_STRING("", gTickLog);
+	Component::tickAll(0.001f);
+	TEST_ASSERT_EQUAL_STRING("b", gTickLog);
+	TEST_ASSERT_EQUAL_INT(2, b.ticks);
+	TEST_ASSERT_EQUAL_INT(1, a.ticks);
+
+	// Going back to its normal countdown afterwards
+	TEST_ASSERT_TRUE(Component::tickAll(0) > 60 * 60 - 1);
+}
+
+void test_stopAndStartTicking()
+{
+	TestComponent a('a', 1), b('b', 2);
+	tickNew();
+
+	a.stopTicking();
+	// Waking up a component that isn't ticking does nothing
+	a.wakeUp();
+	TEST_ASSERT_EQUAL_FLOAT(2.0f, Component::tickAll(0));
+	Component::tickAll(10);
+	TEST_ASSERT_EQUAL_STRING("b", gTickLog);
+
+	b.stopTicking();
+	TEST_ASSERT_EQUAL_FLOAT(60 * 60, Component::tickAll(0));
+
+	// Starts ticking again a second later, and the delta doesn't include the time it was stopped
+	clearTickLog();
+	a.startTicking();
+	TEST_ASSERT_EQUAL_FLOAT(1.0f, Component::tickAll(0));
+	Component::tickAll(1);
+	TEST_ASSERT_EQUAL_STRING("a", gTickLog);
+	TEST_ASSERT_EQUAL_FLOAT(1.0f, a.lastDeltaSeconds);
+}
+
+void test_stopTickingFromTick()
+{
+	class SelfStopping : public TestComponent
+	{
+	  public:
+		virtual float tick(float deltaSeconds) override
+		{
+			TestComponent::tick(deltaSeconds);
+			stopTicking();
+			return 0;
+		}
+	} a;
+
+	tickNew();
+	Component::tickAll(60 * 60);
+	TEST_ASSERT_EQUAL_INT(1, a.ticks);
+}
+
+/**
+ * Ticks n components with random countdowns, and checks the work per tick is O(log n), instead of the O(n) of going
+ * through all the components on every wakeup.
+ */
+void test_visitsPerTickAreLogN()
+{
+	constexpr int maxComponents = AW_MAX_NUM_COMPONENTS;
+
+	for (int n = 2; n <= maxComponents; n *= 2)
+	{
+		TestComponent components[maxComponents];
+		gSeed = 12345;
+		for (int i = 0; i < n; i++)
+		{
+			components[i].setCountdown(testRandom(1, 1000) / 100.0f);
+		}
+		for (int i = n; i < maxComponents; i++)
+		{
+			components[i].stopTicking();
+		}
+		tickNew();
+
+		int log2n = 0;
+		while ((1 << log2n) < n)
+		{
+			log2n++;
+		}
+
+		Component::resetSchedulerStats();
+		uint32_t numWakeups = 0;
+		uint32_t numTicks = 0;
+		float countdown = 0;
+		for (int i = 0; i < 1000; i++)
+		{
+			int ticksBefore = 0;
+			for (int j = 0; j < n; j++)
+			{
+				ticksBefore += components[j].ticks;
+			}
+			uint32_t visitsBefore = Component::getSchedulerVisits();
+
+			countdown = Component::tickAll(countdown);
+
+			int ticks = -ticksBefore;
+			for (int j = 0; j < n; j++)
+			{
+				ticks += components[j].ticks;
+			}
+
+			// Each tick is one visit, plus moving the component down the heap while it ticks, and back up after
+			uint32_t visits = Component::getSchedulerVisits() - visitsBefore;
+			TEST_ASSERT_LESS_OR_EQUAL_UINT32(ticks * (2 * log2n + 1), visits);
+			numWakeups++;
+			numTicks += ticks;
+		}
+
+		// Nearly every wakeup ticks a single component, so the average follows the per tick bound, instead of growing
+		// with n
+		uint32_t visitsPerWakeup = Component::getSchedulerVisits() / numWakeups;
+		TEST_MESSAGE(formatString("%d components: %u visits per wakeup (%u ticks in %u wakeups)", n, visitsPerWakeup,
+			numTicks, numWakeups));
+		TEST_ASSERT_LESS_OR_EQUAL_UINT32(2 * log2n + 1, visitsPerWakeup);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_ticksInDeadlineOrder);
+	RUN_TEST(test_wakeUp);
+	RUN_TEST(test_stopAndStartTicking);
+	RUN_TEST(test_stopTickingFromTick);
+	RUN_TEST(test_visitsPerTickAreLogN);
+	return UNITY_END();
+}